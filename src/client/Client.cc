@@ -291,6 +291,7 @@ Client::Client(Messenger *m, MonClient *mc, Objecter *objecter_)
 				  cct->_conf->client_oc_target_dirty,
 				  cct->_conf->client_oc_max_dirty_age,
 				  true));
+  objectcacher->set_max_readahead(cct->_conf->client_oc_readahead_max_bytes);
   objecter_finisher.start();
   filer.reset(new Filer(objecter, &objecter_finisher));
 }
@@ -1126,6 +1127,7 @@ void Client::insert_readdir_results(MetaRequest *request, MetaSession *session,
     }
 
     dirp->buffer_frag = fg;
+    dirp->buffer_stamp = request->sent_stamp;
 
     _readdir_drop_dirp_buffer(dirp);
     dirp->buffer.reserve(numdn);
@@ -7456,6 +7458,16 @@ int Client::_readdir_cache_cb(dir_result_t *dirp, add_dirent_cb_t cb, void *p,
       continue;
     }
 
+    if (caps && !dn->inode->caps_issued_mask(caps) &&
+	cct->_conf->client_readdir_stat_max_age > 0) {
+      // one readdir gets the stat of this and the following entries,
+      // rather than a getattr each.  our position (last_name) is
+      // not where the readdir cache index is, so don't fill it.
+      ldout(cct, 10) << " '" << dn->name << "' lacks caps, fetching" << dendl;
+      dirp->ordered_count = 0;
+      return -EAGAIN;
+    }
+
     int r = _getattr(dn->inode, caps, dirp->perms);
     if (r < 0)
       return r;
@@ -7502,6 +7514,26 @@ int Client::_readdir_cache_cb(dir_result_t *dirp, add_dirent_cb_t cb, void *p,
   return 0;
 }
 
+/*
+ * The stat of an entry in a readdir reply is whatever the MDS had cached
+ * for it.  Unlike a getattr, readdir takes no rdlocks, so it does not
+ * revoke the caps of clients writing to the entry: size and mtime they
+ * still buffer are missing from it.  Trusting it for entries we hold no
+ * caps on saves a round trip to the MDS per entry of a large directory,
+ * at the cost of possibly stale sizes and times for files being written
+ * elsewhere, which is why it is opt-in.  max_age only bounds how old the
+ * reply is, not how stale its stats are.
+ */
+bool Client::_readdir_buffer_is_fresh(dir_result_t *dirp)
+{
+  double max_age = cct->_conf->client_readdir_stat_max_age;
+  if (max_age <= 0)
+    return false;
+  utime_t age = ceph_clock_now();
+  age -= dirp->buffer_stamp;
+  return (double)age < max_age;
+}
+
 int Client::readdir_r_cb(dir_result_t *d, add_dirent_cb_t cb, void *p,
 			 unsigned want, unsigned flags, bool getref)
 {
@@ -7629,7 +7661,7 @@ int Client::readdir_r_cb(dir_result_t *d, add_dirent_cb_t cb, void *p,
       uint64_t next_off = entry.offset + 1;
 
       int r;
-      if (check_caps) {
+      if (check_caps && !_readdir_buffer_is_fresh(dirp)) {
 	r = _getattr(entry.inode, caps, dirp->perms);
 	if (r < 0)
 	  return r;
@@ -8601,6 +8633,7 @@ int Client::_read_async(Fh *f, uint64_t off, uint64_t len, bufferlist *bl)
   Cond cond;
   bool done = false;
   Context *onfinish = new C_SafeCond(&flock, &cond, &done, &rvalue);
+  in->oset.readahead_limit = in->size;
   r = objectcacher->file_read(&in->oset, &in->layout, in->snapid,
 			      off, len, bl, 0, onfinish);
   if (r == 0) {
@@ -201,6 +201,7 @@ struct dir_result_t {
   UserPerm perms;
 
   frag_t buffer_frag;
+  utime_t buffer_stamp;  // when the request that filled buffer was sent
 
   struct dentry {
     int64_t offset;
@@ -740,6 +741,7 @@ private:
   void _readdir_rechoose_frag(dir_result_t *dirp);
   int _readdir_get_frag(dir_result_t *dirp);
   int _readdir_cache_cb(dir_result_t *dirp, add_dirent_cb_t cb, void *p, int caps, bool getref);
+  bool _readdir_buffer_is_fresh(dir_result_t *dirp);
   void _closedir(dir_result_t *dirp);
 
   // other helpers
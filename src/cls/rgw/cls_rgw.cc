@@ -536,6 +536,55 @@ static int write_bucket_header(cls_method_context_t hctx, struct rgw_bucket_dir_
   return cls_cxx_map_write_header(hctx, &header_bl);
 }
 
+/*
+ * While the index is being resharded every change is logged so that it can
+ * be replayed onto the new index, and once the final pass has started no
+ * further changes are accepted.
+ */
+static int check_reshard(const struct rgw_bucket_dir_header& header, bool *log_op)
+{
+  if (header.new_instance.blocks_writes()) {
+    CLS_LOG(10, "%s(): bucket index is being resharded, status=%d", __func__,
+            (int)header.new_instance.reshard_status);
+    return -CLS_RGW_ERR_BUSY_RESHARDING;
+  }
+  if (header.new_instance.resharding()) {
+    *log_op = true;
+  }
+  return 0;
+}
+
+/*
+ * Versioned ops may update the index without logging, so while resharding
+ * log the key up front as a pending entry to get it replayed.
+ */
+static int check_reshard_olh_op(cls_method_context_t hctx, cls_rgw_obj_key& key,
+                                RGWModifyOp op, string& tag)
+{
+  struct rgw_bucket_dir_header header;
+  int ret = read_bucket_header(hctx, &header);
+  if (ret < 0) {
+    CLS_LOG(1, "ERROR: %s(): failed to read header\n", __func__);
+    return ret;
+  }
+
+  bool log_op = false;
+  ret = check_reshard(header, &log_op);
+  if (ret < 0 || !log_op) {
+    return ret;
+  }
+
+  real_time mtime = real_clock::now();
+  rgw_bucket_entry_ver ver;
+  ret = log_index_operation(hctx, key, op, tag, mtime, ver, CLS_RGW_STATE_PENDING_MODIFY,
+                            header.ver, header.max_marker, 0, NULL, NULL);
+  if (ret < 0) {
+    return ret;
+  }
+
+  return write_bucket_header(hctx, &header);
+}
+
 
 int rgw_bucket_rebuild_index(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
 {
@@ -631,6 +680,57 @@ int rgw_bucket_set_tag_timeout(cls_method_context_t hctx, bufferlist *in, buffer
   return write_bucket_header(hctx, &header);
 }
 
+static int rgw_bucket_set_resharding(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
+{
+  // decode request
+  cls_rgw_set_bucket_resharding_op op;
+  bufferlist::iterator iter = in->begin();
+  try {
+    ::decode(op, iter);
+  } catch (buffer::error& err) {
+    CLS_LOG(1, "ERROR: %s(): failed to decode request\n", __func__);
+    return -EINVAL;
+  }
+
+  struct rgw_bucket_dir_header header;
+  int rc = read_bucket_header(hctx, &header);
+  if (rc < 0) {
+    CLS_LOG(1, "ERROR: %s(): failed to read header\n", __func__);
+    return rc;
+  }
+
+  header.new_instance = op.entry;
+
+  return write_bucket_header(hctx, &header);
+}
+
+static int rgw_bucket_get_resharding(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
+{
+  // decode request
+  cls_rgw_get_bucket_resharding_op op;
+  bufferlist::iterator iter = in->begin();
+  try {
+    ::decode(op, iter);
+  } catch (buffer::error& err) {
+    CLS_LOG(1, "ERROR: %s(): failed to decode request\n", __func__);
+    return -EINVAL;
+  }
+
+  struct rgw_bucket_dir_header header;
+  int rc = read_bucket_header(hctx, &header);
+  if (rc < 0) {
+    CLS_LOG(1, "ERROR: %s(): failed to read header\n", __func__);
+    return rc;
+  }
+
+  cls_rgw_get_bucket_resharding_ret op_ret;
+  op_ret.new_instance = header.new_instance;
+
+  ::encode(op_ret, *out);
+
+  return 0;
+}
+
 static int read_key_entry(cls_method_context_t hctx, cls_rgw_obj_key& key, string *idx, struct rgw_bucket_dir_entry *entry,
                           bool special_delete_marker_name = false);
 
@@ -687,6 +787,11 @@ int rgw_bucket_prepare_op(cls_method_context_t hctx, bufferlist *in, bufferlist
     return rc;
   }
 
+  rc = check_reshard(header, &op.log_op);
+  if (rc < 0) {
+    return rc;
+  }
+
   if (op.log_op) {
     rc = log_index_operation(hctx, op.key, op.op, op.tag, entry.meta.mtime,
                              entry.ver, info.state, header.ver, header.max_marker, op.bilog_flags, NULL, NULL);
@@ -803,6 +908,11 @@ int rgw_bucket_complete_op(cls_method_context_t hctx, bufferlist *in, bufferlist
     return -EINVAL;
   }
 
+  rc = check_reshard(header, &op.log_op);
+  if (rc < 0) {
+    return rc;
+  }
+
   struct rgw_bucket_dir_entry entry;
   bool ondisk = true;
 
@@ -1379,11 +1489,16 @@ static int rgw_bucket_link_olh(cls_method_context_t hctx, bufferlist *in, buffer
     return -EINVAL;
   }
 
+  int ret = check_reshard_olh_op(hctx, op.key, CLS_RGW_OP_LINK_OLH, op.op_tag);
+  if (ret < 0) {
+    return ret;
+  }
+
   BIVerObjEntry obj(hctx, op.key);
   BIOLHEntry olh(hctx, op.key);
 
   /* read instance entry */
-  int ret = obj.init(op.delete_marker);
+  ret = obj.init(op.delete_marker);
   bool existed = (ret == 0);
   if (ret == -ENOENT && op.delete_marker) {
     ret = 0;
@@ -1518,6 +1633,11 @@ static int rgw_bucket_link_olh(cls_method_context_t hctx, bufferlist *in, buffer
     return ret;
   }
 
+  ret = check_reshard(header, &op.log_op);
+  if (ret < 0) {
+    return ret;
+  }
+
   if (op.log_op) {
     rgw_bucket_dir_entry& entry = obj.get_dir_entry();
 
@@ -1564,10 +1684,15 @@ static int rgw_bucket_unlink_instance(cls_method_context_t hctx, bufferlist *in,
     dest_key.instance.clear();
   }
 
+  int ret = check_reshard_olh_op(hctx, dest_key, CLS_RGW_OP_UNLINK_INSTANCE, op.op_tag);
+  if (ret < 0) {
+    return ret;
+  }
+
   BIVerObjEntry obj(hctx, dest_key);
   BIOLHEntry olh(hctx, dest_key);
 
-  int ret = obj.init();
+  ret = obj.init();
   if (ret == -ENOENT) {
     return 0; /* already removed */
   }
@@ -1674,6 +1799,11 @@ static int rgw_bucket_unlink_instance(cls_method_context_t hctx, bufferlist *in,
     return ret;
   }
 
+  ret = check_reshard(header, &op.log_op);
+  if (ret < 0) {
+    return ret;
+  }
+
   if (op.log_op) {
     rgw_bucket_entry_ver ver;
     ver.epoch = (op.olh_epoch ? op.olh_epoch : olh.get_epoch());
@@ -3482,6 +3612,8 @@ CLS_INIT(rgw)
   cls_handle_t h_class;
   cls_method_handle_t h_rgw_bucket_init_index;
   cls_method_handle_t h_rgw_bucket_set_tag_timeout;
+  cls_method_handle_t h_rgw_bucket_set_resharding;
+  cls_method_handle_t h_rgw_bucket_get_resharding;
   cls_method_handle_t h_rgw_bucket_list;
   cls_method_handle_t h_rgw_bucket_check_index;
   cls_method_handle_t h_rgw_bucket_rebuild_index;
@@ -3521,6 +3653,8 @@ CLS_INIT(rgw)
   /* bucket index */
   cls_register_cxx_method(h_class, RGW_BUCKET_INIT_INDEX, CLS_METHOD_RD | CLS_METHOD_WR, rgw_bucket_init_index, &h_rgw_bucket_init_index);
   cls_register_cxx_method(h_class, RGW_BUCKET_SET_TAG_TIMEOUT, CLS_METHOD_RD | CLS_METHOD_WR, rgw_bucket_set_tag_timeout, &h_rgw_bucket_set_tag_timeout);
+  cls_register_cxx_method(h_class, RGW_BUCKET_SET_RESHARDING, CLS_METHOD_RD | CLS_METHOD_WR, rgw_bucket_set_resharding, &h_rgw_bucket_set_resharding);
+  cls_register_cxx_method(h_class, RGW_BUCKET_GET_RESHARDING, CLS_METHOD_RD, rgw_bucket_get_resharding, &h_rgw_bucket_get_resharding);
   cls_register_cxx_method(h_class, RGW_BUCKET_LIST, CLS_METHOD_RD, rgw_bucket_list, &h_rgw_bucket_list);
   cls_register_cxx_method(h_class, RGW_BUCKET_CHECK_INDEX, CLS_METHOD_RD, rgw_bucket_check_index, &h_rgw_bucket_check_index);
   cls_register_cxx_method(h_class, RGW_BUCKET_REBUILD_INDEX, CLS_METHOD_RD | CLS_METHOD_WR, rgw_bucket_rebuild_index, &h_rgw_bucket_rebuild_index);
@@ -121,6 +121,18 @@ static bool issue_bucket_set_tag_timeout_op(librados::IoCtx& io_ctx,
   return manager->aio_operate(io_ctx, oid, &op);
 }
 
+static bool issue_bucket_set_resharding_op(librados::IoCtx& io_ctx,
+    const string& oid, const cls_rgw_bucket_instance_entry& entry,
+    BucketIndexAioManager *manager) {
+  bufferlist in;
+  struct cls_rgw_set_bucket_resharding_op call;
+  call.entry = entry;
+  ::encode(call, in);
+  librados::ObjectWriteOperation op;
+  op.exec(RGW_CLASS, RGW_BUCKET_SET_RESHARDING, in);
+  return manager->aio_operate(io_ctx, oid, &op);
+}
+
 int CLSRGWIssueBucketIndexInit::issue_op(int shard_id, const string& oid)
 {
   return issue_bucket_index_init_op(io_ctx, oid, &manager);
@@ -139,6 +151,11 @@ int CLSRGWIssueSetTagTimeout::issue_op(int shard_id, const string& oid)
   return issue_bucket_set_tag_timeout_op(io_ctx, oid, tag_timeout, &manager);
 }
 
+int CLSRGWIssueSetBucketResharding::issue_op(int shard_id, const string& oid)
+{
+  return issue_bucket_set_resharding_op(io_ctx, oid, entry, &manager);
+}
+
 void cls_rgw_bucket_update_stats(librados::ObjectWriteOperation& o, bool absolute,
                                  const map<uint8_t, rgw_bucket_category_stats>& stats)
 {
@@ -211,6 +228,13 @@ int CLSRGWIssueBucketList::issue_op(int shard_id, const string& oid)
   return issue_bucket_list_op(io_ctx, oid, start_obj, filter_prefix, num_entries, list_versions, &manager, &result[shard_id]);
 }
 
+int CLSRGWIssueBucketListShards::issue_op(int shard_id, const string& oid)
+{
+  return issue_bucket_list_op(io_ctx, oid, start_objs.at(shard_id), filter_prefix,
+                              num_entries.at(shard_id), list_versions, &manager,
+                              &result[shard_id]);
+}
+
 void cls_rgw_remove_obj(librados::ObjectWriteOperation& o, list<string>& keep_attr_prefixes)
 {
   bufferlist in;
@@ -276,6 +300,29 @@ int cls_rgw_bi_get(librados::IoCtx& io_ctx, const string oid,
   return 0;
 }
 
+int cls_rgw_get_bucket_resharding(librados::IoCtx& io_ctx, const string& oid,
+                                  cls_rgw_bucket_instance_entry *entry)
+{
+  bufferlist in, out;
+  struct cls_rgw_get_bucket_resharding_op call;
+  ::encode(call, in);
+  int r = io_ctx.exec(oid, RGW_CLASS, RGW_BUCKET_GET_RESHARDING, in, out);
+  if (r < 0)
+    return r;
+
+  struct cls_rgw_get_bucket_resharding_ret op_ret;
+  bufferlist::iterator iter = out.begin();
+  try {
+    ::decode(op_ret, iter);
+  } catch (buffer::error& err) {
+    return -EIO;
+  }
+
+  *entry = op_ret.new_instance;
+
+  return 0;
+}
+
 int cls_rgw_bi_put(librados::IoCtx& io_ctx, const string oid, rgw_cls_bi_entry& entry)
 {
   bufferlist in, out;
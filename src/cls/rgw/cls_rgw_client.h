@@ -308,6 +308,20 @@ public:
     CLSRGWConcurrentIO(ioc, _bucket_objs, _max_aio), tag_timeout(_tag_timeout) {}
 };
 
+class CLSRGWIssueSetBucketResharding : public CLSRGWConcurrentIO {
+  cls_rgw_bucket_instance_entry entry;
+protected:
+  int issue_op(int shard_id, const string& oid) override;
+public:
+  CLSRGWIssueSetBucketResharding(librados::IoCtx& ioc, map<int, string>& _bucket_objs,
+                                 const cls_rgw_bucket_instance_entry& _entry,
+                                 uint32_t _max_aio) :
+    CLSRGWConcurrentIO(ioc, _bucket_objs, _max_aio), entry(_entry) {}
+};
+
+int cls_rgw_get_bucket_resharding(librados::IoCtx& io_ctx, const string& oid,
+                                  cls_rgw_bucket_instance_entry *entry);
+
 void cls_rgw_bucket_update_stats(librados::ObjectWriteOperation& o, bool absolute,
                                  const map<uint8_t, rgw_bucket_category_stats>& stats);
 
@@ -384,6 +398,40 @@ public:
   start_obj(_start_obj), filter_prefix(_filter_prefix), num_entries(_num_entries), list_versions(_list_versions), result(list_results) {}
 };
 
+/**
+ * List each bucket index shard from its own marker.
+ * NOTE: unlike CLSRGWIssueBucketList, every shard keyed in *oids* has its own
+ *       start object and its own number of entries to return, so that an
+ *       ordered listing can go back to only those shards whose entries ran
+ *       out, picking up where each of them stopped.
+ *
+ * start_objs    - marker for each shard, keyed by shard id.
+ * num_entries   - number of entries to request from each shard, keyed by shard id.
+ *
+ * The other arguments are as for CLSRGWIssueBucketList.
+ */
+class CLSRGWIssueBucketListShards : public CLSRGWConcurrentIO {
+  const map<int, cls_rgw_obj_key>& start_objs;
+  string filter_prefix;
+  const map<int, uint32_t>& num_entries;
+  bool list_versions;
+  map<int, rgw_cls_list_ret>& result;
+protected:
+  int issue_op(int shard_id, const string& oid) override;
+public:
+  CLSRGWIssueBucketListShards(librados::IoCtx& io_ctx,
+                              const map<int, cls_rgw_obj_key>& _start_objs,
+                              const string& _filter_prefix,
+                              const map<int, uint32_t>& _num_entries,
+                              bool _list_versions,
+                              map<int, string>& oids,
+                              map<int, struct rgw_cls_list_ret>& list_results,
+                              uint32_t max_aio) :
+  CLSRGWConcurrentIO(io_ctx, oids, max_aio),
+  start_objs(_start_objs), filter_prefix(_filter_prefix), num_entries(_num_entries),
+  list_versions(_list_versions), result(list_results) {}
+};
+
 class CLSRGWIssueBILogList : public CLSRGWConcurrentIO {
   map<int, struct cls_rgw_bi_log_list_ret>& result;
   BucketIndexShardsManager& marker_mgr;
@@ -6,6 +6,9 @@
 
 #define RGW_CLASS "rgw"
 
+/* returned by index updates while the bucket index is being resharded */
+#define CLS_RGW_ERR_BUSY_RESHARDING 2300
+
 #define RGW_BUCKET_INIT_INDEX "bucket_init_index"
 
 
@@ -21,6 +24,8 @@
 #define RGW_BUCKET_READ_OLH_LOG "bucket_read_olh_log"
 #define RGW_BUCKET_TRIM_OLH_LOG "bucket_trim_olh_log"
 #define RGW_BUCKET_CLEAR_OLH "bucket_clear_olh"
+#define RGW_BUCKET_SET_RESHARDING "bucket_set_resharding"
+#define RGW_BUCKET_GET_RESHARDING "bucket_get_resharding"
 
 #define RGW_OBJ_REMOVE "obj_remove"
 #define RGW_OBJ_STORE_PG_VER "obj_store_pg_ver"
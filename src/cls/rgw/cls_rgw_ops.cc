@@ -17,6 +17,43 @@ void rgw_cls_tag_timeout_op::generate_test_instances(list<rgw_cls_tag_timeout_op
   ls.back()->tag_timeout = 23323;
 }
 
+void cls_rgw_set_bucket_resharding_op::dump(Formatter *f) const
+{
+  encode_json("entry", entry, f);
+}
+
+void cls_rgw_set_bucket_resharding_op::generate_test_instances(list<cls_rgw_set_bucket_resharding_op*>& ls)
+{
+  ls.push_back(new cls_rgw_set_bucket_resharding_op);
+  ls.push_back(new cls_rgw_set_bucket_resharding_op);
+  ls.back()->entry.reshard_status = CLS_RGW_RESHARD_IN_PROGRESS;
+  ls.back()->entry.new_bucket_instance_id = "new_instance_id";
+  ls.back()->entry.num_shards = 32;
+}
+
+void cls_rgw_get_bucket_resharding_op::dump(Formatter *f) const
+{
+}
+
+void cls_rgw_get_bucket_resharding_op::generate_test_instances(list<cls_rgw_get_bucket_resharding_op*>& ls)
+{
+  ls.push_back(new cls_rgw_get_bucket_resharding_op);
+}
+
+void cls_rgw_get_bucket_resharding_ret::dump(Formatter *f) const
+{
+  encode_json("new_instance", new_instance, f);
+}
+
+void cls_rgw_get_bucket_resharding_ret::generate_test_instances(list<cls_rgw_get_bucket_resharding_ret*>& ls)
+{
+  ls.push_back(new cls_rgw_get_bucket_resharding_ret);
+  ls.push_back(new cls_rgw_get_bucket_resharding_ret);
+  ls.back()->new_instance.reshard_status = CLS_RGW_RESHARD_DONE;
+  ls.back()->new_instance.new_bucket_instance_id = "new_instance_id";
+  ls.back()->new_instance.num_shards = 32;
+}
+
 void cls_rgw_gc_set_entry_op::dump(Formatter *f) const
 {
   f->dump_unsigned("expiration_secs", expiration_secs);
@@ -28,6 +28,59 @@ struct rgw_cls_tag_timeout_op
 };
 WRITE_CLASS_ENCODER(rgw_cls_tag_timeout_op)
 
+struct cls_rgw_set_bucket_resharding_op
+{
+  cls_rgw_bucket_instance_entry entry;
+
+  void encode(bufferlist &bl) const {
+    ENCODE_START(1, 1, bl);
+    ::encode(entry, bl);
+    ENCODE_FINISH(bl);
+  }
+  void decode(bufferlist::iterator &bl) {
+    DECODE_START(1, bl);
+    ::decode(entry, bl);
+    DECODE_FINISH(bl);
+  }
+  void dump(Formatter *f) const;
+  static void generate_test_instances(list<cls_rgw_set_bucket_resharding_op*>& ls);
+};
+WRITE_CLASS_ENCODER(cls_rgw_set_bucket_resharding_op)
+
+struct cls_rgw_get_bucket_resharding_op
+{
+  void encode(bufferlist &bl) const {
+    ENCODE_START(1, 1, bl);
+    ENCODE_FINISH(bl);
+  }
+  void decode(bufferlist::iterator &bl) {
+    DECODE_START(1, bl);
+    DECODE_FINISH(bl);
+  }
+  void dump(Formatter *f) const;
+  static void generate_test_instances(list<cls_rgw_get_bucket_resharding_op*>& ls);
+};
+WRITE_CLASS_ENCODER(cls_rgw_get_bucket_resharding_op)
+
+struct cls_rgw_get_bucket_resharding_ret
+{
+  cls_rgw_bucket_instance_entry new_instance;
+
+  void encode(bufferlist &bl) const {
+    ENCODE_START(1, 1, bl);
+    ::encode(new_instance, bl);
+    ENCODE_FINISH(bl);
+  }
+  void decode(bufferlist::iterator &bl) {
+    DECODE_START(1, bl);
+    ::decode(new_instance, bl);
+    DECODE_FINISH(bl);
+  }
+  void dump(Formatter *f) const;
+  static void generate_test_instances(list<cls_rgw_get_bucket_resharding_ret*>& ls);
+};
+WRITE_CLASS_ENCODER(cls_rgw_get_bucket_resharding_ret)
+
 struct rgw_cls_obj_prepare_op
 {
   RGWModifyOp op;
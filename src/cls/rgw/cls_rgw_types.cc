@@ -483,6 +483,23 @@ void rgw_bucket_category_stats::dump(Formatter *f) const
   f->dump_unsigned("actual_size", actual_size);
 }
 
+void cls_rgw_bucket_instance_entry::generate_test_instances(list<cls_rgw_bucket_instance_entry*>& o)
+{
+  cls_rgw_bucket_instance_entry *e = new cls_rgw_bucket_instance_entry;
+  e->reshard_status = CLS_RGW_RESHARD_IN_PROGRESS;
+  e->new_bucket_instance_id = "new_instance_id";
+  e->num_shards = 16;
+  o.push_back(e);
+  o.push_back(new cls_rgw_bucket_instance_entry);
+}
+
+void cls_rgw_bucket_instance_entry::dump(Formatter *f) const
+{
+  f->dump_int("reshard_status", (int)reshard_status);
+  f->dump_string("new_bucket_instance_id", new_bucket_instance_id);
+  f->dump_int("num_shards", num_shards);
+}
+
 void rgw_bucket_dir_header::generate_test_instances(list<rgw_bucket_dir_header*>& o)
 {
   list<rgw_bucket_category_stats *> l;
@@ -516,6 +533,7 @@ void rgw_bucket_dir_header::dump(Formatter *f) const
     f->close_section();
   }
   f->close_section();
+  encode_json("new_instance", new_instance, f);
 }
 
 void rgw_bucket_dir::generate_test_instances(list<rgw_bucket_dir*>& o)
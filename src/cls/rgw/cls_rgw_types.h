@@ -597,22 +597,73 @@ struct rgw_bucket_category_stats {
 };
 WRITE_CLASS_ENCODER(rgw_bucket_category_stats)
 
+enum cls_rgw_reshard_status {
+  CLS_RGW_RESHARD_NONE        = 0,
+  CLS_RGW_RESHARD_IN_PROGRESS = 1, /* entries are being copied, all changes are logged */
+  CLS_RGW_RESHARD_BLOCKING    = 2, /* final catch-up pass, changes are refused */
+  CLS_RGW_RESHARD_DONE        = 3, /* index superseded by new_bucket_instance_id */
+};
+
+struct cls_rgw_bucket_instance_entry {
+  uint8_t reshard_status;
+  string new_bucket_instance_id;
+  int32_t num_shards;
+
+  cls_rgw_bucket_instance_entry() : reshard_status(CLS_RGW_RESHARD_NONE), num_shards(-1) {}
+
+  void encode(bufferlist& bl) const {
+    ENCODE_START(1, 1, bl);
+    ::encode(reshard_status, bl);
+    ::encode(new_bucket_instance_id, bl);
+    ::encode(num_shards, bl);
+    ENCODE_FINISH(bl);
+  }
+
+  void decode(bufferlist::iterator& bl) {
+    DECODE_START(1, bl);
+    ::decode(reshard_status, bl);
+    ::decode(new_bucket_instance_id, bl);
+    ::decode(num_shards, bl);
+    DECODE_FINISH(bl);
+  }
+
+  void dump(Formatter *f) const;
+  static void generate_test_instances(list<cls_rgw_bucket_instance_entry*>& o);
+
+  void clear() {
+    reshard_status = CLS_RGW_RESHARD_NONE;
+    new_bucket_instance_id.clear();
+    num_shards = -1;
+  }
+
+  bool resharding() const {
+    return reshard_status != CLS_RGW_RESHARD_NONE;
+  }
+  bool blocks_writes() const {
+    return reshard_status == CLS_RGW_RESHARD_BLOCKING ||
+           reshard_status == CLS_RGW_RESHARD_DONE;
+  }
+};
+WRITE_CLASS_ENCODER(cls_rgw_bucket_instance_entry)
+
 struct rgw_bucket_dir_header {
   map<uint8_t, rgw_bucket_category_stats> stats;
   uint64_t tag_timeout;
   uint64_t ver;
   uint64_t master_ver;
   string max_marker;
+  cls_rgw_bucket_instance_entry new_instance;
 
   rgw_bucket_dir_header() : tag_timeout(0), ver(0), master_ver(0) {}
 
   void encode(bufferlist &bl) const {
-    ENCODE_START(5, 2, bl);
+    ENCODE_START(6, 2, bl);
     ::encode(stats, bl);
     ::encode(tag_timeout, bl);
     ::encode(ver, bl);
     ::encode(master_ver, bl);
     ::encode(max_marker, bl);
+    ::encode(new_instance, bl);
     ENCODE_FINISH(bl);
   }
   void decode(bufferlist::iterator &bl) {
@@ -632,6 +683,11 @@ struct rgw_bucket_dir_header {
     if (struct_v >= 5) {
       ::decode(max_marker, bl);
     }
+    if (struct_v >= 6) {
+      ::decode(new_instance, bl);
+    } else {
+      new_instance.clear();
+    }
     DECODE_FINISH(bl);
   }
   void dump(Formatter *f) const;
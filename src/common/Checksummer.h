@@ -4,7 +4,10 @@
 #ifndef CEPH_OS_BLUESTORE_CHECKSUMMER
 #define CEPH_OS_BLUESTORE_CHECKSUMMER
 
+#include <algorithm>
+
 #include "include/buffer.h"
+#include "include/crc32c.h"
 #include "xxHash/xxhash.h"
 
 class Checksummer {
@@ -18,6 +21,10 @@ public:
     CSUM_CRC32C_8 = 6,  // low 8 bits of crc32c
     CSUM_MAX,
   };
+  // number of csum values calculated/compared per round
+  enum {
+    CSUM_BATCH = 64,
+  };
   static const char *get_csum_type_string(unsigned t) {
     switch (t) {
     case CSUM_NONE: return "none";
@@ -87,6 +94,27 @@ public:
       ) {
       return p.crc32c(len, init_value);
     }
+
+    static void calc_blocks(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      size_t blocks,
+      const char *data,
+      value_t *pv
+      ) {
+      uint32_t crcs[CSUM_BATCH];
+      while (blocks > 0) {
+	size_t n = std::min<size_t>(blocks, CSUM_BATCH);
+	ceph_crc32c_multi(init_value, (unsigned char const *)data, len, n, crcs);
+	for (size_t i = 0; i < n; ++i) {
+	  pv[i] = crcs[i];
+	}
+	data += n * len;
+	pv += n;
+	blocks -= n;
+      }
+    }
   };
 
   struct crc32c_16 {
@@ -108,6 +136,27 @@ public:
       ) {
       return p.crc32c(len, init_value) & 0xffff;
     }
+
+    static void calc_blocks(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      size_t blocks,
+      const char *data,
+      value_t *pv
+      ) {
+      uint32_t crcs[CSUM_BATCH];
+      while (blocks > 0) {
+	size_t n = std::min<size_t>(blocks, CSUM_BATCH);
+	ceph_crc32c_multi(init_value, (unsigned char const *)data, len, n, crcs);
+	for (size_t i = 0; i < n; ++i) {
+	  pv[i] = crcs[i] & 0xffff;
+	}
+	data += n * len;
+	pv += n;
+	blocks -= n;
+      }
+    }
   };
 
   struct crc32c_8 {
@@ -129,6 +178,27 @@ public:
       ) {
       return p.crc32c(len, init_value) & 0xff;
     }
+
+    static void calc_blocks(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      size_t blocks,
+      const char *data,
+      value_t *pv
+      ) {
+      uint32_t crcs[CSUM_BATCH];
+      while (blocks > 0) {
+	size_t n = std::min<size_t>(blocks, CSUM_BATCH);
+	ceph_crc32c_multi(init_value, (unsigned char const *)data, len, n, crcs);
+	for (size_t i = 0; i < n; ++i) {
+	  pv[i] = crcs[i] & 0xff;
+	}
+	data += n * len;
+	pv += n;
+	blocks -= n;
+      }
+    }
   };
 
   struct xxhash32 {
@@ -158,6 +228,20 @@ public:
       }
       return XXH32_digest(state);
     }
+
+    static void calc_blocks(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      size_t blocks,
+      const char *data,
+      value_t *pv
+      ) {
+      while (blocks--) {
+	*pv++ = XXH32(data, len, init_value);
+	data += len;
+      }
+    }
   };
 
   struct xxhash64 {
@@ -187,8 +271,53 @@ public:
       }
       return XXH64_digest(state);
     }
+
+    static void calc_blocks(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      size_t blocks,
+      const char *data,
+      value_t *pv
+      ) {
+      while (blocks--) {
+	*pv++ = XXH64(data, len, init_value);
+	data += len;
+      }
+    }
   };
 
+  /**
+   * calculate csums of consecutive blocks starting at p into pv
+   *
+   * Runs of blocks that sit in a single contiguous buffer are handed to
+   * Alg::calc_blocks in one go (which may checksum several of them in
+   * parallel); only blocks that straddle buffer boundaries go through
+   * the bufferlist iterator one at a time.
+   */
+  template<class Alg>
+  static void calc_range(
+    typename Alg::state_t state,
+    typename Alg::init_value_t init_value,
+    size_t csum_block_size,
+    size_t blocks,
+    bufferlist::const_iterator& p,
+    typename Alg::value_t *pv) {
+    while (blocks > 0) {
+      bufferptr cur = p.get_current_ptr();
+      size_t n = std::min<size_t>(blocks, cur.length() / csum_block_size);
+      if (n > 0) {
+	Alg::calc_blocks(state, init_value, csum_block_size, n, cur.c_str(), pv);
+	p.advance(n * csum_block_size);
+      } else {
+	*pv = Alg::calc(state, init_value, csum_block_size, p);
+	n = 1;
+      }
+      pv += n;
+      blocks -= n;
+    }
+  }
+
   template<class Alg>
   static int calculate(
     size_t csum_block_size,
@@ -222,10 +351,7 @@ public:
     typename Alg::value_t *pv =
       reinterpret_cast<typename Alg::value_t*>(csum_data->c_str());
     pv += offset / csum_block_size;
-    while (blocks--) {
-      *pv = Alg::calc(state, init_value, csum_block_size, p);
-      ++pv;
-    }
+    calc_range<Alg>(state, init_value, csum_block_size, blocks, p, pv);
     Alg::fini(&state);
     return 0;
   }
@@ -250,18 +376,22 @@ public:
       reinterpret_cast<const typename Alg::value_t*>(csum_data.c_str());
     pv += offset / csum_block_size;
     size_t pos = offset;
+    typename Alg::value_t v[CSUM_BATCH];
     while (length > 0) {
-      typename Alg::value_t v = Alg::calc(state, -1, csum_block_size, p);
-      if (*pv != v) {
-	if (bad_csum) {
-	  *bad_csum = v;
+      size_t n = std::min<size_t>(length / csum_block_size, CSUM_BATCH);
+      calc_range<Alg>(state, -1, csum_block_size, n, p, v);
+      for (size_t i = 0; i < n; ++i) {
+	if (pv[i] != v[i]) {
+	  if (bad_csum) {
+	    *bad_csum = v[i];
+	  }
+	  Alg::fini(&state);
+	  return pos + i * csum_block_size;
 	}
-	Alg::fini(&state);
-	return pos;
       }
-      ++pv;
-      pos += csum_block_size;
-      length -= csum_block_size;
+      pv += n;
+      pos += n * csum_block_size;
+      length -= n * csum_block_size;
     }
     Alg::fini(&state);
     return -1;  // no errors
@@ -0,0 +1,97 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_COMMON_MPSCQUEUE_H
+#define CEPH_COMMON_MPSCQUEUE_H
+
+#include <atomic>
+#include <utility>
+
+namespace ceph {
+
+  /**
+   * Lock-free multi-producer, single-consumer queue
+   *
+   * Producers push() with a single compare-and-swap on the head of a
+   * singly linked list.  The consumer never pops individual items: it
+   * detaches the whole list at once with drain(), which reverses it
+   * and hands the items to a callback in the order they were pushed.
+   * Because nodes are only ever detached all together there is no
+   * ABA hazard.
+   *
+   * push() reports whether the queue was empty beforehand, so callers
+   * can wake the consumer once per batch instead of once per item.
+   * The head is accessed sequentially consistently so that a producer
+   * checking some other state after push() and a consumer checking
+   * empty() after changing that state cannot both miss each other.
+   */
+  template <typename T>
+  class MPSCQueue {
+    struct Node {
+      Node *next = nullptr;
+      T item;
+      explicit Node(T&& i) : item(std::move(i)) {}
+    };
+
+    std::atomic<Node*> head = {nullptr};
+
+  public:
+    MPSCQueue() = default;
+    MPSCQueue(const MPSCQueue&) = delete;
+    MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+    ~MPSCQueue() {
+      drain([](T&&) {});
+    }
+
+    /// queue an item; returns true if the queue was empty before
+    bool push(T&& item) {
+      Node *n = new Node(std::move(item));
+      Node *old = head.load(std::memory_order_relaxed);
+      do {
+	n->next = old;
+      } while (!head.compare_exchange_weak(old, n));
+      return old == nullptr;
+    }
+
+    bool empty() const {
+      return head.load() == nullptr;
+    }
+
+    /// consumer only: pass every queued item to f in push order
+    template <typename F>
+    unsigned drain(F&& f) {
+      Node *n = head.exchange(nullptr);
+      if (!n)
+	return 0;
+      Node *fifo = nullptr;
+      while (n) {
+	Node *next = n->next;
+	n->next = fifo;
+	fifo = n;
+	n = next;
+      }
+      unsigned count = 0;
+      while (fifo) {
+	Node *next = fifo->next;
+	f(std::move(fifo->item));
+	delete fifo;
+	fifo = next;
+	++count;
+      }
+      return count;
+    }
+  };
+
+} // namespace ceph
+
+#endif // CEPH_COMMON_MPSCQUEUE_H
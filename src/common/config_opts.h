@@ -234,6 +234,13 @@ OPTION(ms_async_set_affinity, OPT_BOOL, true)
 // core
 OPTION(ms_async_affinity_cores, OPT_STR, "")
 OPTION(ms_async_send_inline, OPT_BOOL, false)
+// coalesce queued messages into one sendmsg until this many bytes are pending
+OPTION(ms_async_send_batch_bytes, OPT_U64, 128 << 10)
+// per-worker pool of page-aligned buffers that message data is received
+// into; 0 disables the pool.  Chunks are kept until the messenger shuts
+// down, so each worker may pin this much memory once it has been used.
+OPTION(ms_async_rx_buffer_pool_size, OPT_U64, 0)
+OPTION(ms_async_rx_buffer_chunk_size, OPT_U32, 64 << 10)
 OPTION(ms_async_rdma_device_name, OPT_STR, "")
 OPTION(ms_async_rdma_enable_hugepage, OPT_BOOL, false)
 OPTION(ms_async_rdma_buffer_size, OPT_INT, 128 << 10)
@@ -450,6 +457,7 @@ OPTION(client_oc_max_dirty, OPT_INT, 1024*1024* 100)    // MB * n  (dirty OR tx.
 OPTION(client_oc_target_dirty, OPT_INT, 1024*1024* 8) // target dirty (keep this smallish)
 OPTION(client_oc_max_dirty_age, OPT_DOUBLE, 5.0)      // max age in cache before writeback
 OPTION(client_oc_max_objects, OPT_INT, 1000)      // max objects in cache
+OPTION(client_oc_readahead_max_bytes, OPT_LONGLONG, 0) // largest window the cache reads ahead of sequential reads; 0 to disable
 OPTION(client_debug_getattr_caps, OPT_BOOL, false) // check if MDS reply contains wanted caps
 OPTION(client_debug_force_sync_read, OPT_BOOL, false)     // always read synchronously (go to osds)
 OPTION(client_debug_inject_tick_delay, OPT_INT, 0) // delay the client tick for a number of seconds
@@ -460,6 +468,7 @@ OPTION(client_metadata, OPT_STR, "")
 OPTION(client_acl_type, OPT_STR, "")
 OPTION(client_permissions, OPT_BOOL, true)
 OPTION(client_dirsize_rbytes, OPT_BOOL, true)
+OPTION(client_readdir_stat_max_age, OPT_DOUBLE, 0) // seconds readdirplus may use the stat from a readdir reply instead of a getattr per entry without caps; 0 (default) to always getattr
 
 // note: the max amount of "in flight" dirty data is roughly (max - target)
 OPTION(fuse_use_invalidate_cb, OPT_BOOL, true) // use fuse 2.8+ invalidate callback to keep page cache consistent
@@ -528,6 +537,7 @@ OPTION(mds_dirstat_min_interval, OPT_FLOAT, 1)    // try to avoid propagating mo
 OPTION(mds_scatter_nudge_interval, OPT_FLOAT, 5)  // how quickly dirstat changes propagate up the hierarchy
 OPTION(mds_client_prealloc_inos, OPT_INT, 1000)
 OPTION(mds_early_reply, OPT_BOOL, true)
+OPTION(mds_batch_getattr_lookup, OPT_BOOL, false) // answer concurrent identical getattr/lookup requests together (experimental)
 OPTION(mds_default_dir_hash, OPT_INT, CEPH_STR_HASH_RJENKINS)
 OPTION(mds_log_pause, OPT_BOOL, false)
 OPTION(mds_log_skip_corrupt_events, OPT_BOOL, false)
@@ -754,9 +764,27 @@ OPTION(osd_disk_thread_ioprio_priority, OPT_INT, -1) // 0-7
 OPTION(osd_recover_clone_overlap, OPT_BOOL, true)   // preserve clone_overlap during recovery/migration
 OPTION(osd_op_num_threads_per_shard, OPT_INT, 2)
 OPTION(osd_op_num_shards, OPT_INT, 5)
-OPTION(osd_op_queue, OPT_STR, "wpq") // PrioritzedQueue (prio), Weighted Priority Queue (wpq), or debug_random
+OPTION(osd_op_queue, OPT_STR, "wpq") // PrioritzedQueue (prio), Weighted Priority Queue (wpq), mClock by op class (mclock_opclass), mClock by client and op class (mclock_client), or debug_random
 OPTION(osd_op_queue_cut_off, OPT_STR, "low") // Min priority to go to strict queue. (low, high, debug_random)
 
+// mClock reservation (ops/sec), weight and limit (ops/sec, 0 for none)
+// of each op class when osd_op_queue is mclock_opclass or mclock_client
+OPTION(osd_op_queue_mclock_client_op_res, OPT_DOUBLE, 1000.0)
+OPTION(osd_op_queue_mclock_client_op_wgt, OPT_DOUBLE, 500.0)
+OPTION(osd_op_queue_mclock_client_op_lim, OPT_DOUBLE, 0.0)
+OPTION(osd_op_queue_mclock_osd_subop_res, OPT_DOUBLE, 1000.0)
+OPTION(osd_op_queue_mclock_osd_subop_wgt, OPT_DOUBLE, 500.0)
+OPTION(osd_op_queue_mclock_osd_subop_lim, OPT_DOUBLE, 0.0)
+OPTION(osd_op_queue_mclock_snap_res, OPT_DOUBLE, 0.0)
+OPTION(osd_op_queue_mclock_snap_wgt, OPT_DOUBLE, 1.0)
+OPTION(osd_op_queue_mclock_snap_lim, OPT_DOUBLE, 0.001)
+OPTION(osd_op_queue_mclock_recov_res, OPT_DOUBLE, 0.0)
+OPTION(osd_op_queue_mclock_recov_wgt, OPT_DOUBLE, 1.0)
+OPTION(osd_op_queue_mclock_recov_lim, OPT_DOUBLE, 0.001)
+OPTION(osd_op_queue_mclock_scrub_res, OPT_DOUBLE, 0.0)
+OPTION(osd_op_queue_mclock_scrub_wgt, OPT_DOUBLE, 1.0)
+OPTION(osd_op_queue_mclock_scrub_lim, OPT_DOUBLE, 0.001)
+
 OPTION(osd_ignore_stale_divergent_priors, OPT_BOOL, false) // do not assert on divergent_prior entries which aren't in the log and whose on-disk objects are newer
 
 // Set to true for testing.  Users should NOT set this.
@@ -764,6 +792,11 @@ OPTION(osd_ignore_stale_divergent_priors, OPT_BOOL, false) // do not assert on d
 // decode the object, any error will be reported.
 OPTION(osd_read_ec_check_for_errors, OPT_BOOL, false) // return error if any ec shard has an error
 
+// Apply an overwrite that falls within a single data chunk by updating
+// the coding chunks from the change to that chunk, instead of reading
+// and re-encoding the whole stripe, when the plugin supports it
+OPTION(osd_ec_parity_delta_writes, OPT_BOOL, false)
+
 // Only use clone_overlap for recovery if there are fewer than
 // osd_recover_clone_overlap_limit entries in the overlap set
 OPTION(osd_recover_clone_overlap_limit, OPT_INT, 10)
@@ -859,6 +892,7 @@ OPTION(osd_min_pg_log_entries, OPT_U32, 3000)  // number of entries to keep in t
 OPTION(osd_max_pg_log_entries, OPT_U32, 10000) // max entries, say when degraded, before we trim
 OPTION(osd_force_recovery_pg_log_entries_factor, OPT_FLOAT, 1.3) // max entries factor before force recovery
 OPTION(osd_pg_log_trim_min, OPT_U32, 100)
+OPTION(osd_pg_log_journal_max_bytes, OPT_U64, 0) // if > 0, append new log entries to the pgmeta object data and checkpoint them to omap past this size
 OPTION(osd_op_complaint_time, OPT_FLOAT, 30) // how many seconds old makes an op complaint-worthy
 OPTION(osd_command_max_records, OPT_INT, 256)
 OPTION(osd_max_pg_blocked_by, OPT_U32, 16)    // max peer osds to report that are blocking our progress
@@ -978,6 +1012,8 @@ OPTION(osd_recovery_op_warn_multiple, OPT_U32, 16)
 OPTION(osd_mon_shutdown_timeout, OPT_DOUBLE, 5)
 
 OPTION(osd_max_object_size, OPT_U64, 100*1024L*1024L*1024L) // OSD's maximum object size
+OPTION(osd_memory_target, OPT_U64, 4ULL*1024*1024*1024) // mempool tracked memory plus kv cache the OSD aims for (bluestore_cache_autotune)
+OPTION(osd_memory_cache_min, OPT_U64, 128*1024*1024) // never shrink the caches below this, whatever osd_memory_target says
 OPTION(osd_max_object_name_len, OPT_U32, 2048) // max rados object name len
 OPTION(osd_max_object_namespace_len, OPT_U32, 256) // max rados object namespace len
 OPTION(osd_max_attr_name_len, OPT_U32, 100)    // max rados attr name len; cannot go higher than 100 chars for file system backends
@@ -1013,6 +1049,8 @@ OPTION(bdev_inject_crash_flush_delay, OPT_INT, 2) // wait N more seconds on flus
 OPTION(bdev_aio, OPT_BOOL, true)
 OPTION(bdev_aio_poll_ms, OPT_INT, 250)  // milliseconds
 OPTION(bdev_aio_max_queue_depth, OPT_INT, 1024)
+OPTION(bdev_ioring, OPT_BOOL, false)  // use io_uring instead of libaio for KernelDevice aio
+OPTION(bdev_ioring_sqthread_poll, OPT_BOOL, false)  // have a kernel thread poll the io_uring submission queue
 OPTION(bdev_block_size, OPT_INT, 4096)
 OPTION(bdev_debug_aio, OPT_BOOL, false)
 OPTION(bdev_debug_aio_suicide_timeout, OPT_FLOAT, 60.0)
@@ -1081,8 +1119,11 @@ OPTION(bluestore_max_alloc_size, OPT_U32, 0)
 OPTION(bluestore_prefer_deferred_size, OPT_U32, 0)
 OPTION(bluestore_prefer_deferred_size_hdd, OPT_U32, 32768)
 OPTION(bluestore_prefer_deferred_size_ssd, OPT_U32, 0)
+// pack new objects written in one go up to this size into a shared
+// allocation unit instead of giving each its own; 0 disables packing
+OPTION(bluestore_pack_max_object_size, OPT_U32, 0)
 OPTION(bluestore_compression_mode, OPT_STR, "none")  // force|aggressive|passive|none
-OPTION(bluestore_compression_algorithm, OPT_STR, "snappy")
+OPTION(bluestore_compression_algorithm, OPT_STR, "snappy")  // snappy|zlib|zstd|lz4
 OPTION(bluestore_compression_min_blob_size, OPT_U32, 0)
 OPTION(bluestore_compression_min_blob_size_hdd, OPT_U32, 128*1024)
 OPTION(bluestore_compression_min_blob_size_ssd, OPT_U32, 8*1024)
@@ -1123,6 +1164,9 @@ OPTION(bluestore_2q_cache_kin_ratio, OPT_DOUBLE, .5)    // kin page slot size /
 OPTION(bluestore_2q_cache_kout_ratio, OPT_DOUBLE, .5)   // number of kout page slot / total number of page slot
 OPTION(bluestore_cache_size, OPT_U64, 1024*1024*1024)
 OPTION(bluestore_cache_meta_ratio, OPT_DOUBLE, .9)
+OPTION(bluestore_cache_autotune, OPT_BOOL, false) // size kv, onode and buffer caches from osd_memory_target and their miss rates
+OPTION(bluestore_cache_autotune_interval, OPT_DOUBLE, 5) // seconds between rebalances
+OPTION(bluestore_cache_autotune_chunk_size, OPT_U64, 32*1024*1024) // bytes moved between caches per rebalance
 OPTION(bluestore_kvbackend, OPT_STR, "rocksdb")
 OPTION(bluestore_allocator, OPT_STR, "bitmap")     // stupid | bitmap
 OPTION(bluestore_freelist_blocks_per_key, OPT_INT, 128)
@@ -1342,6 +1386,7 @@ OPTION(rbd_cache_max_dirty, OPT_LONGLONG, 24<<20)    // dirty limit in bytes - s
 OPTION(rbd_cache_target_dirty, OPT_LONGLONG, 16<<20) // target dirty limit in bytes
 OPTION(rbd_cache_max_dirty_age, OPT_FLOAT, 1.0)      // seconds in cache before writeback starts
 OPTION(rbd_cache_max_dirty_object, OPT_INT, 0)       // dirty limit for objects - set to 0 for auto calculate from rbd_cache_size
+OPTION(rbd_cache_readahead_max_bytes, OPT_LONGLONG, 0) // largest window the cache reads ahead of sequential reads, in whole objects; 0 (default) to leave readahead to rbd_readahead_*
 OPTION(rbd_cache_block_writes_upfront, OPT_BOOL, false) // whether to block writes to the cache before the aio_write call completes (true), or block before the aio completion is called (false)
 OPTION(rbd_concurrent_management_ops, OPT_INT, 10) // how many operations can be in flight for a management operation like deleting or resizing an image
 OPTION(rbd_balance_snap_reads, OPT_BOOL, false)
@@ -1363,6 +1408,11 @@ OPTION(rbd_validate_names, OPT_BOOL, true) // true if image specs should be vali
 OPTION(rbd_auto_exclusive_lock_until_manual_request, OPT_BOOL, true) // whether to automatically acquire/release exclusive lock until it is explicitly requested, i.e. before we know the user of librbd is properly using the lock API
 OPTION(rbd_mirroring_resync_after_disconnect, OPT_BOOL, false) // automatically start image resync after mirroring is disconnected due to being laggy
 OPTION(rbd_mirroring_replay_delay, OPT_INT, 0) // time-delay in seconds for rbd-mirror asynchronous replication
+OPTION(rbd_persistent_cache, OPT_BOOL, false) // whether to enable the persistent write-back cache for writable image heads; replaces rbd_cache
+OPTION(rbd_persistent_cache_path, OPT_STR, "/var/lib/ceph/rbd-persistent-cache") // directory (ideally on local flash, private to the client user) holding persistent cache logs; created 0700 if missing
+OPTION(rbd_persistent_cache_size, OPT_U64, 1<<30) // size in bytes of a new persistent cache log
+OPTION(rbd_shared_parent_cache, OPT_BOOL, false) // whether to cache parent image objects in a host-local directory shared by all clients
+OPTION(rbd_shared_parent_cache_path, OPT_STR, "/var/lib/ceph/rbd-parent-cache") // directory (ideally on local flash or tmpfs, private to the client user) holding cached parent objects; created 0700 if missing
 
 /*
  * The following options change the behavior for librbd's image creation methods that
@@ -1459,6 +1509,16 @@ OPTION(rgw_override_bucket_index_max_shards, OPT_U32, 0)
  */
 OPTION(rgw_bucket_index_max_aio, OPT_U32, 8)
 
+/**
+ * Dynamic resharding: when a bucket index holds more than
+ * rgw_max_objs_per_shard entries per shard, the bucket is queued and its
+ * index is copied into a larger shard layout in the background.
+ */
+OPTION(rgw_dynamic_resharding, OPT_BOOL, true)
+OPTION(rgw_max_objs_per_shard, OPT_U32, 100000)
+OPTION(rgw_reshard_thread_interval, OPT_U32, 60) // seconds between reshard queue scans
+OPTION(rgw_reshard_bucket_lock_duration, OPT_U32, 120) // seconds, renewed while a reshard makes progress
+
 /**
  * whether or not the quota/gc threads should be started
  */
@@ -1471,6 +1531,7 @@ OPTION(rgw_data, OPT_STR, "/var/lib/ceph/radosgw/$cluster-$id")
 OPTION(rgw_enable_apis, OPT_STR, "s3, s3website, swift, swift_auth, admin")
 OPTION(rgw_cache_enabled, OPT_BOOL, true)   // rgw cache enabled
 OPTION(rgw_cache_lru_size, OPT_INT, 10000)   // num of entries in rgw cache
+OPTION(rgw_cache_shards, OPT_INT, 16)   // num of lock-striped partitions the rgw cache entries are split across
 OPTION(rgw_socket_path, OPT_STR, "")   // path to unix domain socket, if not specified, rgw will not run as external fcgi
 OPTION(rgw_host, OPT_STR, "")  // host for radosgw, can be an IP, default is 0.0.0.0
 OPTION(rgw_port, OPT_STR, "")  // port to listen, format as "8080" "5000", if not specified, rgw will not run external fcgi
@@ -1480,6 +1541,7 @@ OPTION(rgw_content_length_compat, OPT_BOOL, false) // Check both HTTP_CONTENT_LE
 OPTION(rgw_lifecycle_work_time, OPT_STR, "00:00-06:00") //job process lc  at 00:00-06:00s
 OPTION(rgw_lc_lock_max_time, OPT_INT, 60)  // total run time for a single lc processor work
 OPTION(rgw_lc_max_objs, OPT_INT, 32)
+OPTION(rgw_lc_max_worker, OPT_INT, 3)  // number of lc shards processed concurrently
 OPTION(rgw_lc_debug_interval, OPT_INT, -1)  // Debug run interval, in seconds
 OPTION(rgw_script_uri, OPT_STR, "") // alternative value for SCRIPT_URI if not set in request
 OPTION(rgw_request_uri, OPT_STR,  "") // alternative value for REQUEST_URI if not set in request
@@ -1599,6 +1661,8 @@ OPTION(rgw_gc_max_objs, OPT_INT, 32)
 OPTION(rgw_gc_obj_min_wait, OPT_INT, 2 * 3600)    // wait time before object may be handled by gc
 OPTION(rgw_gc_processor_max_time, OPT_INT, 3600)  // total run time for a single gc processor work
 OPTION(rgw_gc_processor_period, OPT_INT, 3600)  // gc processor cycle time
+OPTION(rgw_gc_max_worker, OPT_INT, 4)  // number of gc shards processed concurrently
+OPTION(rgw_gc_max_concurrent_io, OPT_INT, 16)  // max in-flight tail object deletes per gc worker
 OPTION(rgw_s3_success_create_obj_status, OPT_INT, 0) // alternative success status response for create-obj (0 - default)
 OPTION(rgw_resolve_cname, OPT_BOOL, false)  // should rgw try to resolve hostname as a dns cname record
 OPTION(rgw_obj_stripe_size, OPT_INT, 4 << 20)
@@ -1701,6 +1765,7 @@ OPTION(rgw_crypt_s3_kms_encryption_keys, OPT_STR, "") // extra keys that may be
                                                       // defined as map "key1=YmluCmJvb3N0CmJvb3N0LQ== key2=b3V0CnNyYwpUZXN0aW5nCg=="
 OPTION(rgw_crypt_suppress_logs, OPT_BOOL, true)   // suppress logs that might print customer key
 OPTION(rgw_list_bucket_min_readahead, OPT_INT, 1000) // minimum number of entries to read from rados for bucket listing
+OPTION(rgw_bucket_list_min_shard_batch, OPT_U32, 16) // minimum number of entries an ordered listing reads from each bucket index shard at once
 
 OPTION(rgw_rest_getusage_op_compat, OPT_BOOL, false) // dump description of total stats for s3 GetUsage API
 
@@ -10,6 +10,7 @@
 #include "common/sctp_crc32.h"
 #include "common/crc32c_intel_baseline.h"
 #include "common/crc32c_intel_fast.h"
+#include "common/crc32c_intel_multi.h"
 #include "common/crc32c_aarch64.h"
 #include "common/crc32c_ppc.h"
 
@@ -52,3 +53,30 @@ ceph_crc32c_func_t ceph_choose_crc32(void)
  */
 ceph_crc32c_func_t ceph_crc32c_func = ceph_choose_crc32();
 
+
+/*
+ * one block at a time through the chosen single buffer implementation
+ */
+static void ceph_crc32c_multi_generic(uint32_t crc, unsigned char const *data,
+				      unsigned block_len, unsigned nblocks,
+				      uint32_t *out)
+{
+  while (nblocks--) {
+    *out++ = ceph_crc32c(crc, data, block_len);
+    data += block_len;
+  }
+}
+
+ceph_crc32c_multi_func_t ceph_choose_crc32_multi(void)
+{
+  ceph_arch_probe();
+
+#if defined(__i386__) || defined(__x86_64__)
+  if (ceph_arch_intel_sse42 && ceph_crc32c_intel_multi_exists()) {
+    return ceph_crc32c_intel_multi;
+  }
+#endif
+  return ceph_crc32c_multi_generic;
+}
+
+ceph_crc32c_multi_func_t ceph_crc32c_multi_func = ceph_choose_crc32_multi();
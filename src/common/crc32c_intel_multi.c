@@ -0,0 +1,87 @@
+#include "acconfig.h"
+#include "common/crc32c_intel_multi.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+
+#include <nmmintrin.h>
+
+static inline uint64_t load_u64(unsigned char const *p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, unsigned char const *p, unsigned len)
+{
+	uint64_t c = crc;
+	unsigned i;
+
+	for (i = 0; i + 8 <= len; i += 8)
+		c = _mm_crc32_u64(c, load_u64(p + i));
+	for (; i < len; ++i)
+		c = _mm_crc32_u8((uint32_t)c, p[i]);
+	return (uint32_t)c;
+}
+
+__attribute__((target("sse4.2")))
+void ceph_crc32c_intel_multi(uint32_t crc, unsigned char const *buffer,
+			     unsigned block_len, unsigned nblocks,
+			     uint32_t *out)
+{
+	/*
+	 * crc32 has a latency of 3 cycles but a throughput of one per
+	 * cycle, so keep three independent streams in flight.
+	 */
+	while (nblocks >= 3) {
+		unsigned char const *p0 = buffer;
+		unsigned char const *p1 = buffer + block_len;
+		unsigned char const *p2 = buffer + 2 * block_len;
+		uint64_t c0 = crc, c1 = crc, c2 = crc;
+		unsigned i;
+
+		for (i = 0; i + 8 <= block_len; i += 8) {
+			c0 = _mm_crc32_u64(c0, load_u64(p0 + i));
+			c1 = _mm_crc32_u64(c1, load_u64(p1 + i));
+			c2 = _mm_crc32_u64(c2, load_u64(p2 + i));
+		}
+		for (; i < block_len; ++i) {
+			c0 = _mm_crc32_u8((uint32_t)c0, p0[i]);
+			c1 = _mm_crc32_u8((uint32_t)c1, p1[i]);
+			c2 = _mm_crc32_u8((uint32_t)c2, p2[i]);
+		}
+		out[0] = (uint32_t)c0;
+		out[1] = (uint32_t)c1;
+		out[2] = (uint32_t)c2;
+		buffer += 3 * block_len;
+		out += 3;
+		nblocks -= 3;
+	}
+	while (nblocks--) {
+		*out++ = crc32c_sse42(crc, buffer, block_len);
+		buffer += block_len;
+	}
+}
+
+int ceph_crc32c_intel_multi_exists(void)
+{
+	return 1;
+}
+
+#else
+
+int ceph_crc32c_intel_multi_exists(void)
+{
+	return 0;
+}
+
+void ceph_crc32c_intel_multi(uint32_t crc, unsigned char const *buffer,
+			     unsigned block_len, unsigned nblocks,
+			     uint32_t *out)
+{
+}
+
+#endif
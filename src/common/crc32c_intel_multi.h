@@ -0,0 +1,26 @@
+#ifndef CEPH_COMMON_CRC32C_INTEL_MULTI_H
+#define CEPH_COMMON_CRC32C_INTEL_MULTI_H
+
+#include "include/int_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* is the multi-buffer version compiled in */
+extern int ceph_crc32c_intel_multi_exists(void);
+
+/*
+ * crc32c of nblocks consecutive blocks of block_len bytes each, every
+ * one of them seeded with crc.  Three blocks are processed at a time
+ * with interleaved crc32 instructions to hide their latency.
+ */
+extern void ceph_crc32c_intel_multi(uint32_t crc, unsigned char const *buffer,
+				    unsigned block_len, unsigned nblocks,
+				    uint32_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
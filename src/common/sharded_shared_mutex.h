@@ -0,0 +1,81 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_COMMON_SHARDED_SHARED_MUTEX_H
+#define CEPH_COMMON_SHARDED_SHARED_MUTEX_H
+
+#include <atomic>
+#include <boost/thread/shared_mutex.hpp>
+
+namespace ceph {
+
+// A reader/writer mutex for read-mostly state that is consulted by
+// many threads at once, e.g. the Objecter's OSDMap and session map.
+
+// A plain shared_mutex keeps its reader count in one place, so every
+// reader writes the same cache line and readers on different cores
+// serialize on it even though they never wait for each other. Here
+// each thread is assigned one of several shards and only locks that
+// shard for shared access; an exclusive lock takes every shard. Reads
+// therefore scale with the number of cores, much like an RCU read
+// side, while writes get more expensive, which suits state that
+// changes once per map epoch.
+
+// A shared lock must be released by the thread that acquired it.
+// Exclusive locks carry no such restriction.
+
+template <unsigned NumShards = 32>
+class sharded_shared_mutex_t {
+  struct alignas(64) shard_t {
+    boost::shared_mutex lock;
+  };
+  shard_t shards[NumShards];
+
+  static unsigned my_shard() {
+    static std::atomic<unsigned> next_shard = { 0 };
+    static thread_local unsigned shard = next_shard++ % NumShards;
+    return shard;
+  }
+
+public:
+  sharded_shared_mutex_t() = default;
+  sharded_shared_mutex_t(const sharded_shared_mutex_t&) = delete;
+  sharded_shared_mutex_t& operator=(const sharded_shared_mutex_t&) = delete;
+
+  // Lockable
+  void lock() {
+    for (auto& s : shards)
+      s.lock.lock();
+  }
+  bool try_lock() {
+    for (unsigned i = 0; i < NumShards; ++i) {
+      if (!shards[i].lock.try_lock()) {
+	while (i > 0)
+	  shards[--i].lock.unlock();
+	return false;
+      }
+    }
+    return true;
+  }
+  void unlock() {
+    for (unsigned i = NumShards; i > 0; --i)
+      shards[i - 1].lock.unlock();
+  }
+
+  // SharedLockable
+  void lock_shared() {
+    shards[my_shard()].lock.lock_shared();
+  }
+  bool try_lock_shared() {
+    return shards[my_shard()].lock.try_lock_shared();
+  }
+  void unlock_shared() {
+    shards[my_shard()].lock.unlock_shared();
+  }
+};
+
+typedef sharded_shared_mutex_t<> sharded_shared_mutex;
+
+} // namespace ceph
+
+#endif // CEPH_COMMON_SHARDED_SHARED_MUTEX_H
@@ -5,6 +5,7 @@
 #include "CrushTester.h"
 #include "CrushTreeDumper.h"
 #include "include/ceph_features.h"
+#include "common/ceph_time.h"
 
 #include <algorithm>
 #include <stdlib.h>
@@ -499,6 +500,25 @@ void CrushTester::check_overlapped_rules() const
   }
 }
 
+void CrushTester::benchmark_rule(int r, int nr, const vector<__u32>& weight)
+{
+  vector<int> out;
+  int num = max_x - min_x + 1;
+  ceph::mono_time start = ceph::mono_clock::now();
+  for (int x = min_x; x <= max_x; x++) {
+    uint32_t real_x = x;
+    if (pool_id != -1)
+      real_x = crush_hash32_2(CRUSH_HASH_RJENKINS1, x, (uint32_t)pool_id);
+    crush.do_rule(r, real_x, out, nr, weight, 0);
+  }
+  double elapsed = std::chrono::duration<double>(
+    ceph::mono_clock::now() - start).count();
+  err << "rule " << r << " (" << crush.get_rule_name(r) << ") num_rep " << nr
+      << " mappings: " << num << " in " << elapsed << " sec, "
+      << (elapsed > 0 ? (uint64_t)(num / elapsed) : 0) << " mappings/sec"
+      << std::endl;
+}
+
 int CrushTester::test()
 {
   if (min_rule < 0 || max_rule < 0) {
@@ -565,6 +585,9 @@ int CrushTester::test()
       << std::endl;
 
     for (int nr = minr; nr <= maxr; nr++) {
+      if (output_benchmark && use_crush)
+	benchmark_rule(r, nr, weight);
+
       vector<int> per(crush.get_max_devices());
       map<int,int> sizes;
 
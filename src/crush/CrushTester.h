@@ -32,6 +32,7 @@ class CrushTester {
   bool output_mappings;
   bool output_bad_mappings;
   bool output_choose_tries;
+  bool output_benchmark;
 
   bool output_data_file;
   bool output_csv;
@@ -49,6 +50,11 @@ class CrushTester {
    */
   int get_maximum_affected_by_rule(int ruleno);
 
+  /*
+   * map every x in [min_x, max_x] with rule r and report mappings/sec
+   */
+  void benchmark_rule(int r, int nr, const vector<__u32>& weight);
+
   /*
    * for maps where in devices have non-sequential id numbers, return a mapping of device id
    * to a sequential id number. For example, if we have devices with id's 0 1 4 5 6 return a map
@@ -184,6 +190,7 @@ public:
       output_mappings(false),
       output_bad_mappings(false),
       output_choose_tries(false),
+      output_benchmark(false),
       output_data_file(false),
       output_csv(false),
       output_data_file_name("")
@@ -253,6 +260,13 @@ public:
     return output_choose_tries;
   }
 
+  void set_output_benchmark(bool b) {
+    output_benchmark = b;
+  }
+  bool get_output_benchmark() const {
+    return output_benchmark;
+  }
+
   void set_batches(int b) {
     num_batches = b;
   }
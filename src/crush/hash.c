@@ -140,6 +140,57 @@ __u32 crush_hash32_5(int type, __u32 a, __u32 b, __u32 c, __u32 d, __u32 e)
 	}
 }
 
+#ifndef __KERNEL__
+#ifdef CRUSH_HASH_VECTOR
+/* 8 lanes of rjenkins1_3 at once; the hash only uses 32-bit add, xor
+ * and shifts, so lane i produces exactly crush_hash32_rjenkins1_3(a,
+ * b[i], c). */
+typedef __u32 crush_hash_v32 __attribute__((vector_size(32)));
+#define CRUSH_HASH_LANES 8
+
+CRUSH_HASH_TARGET_CLONES
+static void crush_hash32_rjenkins1_3_multi(__u32 a0, const __s32 *bs,
+					   __u32 c0, __u32 *out,
+					   unsigned n, unsigned *done)
+{
+	const crush_hash_v32 zero = {0};
+	unsigned i;
+
+	for (i = 0; i + CRUSH_HASH_LANES <= n; i += CRUSH_HASH_LANES) {
+		crush_hash_v32 a = zero + a0;
+		crush_hash_v32 b;
+		crush_hash_v32 c = zero + c0;
+		crush_hash_v32 hash;
+		crush_hash_v32 x = zero + 231232;
+		crush_hash_v32 y = zero + 1232;
+
+		memcpy(&b, bs + i, sizeof(b));
+		hash = crush_hash_seed ^ a ^ b ^ c;
+		crush_hashmix(a, b, hash);
+		crush_hashmix(c, x, hash);
+		crush_hashmix(y, a, hash);
+		crush_hashmix(b, x, hash);
+		crush_hashmix(y, c, hash);
+		memcpy(out + i, &hash, sizeof(hash));
+	}
+	*done = i;
+}
+#endif
+
+void crush_hash32_3_multi(int type, __u32 a, const __s32 *b, __u32 c,
+			  __u32 *out, unsigned n)
+{
+	unsigned i = 0;
+
+#ifdef CRUSH_HASH_VECTOR
+	if (type == CRUSH_HASH_RJENKINS1)
+		crush_hash32_rjenkins1_3_multi(a, b, c, out, n, &i);
+#endif
+	for (; i < n; i++)
+		out[i] = crush_hash32_3(type, a, b[i], c);
+}
+#endif
+
 const char *crush_hash_name(int type)
 {
 	switch (type) {
@@ -20,4 +20,25 @@ extern __u32 crush_hash32_4(int type, __u32 a, __u32 b, __u32 c, __u32 d);
 extern __u32 crush_hash32_5(int type, __u32 a, __u32 b, __u32 c, __u32 d,
 			    __u32 e);
 
+#ifndef __KERNEL__
+/* GCC vector extensions let the compiler spread the hash across SIMD
+ * lanes; on x86_64 an AVX2 clone is picked at load time if available */
+#if defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))
+# define CRUSH_HASH_VECTOR
+#endif
+#if defined(CRUSH_HASH_VECTOR) && defined(__x86_64__) && defined(__linux__) && \
+  !defined(__clang__) && __GNUC__ >= 6
+# define CRUSH_HASH_TARGET_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+# define CRUSH_HASH_TARGET_CLONES
+#endif
+
+/*
+ * out[i] = crush_hash32_3(type, a, b[i], c) for i in [0, n), computed
+ * several items at a time where possible
+ */
+extern void crush_hash32_3_multi(int type, __u32 a, const __s32 *b, __u32 c,
+				 __u32 *out, unsigned n);
+#endif
+
 #endif
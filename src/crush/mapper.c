@@ -320,6 +320,34 @@ static inline int *get_choose_arg_ids(const struct crush_bucket_straw2 *bucket,
   return arg->ids;
 }
 
+#ifndef __KERNEL__
+/*
+ * div64_s64(ln, weight) for the straw2 draw, ln in [-2^48, 0].
+ *
+ * A double divide is several times cheaper than a 64-bit integer
+ * divide.  ln and weight are exact as doubles and the quotient is off
+ * by less than one, so q * weight (which stays below 2^53) tells us
+ * whether truncation went the wrong way and we fix it up; the result
+ * is bit-identical to the integer division.
+ */
+static inline __s64 crush_straw2_div(__s64 ln, __u32 weight)
+{
+	__s64 q = (__s64)((double)ln / (double)weight);
+	__s64 rem = ln - q * (__s64)weight;
+
+	if (rem > 0)
+		q++;
+	else if (rem <= -(__s64)weight)
+		q--;
+	return q;
+}
+
+/* hash this many items at a time */
+#define CRUSH_STRAW2_BATCH 64
+#else
+#define crush_straw2_div(ln, weight) div64_s64(ln, weight)
+#endif
+
 static int bucket_straw2_choose(const struct crush_bucket_straw2 *bucket,
 				int x, int r, const struct crush_choose_arg *arg,
                                 int position)
@@ -329,10 +357,26 @@ static int bucket_straw2_choose(const struct crush_bucket_straw2 *bucket,
 	__s64 ln, draw, high_draw = 0;
         __u32 *weights = get_choose_arg_weights(bucket, arg, position);
         int *ids = get_choose_arg_ids(bucket, arg);
+#ifndef __KERNEL__
+	__u32 hashes[CRUSH_STRAW2_BATCH];
+#endif
 	for (i = 0; i < bucket->h.size; i++) {
                 dprintk("weight 0x%x item %d\n", weights[i], ids[i]);
+#ifndef __KERNEL__
+		if (i % CRUSH_STRAW2_BATCH == 0) {
+			unsigned n = bucket->h.size - i;
+			if (n > CRUSH_STRAW2_BATCH)
+				n = CRUSH_STRAW2_BATCH;
+			crush_hash32_3_multi(bucket->h.hash, x, ids + i, r,
+					     hashes, n);
+		}
+#endif
 		if (weights[i]) {
+#ifndef __KERNEL__
+			u = hashes[i % CRUSH_STRAW2_BATCH];
+#else
 			u = crush_hash32_3(bucket->h.hash, x, ids[i], r);
+#endif
 			u &= 0xffff;
 
 			/*
@@ -353,7 +397,7 @@ static int bucket_straw2_choose(const struct crush_bucket_straw2 *bucket,
 			 * weight means a larger (less negative) value
 			 * for draw.
 			 */
-			draw = div64_s64(ln, weights[i]);
+			draw = crush_straw2_div(ln, weights[i]);
 		} else {
 			draw = S64_MIN;
 		}
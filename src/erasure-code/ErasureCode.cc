@@ -273,3 +273,208 @@ int ErasureCode::decode_concat(const map<int, bufferlist> &chunks,
   }
   return r;
 }
+
+int ErasureCode::encode_stripes(const set<int> &want_to_encode,
+				unsigned stripe_width,
+				const bufferlist &in,
+				map<int, bufferlist> *encoded)
+{
+  assert(stripe_width > 0);
+  assert(in.length() % stripe_width == 0);
+  for (unsigned offset = 0; offset < in.length(); offset += stripe_width) {
+    bufferlist stripe;
+    stripe.substr_of(in, offset, stripe_width);
+    map<int, bufferlist> chunks;
+    int r = encode(want_to_encode, stripe, &chunks);
+    if (r)
+      return r;
+    for (map<int, bufferlist>::iterator i = chunks.begin();
+	 i != chunks.end();
+	 ++i)
+      (*encoded)[i->first].claim_append(i->second);
+  }
+  return 0;
+}
+
+static bool has_all_chunks(const set<int> &want_to_read,
+			   const map<int, bufferlist> &chunks)
+{
+  for (set<int>::const_iterator i = want_to_read.begin();
+       i != want_to_read.end();
+       ++i) {
+    if (chunks.find(*i) == chunks.end())
+      return false;
+  }
+  return true;
+}
+
+int ErasureCode::decode_stripes(const set<int> &want_to_read,
+				const map<int, bufferlist> &chunks,
+				unsigned chunk_size,
+				map<int, bufferlist> *decoded)
+{
+  assert(!chunks.empty());
+  assert(chunk_size > 0);
+  if (has_all_chunks(want_to_read, chunks)) {
+    for (set<int>::const_iterator i = want_to_read.begin();
+	 i != want_to_read.end();
+	 ++i)
+      (*decoded)[*i] = chunks.find(*i)->second;
+    return 0;
+  }
+  unsigned length = chunks.begin()->second.length();
+  assert(length % chunk_size == 0);
+  for (unsigned offset = 0; offset < length; offset += chunk_size) {
+    map<int, bufferlist> stripe;
+    for (map<int, bufferlist>::const_iterator i = chunks.begin();
+	 i != chunks.end();
+	 ++i) {
+      assert(i->second.length() == length);
+      stripe[i->first].substr_of(i->second, offset, chunk_size);
+    }
+    map<int, bufferlist> out;
+    int r = decode(want_to_read, stripe, &out);
+    if (r)
+      return r;
+    for (set<int>::const_iterator i = want_to_read.begin();
+	 i != want_to_read.end();
+	 ++i)
+      (*decoded)[*i].claim_append(out[*i]);
+  }
+  return 0;
+}
+
+int ErasureCode::encode_stripes_raw(const set<int> &want_to_encode,
+				    unsigned stripe_width,
+				    const bufferlist &in,
+				    map<int, bufferlist> *encoded,
+				    const stripe_encoder_t &encode_stripe)
+{
+  unsigned int k = get_data_chunk_count();
+  unsigned int m = get_chunk_count() - k;
+  unsigned blocksize = stripe_width / k;
+  // the kernel is given chunks at fixed offsets in a single buffer,
+  // which is only possible when the stripes need no padding
+  if (stripe_width % k ||
+      get_chunk_size(stripe_width) != blocksize ||
+      blocksize % SIMD_ALIGN ||
+      !chunk_mapping.empty())
+    return ErasureCode::encode_stripes(want_to_encode, stripe_width,
+				       in, encoded);
+  assert(in.length() % stripe_width == 0);
+  unsigned stripes = in.length() / stripe_width;
+  if (stripes == 0)
+    return 0;
+
+  bufferlist prepared = in;
+  if (!prepared.is_contiguous() || !prepared.is_aligned(SIMD_ALIGN)) {
+    bufferptr buf(buffer::create_aligned(in.length(), SIMD_ALIGN));
+    prepared.rebuild(buf);
+  }
+  bufferptr data_buf = prepared.front();
+  vector<bufferptr> coding_bufs(m);
+  for (unsigned int j = 0; j < m; j++)
+    coding_bufs[j] = buffer::create_aligned(stripes * blocksize, SIMD_ALIGN);
+
+  vector<char*> data(k);
+  vector<char*> coding(m);
+  for (unsigned s = 0; s < stripes; s++) {
+    for (unsigned int i = 0; i < k; i++)
+      data[i] = data_buf.c_str() + s * stripe_width + i * blocksize;
+    for (unsigned int j = 0; j < m; j++)
+      coding[j] = coding_bufs[j].c_str() + s * blocksize;
+    encode_stripe(&data[0], &coding[0], blocksize);
+  }
+
+  for (unsigned int i = 0; i < k; i++) {
+    if (want_to_encode.count(i) == 0)
+      continue;
+    bufferlist &chunk = (*encoded)[i];
+    for (unsigned s = 0; s < stripes; s++)
+      chunk.append(bufferptr(data_buf, s * stripe_width + i * blocksize,
+			     blocksize));
+  }
+  for (unsigned int j = 0; j < m; j++) {
+    if (want_to_encode.count(k + j))
+      (*encoded)[k + j].append(coding_bufs[j]);
+  }
+  return 0;
+}
+
+int ErasureCode::decode_stripes_raw(const set<int> &want_to_read,
+				    const map<int, bufferlist> &chunks,
+				    unsigned chunk_size,
+				    map<int, bufferlist> *decoded,
+				    const stripe_decoder_t &decode_stripe)
+{
+  if (has_all_chunks(want_to_read, chunks) ||
+      chunk_size % SIMD_ALIGN ||
+      !chunk_mapping.empty())
+    return ErasureCode::decode_stripes(want_to_read, chunks,
+				       chunk_size, decoded);
+  unsigned int k = get_data_chunk_count();
+  unsigned int m = get_chunk_count() - k;
+  unsigned length = chunks.begin()->second.length();
+  assert(length % chunk_size == 0);
+  unsigned stripes = length / chunk_size;
+
+  vector<bufferptr> bufs(k + m);
+  vector<int> erasures;
+  for (unsigned int i = 0; i < k + m; i++) {
+    map<int, bufferlist>::const_iterator c = chunks.find(i);
+    if (c == chunks.end()) {
+      erasures.push_back(i);
+      bufs[i] = buffer::create_aligned(length, SIMD_ALIGN);
+    } else {
+      assert(c->second.length() == length);
+      bufferlist chunk = c->second;
+      if (!chunk.is_contiguous() || !chunk.is_aligned(SIMD_ALIGN)) {
+	bufferptr buf(buffer::create_aligned(length, SIMD_ALIGN));
+	chunk.rebuild(buf);
+      }
+      bufs[i] = chunk.front();
+    }
+  }
+  erasures.push_back(-1);
+
+  vector<char*> data(k);
+  vector<char*> coding(m);
+  for (unsigned s = 0; s < stripes; s++) {
+    for (unsigned int i = 0; i < k; i++)
+      data[i] = bufs[i].c_str() + s * chunk_size;
+    for (unsigned int j = 0; j < m; j++)
+      coding[j] = bufs[k + j].c_str() + s * chunk_size;
+    int r = decode_stripe(&erasures[0], &data[0], &coding[0], chunk_size);
+    if (r)
+      return r;
+  }
+  for (set<int>::const_iterator i = want_to_read.begin();
+       i != want_to_read.end();
+       ++i)
+    (*decoded)[*i].append(bufs[*i]);
+  return 0;
+}
+
+int ErasureCode::encode_delta(const bufferptr &old_data,
+			      const bufferptr &new_data,
+			      bufferptr *delta)
+{
+  // addition and subtraction are both XOR in GF(2^w), which is what
+  // all the codes supporting parity deltas are defined over
+  assert(old_data.length() == new_data.length());
+  unsigned length = old_data.length();
+  if (!delta->have_raw() || delta->length() != length)
+    *delta = buffer::create_aligned(length, SIMD_ALIGN);
+  const char *o = old_data.c_str();
+  const char *n = new_data.c_str();
+  char *d = delta->c_str();
+  for (unsigned i = 0; i < length; i++)
+    d[i] = o[i] ^ n[i];
+  return 0;
+}
+
+int ErasureCode::apply_delta(const map<int, bufferptr> &deltas,
+			     map<int, bufferptr> &coding)
+{
+  return -EOPNOTSUPP;
+}
@@ -22,6 +22,7 @@
 
  */ 
 
+#include <functional>
 #include <vector>
 
 #include "ErasureCodeInterface.h"
@@ -104,10 +105,50 @@ namespace ceph {
     int decode_concat(const map<int, bufferlist> &chunks,
 			      bufferlist *decoded) override;
 
+    int encode_stripes(const set<int> &want_to_encode,
+		       unsigned stripe_width,
+		       const bufferlist &in,
+		       map<int, bufferlist> *encoded) override;
+
+    int decode_stripes(const set<int> &want_to_read,
+		       const map<int, bufferlist> &chunks,
+		       unsigned chunk_size,
+		       map<int, bufferlist> *decoded) override;
+
+    bool supports_parity_delta() const override {
+      return false;
+    }
+
+    int encode_delta(const bufferptr &old_data,
+		     const bufferptr &new_data,
+		     bufferptr *delta) override;
+
+    int apply_delta(const map<int, bufferptr> &deltas,
+		    map<int, bufferptr> &coding) override;
+
   protected:
     int parse(const ErasureCodeProfile &profile,
 	      ostream *ss);
 
+    typedef std::function<void(char **data, char **coding,
+			       unsigned blocksize)> stripe_encoder_t;
+    typedef std::function<int(int *erasures, char **data, char **coding,
+			      unsigned blocksize)> stripe_decoder_t;
+
+    /// encode_stripes for plugins whose kernel works on raw buffers
+    int encode_stripes_raw(const set<int> &want_to_encode,
+			   unsigned stripe_width,
+			   const bufferlist &in,
+			   map<int, bufferlist> *encoded,
+			   const stripe_encoder_t &encode_stripe);
+
+    /// decode_stripes for plugins whose kernel works on raw buffers
+    int decode_stripes_raw(const set<int> &want_to_read,
+			   const map<int, bufferlist> &chunks,
+			   unsigned chunk_size,
+			   map<int, bufferlist> *decoded,
+			   const stripe_decoder_t &decode_stripe);
+
   private:
     int chunk_index(unsigned int i) const;
   };
@@ -447,6 +447,91 @@ namespace ceph {
      */
     virtual int decode_concat(const map<int, bufferlist> &chunks,
 			      bufferlist *decoded) = 0;
+
+    /**
+     * Encode the stripes found back to back in **in**, as if
+     * **encode** was called on each **stripe_width** bytes of it in
+     * turn, and store in **encoded** the chunks of every stripe
+     * concatenated: on return **encoded[i]** holds chunk **i** of the
+     * first stripe, followed by chunk **i** of the second stripe and
+     * so on.
+     *
+     * The length of **in** must be a multiple of **stripe_width**.
+     * Plugins may implement this in a single pass over contiguous,
+     * aligned buffers, which is cheaper than calling **encode** once
+     * per stripe when there are many small stripes.
+     *
+     * @param [in] want_to_encode chunk indexes to be encoded
+     * @param [in] stripe_width size of each stripe in **in**
+     * @param [in] in data to be encoded
+     * @param [out] encoded map chunk indexes to chunk data
+     * @return **0** on success or a negative errno on error.
+     */
+    virtual int encode_stripes(const set<int> &want_to_encode,
+			       unsigned stripe_width,
+			       const bufferlist &in,
+			       map<int, bufferlist> *encoded) = 0;
+
+    /**
+     * Decode the stripes found in **chunks**, as if **decode** was
+     * called on each **chunk_size** bytes of the chunks in turn. Each
+     * entry of **chunks** holds chunk **i** of consecutive stripes
+     * and must have the same length, a multiple of **chunk_size**.
+     * On return **decoded** holds the **want_to_read** chunks with
+     * the same layout.
+     *
+     * @param [in] want_to_read chunk indexes to be decoded
+     * @param [in] chunks map chunk indexes to chunk data
+     * @param [in] chunk_size size of the chunk of each stripe
+     * @param [out] decoded map chunk indexes to chunk data
+     * @return **0** on success or a negative errno on error.
+     */
+    virtual int decode_stripes(const set<int> &want_to_read,
+			       const map<int, bufferlist> &chunks,
+			       unsigned chunk_size,
+			       map<int, bufferlist> *decoded) = 0;
+
+    /**
+     * Return true if the coding chunks can be updated from the
+     * change made to a single data chunk, without reading the other
+     * data chunks. This holds for codes that are linear, such as
+     * Reed-Solomon, and allows small overwrites to be applied with
+     * **encode_delta** and **apply_delta**.
+     *
+     * @return **true** if **apply_delta** is supported
+     */
+    virtual bool supports_parity_delta() const = 0;
+
+    /**
+     * Compute in **delta** the difference between the **old_data**
+     * and **new_data** content of a data chunk. The three buffers
+     * must have the same length.
+     *
+     * @param [in] old_data current content of the data chunk
+     * @param [in] new_data content the data chunk is updated to
+     * @param [out] delta difference to be given to **apply_delta**
+     * @return **0** on success or a negative errno on error.
+     */
+    virtual int encode_delta(const bufferptr &old_data,
+			     const bufferptr &new_data,
+			     bufferptr *delta) = 0;
+
+    /**
+     * Update the **coding** chunks in place so that they match data
+     * chunks changed by **deltas**.
+     *
+     * The **deltas** map data chunk indexes to the output of
+     * **encode_delta** and the **coding** map coding chunk indexes
+     * to their current content. Coding chunks that are not in
+     * **coding** are not updated. All buffers must have the same
+     * length.
+     *
+     * @param [in] deltas map data chunk indexes to deltas
+     * @param [in,out] coding map coding chunk indexes to chunk data
+     * @return **0** on success or a negative errno on error.
+     */
+    virtual int apply_delta(const map<int, bufferptr> &deltas,
+			    map<int, bufferptr> &coding) = 0;
   };
 
   typedef ceph::shared_ptr<ErasureCodeInterface> ErasureCodeInterfaceRef;
@@ -139,6 +139,30 @@ int ErasureCodeIsa::decode_chunks(const set<int> &want_to_read,
   return isa_decode(erasures, data, coding, blocksize);
 }
 
+int ErasureCodeIsa::encode_stripes(const set<int> &want_to_encode,
+                                   unsigned stripe_width,
+                                   const bufferlist &in,
+                                   map<int, bufferlist> *encoded)
+{
+  return encode_stripes_raw(
+    want_to_encode, stripe_width, in, encoded,
+    [this](char **data, char **coding, unsigned blocksize) {
+      isa_encode(data, coding, blocksize);
+    });
+}
+
+int ErasureCodeIsa::decode_stripes(const set<int> &want_to_read,
+                                   const map<int, bufferlist> &chunks,
+                                   unsigned chunk_size,
+                                   map<int, bufferlist> *decoded)
+{
+  return decode_stripes_raw(
+    want_to_read, chunks, chunk_size, decoded,
+    [this](int *erasures, char **data, char **coding, unsigned blocksize) {
+      return isa_decode(erasures, data, coding, blocksize);
+    });
+}
+
 // -----------------------------------------------------------------------------
 
 void
@@ -157,6 +181,39 @@ ErasureCodeIsaDefault::isa_encode(char **data,
 
 // -----------------------------------------------------------------------------
 
+int
+ErasureCodeIsaDefault::apply_delta(const map<int, bufferptr> &deltas,
+                                   map<int, bufferptr> &coding)
+{
+  if (!supports_parity_delta())
+    return -EOPNOTSUPP;
+
+  for (auto &&d : deltas) {
+    int i = d.first;
+    assert(i >= 0 && i < k);
+    unsigned char *delta = (unsigned char*) d.second.c_str();
+    int blocksize = d.second.length();
+    for (auto &&c : coding) {
+      int j = c.first - k;
+      assert(j >= 0 && j < m);
+      assert(c.second.length() == d.second.length());
+      unsigned char *parity = (unsigned char*) c.second.c_str();
+      if (m == 1) {
+        // isa_encode computes a single parity chunk as plain XOR
+        byte_xor(delta, parity, delta + blocksize);
+      } else {
+        // the tables of each coding row are 32 * k bytes long
+        ec_encode_data_update(blocksize, k, 1, i,
+                              encode_tbls + 32 * k * j,
+                              delta, &parity);
+      }
+    }
+  }
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+
 bool
 ErasureCodeIsaDefault::erasure_contains(int *erasures, int i)
 {
@@ -94,6 +94,16 @@ public:
                             const map<int, bufferlist> &chunks,
                             map<int, bufferlist> *decoded) override;
 
+  int encode_stripes(const set<int> &want_to_encode,
+                     unsigned stripe_width,
+                     const bufferlist &in,
+                     map<int, bufferlist> *encoded) override;
+
+  int decode_stripes(const set<int> &want_to_read,
+                     const map<int, bufferlist> &chunks,
+                     unsigned chunk_size,
+                     map<int, bufferlist> *decoded) override;
+
   int init(ErasureCodeProfile &profile, ostream *ss) override;
 
   virtual void isa_encode(char **data,
@@ -148,6 +158,14 @@ public:
                           char **coding,
                           int blocksize) override;
 
+  bool supports_parity_delta() const override
+  {
+    return chunk_mapping.empty();
+  }
+
+  int apply_delta(const map<int, bufferptr> &deltas,
+                  map<int, bufferptr> &coding) override;
+
   virtual bool erasure_contains(int *erasures, int i);
 
   int isa_decode(int *erasures,
@@ -150,6 +150,66 @@ int ErasureCodeJerasure::decode_chunks(const set<int> &want_to_read,
   return jerasure_decode(erasures, data, coding, blocksize);
 }
 
+int ErasureCodeJerasure::encode_stripes(const set<int> &want_to_encode,
+					unsigned stripe_width,
+					const bufferlist &in,
+					map<int, bufferlist> *encoded)
+{
+  return encode_stripes_raw(
+    want_to_encode, stripe_width, in, encoded,
+    [this](char **data, char **coding, unsigned blocksize) {
+      jerasure_encode(data, coding, blocksize);
+    });
+}
+
+int ErasureCodeJerasure::decode_stripes(const set<int> &want_to_read,
+					const map<int, bufferlist> &chunks,
+					unsigned chunk_size,
+					map<int, bufferlist> *decoded)
+{
+  return decode_stripes_raw(
+    want_to_read, chunks, chunk_size, decoded,
+    [this](int *erasures, char **data, char **coding, unsigned blocksize) {
+      return jerasure_decode(erasures, data, coding, blocksize);
+    });
+}
+
+int ErasureCodeJerasure::apply_delta(const map<int, bufferptr> &deltas,
+				     map<int, bufferptr> &coding)
+{
+  const int *matrix = get_coding_matrix();
+  if (!supports_parity_delta())
+    return -EOPNOTSUPP;
+  // coding chunk j is the sum over i of matrix[j][i] * data chunk i,
+  // so a change to data chunk i adds matrix[j][i] * delta to it
+  for (auto &&d : deltas) {
+    int i = d.first;
+    assert(i >= 0 && i < k);
+    char *delta = const_cast<char*>(d.second.c_str());
+    int blocksize = d.second.length();
+    for (auto &&c : coding) {
+      int j = c.first - k;
+      assert(j >= 0 && j < m);
+      assert(c.second.length() == d.second.length());
+      int multby = matrix[j * k + i];
+      switch (w) {
+      case 8:
+	galois_w08_region_multiply(delta, multby, blocksize, c.second.c_str(), 1);
+	break;
+      case 16:
+	galois_w16_region_multiply(delta, multby, blocksize, c.second.c_str(), 1);
+	break;
+      case 32:
+	galois_w32_region_multiply(delta, multby, blocksize, c.second.c_str(), 1);
+	break;
+      default:
+	return -EOPNOTSUPP;
+      }
+    }
+  }
+  return 0;
+}
+
 bool ErasureCodeJerasure::is_prime(int value)
 {
   int prime55[] = {
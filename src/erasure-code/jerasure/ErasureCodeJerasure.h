@@ -72,8 +72,25 @@ public:
 			    const map<int, bufferlist> &chunks,
 			    map<int, bufferlist> *decoded) override;
 
+  int encode_stripes(const set<int> &want_to_encode,
+		     unsigned stripe_width,
+		     const bufferlist &in,
+		     map<int, bufferlist> *encoded) override;
+
+  int decode_stripes(const set<int> &want_to_read,
+		     const map<int, bufferlist> &chunks,
+		     unsigned chunk_size,
+		     map<int, bufferlist> *decoded) override;
+
   int init(ErasureCodeProfile &profile, ostream *ss) override;
 
+  bool supports_parity_delta() const override {
+    return get_coding_matrix() && chunk_mapping.empty();
+  }
+
+  int apply_delta(const map<int, bufferptr> &deltas,
+		  map<int, bufferptr> &coding) override;
+
   virtual void jerasure_encode(char **data,
                                char **coding,
                                int blocksize) = 0;
@@ -86,6 +103,9 @@ public:
   static bool is_prime(int value);
 protected:
   virtual int parse(ErasureCodeProfile &profile, ostream *ss);
+  // the m x k coding matrix over GF(2^w), or NULL if the technique
+  // encodes with a bit matrix
+  virtual const int *get_coding_matrix() const { return NULL; }
 };
 
 class ErasureCodeJerasureReedSolomonVandermonde : public ErasureCodeJerasure {
@@ -114,6 +134,8 @@ public:
                                int blocksize) override;
   unsigned get_alignment() const override;
   void prepare() override;
+protected:
+  const int *get_coding_matrix() const override { return matrix; }
 private:
   int parse(ErasureCodeProfile &profile, ostream *ss) override;
 };
@@ -143,6 +165,8 @@ public:
                                int blocksize) override;
   unsigned get_alignment() const override;
   void prepare() override;
+protected:
+  const int *get_coding_matrix() const override { return matrix; }
 private:
   int parse(ErasureCodeProfile &profile, ostream *ss) override;
 };
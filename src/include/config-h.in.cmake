@@ -90,6 +90,12 @@
 /* Defined if you have libaio */
 #cmakedefine HAVE_LIBAIO
 
+/* Defined if you have liburing */
+#cmakedefine HAVE_LIBURING
+
+/* Defined if you have liblz4 */
+#cmakedefine HAVE_LZ4
+
 /* Defined if OpenLDAP enabled */
 #cmakedefine HAVE_OPENLDAP
 
@@ -29,4 +29,35 @@ static inline uint32_t ceph_crc32c(uint32_t crc, unsigned char const *data, unsi
 	return ceph_crc32c_func(crc, data, length);
 }
 
+typedef void (*ceph_crc32c_multi_func_t)(uint32_t crc, unsigned char const *data,
+					 unsigned block_len, unsigned nblocks,
+					 uint32_t *out);
+
+/*
+ * this is a static global with the chosen multi-buffer crc32c
+ * implementation for the given architecture.
+ */
+extern ceph_crc32c_multi_func_t ceph_crc32c_multi_func;
+
+extern ceph_crc32c_multi_func_t ceph_choose_crc32_multi(void);
+
+/**
+ * calculate crc32c of several consecutive, equally sized blocks
+ *
+ * Each block is checksummed independently, starting from the same
+ * initial value, and its crc is stored in out[i].
+ *
+ * @param crc initial value for every block
+ * @param data pointer to the first block (must not be NULL)
+ * @param block_len length of each block
+ * @param nblocks number of blocks
+ * @param out array of at least nblocks crc values
+ */
+static inline void ceph_crc32c_multi(uint32_t crc, unsigned char const *data,
+				     unsigned block_len, unsigned nblocks,
+				     uint32_t *out)
+{
+	ceph_crc32c_multi_func(crc, data, block_len, nblocks, out);
+}
+
 #endif
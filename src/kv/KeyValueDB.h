@@ -346,6 +346,21 @@ public:
   virtual void get_statistics(Formatter *f) {
     return;
   }
+
+  /// bytes currently held by the backend's read cache, or -EOPNOTSUPP
+  virtual int64_t get_cache_usage() const {
+    return -EOPNOTSUPP;
+  }
+
+  /// resize the backend's read cache
+  virtual int set_cache_size(uint64_t s) {
+    return -EOPNOTSUPP;
+  }
+
+  /// read cache hit/miss counts since the db was opened
+  virtual int get_cache_hit_stats(uint64_t *hits, uint64_t *misses) {
+    return -EOPNOTSUPP;
+  }
 protected:
   /// List of matching prefixes and merge operators
   std::vector<std::pair<std::string,
@@ -15,6 +15,7 @@
 #include "rocksdb/env.h"
 #include "rocksdb/slice.h"
 #include "rocksdb/cache.h"
+#include "rocksdb/statistics.h"
 #include "rocksdb/filter_policy.h"
 #include "rocksdb/utilities/convenience.h"
 #include "rocksdb/merge_operator.h"
@@ -436,6 +437,36 @@ void RocksDBStore::get_statistics(Formatter *f)
   }
 }
 
+int64_t RocksDBStore::get_cache_usage() const
+{
+  if (!bbt_opts.block_cache) {
+    return -EOPNOTSUPP;
+  }
+  return bbt_opts.block_cache->GetUsage();
+}
+
+int RocksDBStore::set_cache_size(uint64_t s)
+{
+  if (!bbt_opts.block_cache) {
+    return -EOPNOTSUPP;
+  }
+  dout(10) << __func__ << " block cache capacity "
+	   << bbt_opts.block_cache->GetCapacity() << " -> " << s << dendl;
+  bbt_opts.block_cache->SetCapacity(s);
+  return 0;
+}
+
+int RocksDBStore::get_cache_hit_stats(uint64_t *hits, uint64_t *misses)
+{
+  // block cache tickers are only collected with rocksdb_perf
+  if (!dbstats) {
+    return -EOPNOTSUPP;
+  }
+  *hits = dbstats->getTickerCount(rocksdb::BLOCK_CACHE_HIT);
+  *misses = dbstats->getTickerCount(rocksdb::BLOCK_CACHE_MISS);
+  return 0;
+}
+
 int RocksDBStore::submit_transaction(KeyValueDB::Transaction t)
 {
   utime_t start = ceph_clock_now();
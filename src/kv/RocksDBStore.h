@@ -155,6 +155,10 @@ public:
   void split_stats(const std::string &s, char delim, std::vector<std::string> &elems);
   void get_statistics(Formatter *f) override;
 
+  int64_t get_cache_usage() const override;
+  int set_cache_size(uint64_t s) override;
+  int get_cache_hit_stats(uint64_t *hits, uint64_t *misses) override;
+
   struct  RocksWBHandler: public rocksdb::WriteBatch::Handler {
     std::string seen ;
     int num_seen = 0;
@@ -4,6 +4,7 @@
 #include "librbd/ExclusiveLock.h"
 #include "librbd/ImageWatcher.h"
 #include "librbd/ImageState.h"
+#include "librbd/cache/ImageCache.h"
 #include "librbd/exclusive_lock/PreAcquireRequest.h"
 #include "librbd/exclusive_lock/PostAcquireRequest.h"
 #include "librbd/exclusive_lock/PreReleaseRequest.h"
@@ -237,6 +238,10 @@ void ExclusiveLock<I>::handle_post_acquired_lock(int r) {
 
   if (r >= 0) {
     m_image_ctx.image_watcher->notify_acquired_lock();
+    if (m_image_ctx.image_cache != nullptr) {
+      // e.g. writes replayed from a persistent cache may be destaged now
+      m_image_ctx.image_cache->handle_lock_acquired();
+    }
     m_image_ctx.io_work_queue->clear_require_lock_on_read();
     m_image_ctx.io_work_queue->unblock_writes();
   }
@@ -271,7 +271,10 @@ struct C_InvalidateCache : public Context {
 
     perf_start(pname);
 
-    if (cache) {
+    // the persistent cache sits in front of the image and must write
+    // through to RADOS when it destages
+    bool persistent = persistent_cache && !read_only && snap_name.empty();
+    if (cache && !persistent) {
       Mutex::Locker l(cache_lock);
       ldout(cct, 20) << "enabling caching..." << dendl;
       writeback_handler = new LibrbdWriteback(this, cache_lock);
@@ -307,6 +310,9 @@ struct C_InvalidateCache : public Context {
 
       object_set = new ObjectCacher::ObjectSet(NULL, data_ctx.get_id(), 0);
       object_set->return_enoent = true;
+      object_set->layout = layout;
+      object_set->object_format = format_string;
+      object_cacher->set_max_readahead(cache_readahead_max_bytes);
       object_cacher->start();
     }
 
@@ -716,12 +722,14 @@ struct C_InvalidateCache : public Context {
 				     int fadvise_flags) {
     snap_lock.get_read();
     ObjectCacher::OSDRead *rd = object_cacher->prepare_read(snap_id, bl, fadvise_flags);
+    uint64_t image_size = get_image_size(snap_id);
     snap_lock.put_read();
     ObjectExtent extent(o, object_no, off, len, 0);
     extent.oloc.pool = data_ctx.get_id();
     extent.buffer_extents.push_back(make_pair(0, len));
     rd->extents.push_back(extent);
     cache_lock.Lock();
+    object_set->readahead_limit = image_size;
     int r = object_cacher->readx(rd, object_set, onfinish);
     cache_lock.Unlock();
     if (r != 0)
@@ -957,6 +965,7 @@ struct C_InvalidateCache : public Context {
         "rbd_cache_target_dirty", false)(
         "rbd_cache_max_dirty_age", false)(
         "rbd_cache_max_dirty_object", false)(
+        "rbd_cache_readahead_max_bytes", false)(
         "rbd_cache_block_writes_upfront", false)(
         "rbd_concurrent_management_ops", false)(
         "rbd_balance_snap_reads", false)(
@@ -981,7 +990,11 @@ struct C_InvalidateCache : public Context {
         "rbd_journal_max_concurrent_object_sets", false)(
         "rbd_mirroring_resync_after_disconnect", false)(
         "rbd_mirroring_replay_delay", false)(
-        "rbd_skip_partial_discard", false);
+        "rbd_skip_partial_discard", false)(
+        "rbd_persistent_cache", false)(
+        "rbd_persistent_cache_path", false)(
+        "rbd_persistent_cache_size", false)(
+        "rbd_shared_parent_cache", false);
 
     md_config_t local_config_t;
     std::map<std::string, bufferlist> res;
@@ -1015,6 +1028,7 @@ struct C_InvalidateCache : public Context {
     ASSIGN_OPTION(cache_target_dirty);
     ASSIGN_OPTION(cache_max_dirty_age);
     ASSIGN_OPTION(cache_max_dirty_object);
+    ASSIGN_OPTION(cache_readahead_max_bytes);
     ASSIGN_OPTION(cache_block_writes_upfront);
     ASSIGN_OPTION(concurrent_management_ops);
     ASSIGN_OPTION(balance_snap_reads);
@@ -1041,6 +1055,10 @@ struct C_InvalidateCache : public Context {
     ASSIGN_OPTION(mirroring_resync_after_disconnect);
     ASSIGN_OPTION(mirroring_replay_delay);
     ASSIGN_OPTION(skip_partial_discard);
+    ASSIGN_OPTION(persistent_cache);
+    ASSIGN_OPTION(persistent_cache_path);
+    ASSIGN_OPTION(persistent_cache_size);
+    ASSIGN_OPTION(shared_parent_cache);
   }
 
   ExclusiveLock<ImageCtx> *ImageCtx::create_exclusive_lock() {
@@ -47,7 +47,10 @@ namespace librbd {
   template <typename> class Operations;
   class LibrbdWriteback;
 
-  namespace cache { struct ImageCache; }
+  namespace cache {
+  struct ImageCache;
+  class SharedParentCache;
+  }
   namespace exclusive_lock { struct Policy; }
   namespace io {
   class AioCompletion;
@@ -131,6 +134,7 @@ namespace librbd {
     file_layout_t layout;
 
     cache::ImageCache *image_cache = nullptr;
+    cache::SharedParentCache *parent_cache = nullptr;
     ObjectCacher *object_cacher;
     LibrbdWriteback *writeback_handler;
     ObjectCacher::ObjectSet *object_set;
@@ -168,6 +172,7 @@ namespace librbd {
     uint64_t cache_target_dirty;
     double cache_max_dirty_age;
     uint32_t cache_max_dirty_object;
+    uint64_t cache_readahead_max_bytes;
     bool cache_block_writes_upfront;
     uint32_t concurrent_management_ops;
     bool balance_snap_reads;
@@ -194,6 +199,10 @@ namespace librbd {
     bool mirroring_resync_after_disconnect;
     int mirroring_replay_delay;
     bool skip_partial_discard;
+    bool persistent_cache;
+    std::string persistent_cache_path;
+    uint64_t persistent_cache_size;
+    bool shared_parent_cache;
 
     LibrbdAdminSocketHook *asok_hook;
 
@@ -0,0 +1,1178 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "FileImageCache.h"
+#include "include/buffer.h"
+#include "include/encoding.h"
+#include "include/Context.h"
+#include "common/dout.h"
+#include "common/errno.h"
+#include "common/RWLock.h"
+#include "common/WorkQueue.h"
+#include "include/stringify.h"
+#include "librbd/ExclusiveLock.h"
+#include "librbd/ImageCtx.h"
+#include "librbd/managed_lock/GetLockerRequest.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#define dout_subsys ceph_subsys_rbd
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::FileImageCache: " << this << " " \
+                           <<  __func__ << ": "
+
+namespace librbd {
+namespace cache {
+
+namespace {
+
+const uint64_t BLOCK_SIZE = 4096;
+const uint64_t SUPERBLOCK_MAGIC = 0x7262645f77626373ull; // "rbd_wbcs"
+const uint64_t ENTRY_MAGIC = 0x7262645f77626365ull;      // "rbd_wbce"
+const unsigned MAX_DESTAGES_IN_FLIGHT = 16;
+
+struct Superblock {
+  uint64_t log_size = 0;
+  uint64_t tail_pos = 0;
+  uint64_t tail_seq = 1;
+  int64_t pool_id = -1;
+  std::string image_id;
+  uint64_t owner_id = 0;   ///< librados instance that logged the entries
+
+  void encode(bufferlist &bl) const {
+    ENCODE_START(2, 1, bl);
+    ::encode(log_size, bl);
+    ::encode(tail_pos, bl);
+    ::encode(tail_seq, bl);
+    ::encode(pool_id, bl);
+    ::encode(image_id, bl);
+    ::encode(owner_id, bl);
+    ENCODE_FINISH(bl);
+  }
+  void decode(bufferlist::iterator &it) {
+    DECODE_START(2, it);
+    ::decode(log_size, it);
+    ::decode(tail_pos, it);
+    ::decode(tail_seq, it);
+    ::decode(pool_id, it);
+    ::decode(image_id, it);
+    if (struct_v >= 2) {
+      ::decode(owner_id, it);
+    }
+    DECODE_FINISH(it);
+  }
+};
+
+struct EntryHeader {
+  uint64_t seq = 0;
+  uint8_t type = 0;
+  uint64_t image_offset = 0;
+  uint64_t length = 0;
+  uint32_t data_crc = 0;
+
+  void encode(bufferlist &bl) const {
+    ENCODE_START(1, 1, bl);
+    ::encode(seq, bl);
+    ::encode(type, bl);
+    ::encode(image_offset, bl);
+    ::encode(length, bl);
+    ::encode(data_crc, bl);
+    ENCODE_FINISH(bl);
+  }
+  void decode(bufferlist::iterator &it) {
+    DECODE_START(1, it);
+    ::decode(seq, it);
+    ::decode(type, it);
+    ::decode(image_offset, it);
+    ::decode(length, it);
+    ::decode(data_crc, it);
+    DECODE_FINISH(it);
+  }
+};
+
+// a block is: magic, crc of the payload, payload, zero padding
+template <typename T>
+void encode_block(uint64_t magic, const T &t, bufferlist *out) {
+  bufferlist payload;
+  t.encode(payload);
+  ::encode(magic, *out);
+  ::encode(payload.crc32c(0), *out);
+  ::encode(payload, *out);
+  assert(out->length() <= BLOCK_SIZE);
+  out->append_zero(BLOCK_SIZE - out->length());
+}
+
+template <typename T>
+bool decode_block(uint64_t magic, bufferlist &bl, T *t) {
+  try {
+    bufferlist::iterator it = bl.begin();
+    uint64_t m;
+    uint32_t crc;
+    bufferlist payload;
+    ::decode(m, it);
+    if (m != magic) {
+      return false;
+    }
+    ::decode(crc, it);
+    ::decode(payload, it);
+    if (payload.crc32c(0) != crc) {
+      return false;
+    }
+    bufferlist::iterator p = payload.begin();
+    t->decode(p);
+  } catch (buffer::error&) {
+    return false;
+  }
+  return true;
+}
+
+} // anonymous namespace
+
+template <typename I>
+FileImageCache<I>::FileImageCache(I &image_ctx)
+  : m_image_ctx(image_ctx), m_image_writeback(image_ctx),
+    m_lock("librbd::cache::FileImageCache::m_lock"),
+    m_writer_thread(this) {
+}
+
+template <typename I>
+FileImageCache<I>::~FileImageCache() {
+  assert(m_fd < 0);
+  assert(m_log_entries.empty());
+  assert(m_pending_writes.empty());
+}
+
+template <typename I>
+uint64_t FileImageCache<I>::round_up(uint64_t v) {
+  return (v + BLOCK_SIZE - 1) & ~(BLOCK_SIZE - 1);
+}
+
+template <typename I>
+uint64_t FileImageCache<I>::entry_size(uint64_t length) const {
+  return BLOCK_SIZE + round_up(length);
+}
+
+template <typename I>
+int FileImageCache<I>::read_log(uint64_t pos, uint64_t length,
+                                bufferlist *bl) {
+  uint64_t off = BLOCK_SIZE + pos % m_log_size;
+  assert(off + length <= BLOCK_SIZE + m_log_size);
+  bufferptr bp(length);
+  uint64_t done = 0;
+  while (done < length) {
+    ssize_t r = ::pread(m_fd, bp.c_str() + done, length - done, off + done);
+    if (r < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -errno;
+    } else if (r == 0) {
+      return -EIO;
+    }
+    done += r;
+  }
+  bl->append(std::move(bp));
+  return 0;
+}
+
+template <typename I>
+int FileImageCache<I>::write_log(uint64_t pos, bufferlist &bl) {
+  uint64_t off = BLOCK_SIZE + pos % m_log_size;
+  assert(off + bl.length() <= BLOCK_SIZE + m_log_size);
+  return bl.write_fd(m_fd, off);
+}
+
+template <typename I>
+int FileImageCache<I>::write_superblock(uint64_t tail_pos, uint64_t tail_seq,
+                                        uint64_t owner_id) {
+  Superblock sb;
+  sb.log_size = m_log_size;
+  sb.tail_pos = tail_pos;
+  sb.tail_seq = tail_seq;
+  sb.pool_id = m_image_ctx.md_ctx.get_id();
+  sb.image_id = m_image_ctx.id;
+  sb.owner_id = owner_id;
+
+  bufferlist bl;
+  encode_block(SUPERBLOCK_MAGIC, sb, &bl);
+  return bl.write_fd(m_fd, 0);
+}
+
+template <typename I>
+int FileImageCache<I>::open_log(bool *created) {
+  CephContext *cct = m_image_ctx.cct;
+
+  const std::string &dir = m_image_ctx.persistent_cache_path;
+  if (::mkdir(dir.c_str(), 0700) < 0 && errno != EEXIST) {
+    int r = -errno;
+    lderr(cct) << "failed to create " << dir << ": " << cpp_strerror(r)
+               << dendl;
+    return r;
+  }
+
+  // the log is replayed into the image, so it must not be a file (or a
+  // link to one) that anyone else could have written
+  m_path = dir + "/rbd-" + stringify(m_image_ctx.md_ctx.get_id()) + "." +
+    m_image_ctx.id + ".cache";
+  m_fd = ::open(m_path.c_str(), O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC,
+                0600);
+  if (m_fd < 0) {
+    int r = -errno;
+    lderr(cct) << "failed to open " << m_path << ": " << cpp_strerror(r)
+               << dendl;
+    return r;
+  }
+
+  struct stat st;
+  if (::fstat(m_fd, &st) < 0) {
+    return -errno;
+  }
+  if (!S_ISREG(st.st_mode) || st.st_uid != ::geteuid() ||
+      (st.st_mode & (S_IRWXG | S_IRWXO)) != 0 || st.st_nlink != 1) {
+    lderr(cct) << m_path << " is not a private file of this user" << dendl;
+    return -EPERM;
+  }
+
+  *created = (st.st_size == 0);
+  if (*created) {
+    m_log_size = std::max(m_image_ctx.persistent_cache_size & ~(BLOCK_SIZE - 1),
+                          16 * BLOCK_SIZE);
+    int r = ::posix_fallocate(m_fd, 0, BLOCK_SIZE + m_log_size);
+    if (r != 0) {
+      lderr(cct) << "failed to allocate " << m_path << ": "
+                 << cpp_strerror(r) << dendl;
+      return -r;
+    }
+    r = write_superblock(0, 1, 0);
+    if (r == 0 && ::fdatasync(m_fd) < 0) {
+      r = -errno;
+    }
+    return r;
+  }
+
+  bufferlist bl;
+  ssize_t r = bl.read_fd(m_fd, BLOCK_SIZE);
+  Superblock sb;
+  if (r < 0 || !decode_block(SUPERBLOCK_MAGIC, bl, &sb)) {
+    lderr(cct) << "corrupt superblock in " << m_path << dendl;
+    return -EIO;
+  }
+  if (sb.pool_id != m_image_ctx.md_ctx.get_id() ||
+      sb.image_id != m_image_ctx.id ||
+      sb.log_size == 0 || sb.log_size % BLOCK_SIZE != 0 ||
+      (uint64_t)st.st_size < BLOCK_SIZE + sb.log_size) {
+    lderr(cct) << m_path << " does not belong to this image" << dendl;
+    return -EINVAL;
+  }
+
+  // an existing log keeps its size until it has been drained and removed
+  m_log_size = sb.log_size;
+  m_tail_pos = m_persisted_tail_pos = sb.tail_pos;
+  m_tail_seq = m_persisted_tail_seq = sb.tail_seq;
+  m_log_owner_id = m_persisted_log_owner_id = sb.owner_id;
+  return 0;
+}
+
+template <typename I>
+int FileImageCache<I>::replay_log() {
+  CephContext *cct = m_image_ctx.cct;
+
+  uint64_t pos = m_tail_pos;
+  uint64_t seq = m_tail_seq;
+  while (pos - m_tail_pos < m_log_size) {
+    bufferlist bl;
+    int r = read_log(pos, BLOCK_SIZE, &bl);
+    if (r < 0) {
+      return r;
+    }
+
+    EntryHeader h;
+    if (!decode_block(ENTRY_MAGIC, bl, &h) || h.seq != seq) {
+      break;
+    }
+
+    uint64_t ring_left = m_log_size - pos % m_log_size;
+    uint64_t size;
+    if (h.type == ENTRY_TYPE_PAD) {
+      size = ring_left;
+    } else if (h.type == ENTRY_TYPE_WRITE) {
+      size = entry_size(h.length);
+      if (size > ring_left) {
+        break;
+      }
+      bufferlist data;
+      r = read_log(pos + BLOCK_SIZE, h.length, &data);
+      if (r < 0) {
+        return r;
+      }
+      if (data.crc32c(0) != h.data_crc) {
+        // torn append; it was never acknowledged
+        break;
+      }
+    } else {
+      break;
+    }
+    if (pos + size - m_tail_pos > m_log_size) {
+      break;
+    }
+
+    LogEntry *entry = new LogEntry{seq, pos, size, h.type, h.image_offset,
+                                   h.length};
+    if (h.type == ENTRY_TYPE_PAD) {
+      entry->state = ENTRY_STATE_DESTAGED;
+    } else {
+      map_insert(entry);
+    }
+    m_log_entries.push_back(entry);
+    pos += size;
+    ++seq;
+  }
+
+  m_head_pos = pos;
+  m_next_seq = seq;
+  ldout(cct, 5) << "replayed " << m_log_entries.size() << " entries, "
+                << (m_head_pos - m_tail_pos) << " bytes" << dendl;
+  return 0;
+}
+
+template <typename I>
+int FileImageCache<I>::discard_log() {
+  Mutex::Locker locker(m_lock);
+  for (auto entry : m_log_entries) {
+    delete entry;
+  }
+  m_log_entries.clear();
+  m_extent_map.clear();
+
+  m_tail_pos = m_persisted_tail_pos = m_head_pos;
+  m_tail_seq = m_persisted_tail_seq = m_next_seq;
+  int r = write_superblock(m_tail_pos, m_tail_seq, m_log_owner_id);
+  if (r == 0 && ::fdatasync(m_fd) < 0) {
+    r = -errno;
+  }
+  return r;
+}
+
+template <typename I>
+void FileImageCache<I>::init(Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << dendl;
+
+  m_owner_id = m_image_ctx.md_ctx.get_instance_id();
+
+  bool created = false;
+  int r = open_log(&created);
+  if (r == 0 && !created) {
+    r = replay_log();
+  }
+  if (r < 0 || m_log_entries.empty()) {
+    handle_init(r, on_finish);
+    return;
+  }
+
+  send_get_locker(on_finish);
+}
+
+template <typename I>
+void FileImageCache<I>::send_get_locker(Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << dendl;
+
+  Context *ctx = new FunctionContext([this, on_finish](int r) {
+      handle_get_locker(r, on_finish);
+    });
+  auto req = managed_lock::GetLockerRequest<I>::create(
+    m_image_ctx.md_ctx, m_image_ctx.header_oid, true, &m_locker, ctx);
+  req->send();
+}
+
+template <typename I>
+void FileImageCache<I>::handle_get_locker(int r, Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << "r=" << r << dendl;
+
+  if (r < 0 && r != -ENOENT && r != -EBUSY) {
+    lderr(cct) << "failed to retrieve image lock owner: " << cpp_strerror(r)
+               << dendl;
+    handle_init(r, on_finish);
+    return;
+  }
+
+  // the client that logged the entries never releases the lock with
+  // entries left in the log.  If it no longer holds the lock, someone
+  // broke it and may have written the image since, and replaying the
+  // log could overwrite newer data.
+  if (r < 0 || m_locker.entity != entity_name_t::CLIENT(m_log_owner_id)) {
+    lderr(cct) << "discarding " << m_log_entries.size() << " entries in "
+               << m_path << ": the image lock is no longer held by client."
+               << m_log_owner_id << ", which logged them" << dendl;
+    handle_init(discard_log(), on_finish);
+    return;
+  }
+
+  // replayed writes may only be destaged by the lock owner.  The lock
+  // cannot be acquired while the image is being opened, so request it
+  // once the open has finished and hold the entries back until then.
+  {
+    RWLock::RLocker owner_locker(m_image_ctx.owner_lock);
+    if (m_image_ctx.exclusive_lock != nullptr &&
+        !m_image_ctx.exclusive_lock->is_lock_owner()) {
+      m_destage_held = true;
+      I *image_ctx = &m_image_ctx;
+      m_image_ctx.op_work_queue->queue(new FunctionContext(
+        [image_ctx](int r) {
+          RWLock::RLocker owner_locker(image_ctx->owner_lock);
+          if (image_ctx->exclusive_lock != nullptr) {
+            image_ctx->exclusive_lock->acquire_lock(nullptr);
+          }
+        }), 0);
+    }
+  }
+  handle_init(0, on_finish);
+}
+
+template <typename I>
+void FileImageCache<I>::handle_init(int r, Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << "r=" << r << dendl;
+
+  if (r < 0) {
+    Mutex::Locker locker(m_lock);
+    for (auto entry : m_log_entries) {
+      delete entry;
+    }
+    m_log_entries.clear();
+    m_extent_map.clear();
+    if (m_fd >= 0) {
+      VOID_TEMP_FAILURE_RETRY(::close(m_fd));
+      m_fd = -1;
+    }
+    on_finish->complete(r);
+    return;
+  }
+
+  ldout(cct, 5) << "using " << m_path << ", log size " << m_log_size
+                << (m_destage_held ? ", waiting for the exclusive lock" : "")
+                << dendl;
+  m_writer_thread.create("rbd_wb_cache");
+  on_finish->complete(0);
+}
+
+template <typename I>
+void FileImageCache<I>::shut_down(Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << dendl;
+
+  // everything is destaged (and the image flushed) before the log is
+  // closed, so the file is left empty -- unless replayed entries are
+  // still waiting for the exclusive lock; they stay for the next open
+  flush(new FunctionContext([this, on_finish](int r) {
+      {
+        Mutex::Locker locker(m_lock);
+        m_stop = true;
+        m_cond.Signal();
+      }
+      m_writer_thread.join();
+
+      if (r == 0) {
+        Mutex::Locker locker(m_lock);
+        assert(m_pending_writes.empty());
+        r = write_superblock(m_tail_pos, m_tail_seq, m_log_owner_id);
+        if (r == 0 && ::fdatasync(m_fd) < 0) {
+          r = -errno;
+        }
+      } else {
+        lderr(m_image_ctx.cct) << "failed to destage " << m_path << ": "
+                               << cpp_strerror(r) << dendl;
+      }
+
+      {
+        Mutex::Locker locker(m_lock);
+        for (auto entry : m_log_entries) {
+          delete entry;
+        }
+        m_log_entries.clear();
+        m_extent_map.clear();
+      }
+      VOID_TEMP_FAILURE_RETRY(::close(m_fd));
+      m_fd = -1;
+      on_finish->complete(r);
+    }));
+}
+
+template <typename I>
+void FileImageCache<I>::aio_read(Extents &&image_extents, bufferlist *bl,
+                                 int fadvise_flags, Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << "image_extents=" << image_extents << ", "
+                 << "on_finish=" << on_finish << dendl;
+
+  uint64_t total = 0;
+  for (auto &extent : image_extents) {
+    total += extent.second;
+  }
+
+  std::map<uint64_t, bufferlist> overlay;
+  uint64_t covered = 0;
+  int r = read_overlay(image_extents, &overlay, &covered);
+  if (r < 0) {
+    on_finish->complete(r);
+    return;
+  }
+
+  if (covered == total) {
+    ldout(cct, 20) << "hit" << dendl;
+    bl->clear();
+    bl->append_zero(total);
+    for (auto &o : overlay) {
+      bl->copy_in(o.first, o.second.length(), o.second);
+    }
+    on_finish->complete(0);
+    return;
+  }
+
+  // read the image and lay the newer cached data over it
+  Context *ctx = new FunctionContext(
+    [bl, total, overlay=std::move(overlay), on_finish](int r) {
+      if (r >= 0) {
+        if (bl->length() < total) {
+          bl->append_zero(total - bl->length());
+        }
+        for (auto &o : overlay) {
+          bl->copy_in(o.first, o.second.length(), o.second);
+        }
+      }
+      on_finish->complete(r);
+    });
+  m_image_writeback.aio_read(std::move(image_extents), bl, fadvise_flags, ctx);
+}
+
+template <typename I>
+void FileImageCache<I>::aio_write(Extents &&image_extents,
+                                  bufferlist&& bl,
+                                  int fadvise_flags,
+                                  Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << "image_extents=" << image_extents << ", "
+                 << "on_finish=" << on_finish << dendl;
+
+  bool too_large = false;
+  for (auto &extent : image_extents) {
+    if (entry_size(extent.second) > m_log_size / 4) {
+      too_large = true;
+    }
+  }
+  if (too_large) {
+    auto extents = std::make_shared<Extents>(std::move(image_extents));
+    auto data = std::make_shared<bufferlist>(std::move(bl));
+    start_barrier(
+      [this, extents, data, fadvise_flags](Context *ctx) {
+        m_image_writeback.aio_write(std::move(*extents), std::move(*data),
+                                    fadvise_flags, ctx);
+      }, on_finish);
+    return;
+  }
+
+  C_GatherBuilder gather(cct);
+  {
+    Mutex::Locker locker(m_lock);
+    if (m_barrier) {
+      auto extents = std::make_shared<Extents>(std::move(image_extents));
+      auto data = std::make_shared<bufferlist>(std::move(bl));
+      m_barrier_waiters.push_back(
+        [this, extents, data, fadvise_flags, on_finish]() {
+          aio_write(std::move(*extents), std::move(*data), fadvise_flags,
+                    on_finish);
+        });
+      return;
+    }
+
+    uint64_t off = 0;
+    for (auto &extent : image_extents) {
+      if (extent.second == 0) {
+        continue;
+      }
+      PendingWrite pw;
+      pw.image_offset = extent.first;
+      pw.bl.substr_of(bl, off, extent.second);
+      pw.on_persist = gather.new_sub();
+      m_pending_writes.push_back(std::move(pw));
+      off += extent.second;
+    }
+    m_cond.Signal();
+  }
+
+  if (!gather.has_subs()) {
+    on_finish->complete(0);
+    return;
+  }
+  gather.set_finisher(on_finish);
+  gather.activate();
+}
+
+template <typename I>
+void FileImageCache<I>::aio_discard(uint64_t offset, uint64_t length,
+                                    bool skip_partial_discard,
+                                    Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << "offset=" << offset << ", "
+                 << "length=" << length << ", "
+                 << "on_finish=" << on_finish << dendl;
+
+  start_barrier(
+    [this, offset, length, skip_partial_discard](Context *ctx) {
+      m_image_writeback.aio_discard(offset, length, skip_partial_discard, ctx);
+    }, on_finish);
+}
+
+template <typename I>
+void FileImageCache<I>::aio_flush(Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << "on_finish=" << on_finish << dendl;
+
+  // acknowledged writes are already durable in the log
+  m_image_ctx.op_work_queue->queue(on_finish, 0);
+}
+
+template <typename I>
+void FileImageCache<I>::aio_writesame(uint64_t offset, uint64_t length,
+                                      bufferlist&& bl, int fadvise_flags,
+                                      Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << "offset=" << offset << ", "
+                 << "length=" << length << ", "
+                 << "data_len=" << bl.length() << ", "
+                 << "on_finish=" << on_finish << dendl;
+
+  auto data = std::make_shared<bufferlist>(std::move(bl));
+  start_barrier(
+    [this, offset, length, data, fadvise_flags](Context *ctx) {
+      m_image_writeback.aio_writesame(offset, length, std::move(*data),
+                                      fadvise_flags, ctx);
+    }, on_finish);
+}
+
+template <typename I>
+void FileImageCache<I>::invalidate(Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << dendl;
+
+  // only dirty data is cached, and that cannot be dropped
+  flush(on_finish);
+}
+
+template <typename I>
+void FileImageCache<I>::flush(Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << dendl;
+
+  wait_for_destage(new FunctionContext([this, on_finish](int r) {
+      if (r < 0) {
+        on_finish->complete(r);
+        return;
+      }
+      m_image_writeback.aio_flush(on_finish);
+    }));
+}
+
+template <typename I>
+void FileImageCache<I>::handle_lock_acquired() {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << dendl;
+
+  Mutex::Locker locker(m_lock);
+  if (m_destage_held) {
+    // the entries are ours now; the writer records that before it
+    // destages them
+    ldout(cct, 5) << "destaging replayed entries" << dendl;
+    m_destage_held = false;
+    m_log_owner_id = m_owner_id;
+    m_cond.Signal();
+  }
+}
+
+template <typename I>
+void FileImageCache<I>::wait_for_destage(Context *on_finish) {
+  Mutex::Locker locker(m_lock);
+
+  if (m_destage_held) {
+    // nothing can have been logged without the lock; the replayed
+    // entries are left to the next lock owner
+    ldout(m_image_ctx.cct, 5) << "replayed entries wait for the lock"
+                              << dendl;
+    m_image_ctx.op_work_queue->queue(on_finish, 0);
+    return;
+  }
+
+  // retry destaging after an earlier failure
+  m_destage_error = 0;
+  if (!m_pending_writes.empty()) {
+    m_pending_writes.back().destage_waiters.push_back(on_finish);
+  } else {
+    m_destage_waiters.push_back(std::make_pair(m_next_seq, on_finish));
+    complete_destage_waiters();
+  }
+  m_cond.Signal();
+}
+
+template <typename I>
+void FileImageCache<I>::complete_destage_waiters() {
+  assert(m_lock.is_locked());
+
+  for (auto it = m_destage_waiters.begin(); it != m_destage_waiters.end(); ) {
+    if (m_tail_seq >= it->first) {
+      m_image_ctx.op_work_queue->queue(it->second, 0);
+    } else if (m_destage_error < 0 && m_destaging.empty()) {
+      // report the failure only once no destage still refers to the
+      // entries, so that the caller may tear the cache down
+      m_image_ctx.op_work_queue->queue(it->second, m_destage_error);
+    } else {
+      ++it;
+      continue;
+    }
+    it = m_destage_waiters.erase(it);
+  }
+}
+
+template <typename I>
+void FileImageCache<I>::start_barrier(std::function<void(Context*)> &&op,
+                                      Context *on_finish) {
+  {
+    Mutex::Locker locker(m_lock);
+    if (m_barrier) {
+      auto barrier_op = std::make_shared<std::function<void(Context*)> >(
+        std::move(op));
+      m_barrier_waiters.push_back([this, barrier_op, on_finish]() {
+          start_barrier(std::move(*barrier_op), on_finish);
+        });
+      return;
+    }
+    m_barrier = true;
+  }
+
+  // drain the log and make the retired tail durable first, so that a
+  // replay after a crash cannot apply older writes on top of this one
+  auto barrier_op = std::make_shared<std::function<void(Context*)> >(
+    std::move(op));
+  Context *on_barrier = new FunctionContext([this, on_finish](int r) {
+      std::list<std::function<void()> > waiters;
+      {
+        Mutex::Locker locker(m_lock);
+        m_barrier = false;
+        waiters.swap(m_barrier_waiters);
+      }
+      on_finish->complete(r);
+      for (auto &waiter : waiters) {
+        waiter();
+      }
+    });
+  wait_for_destage(new FunctionContext(
+    [this, barrier_op, on_barrier](int r) {
+      if (r < 0) {
+        on_barrier->complete(r);
+        return;
+      }
+      Mutex::Locker locker(m_lock);
+      m_sync_waiters.push_back(new FunctionContext(
+        [barrier_op, on_barrier](int r) {
+          if (r < 0) {
+            on_barrier->complete(r);
+            return;
+          }
+          (*barrier_op)(on_barrier);
+        }));
+      m_cond.Signal();
+    }));
+}
+
+template <typename I>
+void FileImageCache<I>::writer_entry() {
+  m_lock.Lock();
+  while (!m_stop) {
+    std::list<Context*> acks;
+    int ack_r = 0;
+    bool did_io = append_pending(&acks, &ack_r);
+
+    std::list<LogEntry*> destages;
+    dispatch_destages(&destages);
+
+    if (!acks.empty() || !destages.empty()) {
+      m_lock.Unlock();
+      for (auto ctx : acks) {
+        ctx->complete(ack_r);
+      }
+      for (auto entry : destages) {
+        destage(entry);
+      }
+      m_lock.Lock();
+      continue;
+    }
+    if (!did_io) {
+      m_cond.Wait(m_lock);
+    }
+  }
+  m_lock.Unlock();
+}
+
+template <typename I>
+bool FileImageCache<I>::append_pending(std::list<Context*> *acks, int *ack_r) {
+  assert(m_lock.is_locked());
+  CephContext *cct = m_image_ctx.cct;
+
+  uint64_t tail_pos = m_tail_pos;
+  uint64_t tail_seq = m_tail_seq;
+  uint64_t owner_id = m_log_owner_id;
+  bool write_sb = (tail_pos != m_persisted_tail_pos ||
+                   owner_id != m_persisted_log_owner_id ||
+                   !m_sync_waiters.empty());
+
+  // new entries may only reuse space freed by the persisted tail
+  std::list<std::pair<uint64_t, bufferlist> > ios;
+  std::list<LogEntry*> entries;
+  std::list<PendingWrite> writes;
+  std::list<std::pair<uint64_t, Context*> > destage_waiters;
+  uint64_t head = m_head_pos;
+  uint64_t seq = m_next_seq;
+  while (!m_pending_writes.empty()) {
+    PendingWrite &pw = m_pending_writes.front();
+    uint64_t size = entry_size(pw.bl.length());
+    uint64_t ring_left = m_log_size - head % m_log_size;
+    uint64_t pad = ring_left < size ? ring_left : 0;
+    if (head + pad + size - m_persisted_tail_pos > m_log_size) {
+      break;
+    }
+
+    if (pad) {
+      EntryHeader h;
+      h.seq = seq;
+      h.type = ENTRY_TYPE_PAD;
+      h.length = pad - BLOCK_SIZE;
+      bufferlist bl;
+      encode_block(ENTRY_MAGIC, h, &bl);
+      ios.push_back(std::make_pair(head, std::move(bl)));
+      LogEntry *entry = new LogEntry{seq, head, pad, ENTRY_TYPE_PAD, 0, 0};
+      entry->state = ENTRY_STATE_DESTAGED;
+      entries.push_back(entry);
+      head += pad;
+      ++seq;
+    }
+
+    EntryHeader h;
+    h.seq = seq;
+    h.type = ENTRY_TYPE_WRITE;
+    h.image_offset = pw.image_offset;
+    h.length = pw.bl.length();
+    h.data_crc = pw.bl.crc32c(0);
+    bufferlist bl;
+    encode_block(ENTRY_MAGIC, h, &bl);
+    bl.append(pw.bl);
+    bl.append_zero(size - bl.length());
+    ios.push_back(std::make_pair(head, std::move(bl)));
+    entries.push_back(new LogEntry{seq, head, size, ENTRY_TYPE_WRITE,
+                                   pw.image_offset, h.length});
+    head += size;
+    ++seq;
+
+    // waiters attached to a write want it, and everything before it,
+    // destaged
+    for (auto ctx : pw.destage_waiters) {
+      destage_waiters.push_back(std::make_pair(seq, ctx));
+    }
+    writes.push_back(std::move(pw));
+    m_pending_writes.pop_front();
+  }
+
+  // a replay checks that the client that logged the entries still
+  // holds the image lock
+  if (!ios.empty() && owner_id != m_owner_id) {
+    owner_id = m_owner_id;
+    write_sb = true;
+  }
+  if (ios.empty() && !write_sb) {
+    return false;
+  }
+
+  std::list<Context*> sync_waiters;
+  sync_waiters.swap(m_sync_waiters);
+
+  m_lock.Unlock();
+  int r = 0;
+  if (write_sb) {
+    r = write_superblock(tail_pos, tail_seq, owner_id);
+  }
+  for (auto &io : ios) {
+    if (r < 0) {
+      break;
+    }
+    r = write_log(io.first, io.second);
+  }
+  if (r == 0 && ::fdatasync(m_fd) < 0) {
+    r = -errno;
+  }
+  m_lock.Lock();
+
+  for (auto ctx : sync_waiters) {
+    m_image_ctx.op_work_queue->queue(ctx, r);
+  }
+
+  if (r < 0) {
+    lderr(cct) << "failed to append to " << m_path << ": " << cpp_strerror(r)
+               << dendl;
+    for (auto entry : entries) {
+      delete entry;
+    }
+    for (auto &pw : writes) {
+      acks->push_back(pw.on_persist);
+    }
+    for (auto &waiter : destage_waiters) {
+      m_image_ctx.op_work_queue->queue(waiter.second, r);
+    }
+    *ack_r = r;
+    return true;
+  }
+
+  if (write_sb) {
+    m_persisted_tail_pos = tail_pos;
+    m_persisted_tail_seq = tail_seq;
+    m_log_owner_id = m_persisted_log_owner_id = owner_id;
+  }
+  m_head_pos = head;
+  m_next_seq = seq;
+  for (auto entry : entries) {
+    if (entry->type == ENTRY_TYPE_WRITE) {
+      map_insert(entry);
+    }
+    m_log_entries.push_back(entry);
+  }
+  retire_entries();
+
+  m_destage_waiters.splice(m_destage_waiters.end(), destage_waiters);
+  for (auto &pw : writes) {
+    acks->push_back(pw.on_persist);
+  }
+  *ack_r = 0;
+  ldout(cct, 20) << "appended " << writes.size() << " writes, head "
+                 << m_head_pos << ", tail " << m_persisted_tail_pos << dendl;
+  return true;
+}
+
+template <typename I>
+void FileImageCache<I>::dispatch_destages(std::list<LogEntry*> *destages) {
+  assert(m_lock.is_locked());
+  if (m_destage_error < 0 || m_destage_held) {
+    return;
+  }
+
+  for (auto entry : m_log_entries) {
+    if (m_destaging.size() >= MAX_DESTAGES_IN_FLIGHT) {
+      break;
+    }
+    if (entry->state != ENTRY_STATE_DIRTY) {
+      continue;
+    }
+    // keep overlapping writes in log order
+    if (overlaps_destaging(entry)) {
+      break;
+    }
+    entry->state = ENTRY_STATE_DESTAGING;
+    m_destaging.push_back(entry);
+    destages->push_back(entry);
+  }
+}
+
+template <typename I>
+bool FileImageCache<I>::overlaps_destaging(const LogEntry *entry) const {
+  for (auto other : m_destaging) {
+    if (other->image_offset < entry->image_offset + entry->length &&
+        entry->image_offset < other->image_offset + other->length) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename I>
+void FileImageCache<I>::destage(LogEntry *entry) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << "seq=" << entry->seq << ", "
+                 << "image_offset=" << entry->image_offset << ", "
+                 << "length=" << entry->length << dendl;
+
+  bufferlist bl;
+  int r = read_log(entry->pos + BLOCK_SIZE, entry->length, &bl);
+  if (r < 0) {
+    handle_destage(entry, r);
+    return;
+  }
+
+  m_image_writeback.aio_write(
+    {{entry->image_offset, entry->length}}, std::move(bl), 0,
+    new FunctionContext([this, entry](int r) {
+        handle_destage(entry, r);
+      }));
+}
+
+template <typename I>
+void FileImageCache<I>::handle_destage(LogEntry *entry, int r) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << "seq=" << entry->seq << ", r=" << r << dendl;
+
+  Mutex::Locker locker(m_lock);
+  m_destaging.remove(entry);
+  if (r < 0) {
+    lderr(cct) << "failed to destage seq " << entry->seq << ": "
+               << cpp_strerror(r) << dendl;
+    entry->state = ENTRY_STATE_DIRTY;
+    if (m_destage_error == 0) {
+      m_destage_error = r;
+    }
+  } else {
+    entry->state = ENTRY_STATE_DESTAGED;
+    map_remove(entry);
+    retire_entries();
+  }
+  complete_destage_waiters();
+  m_cond.Signal();
+}
+
+template <typename I>
+void FileImageCache<I>::retire_entries() {
+  assert(m_lock.is_locked());
+  while (!m_log_entries.empty() &&
+         m_log_entries.front()->state == ENTRY_STATE_DESTAGED &&
+         m_log_entries.front()->readers == 0) {
+    LogEntry *entry = m_log_entries.front();
+    m_tail_pos = entry->pos + entry->size;
+    m_log_entries.pop_front();
+    delete entry;
+  }
+  m_tail_seq = m_log_entries.empty() ? m_next_seq :
+    m_log_entries.front()->seq;
+}
+
+template <typename I>
+void FileImageCache<I>::map_insert(LogEntry *entry) {
+  uint64_t start = entry->image_offset;
+  uint64_t end = start + entry->length;
+
+  auto p = m_extent_map.lower_bound(start);
+  if (p != m_extent_map.begin()) {
+    auto q = std::prev(p);
+    if (q->first + q->second.length > start) {
+      p = q;
+    }
+  }
+  while (p != m_extent_map.end() && p->first < end) {
+    uint64_t p_start = p->first;
+    uint64_t p_end = p_start + p->second.length;
+    MapExtent old = p->second;
+    p = m_extent_map.erase(p);
+    if (p_start < start) {
+      m_extent_map[p_start] = MapExtent{start - p_start, old.entry,
+                                        old.entry_offset};
+    }
+    if (p_end > end) {
+      m_extent_map[end] = MapExtent{p_end - end, old.entry,
+                                    old.entry_offset + (end - p_start)};
+    }
+  }
+  m_extent_map[start] = MapExtent{entry->length, entry, 0};
+}
+
+template <typename I>
+void FileImageCache<I>::map_remove(LogEntry *entry) {
+  uint64_t start = entry->image_offset;
+  uint64_t end = start + entry->length;
+
+  auto p = m_extent_map.lower_bound(start);
+  if (p != m_extent_map.begin()) {
+    auto q = std::prev(p);
+    if (q->first + q->second.length > start) {
+      p = q;
+    }
+  }
+  while (p != m_extent_map.end() && p->first < end) {
+    if (p->second.entry == entry) {
+      p = m_extent_map.erase(p);
+    } else {
+      ++p;
+    }
+  }
+}
+
+template <typename I>
+int FileImageCache<I>::read_overlay(const Extents &image_extents,
+                                   std::map<uint64_t, bufferlist> *overlay,
+                                   uint64_t *covered) {
+  struct OverlayRead {
+    LogEntry *entry;
+    uint64_t pos;
+    uint64_t length;
+    uint64_t buffer_off;
+  };
+  std::list<OverlayRead> reads;
+
+  {
+    Mutex::Locker locker(m_lock);
+
+    // overlay offsets are relative to the start of the read buffer
+    uint64_t buffer_off = 0;
+    for (auto &extent : image_extents) {
+      uint64_t start = extent.first;
+      uint64_t end = start + extent.second;
+
+      auto p = m_extent_map.lower_bound(start);
+      if (p != m_extent_map.begin()) {
+        auto q = std::prev(p);
+        if (q->first + q->second.length > start) {
+          p = q;
+        }
+      }
+      for (; p != m_extent_map.end() && p->first < end; ++p) {
+        uint64_t hit_start = std::max(start, p->first);
+        uint64_t hit_end = std::min(end, p->first + p->second.length);
+        LogEntry *entry = p->second.entry;
+
+        // a pinned entry is not retired, so its space in the log is not
+        // reused while it is read below
+        ++entry->readers;
+        reads.push_back(OverlayRead{
+          entry,
+          entry->pos + BLOCK_SIZE + p->second.entry_offset +
+            (hit_start - p->first),
+          hit_end - hit_start,
+          buffer_off + hit_start - start});
+      }
+      buffer_off += extent.second;
+    }
+  }
+
+  int r = 0;
+  for (auto &read : reads) {
+    bufferlist bl;
+    r = read_log(read.pos, read.length, &bl);
+    if (r < 0) {
+      break;
+    }
+    (*overlay)[read.buffer_off] = std::move(bl);
+    *covered += read.length;
+  }
+
+  if (!reads.empty()) {
+    Mutex::Locker locker(m_lock);
+    for (auto &read : reads) {
+      --read.entry->readers;
+    }
+    retire_entries();
+    complete_destage_waiters();
+    m_cond.Signal();
+  }
+  return r;
+}
+
+} // namespace cache
+} // namespace librbd
+
+template class librbd::cache::FileImageCache<librbd::ImageCtx>;
@@ -0,0 +1,216 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_LIBRBD_CACHE_FILE_IMAGE_CACHE
+#define CEPH_LIBRBD_CACHE_FILE_IMAGE_CACHE
+
+#include "ImageCache.h"
+#include "ImageWriteback.h"
+#include "include/buffer.h"
+#include "common/Cond.h"
+#include "common/Mutex.h"
+#include "common/Thread.h"
+#include "librbd/managed_lock/Types.h"
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <string>
+
+namespace librbd {
+
+struct ImageCtx;
+
+namespace cache {
+
+/**
+ * Persistent, write-back client-side image extent cache
+ *
+ * Writes are appended to a log in a local file (intended to live on
+ * local flash) and acknowledged once the log append is durable.  A
+ * background thread batches appends into a single fdatasync and
+ * destages logged writes to the image in log order; writes that
+ * overlap an in-flight destage wait for it, so the image always moves
+ * through the same sequence of states the client produced.  Reads are
+ * served from the image with any not yet destaged data overlaid from
+ * the log.
+ *
+ * The log is a ring of 4K blocks following a superblock that records
+ * the oldest live entry.  Each entry is a checksummed header block
+ * followed by its data.  After a crash, init() replays every intact
+ * entry from the superblock's tail onward and destages them again;
+ * since destaging is idempotent and in order, this leaves the image as
+ * of the last acknowledged write.  The superblock also records the
+ * client that logged the entries; they are only replayed while that
+ * client still holds the image's exclusive lock.  Otherwise another
+ * client has broken the lock and may have written the image since, and
+ * the log is discarded.  init() does not wait for the exclusive lock:
+ * replayed entries are held back (but served to reads) until
+ * handle_lock_acquired() is called.
+ *
+ * Discards, writesames and writes too large for the log act as
+ * barriers: the log is drained, later requests wait, and the request
+ * is passed straight through to the image.
+ *
+ * The cache assumes it is the only writer of the image (e.g. it holds
+ * the exclusive lock); flush() drains the log so that the image is
+ * complete before the lock is handed over or a snapshot is taken.
+ */
+template <typename ImageCtxT = librbd::ImageCtx>
+class FileImageCache : public ImageCache {
+public:
+  FileImageCache(ImageCtxT &image_ctx);
+  ~FileImageCache() override;
+
+  /// client AIO methods
+  void aio_read(Extents&& image_extents, ceph::bufferlist *bl,
+                int fadvise_flags, Context *on_finish) override;
+  void aio_write(Extents&& image_extents, ceph::bufferlist&& bl,
+                 int fadvise_flags, Context *on_finish) override;
+  void aio_discard(uint64_t offset, uint64_t length,
+                   bool skip_partial_discard, Context *on_finish) override;
+  void aio_flush(Context *on_finish) override;
+  void aio_writesame(uint64_t offset, uint64_t length,
+                     ceph::bufferlist&& bl,
+                     int fadvise_flags, Context *on_finish) override;
+
+  /// internal state methods
+  void init(Context *on_finish) override;
+  void shut_down(Context *on_finish) override;
+
+  void invalidate(Context *on_finish) override;
+  void flush(Context *on_finish) override;
+
+  void handle_lock_acquired() override;
+
+private:
+  enum EntryType {
+    ENTRY_TYPE_WRITE = 1,
+    ENTRY_TYPE_PAD = 2,    ///< skips the rest of the ring
+  };
+  enum EntryState {
+    ENTRY_STATE_DIRTY,
+    ENTRY_STATE_DESTAGING,
+    ENTRY_STATE_DESTAGED,
+  };
+
+  /// a durable log entry that has not been retired yet
+  struct LogEntry {
+    uint64_t seq;
+    uint64_t pos;          ///< log position of the header block
+    uint64_t size;         ///< header plus padded data
+    uint8_t type;
+    uint64_t image_offset;
+    uint64_t length;
+    EntryState state = ENTRY_STATE_DIRTY;
+    unsigned readers = 0;  ///< overlay reads in flight; pins the entry
+  };
+
+  /// a write waiting for its log append
+  struct PendingWrite {
+    uint64_t image_offset;
+    ceph::bufferlist bl;
+    Context *on_persist;
+    std::list<Context*> destage_waiters;  ///< flushes issued behind it
+  };
+
+  /// dirty image range backed by (part of) a log entry
+  struct MapExtent {
+    uint64_t length;
+    LogEntry *entry;
+    uint64_t entry_offset;
+  };
+  typedef std::map<uint64_t, MapExtent> ExtentMap;
+
+  class WriterThread : public Thread {
+  public:
+    explicit WriterThread(FileImageCache *cache) : cache(cache) {}
+    void *entry() override {
+      cache->writer_entry();
+      return nullptr;
+    }
+  private:
+    FileImageCache *cache;
+  };
+
+  ImageCtxT &m_image_ctx;
+  ImageWriteback<ImageCtxT> m_image_writeback;
+
+  std::string m_path;
+  int m_fd = -1;
+  uint64_t m_log_size = 0;       ///< bytes in the ring, after the superblock
+  uint64_t m_owner_id = 0;       ///< this client's librados instance
+  managed_lock::Locker m_locker; ///< image lock holder, checked at replay
+
+  Mutex m_lock;
+  Cond m_cond;
+  WriterThread m_writer_thread;
+  bool m_stop = false;
+
+  // log positions grow without bound; the ring offset is pos % m_log_size
+  uint64_t m_head_pos = 0;
+  uint64_t m_next_seq = 1;
+  uint64_t m_tail_pos = 0;       ///< oldest entry not yet destaged
+  uint64_t m_tail_seq = 1;
+  uint64_t m_persisted_tail_pos = 0;
+  uint64_t m_persisted_tail_seq = 1;
+  uint64_t m_log_owner_id = 0;   ///< instance that logged the live entries
+  uint64_t m_persisted_log_owner_id = 0;
+
+  std::deque<PendingWrite> m_pending_writes;
+  std::deque<LogEntry*> m_log_entries;
+  ExtentMap m_extent_map;
+  std::list<LogEntry*> m_destaging;
+  int m_destage_error = 0;
+  bool m_destage_held = false;   ///< replayed entries wait for the lock
+
+  /// contexts waiting for the next superblock update to be durable
+  std::list<Context*> m_sync_waiters;
+
+  /// contexts waiting for every entry with seq < first to be destaged
+  std::list<std::pair<uint64_t, Context*> > m_destage_waiters;
+
+  /// requests held back while a barrier request drains the log
+  bool m_barrier = false;
+  std::list<std::function<void()> > m_barrier_waiters;
+
+  static uint64_t round_up(uint64_t v);
+  uint64_t entry_size(uint64_t length) const;
+
+  int open_log(bool *created);
+  int write_superblock(uint64_t tail_pos, uint64_t tail_seq,
+                       uint64_t owner_id);
+  int replay_log();
+  int discard_log();
+  void send_get_locker(Context *on_finish);
+  void handle_get_locker(int r, Context *on_finish);
+  void handle_init(int r, Context *on_finish);
+
+  void writer_entry();
+  bool append_pending(std::list<Context*> *acks, int *ack_r);
+  void dispatch_destages(std::list<LogEntry*> *destages);
+  void destage(LogEntry *entry);
+  void handle_destage(LogEntry *entry, int r);
+  void retire_entries();
+  void complete_destage_waiters();
+
+  void map_insert(LogEntry *entry);
+  void map_remove(LogEntry *entry);
+  bool overlaps_destaging(const LogEntry *entry) const;
+  int read_overlay(const Extents &image_extents,
+                   std::map<uint64_t, ceph::bufferlist> *overlay,
+                   uint64_t *covered);
+
+  void wait_for_destage(Context *on_finish);
+  void start_barrier(std::function<void(Context*)> &&op, Context *on_finish);
+
+  int read_log(uint64_t pos, uint64_t length, ceph::bufferlist *bl);
+  int write_log(uint64_t pos, ceph::bufferlist &bl);
+};
+
+} // namespace cache
+} // namespace librbd
+
+extern template class librbd::cache::FileImageCache<librbd::ImageCtx>;
+
+#endif // CEPH_LIBRBD_CACHE_FILE_IMAGE_CACHE
@@ -41,6 +41,9 @@ struct ImageCache {
   virtual void invalidate(Context *on_finish) = 0;
   virtual void flush(Context *on_finish) = 0;
 
+  /// the exclusive lock has been acquired
+  virtual void handle_lock_acquired() = 0;
+
 };
 
 } // namespace cache
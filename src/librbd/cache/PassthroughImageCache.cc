@@ -111,6 +111,12 @@ void PassthroughImageCache<I>::flush(Context *on_finish) {
   aio_flush(on_finish);
 }
 
+template <typename I>
+void PassthroughImageCache<I>::handle_lock_acquired() {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << dendl;
+}
+
 } // namespace cache
 } // namespace librbd
 
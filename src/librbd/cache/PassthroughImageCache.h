@@ -40,6 +40,8 @@ public:
   void invalidate(Context *on_finish) override;
   void flush(Context *on_finish) override;
 
+  void handle_lock_acquired() override;
+
 private:
   ImageCtxT &m_image_ctx;
   ImageWriteback<ImageCtxT> m_image_writeback;
@@ -0,0 +1,274 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "librbd/cache/SharedParentCache.h"
+#include "include/buffer.h"
+#include "include/compat.h"
+#include "include/Context.h"
+#include "include/stringify.h"
+#include "common/ceph_context.h"
+#include "common/dout.h"
+#include "common/errno.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#define dout_subsys ceph_subsys_rbd
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::cache::SharedParentCache: " << this \
+                           << " " << __func__ << ": "
+
+namespace librbd {
+namespace cache {
+
+namespace {
+
+struct SharedParentCacheSingleton {
+  SharedParentCache cache;
+
+  explicit SharedParentCacheSingleton(CephContext *cct)
+    : cache(cct, cct->_conf->rbd_shared_parent_cache_path) {
+  }
+};
+
+// cached objects are returned to readers as image data, so only files
+// that nobody but this user could have written are trusted
+bool is_private(const struct stat &st) {
+  return st.st_uid == ::geteuid() && (st.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+
+} // anonymous namespace
+
+SharedParentCache *SharedParentCache::get_instance(CephContext *cct) {
+  SharedParentCacheSingleton *singleton;
+  cct->lookup_or_create_singleton_object<SharedParentCacheSingleton>(
+    singleton, "librbd::cache::SharedParentCache");
+  return &singleton->cache;
+}
+
+SharedParentCache::SharedParentCache(CephContext *cct,
+                                     const std::string &path)
+  : m_cct(cct), m_path(path),
+    m_lock("librbd::cache::SharedParentCache::m_lock"),
+    m_publisher(cct, "librbd::cache::SharedParentCache", "rbd_pcache") {
+  struct stat st;
+  if (::mkdir(m_path.c_str(), 0700) < 0 && errno != EEXIST) {
+    int r = -errno;
+    lderr(m_cct) << "failed to create " << m_path << ": " << cpp_strerror(r)
+                 << dendl;
+  } else if (::lstat(m_path.c_str(), &st) < 0) {
+    int r = -errno;
+    lderr(m_cct) << "failed to stat " << m_path << ": " << cpp_strerror(r)
+                 << dendl;
+  } else if (!S_ISDIR(st.st_mode) || !is_private(st)) {
+    lderr(m_cct) << m_path << " is not a directory private to this user, "
+                 << "not caching parent objects in it" << dendl;
+  } else {
+    m_usable = true;
+  }
+  m_publisher.start();
+}
+
+SharedParentCache::~SharedParentCache() {
+  m_publisher.wait_for_empty();
+  m_publisher.stop();
+  assert(m_fetches.empty());
+}
+
+std::string SharedParentCache::get_file_name(int64_t pool_id,
+                                             const std::string &image_id,
+                                             uint64_t snap_id,
+                                             uint64_t object_no) const {
+  char buf[64];
+  snprintf(buf, sizeof(buf), ".%llx.%016llx",
+           (unsigned long long)snap_id, (unsigned long long)object_no);
+  return m_path + "/" + stringify(pool_id) + "." + image_id + buf;
+}
+
+int SharedParentCache::read(int64_t pool_id, const std::string &image_id,
+                            uint64_t snap_id, uint64_t object_no,
+                            uint64_t off, uint64_t len,
+                            ceph::bufferlist *bl) {
+  std::string name = get_file_name(pool_id, image_id, snap_id, object_no);
+  {
+    Mutex::Locker locker(m_lock);
+    auto it = m_fetches.find(name);
+    if (it != m_fetches.end() && it->second.fetched) {
+      // fetched, but the file is still being written
+      const bufferlist &data = it->second.data;
+      bl->clear();
+      if (off < data.length()) {
+        bl->substr_of(data, off, std::min<uint64_t>(len, data.length() - off));
+      }
+      ldout(m_cct, 20) << name << " " << off << "~" << len
+                       << " hit in memory, " << bl->length() << " bytes"
+                       << dendl;
+      return bl->length();
+    }
+  }
+
+  if (!m_usable) {
+    return -ENOENT;
+  }
+
+  int fd = ::open(name.c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+  if (fd < 0) {
+    return errno == ELOOP ? -ENOENT : -errno;
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || !is_private(st)) {
+    // treated as a miss; the fetch replaces it
+    lderr(m_cct) << "ignoring " << name << ": not a private file of this user"
+                 << dendl;
+    VOID_TEMP_FAILURE_RETRY(::close(fd));
+    return -ENOENT;
+  }
+
+  bufferptr bp(len);
+  uint64_t done = 0;
+  int r = 0;
+  while (done < len) {
+    ssize_t ret = ::pread(fd, bp.c_str() + done, len - done, off + done);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      r = -errno;
+      break;
+    } else if (ret == 0) {
+      break;
+    }
+    done += ret;
+  }
+  VOID_TEMP_FAILURE_RETRY(::close(fd));
+
+  if (r < 0) {
+    lderr(m_cct) << "failed to read " << name << ": " << cpp_strerror(r)
+                 << dendl;
+    return r;
+  }
+
+  ldout(m_cct, 20) << name << " " << off << "~" << len << " hit, "
+                   << done << " bytes" << dendl;
+  bp.set_length(done);
+  bl->clear();
+  if (done > 0) {
+    bl->append(std::move(bp));
+  }
+  return done;
+}
+
+void SharedParentCache::write(int64_t pool_id, const std::string &image_id,
+                              uint64_t snap_id, uint64_t object_no,
+                              const ceph::bufferlist &bl) {
+  if (!m_usable) {
+    return;
+  }
+
+  std::string name = get_file_name(pool_id, image_id, snap_id, object_no);
+  std::string tmp_name = name + ".tmp." + stringify(getpid()) + "." +
+    stringify(++m_tmp_seq);
+
+  int fd = ::open(tmp_name.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                  0600);
+  if (fd < 0) {
+    int r = -errno;
+    ldout(m_cct, 5) << "failed to create " << tmp_name << ": "
+                    << cpp_strerror(r) << dendl;
+    return;
+  }
+
+  // the data must be stable before the rename publishes it, or a host
+  // crash could leave a short file that reads back as zeroes
+  int r = bl.write_fd(fd);
+  if (r == 0 && ::fdatasync(fd) < 0) {
+    r = -errno;
+  }
+  VOID_TEMP_FAILURE_RETRY(::close(fd));
+  if (r == 0 && ::rename(tmp_name.c_str(), name.c_str()) < 0) {
+    r = -errno;
+  }
+  if (r < 0) {
+    ldout(m_cct, 5) << "failed to publish " << name << ": "
+                    << cpp_strerror(r) << dendl;
+    ::unlink(tmp_name.c_str());
+    return;
+  }
+  ldout(m_cct, 20) << name << " cached, " << bl.length() << " bytes" << dendl;
+}
+
+bool SharedParentCache::start_fetch(int64_t pool_id,
+                                    const std::string &image_id,
+                                    uint64_t snap_id, uint64_t object_no,
+                                    bufferlist *bl, Context *on_finish) {
+  std::string name = get_file_name(pool_id, image_id, snap_id, object_no);
+
+  Mutex::Locker locker(m_lock);
+  auto it = m_fetches.find(name);
+  if (it != m_fetches.end()) {
+    ldout(m_cct, 20) << name << " joins an in-flight fetch" << dendl;
+    it->second.waiters.push_back(std::make_pair(bl, on_finish));
+    return false;
+  }
+
+  m_fetches[name].waiters.push_back(std::make_pair(bl, on_finish));
+  return true;
+}
+
+void SharedParentCache::finish_fetch(int64_t pool_id,
+                                     const std::string &image_id,
+                                     uint64_t snap_id, uint64_t object_no,
+                                     int r, const bufferlist &bl) {
+  std::string name = get_file_name(pool_id, image_id, snap_id, object_no);
+
+  // bl may belong to one of the waiters
+  bufferlist data(bl);
+  Waiters waiters;
+  {
+    Mutex::Locker locker(m_lock);
+    auto it = m_fetches.find(name);
+    assert(it != m_fetches.end());
+    waiters.swap(it->second.waiters);
+    if (r < 0) {
+      m_fetches.erase(it);
+    } else {
+      it->second.fetched = true;
+      it->second.data = data;
+    }
+  }
+
+  if (r >= 0) {
+    // misses that race with the publish wait for it
+    m_publisher.queue(new FunctionContext(
+      [this, pool_id, image_id, snap_id, object_no, name, data](int) {
+        write(pool_id, image_id, snap_id, object_no, data);
+
+        Waiters waiters;
+        {
+          Mutex::Locker locker(m_lock);
+          auto it = m_fetches.find(name);
+          assert(it != m_fetches.end());
+          waiters.swap(it->second.waiters);
+          m_fetches.erase(it);
+        }
+        complete_waiters(waiters, 0, data);
+      }));
+  }
+  complete_waiters(waiters, r, data);
+}
+
+void SharedParentCache::complete_waiters(Waiters &waiters, int r,
+                                         const bufferlist &bl) {
+  for (auto &waiter : waiters) {
+    if (r >= 0) {
+      *waiter.first = bl;
+    }
+    waiter.second->complete(r);
+  }
+}
+
+} // namespace cache
+} // namespace librbd
@@ -0,0 +1,109 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_LIBRBD_CACHE_SHARED_PARENT_CACHE
+#define CEPH_LIBRBD_CACHE_SHARED_PARENT_CACHE
+
+#include "include/buffer.h"
+#include "include/int_types.h"
+#include "common/Finisher.h"
+#include "common/Mutex.h"
+#include <atomic>
+#include <list>
+#include <map>
+#include <string>
+
+class Context;
+struct CephContext;
+
+namespace librbd {
+namespace cache {
+
+/**
+ * Host-local cache of parent image objects, shared by every client
+ *
+ * Parent images are only ever read at a snapshot, so an object's
+ * content is fixed for a given pool/image/snapshot/object tuple.  Each
+ * cached object is a whole-object file named after that tuple in a
+ * local directory; files are published with an atomic rename, so any
+ * number of processes may fill and read the directory concurrently
+ * without further coordination.  Files are never modified once
+ * published and may be removed at any time to reclaim space.
+ *
+ * Only a directory, and files in it, that are owned by this user and
+ * not writable by anyone else are used; otherwise every read misses.
+ *
+ * Within a process, concurrent misses for the same object are
+ * coalesced into a single fetch, and fetched objects are published
+ * from a dedicated thread so that the disk writes never hold up the
+ * image's work queues.  Until its file is in place, a fetched object
+ * is served from memory.
+ */
+class SharedParentCache {
+public:
+  /// the process-wide cache at rbd_shared_parent_cache_path
+  static SharedParentCache *get_instance(CephContext *cct);
+
+  SharedParentCache(CephContext *cct, const std::string &path);
+  ~SharedParentCache();
+
+  /**
+   * read len bytes at off from a cached object
+   *
+   * Returns the number of bytes read, which is short if the object
+   * ends before off + len, or -ENOENT if the object is not cached.
+   */
+  int read(int64_t pool_id, const std::string &image_id, uint64_t snap_id,
+           uint64_t object_no, uint64_t off, uint64_t len,
+           ceph::bufferlist *bl);
+
+  /// publish the full content of an object
+  void write(int64_t pool_id, const std::string &image_id, uint64_t snap_id,
+             uint64_t object_no, const ceph::bufferlist &bl);
+
+  /**
+   * join the fetch of an object that missed the cache
+   *
+   * Returns true if the caller is the first to miss and must read the
+   * whole object and report it with finish_fetch().  In either case the
+   * object is stored in *bl and on_finish is completed with the result
+   * of that read.
+   */
+  bool start_fetch(int64_t pool_id, const std::string &image_id,
+                   uint64_t snap_id, uint64_t object_no,
+                   ceph::bufferlist *bl, Context *on_finish);
+
+  /// complete a fetch started by start_fetch(); publishes the object
+  void finish_fetch(int64_t pool_id, const std::string &image_id,
+                    uint64_t snap_id, uint64_t object_no, int r,
+                    const ceph::bufferlist &bl);
+
+private:
+  typedef std::list<std::pair<ceph::bufferlist*, Context*> > Waiters;
+
+  struct Fetch {
+    bool fetched = false;      ///< read, but not yet published
+    ceph::bufferlist data;
+    Waiters waiters;
+  };
+
+  CephContext *m_cct;
+  std::string m_path;
+  bool m_usable = false;     ///< the directory is private to this user
+  std::atomic<uint64_t> m_tmp_seq = {0};
+
+  Mutex m_lock;
+  std::map<std::string, Fetch> m_fetches;  ///< by file name
+  Finisher m_publisher;
+
+  static void complete_waiters(Waiters &waiters, int r,
+                               const ceph::bufferlist &bl);
+
+  std::string get_file_name(int64_t pool_id, const std::string &image_id,
+                            uint64_t snap_id, uint64_t object_no) const;
+};
+
+} // namespace cache
+} // namespace librbd
+
+#endif // CEPH_LIBRBD_CACHE_SHARED_PARENT_CACHE
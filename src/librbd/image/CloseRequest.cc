@@ -10,6 +10,7 @@
 #include "librbd/ImageWatcher.h"
 #include "librbd/ObjectMap.h"
 #include "librbd/Utils.h"
+#include "librbd/cache/ImageCache.h"
 #include "librbd/io/ImageRequestWQ.h"
 
 #define dout_subsys ceph_subsys_rbd
@@ -102,6 +103,38 @@ void CloseRequest<I>::handle_shut_down_io_queue(int r) {
   CephContext *cct = m_image_ctx->cct;
   ldout(cct, 10) << this << " " << __func__ << ": r=" << r << dendl;
 
+  send_shut_down_image_cache();
+}
+
+template <typename I>
+void CloseRequest<I>::send_shut_down_image_cache() {
+  if (m_image_ctx->image_cache == nullptr) {
+    send_shut_down_exclusive_lock();
+    return;
+  }
+
+  CephContext *cct = m_image_ctx->cct;
+  ldout(cct, 10) << this << " " << __func__ << dendl;
+
+  // destage any cached writes while we still hold the exclusive lock
+  m_image_ctx->image_cache->shut_down(create_async_context_callback(
+    *m_image_ctx, create_context_callback<
+      CloseRequest<I>, &CloseRequest<I>::handle_shut_down_image_cache>(this)));
+}
+
+template <typename I>
+void CloseRequest<I>::handle_shut_down_image_cache(int r) {
+  CephContext *cct = m_image_ctx->cct;
+  ldout(cct, 10) << this << " " << __func__ << ": r=" << r << dendl;
+
+  delete m_image_ctx->image_cache;
+  m_image_ctx->image_cache = nullptr;
+
+  save_result(r);
+  if (r < 0) {
+    lderr(cct) << "failed to shut down image cache: " << cpp_strerror(r)
+               << dendl;
+  }
   send_shut_down_exclusive_lock();
 }
 
@@ -36,9 +36,12 @@ private:
    * UNREGISTER_IMAGE_WATCHER
    *    |
    *    v
-   * SHUT_DOWN_AIO_WORK_QUEUE . . .
-   *    |                         .
-   *    v                         .
+   * SHUT_DOWN_AIO_WORK_QUEUE
+   *    |
+   *    v
+   * SHUT_DOWN_IMAGE_CACHE (skip if disabled)
+   *    |
+   *    v         . . . . . . . .
    * SHUT_DOWN_EXCLUSIVE_LOCK     . (exclusive lock
    *    |                         .  disabled)
    *    v                         v
@@ -83,6 +86,9 @@ private:
   void send_shut_down_io_queue();
   void handle_shut_down_io_queue(int r);
 
+  void send_shut_down_image_cache();
+  void handle_shut_down_image_cache(int r);
+
   void send_shut_down_exclusive_lock();
   void handle_shut_down_exclusive_lock(int r);
 
@@ -8,6 +8,7 @@
 #include "common/WorkQueue.h"
 #include "librbd/ImageCtx.h"
 #include "librbd/Utils.h"
+#include "librbd/cache/SharedParentCache.h"
 #include "librbd/image/CloseRequest.h"
 #include "librbd/image/OpenRequest.h"
 #include "librbd/image/SetSnapRequest.h"
@@ -116,6 +117,12 @@ void RefreshParentRequest<I>::send_open_parent() {
     m_parent_image_ctx->set_read_flag(librados::OPERATION_LOCALIZE_READS);
   }
 
+  // parent objects are immutable, so all clients on this host can share them
+  if (m_child_image_ctx.shared_parent_cache) {
+    m_parent_image_ctx->parent_cache =
+      cache::SharedParentCache::get_instance(cct);
+  }
+
   using klass = RefreshParentRequest<I>;
   Context *ctx = create_async_context_callback(
     m_child_image_ctx, create_context_callback<
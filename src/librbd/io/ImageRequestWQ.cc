@@ -8,6 +8,7 @@
 #include "librbd/ImageState.h"
 #include "librbd/internal.h"
 #include "librbd/Utils.h"
+#include "librbd/cache/ImageCache.h"
 #include "librbd/exclusive_lock/Policy.h"
 #include "librbd/io/AioCompletion.h"
 #include "librbd/io/ImageRequest.h"
@@ -284,7 +285,7 @@ void ImageRequestWQ::shut_down(Context *on_shutdown) {
   }
 
   // ensure that all in-flight IO is flushed
-  m_image_ctx.flush(on_shutdown);
+  flush_image(on_shutdown);
 }
 
 bool ImageRequestWQ::is_lock_request_needed() const {
@@ -315,7 +316,7 @@ void ImageRequestWQ::block_writes(Context *on_blocked) {
   }
 
   // ensure that all in-flight IO is flushed
-  m_image_ctx.flush(on_blocked);
+  flush_image(on_blocked);
 }
 
 void ImageRequestWQ::unblock_writes() {
@@ -447,7 +448,7 @@ void ImageRequestWQ::finish_in_progress_write() {
   }
 
   if (writes_blocked) {
-    m_image_ctx.flush(new C_BlockedWrites(this));
+    flush_image(new C_BlockedWrites(this));
   }
 }
 
@@ -480,7 +481,17 @@ void ImageRequestWQ::finish_in_flight_op() {
   ldout(cct, 5) << __func__ << ": completing shut down" << dendl;
 
   assert(on_shutdown != nullptr);
-  m_image_ctx.flush(on_shutdown);
+  flush_image(on_shutdown);
+}
+
+void ImageRequestWQ::flush_image(Context *on_finish) {
+  // a write-back image cache must be drained as well, e.g. before the
+  // exclusive lock is released or a snapshot is taken
+  if (m_image_ctx.image_cache != nullptr) {
+    m_image_ctx.image_cache->flush(on_finish);
+    return;
+  }
+  m_image_ctx.flush(on_finish);
 }
 
 bool ImageRequestWQ::is_lock_required() const {
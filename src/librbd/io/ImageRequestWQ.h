@@ -119,6 +119,8 @@ private:
   int start_in_flight_op(AioCompletion *c);
   void finish_in_flight_op();
 
+  void flush_image(Context *on_finish);
+
   void queue(ImageRequest<ImageCtx> *req);
 
   void handle_refreshed(int r, ImageRequest<ImageCtx> *req);
@@ -14,6 +14,7 @@
 #include "librbd/ImageCtx.h"
 #include "librbd/ObjectMap.h"
 #include "librbd/Utils.h"
+#include "librbd/cache/SharedParentCache.h"
 #include "librbd/io/AioCompletion.h"
 #include "librbd/io/CopyupRequest.h"
 #include "librbd/io/ImageRequest.h"
@@ -281,6 +282,11 @@ void ObjectReadRequest<I>::send() {
     }
   }
 
+  if (image_ctx->parent_cache != nullptr && this->m_snap_id != CEPH_NOSNAP) {
+    send_shared_cache_read();
+    return;
+  }
+
   librados::ObjectReadOperation op;
   int flags = image_ctx->get_read_flags(this->m_snap_id);
   if (m_sparse) {
@@ -300,6 +306,87 @@ void ObjectReadRequest<I>::send() {
   rados_completion->release();
 }
 
+template <typename I>
+void ObjectReadRequest<I>::send_shared_cache_read() {
+  ImageCtx *image_ctx = this->m_ictx;
+  cache::SharedParentCache *parent_cache = image_ctx->parent_cache;
+
+  int r = parent_cache->read(image_ctx->data_ctx.get_id(), image_ctx->id,
+                             this->m_snap_id, this->m_object_no,
+                             this->m_object_off, this->m_object_len,
+                             &m_read_data);
+  if (r >= 0) {
+    if (m_sparse && r > 0) {
+      m_ext_map[this->m_object_off] = r;
+    }
+    image_ctx->op_work_queue->queue(util::create_context_callback<
+      ObjectRequest<I> >(this), r);
+    return;
+  }
+
+  // fetch the whole object so that later reads of any part of it hit,
+  // unless another request is already fetching it
+  ldout(image_ctx->cct, 20) << "send_shared_cache_read " << this << " "
+                            << this->m_oid << " miss" << dendl;
+  using klass = ObjectReadRequest<I>;
+  if (!parent_cache->start_fetch(
+        image_ctx->data_ctx.get_id(), image_ctx->id, this->m_snap_id,
+        this->m_object_no, &m_read_data,
+        util::create_context_callback<
+          klass, &klass::handle_shared_cache_read>(this))) {
+    return;
+  }
+
+  librados::ObjectReadOperation op;
+  op.read(0, image_ctx->layout.object_size, &m_read_data, nullptr);
+  op.set_op_flags2(m_op_flags);
+
+  librados::AioCompletion *rados_completion =
+    util::create_rados_callback<klass, &klass::handle_shared_cache_fetch>(this);
+  r = image_ctx->data_ctx.aio_operate(this->m_oid, rados_completion, &op,
+                                      image_ctx->get_read_flags(
+                                        this->m_snap_id), nullptr);
+  assert(r == 0);
+
+  rados_completion->release();
+}
+
+template <typename I>
+void ObjectReadRequest<I>::handle_shared_cache_fetch(int r) {
+  ImageCtx *image_ctx = this->m_ictx;
+  ldout(image_ctx->cct, 20) << "handle_shared_cache_fetch " << this << " "
+                            << this->m_oid << " r = " << r << dendl;
+
+  // hands the object to every request waiting for it (this one included)
+  // and publishes it
+  image_ctx->parent_cache->finish_fetch(
+    image_ctx->data_ctx.get_id(), image_ctx->id, this->m_snap_id,
+    this->m_object_no, r, m_read_data);
+}
+
+template <typename I>
+void ObjectReadRequest<I>::handle_shared_cache_read(int r) {
+  ImageCtx *image_ctx = this->m_ictx;
+  ldout(image_ctx->cct, 20) << "handle_shared_cache_read " << this << " "
+                            << this->m_oid << " r = " << r << dendl;
+
+  if (r >= 0) {
+    bufferlist bl;
+    if (m_read_data.length() > this->m_object_off) {
+      bl.substr_of(m_read_data, this->m_object_off,
+                   std::min<uint64_t>(this->m_object_len,
+                                      m_read_data.length() -
+                                        this->m_object_off));
+    }
+    m_read_data.swap(bl);
+    r = m_read_data.length();
+    if (m_sparse && r > 0) {
+      m_ext_map[this->m_object_off] = r;
+    }
+  }
+  this->complete(r);
+}
+
 template <typename I>
 void ObjectReadRequest<I>::send_copyup()
 {
@@ -197,6 +197,10 @@ private:
 
   read_state_d m_state;
 
+  void send_shared_cache_read();
+  void handle_shared_cache_fetch(int r);
+  void handle_shared_cache_read(int r);
+
   void send_copyup();
 
   void read_from_parent(Extents&& image_extents);
@@ -217,6 +217,12 @@ struct MDRequestImpl : public MutationImpl {
   // indicator for vxattr osdmap update
   bool waited_for_osdmap;
 
+  // batched getattr/lookup (see Server::batch_getattr_lookup)
+  MDSCacheObject *batch_obj;     ///< what we are batch head for, if any
+  snapid_t batch_snapid;
+  MDRequestImpl *batch_head;     ///< the request that will answer us
+  list<boost::intrusive_ptr<MDRequestImpl> > batch_reqs; ///< who we answer
+
   // break rarely-used fields into a separately allocated structure 
   // to save memory for most ops
   struct More {
@@ -304,7 +310,9 @@ struct MDRequestImpl : public MutationImpl {
     slave_request(NULL), internal_op(params.internal_op), internal_op_finish(NULL),
     internal_op_private(NULL),
     retry(0),
-    waited_for_osdmap(false), _more(NULL) {
+    waited_for_osdmap(false), batch_obj(NULL), batch_snapid(0),
+    batch_head(NULL),
+    _more(NULL) {
     in[0] = in[1] = NULL;
     if (!params.throttled.is_zero())
       mark_event("throttled", params.throttled);
@@ -118,6 +118,8 @@ void Server::create_logger()
       "Client session messages", "hcs");
   plb.add_u64_counter(l_mdss_dispatch_client_request, "dispatch_client_request", "Client requests dispatched");
   plb.add_u64_counter(l_mdss_dispatch_slave_request, "dispatch_server_request", "Server requests dispatched");
+  plb.add_u64_counter(l_mdss_req_batched, "req_batched",
+      "Getattr and lookup requests answered along with an identical one");
   logger = plb.create_perf_counters();
   g_ceph_context->get_perfcounters_collection()->add(logger);
 }
@@ -2793,6 +2795,12 @@ void Server::handle_client_getattr(MDRequestRef& mdr, bool is_lookup)
   if ((mask & CEPH_CAP_FILE_SHARED) && (issued & CEPH_CAP_FILE_EXCL) == 0) rdlocks.insert(&ref->filelock);
   if ((mask & CEPH_CAP_XATTR_SHARED) && (issued & CEPH_CAP_XATTR_EXCL) == 0) rdlocks.insert(&ref->xattrlock);
 
+  MDSCacheObject *batch_obj = ref;
+  if (is_lookup)
+    batch_obj = mdr->dn[0].back();
+  if (batch_getattr_lookup(mdr, batch_obj, rdlocks))
+    return;
+
   if (!mds->locker->acquire_locks(mdr, rdlocks, wrlocks, xlocks))
     return;
 
@@ -2811,9 +2819,128 @@ void Server::handle_client_getattr(MDRequestRef& mdr, bool is_lookup)
   mdr->tracei = ref;
   if (is_lookup)
     mdr->tracedn = mdr->dn[0].back();
+  batch_respond(mdr);
   respond_to_request(mdr, 0);
 }
 
+/*
+ * Many clients often stat or look up the same file at once (think of
+ * every rank of a job opening its input).  Rather than have each of
+ * them traverse the path, wait for and take the same locks and build
+ * its reply in turn, the first request becomes the batch head and
+ * identical ones (same target, snapid and mask) wait for it.  Once the
+ * head holds its locks every waiter is answered from the same state.
+ *
+ * A request only joins if the head's locks cover its own; anything
+ * that keeps the head from answering successfully sends the waiters
+ * back through dispatch on their own.
+ *
+ * @return true if mdr was added to a batch and must not go on
+ */
+bool Server::batch_getattr_lookup(MDRequestRef& mdr, MDSCacheObject *obj,
+				  const set<SimpleLock*>& rdlocks)
+{
+  if (!g_conf->mds_batch_getattr_lookup)
+    return false;
+
+  int mask = mdr->client_request->head.args.getattr.mask;
+  batch_key_t key(obj, mdr->snapid, mask);
+
+  if (mdr->batch_obj) {
+    // retried head; keep the batch only if nothing changed under it
+    auto p = batch_heads.find(key);
+    if (p != batch_heads.end() && p->second.mdr == mdr &&
+	p->second.rdlocks == rdlocks)
+      return false;
+    batch_cleanup(mdr);
+  }
+
+  auto p = batch_heads.find(key);
+  if (p == batch_heads.end()) {
+    batch_head_t& head = batch_heads[key];
+    head.mdr = mdr;
+    head.rdlocks = rdlocks;
+    mdr->batch_obj = obj;
+    mdr->batch_snapid = mdr->snapid;
+    return false;
+  }
+
+  // a waiter holding locks could block the head behind a writer
+  if (!mdr->locks.empty() ||
+      !std::includes(p->second.rdlocks.begin(), p->second.rdlocks.end(),
+		     rdlocks.begin(), rdlocks.end()))
+    return false;
+
+  MDRequestRef& head = p->second.mdr;
+  dout(10) << "batch_getattr_lookup " << *mdr << " waits for " << *head
+	   << dendl;
+  head->batch_reqs.push_back(mdr);
+  mdr->batch_head = head.get();
+  mdr->mark_event("batched");
+  if (logger) logger->inc(l_mdss_req_batched);
+  return true;
+}
+
+/*
+ * answer the requests waiting for mdr, which is about to reply with
+ * its locks held
+ */
+void Server::batch_respond(MDRequestRef& mdr)
+{
+  if (!mdr->batch_obj)
+    return;
+
+  int mask = mdr->client_request->head.args.getattr.mask;
+  batch_heads.erase(batch_key_t(mdr->batch_obj, mdr->batch_snapid, mask));
+  mdr->batch_obj = NULL;
+
+  list<MDRequestRef> reqs;
+  reqs.swap(mdr->batch_reqs);
+  for (list<MDRequestRef>::iterator p = reqs.begin(); p != reqs.end(); ++p) {
+    MDRequestRef& r = *p;
+    r->batch_head = NULL;
+    if (!check_access(r, mdr->tracei, MAY_READ))
+      continue;
+    r->getattr_caps = mask;
+    mds->balancer->hit_inode(ceph_clock_now(), mdr->tracei, META_POP_IRD,
+			     r->client_request->get_source().num());
+    dout(10) << "reply to batched stat on " << *r->client_request << dendl;
+    r->tracei = mdr->tracei;
+    r->tracedn = mdr->tracedn;
+    respond_to_request(r, 0);
+  }
+}
+
+/*
+ * take mdr out of any batch; requests that were waiting for it are
+ * dispatched again
+ */
+void Server::batch_cleanup(MDRequestRef& mdr)
+{
+  if (mdr->batch_head) {
+    mdr->batch_head->batch_reqs.remove(mdr);
+    mdr->batch_head = NULL;
+  }
+  if (!mdr->batch_obj)
+    return;
+
+  int mask = mdr->client_request->head.args.getattr.mask;
+  auto p = batch_heads.find(batch_key_t(mdr->batch_obj, mdr->batch_snapid,
+					mask));
+  if (p != batch_heads.end() && p->second.mdr == mdr)
+    batch_heads.erase(p);
+  mdr->batch_obj = NULL;
+
+  for (list<MDRequestRef>::iterator q = mdr->batch_reqs.begin();
+       q != mdr->batch_reqs.end();
+       ++q) {
+    dout(10) << "batch_cleanup " << *mdr << " retrying " << **q << dendl;
+    (*q)->batch_head = NULL;
+    mds->queue_waiter(new C_MDS_RetryRequest(mdcache, *q));
+  }
+  mdr->batch_reqs.clear();
+}
+
 struct C_MDS_LookupIno2 : public ServerContext {
   MDRequestRef mdr;
   C_MDS_LookupIno2(Server *s, MDRequestRef& r) : ServerContext(s), mdr(r) {}
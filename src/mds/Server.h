@@ -36,6 +36,7 @@ enum {
   l_mdss_handle_client_session,
   l_mdss_dispatch_client_request,
   l_mdss_dispatch_slave_request,
+  l_mdss_req_batched,
   l_mdss_last,
 };
 
@@ -53,6 +54,15 @@ private:
   MDSInternalContext *reconnect_done;
   int failed_reconnects;
 
+  // getattr/lookup requests that others with the same target wait for,
+  // keyed by (inode or dentry, snapid, getattr mask)
+  typedef std::tuple<MDSCacheObject*, snapid_t, int> batch_key_t;
+  struct batch_head_t {
+    MDRequestRef mdr;
+    set<SimpleLock*> rdlocks;  ///< what the head rdlocks
+  };
+  map<batch_key_t, batch_head_t> batch_heads;
+
   friend class MDSContinuation;
   friend class ServerContext;
   friend class ServerLogContext;
@@ -159,6 +169,10 @@ public:
 
   // requests on existing inodes.
   void handle_client_getattr(MDRequestRef& mdr, bool is_lookup);
+  bool batch_getattr_lookup(MDRequestRef& mdr, MDSCacheObject *obj,
+			    const set<SimpleLock*>& rdlocks);
+  void batch_respond(MDRequestRef& mdr);
+  void batch_cleanup(MDRequestRef& mdr);
   void handle_client_lookup_ino(MDRequestRef& mdr,
 				bool want_parent, bool want_dentry);
   void _lookup_ino_2(MDRequestRef& mdr, int r);
@@ -207,14 +207,20 @@ void PGMap::apply_incremental(CephContext *cct, const Incremental& inc)
       pg_pool_sum_old[update_pg.pool()] = pg_pool_sum[update_pg.pool()];
 
     ceph::unordered_map<pg_t,pg_stat_t>::iterator t = pg_stat.find(update_pg);
+    bool sameosds = false;
     if (t == pg_stat.end()) {
       ceph::unordered_map<pg_t,pg_stat_t>::value_type v(update_pg, update_stat);
       pg_stat.insert(v);
     } else {
-      stat_pg_sub(update_pg, t->second);
+      sameosds =
+	t->second.acting == update_stat.acting &&
+	t->second.up == update_stat.up &&
+	t->second.blocked_by == update_stat.blocked_by &&
+	t->second.up_primary == update_stat.up_primary;
+      stat_pg_sub(update_pg, t->second, sameosds);
       t->second = update_stat;
     }
-    stat_pg_add(update_pg, update_stat);
+    stat_pg_add(update_pg, update_stat, sameosds);
   }
   assert(osd_stat.size() == osd_epochs.size());
   for (map<int32_t,osd_stat_t>::const_iterator p =
@@ -344,6 +350,11 @@ void PGMap::calc_stats()
   osd_sum = osd_stat_t();
   pg_by_osd.clear();
   num_primary_pg_by_osd.clear();
+  for (int i = 0; i < NUM_STUCK_TYPES; ++i)
+    stuck_pgs_by_stamp[i].clear();
+  pgs_by_last_scrub.clear();
+  pgs_by_last_deep_scrub.clear();
+  num_pg_by_last_epoch_clean.clear();
 
   for (ceph::unordered_map<pg_t,pg_stat_t>::iterator p = pg_stat.begin();
        p != pg_stat.end();
@@ -463,6 +474,8 @@ void PGMap::stat_pg_add(const pg_t &pgid, const pg_stat_t &s,
     ++num_pg_active;
   }
 
+  index_pg_add(pgid, s);
+
   if (sameosds)
     return;
 
@@ -513,6 +526,8 @@ void PGMap::stat_pg_sub(const pg_t &pgid, const pg_stat_t &s,
     --num_pg_active;
   }
 
+  index_pg_sub(pgid, s);
+
   if (sameosds)
     return;
 
@@ -546,6 +561,56 @@ void PGMap::stat_pg_sub(const pg_t &pgid, const pg_stat_t &s,
   }
 }
 
+bool PGMap::get_stuck_stamp(int i, const pg_stat_t& s, utime_t *stamp)
+{
+  switch (1 << i) {
+  case STUCK_INACTIVE:
+    *stamp = s.last_active;
+    return !(s.state & PG_STATE_ACTIVE);
+  case STUCK_UNCLEAN:
+    *stamp = s.last_clean;
+    return !(s.state & PG_STATE_CLEAN);
+  case STUCK_UNDERSIZED:
+    *stamp = s.last_fullsized;
+    return s.state & PG_STATE_UNDERSIZED;
+  case STUCK_DEGRADED:
+    *stamp = s.last_undegraded;
+    return s.state & PG_STATE_DEGRADED;
+  case STUCK_STALE:
+    *stamp = s.last_unstale;
+    return s.state & PG_STATE_STALE;
+  }
+  ceph_abort();
+  return false;
+}
+
+void PGMap::index_pg_add(const pg_t& pgid, const pg_stat_t& s)
+{
+  for (int i = 0; i < NUM_STUCK_TYPES; ++i) {
+    utime_t stamp;
+    if (get_stuck_stamp(i, s, &stamp))
+      stuck_pgs_by_stamp[i].insert(make_pair(stamp, pgid));
+  }
+  pgs_by_last_scrub.insert(make_pair(s.last_scrub_stamp, pgid));
+  pgs_by_last_deep_scrub.insert(make_pair(s.last_deep_scrub_stamp, pgid));
+  num_pg_by_last_epoch_clean[s.get_effective_last_epoch_clean()]++;
+}
+
+void PGMap::index_pg_sub(const pg_t& pgid, const pg_stat_t& s)
+{
+  for (int i = 0; i < NUM_STUCK_TYPES; ++i) {
+    utime_t stamp;
+    if (get_stuck_stamp(i, s, &stamp))
+      stuck_pgs_by_stamp[i].erase(make_pair(stamp, pgid));
+  }
+  pgs_by_last_scrub.erase(make_pair(s.last_scrub_stamp, pgid));
+  pgs_by_last_deep_scrub.erase(make_pair(s.last_deep_scrub_stamp, pgid));
+  auto p = num_pg_by_last_epoch_clean.find(s.get_effective_last_epoch_clean());
+  assert(p != num_pg_by_last_epoch_clean.end());
+  if (--p->second == 0)
+    num_pg_by_last_epoch_clean.erase(p);
+}
+
 void PGMap::stat_pg_update(const pg_t pgid, pg_stat_t& s,
                            bufferlist::iterator& blp)
 {
@@ -586,13 +651,8 @@ epoch_t PGMap::calc_min_last_epoch_clean() const
   if (pg_stat.empty())
     return 0;
 
-  ceph::unordered_map<pg_t,pg_stat_t>::const_iterator p = pg_stat.begin();
-  epoch_t min = p->second.get_effective_last_epoch_clean();
-  for (++p; p != pg_stat.end(); ++p) {
-    epoch_t lec = p->second.get_effective_last_epoch_clean();
-    if (lec < min)
-      min = lec;
-  }
+  assert(!num_pg_by_last_epoch_clean.empty());
+  epoch_t min = num_pg_by_last_epoch_clean.begin()->first;
   // also scan osd epochs
   // don't trim past the oldest reported osd epoch
   for (ceph::unordered_map<int32_t, epoch_t>::const_iterator i = osd_epochs.begin();
@@ -1028,92 +1088,62 @@ void PGMap::get_stuck_stats(int types, const utime_t cutoff,
                             ceph::unordered_map<pg_t, pg_stat_t>& stuck_pgs) const
 {
   assert(types != 0);
-  for (ceph::unordered_map<pg_t, pg_stat_t>::const_iterator i = pg_stat.begin();
-       i != pg_stat.end();
-       ++i) {
-    utime_t val = cutoff; // don't care about >= cutoff so that is infinity
-
-    if ((types & STUCK_INACTIVE) && !(i->second.state & PG_STATE_ACTIVE)) {
-      if (i->second.last_active < val)
-	val = i->second.last_active;
-    }
-
-    if ((types & STUCK_UNCLEAN) && !(i->second.state & PG_STATE_CLEAN)) {
-      if (i->second.last_clean < val)
-	val = i->second.last_clean;
-    }
-
-    if ((types & STUCK_DEGRADED) && (i->second.state & PG_STATE_DEGRADED)) {
-      if (i->second.last_undegraded < val)
-	val = i->second.last_undegraded;
-    }
-
-    if ((types & STUCK_UNDERSIZED) && (i->second.state & PG_STATE_UNDERSIZED)) {
-      if (i->second.last_fullsized < val)
-	val = i->second.last_fullsized;
+  for (int i = 0; i < NUM_STUCK_TYPES; ++i) {
+    if (!(types & (1 << i)))
+      continue;
+    // only the prefix that began before the cutoff is stuck
+    for (auto p = stuck_pgs_by_stamp[i].begin();
+	 p != stuck_pgs_by_stamp[i].end() && p->first < cutoff;
+	 ++p) {
+      auto q = pg_stat.find(p->second);
+      assert(q != pg_stat.end());
+      stuck_pgs[p->second] = q->second;
     }
+  }
+}
 
-    if ((types & STUCK_STALE) && (i->second.state & PG_STATE_STALE)) {
-      if (i->second.last_unstale < val)
-	val = i->second.last_unstale;
-    }
+bool PGMap::get_stuck_counts(const utime_t cutoff, map<string, int>& note) const
+{
+  static const char *names[NUM_STUCK_TYPES] = {
+    "stuck inactive",
+    "stuck unclean",
+    "stuck undersized",
+    "stuck degraded",
+    "stuck stale",
+  };
 
-    // val is now the earliest any of the requested stuck states began
-    if (val < cutoff) {
-      stuck_pgs[i->first] = i->second;
+  bool any = false;
+  for (int i = 0; i < NUM_STUCK_TYPES; ++i) {
+    int n = 0;
+    for (auto p = stuck_pgs_by_stamp[i].begin();
+	 p != stuck_pgs_by_stamp[i].end() && p->first < cutoff;
+	 ++p)
+      ++n;
+    if (n) {
+      note[names[i]] = n;
+      any = true;
     }
   }
+  return any;
 }
 
-bool PGMap::get_stuck_counts(const utime_t cutoff, map<string, int>& note) const
+void PGMap::get_unscrubbed(const utime_t scrub_cutoff,
+			   const utime_t deep_scrub_cutoff,
+			   set<pg_t> *not_scrubbed,
+			   set<pg_t> *not_deep_scrubbed) const
 {
-  int inactive = 0;
-  int unclean = 0;
-  int degraded = 0;
-  int undersized = 0;
-  int stale = 0;
-
-  for (ceph::unordered_map<pg_t, pg_stat_t>::const_iterator i = pg_stat.begin();
-       i != pg_stat.end();
-       ++i) {
-    if (! (i->second.state & PG_STATE_ACTIVE)) {
-      if (i->second.last_active < cutoff)
-        ++inactive;
-    }
-    if (! (i->second.state & PG_STATE_CLEAN)) {
-      if (i->second.last_clean < cutoff)
-        ++unclean;
-    }
-    if (i->second.state & PG_STATE_DEGRADED) {
-      if (i->second.last_undegraded < cutoff)
-        ++degraded;
-    }
-    if (i->second.state & PG_STATE_UNDERSIZED) {
-      if (i->second.last_fullsized < cutoff)
-        ++undersized;
-    }
-    if (i->second.state & PG_STATE_STALE) {
-      if (i->second.last_unstale < cutoff)
-        ++stale;
-    }
-  }
-  
-  if (inactive)
-    note["stuck inactive"] = inactive;
-  
-  if (unclean)
-    note["stuck unclean"] = unclean;
-  
-  if (undersized)
-    note["stuck undersized"] = undersized;
-  
-  if (degraded)
-    note["stuck degraded"] = degraded;
-  
-  if (stale)
-    note["stuck stale"] = stale; 
-  
-  return inactive || unclean || undersized || degraded || stale;
+  if (not_scrubbed) {
+    for (auto p = pgs_by_last_scrub.begin();
+	 p != pgs_by_last_scrub.end() && p->first <= scrub_cutoff;
+	 ++p)
+      not_scrubbed->insert(p->second);
+  }
+  if (not_deep_scrubbed) {
+    for (auto p = pgs_by_last_deep_scrub.begin();
+	 p != pgs_by_last_deep_scrub.end() && p->first <= deep_scrub_cutoff;
+	 ++p)
+      not_deep_scrubbed->insert(p->second);
+  }
 }
 
 void PGMap::dump_stuck(Formatter *f, int types, utime_t cutoff) const
@@ -127,6 +127,19 @@ public:
   ceph::unordered_map<int,set<pg_t> > pg_by_osd;
   ceph::unordered_map<int,int> num_primary_pg_by_osd;
 
+  /**
+   * pgs indexed by the stamps the health checks look at, so that they
+   * only visit the pgs that are actually behind instead of all of them.
+   *
+   * stuck_pgs_by_stamp[i] holds the pgs currently in stuck condition
+   * (1 << i) (see STUCK_*), keyed by when they entered it.
+   */
+  static const int NUM_STUCK_TYPES = 5;
+  set<pair<utime_t,pg_t> > stuck_pgs_by_stamp[NUM_STUCK_TYPES];
+  set<pair<utime_t,pg_t> > pgs_by_last_scrub;
+  set<pair<utime_t,pg_t> > pgs_by_last_deep_scrub;
+  map<epoch_t,int> num_pg_by_last_epoch_clean;
+
   utime_t stamp;
 
   // recent deltas, and summation
@@ -183,6 +196,10 @@ public:
 
   epoch_t calc_min_last_epoch_clean() const;
 
+  static bool get_stuck_stamp(int i, const pg_stat_t& s, utime_t *stamp);
+  void index_pg_add(const pg_t& pgid, const pg_stat_t& s);
+  void index_pg_sub(const pg_t& pgid, const pg_stat_t& s);
+
   int64_t get_rule_avail(const OSDMap& osdmap, int ruleno) const;
 
  public:
@@ -305,6 +322,10 @@ public:
   void get_stuck_stats(int types, const utime_t cutoff,
 		       ceph::unordered_map<pg_t, pg_stat_t>& stuck_pgs) const;
   bool get_stuck_counts(const utime_t cutoff, map<string, int>& note) const;
+  void get_unscrubbed(const utime_t scrub_cutoff,
+		      const utime_t deep_scrub_cutoff,
+		      set<pg_t> *not_scrubbed,
+		      set<pg_t> *not_deep_scrubbed) const;
   void dump_stuck(Formatter *f, int types, utime_t cutoff) const;
   void dump_stuck_plain(ostream& ss, int types, utime_t cutoff) const;
   int dump_stuck_pg_stats(stringstream &ds,
@@ -1230,9 +1230,7 @@ namespace {
   }
 
 
-  using pg_stat_map_t = const ceph::unordered_map<pg_t,pg_stat_t>;
-
-  void print_unscrubbed_pgs(pg_stat_map_t& pg_stats,
+  void print_unscrubbed_pgs(const PGMap& pg_map,
 			    list<pair<health_status_t,string> > &summary,
 			    list<pair<health_status_t,string> > *detail,
 			    const CephContext* cct) {
@@ -1240,42 +1238,40 @@ namespace {
       cct->_conf->mon_warn_not_deep_scrubbed == 0)
       return;
 
-    int pgs_count = 0;
     const utime_t now = ceph_clock_now();
-    for (const auto& pg_entry : pg_stats) {
-      const auto& pg_stat(pg_entry.second);
-      const utime_t time_since_ls = now - pg_stat.last_scrub_stamp;
-      const utime_t time_since_lds = now - pg_stat.last_deep_scrub_stamp;
-
-      const int mon_warn_not_scrubbed =
-	cct->_conf->mon_warn_not_scrubbed + cct->_conf->mon_scrub_interval;
-
-      const int mon_warn_not_deep_scrubbed =
-	cct->_conf->mon_warn_not_deep_scrubbed + cct->_conf->osd_deep_scrub_interval;
-
-      bool not_scrubbed = (time_since_ls >= mon_warn_not_scrubbed &&
-			   cct->_conf->mon_warn_not_scrubbed != 0);
-
-      bool not_deep_scrubbed = (time_since_lds >= mon_warn_not_deep_scrubbed &&
-				cct->_conf->mon_warn_not_deep_scrubbed != 0);
-
-      if (detail != nullptr) {
-	if (not_scrubbed) {
-	  print_unscrubbed_detailed(pg_entry,
-				    detail,
-				    scrubbed_or_deepscrubbed_t::SCRUBBED);
-	}
-        if (not_deep_scrubbed) {
-	  print_unscrubbed_detailed(pg_entry,
-				    detail,
-				    scrubbed_or_deepscrubbed_t::DEEPSCRUBBED);
-	}
+    const int mon_warn_not_scrubbed =
+      cct->_conf->mon_warn_not_scrubbed + cct->_conf->mon_scrub_interval;
+    const int mon_warn_not_deep_scrubbed =
+      cct->_conf->mon_warn_not_deep_scrubbed + cct->_conf->osd_deep_scrub_interval;
+
+    // the pgmap keeps pgs ordered by scrub stamp, so this only visits
+    // the pgs that are overdue
+    set<pg_t> not_scrubbed, not_deep_scrubbed;
+    pg_map.get_unscrubbed(
+      now - utime_t(mon_warn_not_scrubbed, 0),
+      now - utime_t(mon_warn_not_deep_scrubbed, 0),
+      cct->_conf->mon_warn_not_scrubbed ? &not_scrubbed : nullptr,
+      cct->_conf->mon_warn_not_deep_scrubbed ? &not_deep_scrubbed : nullptr);
+
+    if (detail != nullptr) {
+      for (const auto& pgid : not_scrubbed) {
+	print_unscrubbed_detailed(*pg_map.pg_stat.find(pgid),
+				  detail,
+				  scrubbed_or_deepscrubbed_t::SCRUBBED);
       }
-      if (not_scrubbed || not_deep_scrubbed) {
-	++pgs_count;
+      for (const auto& pgid : not_deep_scrubbed) {
+	print_unscrubbed_detailed(*pg_map.pg_stat.find(pgid),
+				  detail,
+				  scrubbed_or_deepscrubbed_t::DEEPSCRUBBED);
       }
     }
 
+    size_t pgs_count = not_scrubbed.size();
+    for (const auto& pgid : not_deep_scrubbed) {
+      if (!not_scrubbed.count(pgid))
+	++pgs_count;
+    }
+
     if (pgs_count > 0) {
       std::stringstream ss;
       ss << pgs_count << " unscrubbed pgs";
@@ -1619,7 +1615,7 @@ void PGMonitor::get_health(list<pair<health_status_t,string> >& summary,
     }
   }
 
-  print_unscrubbed_pgs(pg_map.pg_stat, summary, detail, cct);
+  print_unscrubbed_pgs(pg_map, summary, detail, cct);
 
 }
 
@@ -26,6 +26,7 @@ class Connection;
 class AuthAuthorizer;
 class CryptoKey;
 class CephContext;
+struct ceph_msg_header;
 
 class Dispatcher {
 public:
@@ -90,6 +91,22 @@ public:
    * @param m A message which has been received
    */
   virtual void ms_fast_preprocess(Message *m) {}
+  /**
+   * Provide the buffer a message's data segment is received into.
+   *
+   * Called once the header of a message carrying data has been read,
+   * before the data itself is. It is called from the same thread and
+   * under the same restrictions as ms_fast_dispatch(). Dispatchers that
+   * want large payloads to land in particular buffers (e.g. ones fit for
+   * O_DIRECT) may append header.data_len bytes of buffers to *bl.
+   *
+   * @param con The Connection the message is arriving on
+   * @param header The header of the incoming message
+   * @param bl Output: the buffers to read the data segment into
+   * @return true if *bl was filled in; false to use the messenger's own
+   */
+  virtual bool ms_get_rx_buffer(Connection *con, const ceph_msg_header& header,
+				bufferlist *bl) { return false; }
   /**
    * The Messenger calls this function to deliver a single message.
    *
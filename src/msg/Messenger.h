@@ -601,6 +601,22 @@ public:
       (*p)->ms_fast_preprocess(m);
     }
   }
+  /**
+   * Ask the fast Dispatchers for a buffer to receive a message's data
+   * segment into; see Dispatcher::ms_get_rx_buffer().
+   *
+   * @return true if one of them filled in *bl
+   */
+  bool ms_deliver_get_rx_buffer(Connection *con, const ceph_msg_header& header,
+				bufferlist *bl) {
+    for (list<Dispatcher*>::iterator p = fast_dispatchers.begin();
+	 p != fast_dispatchers.end();
+	 ++p) {
+      if ((*p)->ms_get_rx_buffer(con, header, bl))
+	return true;
+    }
+    return false;
+  }
   /**
    *  Deliver a single Message. Send it to each Dispatcher
    *  in sequence until one of them handles it.
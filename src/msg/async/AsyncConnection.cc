@@ -97,27 +97,6 @@ class C_tick_wakeup : public EventCallback {
   }
 };
 
-static void alloc_aligned_buffer(bufferlist& data, unsigned len, unsigned off)
-{
-  // create a buffer to read into that matches the data alignment
-  unsigned left = len;
-  if (off & ~CEPH_PAGE_MASK) {
-    // head
-    unsigned head = 0;
-    head = MIN(CEPH_PAGE_SIZE - (off & ~CEPH_PAGE_MASK), left);
-    data.push_back(buffer::create(head));
-    left -= head;
-  }
-  unsigned middle = left & CEPH_PAGE_MASK;
-  if (middle > 0) {
-    data.push_back(buffer::create_page_aligned(middle));
-    left -= middle;
-  }
-  if (left) {
-    data.push_back(buffer::create(left));
-  }
-}
-
 AsyncConnection::AsyncConnection(CephContext *cct, AsyncMessenger *m, DispatchQueue *q,
                                  Worker *w)
   : Connection(cct, m), delay_state(NULL), async_msgr(m), conn_id(q->get_id()),
@@ -146,6 +125,7 @@ AsyncConnection::AsyncConnection(CephContext *cct, AsyncMessenger *m, DispatchQu
 
 AsyncConnection::~AsyncConnection()
 {
+  assert(pending_q.empty());
   assert(out_q.empty());
   assert(sent.empty());
   delete authorizer;
@@ -624,9 +604,16 @@ void AsyncConnection::process()
               if (data_buf.length() < data_len)
                 data_buf.push_back(buffer::create(data_len - data_buf.length()));
               data_blp = data_buf.begin();
+            } else if (async_msgr->ms_deliver_get_rx_buffer(this, current_header, &data_buf)) {
+              ldout(async_msgr->cct,20) << __func__ << " dispatcher provided rx buffer len "
+                                        << data_buf.length() << dendl;
+              assert(data_buf.length() >= data_len);
+              data_blp = data_buf.begin();
             } else {
               ldout(async_msgr->cct,20) << __func__ << " allocating new rx buffer at offset " << data_off << dendl;
-              alloc_aligned_buffer(data_buf, data_len, data_off);
+              unsigned pooled = alloc_aligned_rx_buffer(
+                data_buf, data_len, data_off, worker->rx_buffer_pool.get());
+              logger->inc(l_msgr_recv_pool_bytes, pooled);
               data_blp = data_buf.begin();
             }
           }
@@ -1925,6 +1912,31 @@ int AsyncConnection::send_message(Message *m)
   if (can_fast_prepare)
     prepare_send_message(f, m, bl);
 
+  if (!async_msgr->cct->_conf->ms_async_send_inline) {
+    // submission without write_lock: the worker sorts pending messages
+    // into out_q by priority (and re-checks features) when it drains them
+    // in handle_write, so we only need to wake it for the first message
+    // of a batch.
+    std::lock_guard<std::mutex> l(enqueue_lock);
+    if (can_write == WriteStatus::CLOSED) {
+      ldout(async_msgr->cct, 10) << __func__ << " connection closed."
+                                 << " Drop message " << m << dendl;
+      m->put();
+      return 0;
+    }
+    if (can_fast_prepare && can_write == WriteStatus::NOWRITE) {
+      bl.clear();
+      m->get_payload().clear();
+    }
+    m->trace.event("async enqueueing message");
+    bool was_empty = pending_q.push(PendingMessage(std::move(bl), m, f));
+    ldout(async_msgr->cct, 15) << __func__ << " queued m=" << m
+                               << (was_empty ? ", reschedule" : "") << dendl;
+    if (was_empty && can_write != WriteStatus::REPLACING)
+      center->dispatch_event_external(write_handler);
+    return 0;
+  }
+
   std::lock_guard<std::mutex> l(write_lock);
   // "features" changes will change the payload encoding
   if (can_fast_prepare && (can_write == WriteStatus::NOWRITE || get_features() != f)) {
@@ -1957,6 +1969,28 @@ int AsyncConnection::send_message(Message *m)
   return 0;
 }
 
+void AsyncConnection::_drain_pending()
+{
+  unsigned n = pending_q.drain([this](PendingMessage&& p) {
+      if (can_write == WriteStatus::CLOSED) {
+        ldout(async_msgr->cct, 10) << "_drain_pending connection closed."
+                                   << " Drop message " << p.m << dendl;
+        p.m->put();
+        return;
+      }
+      // "features" changes will change the payload encoding
+      if (p.bl.length() && p.features != get_features()) {
+        p.bl.clear();
+        p.m->get_payload().clear();
+        ldout(async_msgr->cct, 5) << "_drain_pending clear encoded buffer previous "
+                                  << p.features << " != " << get_features() << dendl;
+      }
+      out_q[p.m->get_priority()].emplace_back(std::move(p.bl), p.m);
+    });
+  if (n)
+    ldout(async_msgr->cct, 20) << __func__ << " " << n << " messages" << dendl;
+}
+
 void AsyncConnection::requeue_sent()
 {
   if (sent.empty())
@@ -2013,6 +2047,10 @@ void AsyncConnection::discard_out_queue()
       r->second->put();
     }
   out_q.clear();
+  pending_q.drain([this](PendingMessage&& p) {
+      ldout(async_msgr->cct, 20) << "discard_out_queue discard " << p.m << dendl;
+      p.m->put();
+    });
   outcoming_bl.clear();
 }
 
@@ -2146,6 +2184,11 @@ void AsyncConnection::_stop()
 
   ldout(async_msgr->cct, 2) << __func__ << dendl;
   std::lock_guard<std::mutex> l(write_lock);
+  {
+    // close to send_message() before the queues are discarded
+    std::lock_guard<std::mutex> el(enqueue_lock);
+    can_write = WriteStatus::CLOSED;
+  }
 
   reset_recv_state();
   dispatch_queue->discard_queue(conn_id);
@@ -2155,7 +2198,6 @@ void AsyncConnection::_stop()
 
   state = STATE_CLOSED;
   open_write = false;
-  can_write = WriteStatus::CLOSED;
   state_offset = 0;
   // Make sure in-queue events will been processed
   center->dispatch_event_external(EventCallbackRef(new C_clean_handler(this)));
@@ -2271,7 +2313,16 @@ ssize_t AsyncConnection::write_message(Message *m, bufferlist& bl, bool more)
   logger->inc(l_msgr_send_bytes, outcoming_bl.length() - original_bl_len);
   ldout(async_msgr->cct, 20) << __func__ << " sending " << m->get_seq()
                              << " " << m << dendl;
-  ssize_t rc = _try_send(more);
+  ssize_t rc = 0;
+  if (more && outcoming_bl.length() < async_msgr->cct->_conf->ms_async_send_batch_bytes) {
+    // more messages are queued behind this one; let handle_write flush
+    // them together with a single sendmsg
+    ldout(async_msgr->cct, 20) << __func__ << " batching " << m
+                               << ", " << outcoming_bl.length() << " bytes pending" << dendl;
+    logger->inc(l_msgr_send_messages_batched);
+  } else {
+    rc = _try_send(more);
+  }
   if (rc < 0) {
     ldout(async_msgr->cct, 1) << __func__ << " error sending " << m << ", "
                               << cpp_strerror(rc) << dendl;
@@ -27,6 +27,7 @@
 using namespace std;
 
 #include "auth/AuthSessionHandler.h"
+#include "common/MPSCQueue.h"
 #include "common/ceph_time.h"
 #include "common/perf_counters.h"
 #include "include/buffer.h"
@@ -96,7 +97,7 @@ class AsyncConnection : public Connection {
     return 0;
   }
   bool is_queued() const {
-    return !out_q.empty() || outcoming_bl.length();
+    return !out_q.empty() || !pending_q.empty() || outcoming_bl.length();
   }
   void shutdown_socket() {
     for (auto &&t : register_time_events)
@@ -112,7 +113,9 @@ class AsyncConnection : public Connection {
       cs.close();
     }
   }
+  void _drain_pending();
   Message *_get_next_outgoing(bufferlist *bl) {
+    _drain_pending();
     Message *m = 0;
     while (!m && !out_q.empty()) {
       map<int, list<pair<bufferlist, Message*> > >::reverse_iterator it = out_q.rbegin();
@@ -129,7 +132,7 @@ class AsyncConnection : public Connection {
     return m;
   }
   bool _has_next_outgoing() const {
-    return !out_q.empty();
+    return !out_q.empty() || !pending_q.empty();
   }
   void reset_recv_state();
 
@@ -314,6 +317,21 @@ class AsyncConnection : public Connection {
   std::atomic<WriteStatus> can_write;
   bool open_write;
   map<int, list<pair<bufferlist, Message*> > > out_q;  // priority queue for outbound msgs
+  /// a message submitted by send_message() but not yet sorted into out_q
+  struct PendingMessage {
+    bufferlist bl;
+    Message *m;
+    uint64_t features;  ///< features bl was encoded with
+    PendingMessage(bufferlist&& b, Message *m, uint64_t f)
+      : bl(std::move(b)), m(m), features(f) {}
+  };
+  // submission queue, drained by the worker under write_lock
+  ceph::MPSCQueue<PendingMessage> pending_q;
+  // held by send_message() across its CLOSED check and push, and by
+  // _stop() while it closes the connection, so that nothing is queued
+  // (or write_handler dispatched) once the connection is closed.  It is
+  // never held for longer than that, so senders do not wait on writes.
+  std::mutex enqueue_lock;
   list<Message*> sent; // the first bufferlist need to inject seq
   bufferlist outcoming_bl;
   bool keepalive;
@@ -0,0 +1,108 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <stdlib.h>
+#include <algorithm>
+
+#include "RxBufferPool.h"
+#include "common/deleter.h"
+#include "include/assert.h"
+#include "include/page.h"
+
+std::shared_ptr<RxBufferPool> RxBufferPool::create(unsigned chunk_size,
+						   uint64_t max_bytes)
+{
+  chunk_size = (chunk_size + ~CEPH_PAGE_MASK) & CEPH_PAGE_MASK;
+  if (!chunk_size || max_bytes < chunk_size)
+    return nullptr;
+  return std::shared_ptr<RxBufferPool>(
+    new RxBufferPool(chunk_size, max_bytes / chunk_size));
+}
+
+RxBufferPool::~RxBufferPool()
+{
+  // every outstanding chunk holds a reference to us, so by now they
+  // have all come back
+  returned.drain([this](char*&& c) { free_chunks.push_back(c); });
+  assert(free_chunks.size() == allocated);
+  for (auto c : free_chunks)
+    ::free(c);
+}
+
+ceph::bufferptr RxBufferPool::get()
+{
+  returned.drain([this](char*&& c) { free_chunks.push_back(c); });
+
+  char *c;
+  if (!free_chunks.empty()) {
+    c = free_chunks.back();
+    free_chunks.pop_back();
+  } else if (allocated < max_chunks) {
+    void *p;
+    if (::posix_memalign(&p, CEPH_PAGE_SIZE, chunk_size))
+      return ceph::bufferptr();
+    c = static_cast<char*>(p);
+    ++allocated;
+  } else {
+    return ceph::bufferptr();
+  }
+
+  std::shared_ptr<RxBufferPool> pool = shared_from_this();
+  return ceph::bufferptr(ceph::buffer::claim_buffer(
+      chunk_size, c,
+      make_deleter([pool, c]() mutable {
+	  pool->returned.push(std::move(c));
+	})));
+}
+
+unsigned alloc_aligned_rx_buffer(ceph::bufferlist& data, unsigned len,
+				 unsigned off, RxBufferPool *pool)
+{
+  // create a buffer to read into that matches the data alignment
+  unsigned left = len;
+  unsigned pooled = 0;
+  if (off & ~CEPH_PAGE_MASK) {
+    // head
+    unsigned head = std::min<unsigned>(CEPH_PAGE_SIZE - (off & ~CEPH_PAGE_MASK),
+				       left);
+    data.push_back(ceph::buffer::create(head));
+    left -= head;
+  }
+  unsigned middle = left & CEPH_PAGE_MASK;
+  if (middle > 0 && pool) {
+    // whole chunks come from the worker's pool, the rest is allocated
+    pooled = pool->get(middle, data);
+    left -= pooled;
+    middle -= pooled;
+  }
+  if (middle > 0) {
+    data.push_back(ceph::buffer::create_page_aligned(middle));
+    left -= middle;
+  }
+  if (left) {
+    data.push_back(ceph::buffer::create(left));
+  }
+  return pooled;
+}
+
+unsigned RxBufferPool::get(unsigned len, ceph::bufferlist& bl)
+{
+  unsigned got = 0;
+  while (len - got >= chunk_size) {
+    ceph::bufferptr bp = get();
+    if (!bp.have_raw())
+      break;
+    bl.push_back(std::move(bp));
+    got += chunk_size;
+  }
+  return got;
+}
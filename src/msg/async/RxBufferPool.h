@@ -0,0 +1,75 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MSG_ASYNC_RXBUFFERPOOL_H
+#define CEPH_MSG_ASYNC_RXBUFFERPOOL_H
+
+#include <memory>
+#include <vector>
+
+#include "common/MPSCQueue.h"
+#include "include/buffer.h"
+
+/**
+ * Pool of page-aligned receive buffers owned by one Worker
+ *
+ * Message data segments are read straight into fixed size, page-aligned
+ * chunks from this pool so that large writes arrive already aligned for
+ * O_DIRECT and we avoid a fresh posix_memalign per message.  Chunks are
+ * handed out as buffer::ptrs whose deleter returns them to the pool, so
+ * they may be released from any thread; only the owning worker thread
+ * may allocate.  At most max_chunks are ever allocated, after which
+ * get() fails and the caller falls back to ordinary buffers.
+ */
+class RxBufferPool : public std::enable_shared_from_this<RxBufferPool> {
+  const unsigned chunk_size;
+  const unsigned max_chunks;
+  unsigned allocated = 0;           ///< chunks alive, free or in use
+  std::vector<char*> free_chunks;   ///< owned by the worker thread
+  ceph::MPSCQueue<char*> returned;  ///< chunks released by other threads
+
+  RxBufferPool(unsigned chunk_size, unsigned max_chunks)
+    : chunk_size(chunk_size), max_chunks(max_chunks) {}
+
+public:
+  static std::shared_ptr<RxBufferPool> create(unsigned chunk_size,
+					      uint64_t max_bytes);
+  ~RxBufferPool();
+
+  unsigned get_chunk_size() const {
+    return chunk_size;
+  }
+
+  /// worker thread only: a chunk_size buffer, or an empty ptr if exhausted
+  ceph::bufferptr get();
+
+  /**
+   * worker thread only: append len bytes of pooled buffers to bl
+   *
+   * Only whole chunks are taken from the pool; returns the number of
+   * bytes appended, which may be less than len.
+   */
+  unsigned get(unsigned len, ceph::bufferlist& bl);
+};
+
+/**
+ * append a buffer of len bytes to data to receive a segment into
+ *
+ * The page-aligned middle part comes from pool (if any) where possible
+ * and the segment's offset within its first page, off, is kept, so the
+ * received data lines up with pages.  Returns the number of bytes taken
+ * from the pool.
+ */
+unsigned alloc_aligned_rx_buffer(ceph::bufferlist& data, unsigned len,
+				 unsigned off, RxBufferPool *pool);
+
+#endif
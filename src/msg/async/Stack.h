@@ -22,6 +22,7 @@
 #include "common/simple_spin.h"
 #include "msg/msg_types.h"
 #include "msg/async/Event.h"
+#include "msg/async/RxBufferPool.h"
 
 class Worker;
 class ConnectedSocketImpl {
@@ -190,7 +191,9 @@ enum {
   l_msgr_recv_messages,
   l_msgr_send_messages,
   l_msgr_send_messages_inline,
+  l_msgr_send_messages_batched,
   l_msgr_recv_bytes,
+  l_msgr_recv_pool_bytes,
   l_msgr_send_bytes,
   l_msgr_created_connections,
   l_msgr_active_connections,
@@ -211,6 +214,7 @@ class Worker {
 
   std::atomic_uint references;
   EventCenter center;
+  std::shared_ptr<RxBufferPool> rx_buffer_pool;  ///< null if disabled
 
   Worker(const Worker&) = delete;
   Worker& operator=(const Worker&) = delete;
@@ -225,13 +229,19 @@ class Worker {
     plb.add_u64_counter(l_msgr_recv_messages, "msgr_recv_messages", "Network received messages");
     plb.add_u64_counter(l_msgr_send_messages, "msgr_send_messages", "Network sent messages");
     plb.add_u64_counter(l_msgr_send_messages_inline, "msgr_send_messages_inline", "Network sent inline messages");
+    plb.add_u64_counter(l_msgr_send_messages_batched, "msgr_send_messages_batched", "Network sent messages coalesced with following ones");
     plb.add_u64_counter(l_msgr_recv_bytes, "msgr_recv_bytes", "Network received bytes");
+    plb.add_u64_counter(l_msgr_recv_pool_bytes, "msgr_recv_pool_bytes", "Network received bytes read into pooled buffers");
     plb.add_u64_counter(l_msgr_send_bytes, "msgr_send_bytes", "Network received bytes");
     plb.add_u64_counter(l_msgr_active_connections, "msgr_active_connections", "Active connection number");
     plb.add_u64_counter(l_msgr_created_connections, "msgr_created_connections", "Created connection number");
 
     perf_logger = plb.create_perf_counters();
     cct->get_perfcounters_collection()->add(perf_logger);
+
+    rx_buffer_pool = RxBufferPool::create(
+      cct->_conf->ms_async_rx_buffer_chunk_size,
+      cct->_conf->ms_async_rx_buffer_pool_size);
   }
   virtual ~Worker() {
     if (perf_logger) {
@@ -3229,28 +3229,39 @@ void BlueStore::Collection::trim_cache()
   }
   float bytes_per_onode = (float)total_bytes / (float)total_onodes;
   size_t num_shards = store->cache_shards.size();
-  uint64_t shard_target = store->cct->_conf->bluestore_cache_size / num_shards;
+  uint64_t shard_target = store->cache_size / num_shards;
   ldout(store->cct, 30) << __func__
 			<< " total meta bytes " << total_bytes
 			<< ", total onodes " << total_onodes
 			<< ", bytes_per_onode " << bytes_per_onode
 	   << dendl;
-  cache->trim(shard_target, store->cct->_conf->bluestore_cache_meta_ratio,
-	      bytes_per_onode);
+  cache->trim(shard_target, store->cache_meta_ratio, bytes_per_onode);
 
   store->_update_cache_logger();
 }
 
 // =======================================================
 
+#undef dout_prefix
+#define dout_prefix *_dout << "bluestore.MempoolThread(" << this << ") "
+
 void *BlueStore::MempoolThread::entry()
 {
   Mutex::Locker l(lock);
+  utime_t next_autotune = ceph_clock_now();
   while (!stop) {
     store->mempool_bytes = mempool::bluestore_meta_other::allocated_bytes() +
       mempool::bluestore_meta_onode::allocated_bytes();
     store->mempool_onodes = mempool::bluestore_meta_onode::allocated_items();
     ++store->mempool_seq;
+    if (store->cct->_conf->bluestore_cache_autotune) {
+      utime_t now = ceph_clock_now();
+      if (now >= next_autotune) {
+	_autotune_cache();
+	next_autotune = now;
+	next_autotune += store->cct->_conf->bluestore_cache_autotune_interval;
+      }
+    }
     utime_t wait;
     wait += store->cct->_conf->bluestore_cache_trim_interval;
     cond.WaitInterval(lock, wait);
@@ -3259,6 +3270,145 @@ void *BlueStore::MempoolThread::entry()
   return NULL;
 }
 
+void BlueStore::MempoolThread::_autotune_cache()
+{
+  CephContext *cct = store->cct;
+  CacheAutotuner::Inputs in;
+  in.target = cct->_conf->osd_memory_target;
+  in.cache_min = cct->_conf->osd_memory_cache_min;
+  in.chunk = cct->_conf->bluestore_cache_autotune_chunk_size;
+  for (int i = 0; i < mempool::num_pools; ++i) {
+    in.mempool_total += mempool::get_pool(mempool::pool_index_t(i)).allocated_bytes();
+  }
+  in.meta_bytes = store->mempool_bytes;
+  in.onodes = store->mempool_onodes;
+  in.data_bytes = store->logger->get(l_bluestore_buffer_bytes);
+  int64_t kv_usage = store->db ? store->db->get_cache_usage() : -EOPNOTSUPP;
+  in.kv_tunable = kv_usage >= 0;
+  in.kv_bytes = in.kv_tunable ? kv_usage : 0;
+  uint64_t kv_hits = 0;
+  in.kv_stats = in.kv_tunable &&
+    store->db->get_cache_hit_stats(&kv_hits, &in.kv_misses) == 0;
+  in.kv_block_size = cct->_conf->rocksdb_block_size;
+  in.onode_misses = store->logger->get(l_bluestore_onode_misses);
+  in.buffer_miss_bytes = store->logger->get(l_bluestore_buffer_miss_bytes);
+  in.cache_size = store->cache_size;
+  in.cache_meta_ratio = store->cache_meta_ratio;
+  in.kv_cache_size = cct->_conf->rocksdb_cache_size;
+
+  CacheAutotuner::Targets t = autotuner.tune(in);
+
+  if (in.kv_tunable) {
+    store->db->set_cache_size(t.kv);
+  }
+  store->cache_size = t.meta + t.data;
+  store->cache_meta_ratio = (t.meta + t.data) ?
+    (double)t.meta / (t.meta + t.data) : 0;
+
+  store->logger->set(l_bluestore_cache_kv_target, t.kv);
+  store->logger->set(l_bluestore_cache_meta_target, t.meta);
+  store->logger->set(l_bluestore_cache_data_target, t.data);
+  ldout(cct, 10) << __func__ << " target " << pretty_si_t(in.target)
+		 << " other " << pretty_si_t(t.other)
+		 << " budget " << pretty_si_t(t.budget)
+		 << " -> kv " << pretty_si_t(t.kv)
+		 << " (" << pretty_si_t(in.kv_bytes) << " used)"
+		 << " meta " << pretty_si_t(t.meta)
+		 << " (" << pretty_si_t(in.meta_bytes) << " used)"
+		 << " data " << pretty_si_t(t.data)
+		 << " (" << pretty_si_t(in.data_bytes) << " used)" << dendl;
+}
+
+// =======================================================
+
+#undef dout_prefix
+#define dout_prefix *_dout << "bluestore.CacheAutotuner(" << this << ") "
+
+/*
+ * Split a single memory budget between the kv (rocksdb block) cache,
+ * the onode cache and the buffer cache.
+ *
+ * The budget is osd_memory_target minus whatever the rest of the OSD
+ * is using according to the mempools.  Each round we estimate how many
+ * bytes every cache had to go to disk for since the previous round,
+ * relative to its size, and move one bluestore_cache_autotune_chunk_size
+ * from the cache under the least pressure to the one under the most.
+ */
+BlueStore::CacheAutotuner::Targets BlueStore::CacheAutotuner::tune(
+  const Inputs& in)
+{
+  Targets t;
+
+  // everything that is not one of our caches
+  uint64_t other = in.mempool_total + in.kv_bytes;
+  uint64_t cached = in.meta_bytes + in.data_bytes + in.kv_bytes;
+  t.other = other > cached ? other - cached : 0;
+  t.budget = in.target > t.other + in.cache_min ?
+    in.target - t.other : in.cache_min;
+
+  if (!primed) {
+    // start from the static configuration
+    double total = (double)in.cache_size +
+      (in.kv_tunable ? in.kv_cache_size : 0);
+    if (total <= 0) {
+      total = 1;
+    }
+    kv_ratio = in.kv_tunable ? in.kv_cache_size / total : 0;
+    meta_ratio = in.cache_size * in.cache_meta_ratio / total;
+    data_ratio = MAX(0.0, 1.0 - kv_ratio - meta_ratio);
+    primed = true;
+  } else {
+    // counters may have been reset (perf reset) since the last round
+    auto delta = [](uint64_t cur, uint64_t last) {
+      return cur >= last ? (double)(cur - last) : 0.0;
+    };
+    double bytes_per_onode = (double)in.meta_bytes / MAX(in.onodes, 1);
+    double kv_miss = delta(in.kv_misses, last_kv_misses) * in.kv_block_size;
+    double meta_miss = delta(in.onode_misses, last_onode_misses) *
+      bytes_per_onode;
+    double data_miss = delta(in.buffer_miss_bytes, last_buffer_miss_bytes);
+
+    // pressure is the miss volume relative to the cache's share; without
+    // hit stats the kv cache keeps its share but is not rebalanced
+    double *ratios[3] = { &kv_ratio, &meta_ratio, &data_ratio };
+    double pressure[3] = {
+      in.kv_stats ? kv_miss / MAX(kv_ratio * t.budget, 1.0) : -1,
+      meta_miss / MAX(meta_ratio * t.budget, 1.0),
+      data_miss / MAX(data_ratio * t.budget, 1.0)
+    };
+    double step = MIN(1.0, (double)in.chunk / t.budget);
+    int hi = -1, lo = -1;
+    for (int i = 0; i < 3; ++i) {
+      if (pressure[i] < 0) {
+	continue;
+      }
+      if (hi < 0 || pressure[i] > pressure[hi]) {
+	hi = i;
+      }
+      // only shrink caches that can give up a chunk and keep one
+      if (*ratios[i] >= 2 * step && (lo < 0 || pressure[i] < pressure[lo])) {
+	lo = i;
+      }
+    }
+    if (hi >= 0 && lo >= 0 && hi != lo && pressure[hi] > pressure[lo]) {
+      *ratios[lo] -= step;
+      *ratios[hi] += step;
+    }
+    ldout(cct, 20) << __func__ << " miss bytes kv " << kv_miss
+		   << " meta " << meta_miss << " data " << data_miss
+		   << " pressure " << pressure[0] << "/" << pressure[1]
+		   << "/" << pressure[2] << dendl;
+  }
+  last_kv_misses = in.kv_misses;
+  last_onode_misses = in.onode_misses;
+  last_buffer_miss_bytes = in.buffer_miss_bytes;
+
+  t.kv = kv_ratio * t.budget;
+  t.meta = meta_ratio * t.budget;
+  t.data = t.budget - t.kv - t.meta;
+  return t;
+}
+
 // =======================================================
 
 #undef dout_prefix
@@ -3285,6 +3435,7 @@ BlueStore::BlueStore(CephContext *cct, const string& path)
   _init_logger();
   cct->_conf->add_observer(this);
   set_cache_shards(1);
+  _set_cache_sizes();
 
   if (cct->_conf->bluestore_shard_finishers) {
     m_finisher_num = cct->_conf->osd_op_num_shards;
@@ -3315,6 +3466,7 @@ BlueStore::BlueStore(CephContext *cct,
   _init_logger();
   cct->_conf->add_observer(this);
   set_cache_shards(1);
+  _set_cache_sizes();
 
   if (cct->_conf->bluestore_shard_finishers) {
     m_finisher_num = cct->_conf->osd_op_num_shards;
@@ -3373,6 +3525,9 @@ const char **BlueStore::get_tracked_conf_keys() const
     "bluestore_max_blob_size",
     "bluestore_max_blob_size_ssd",
     "bluestore_max_blob_size_hdd",
+    "bluestore_cache_size",
+    "bluestore_cache_meta_ratio",
+    "bluestore_cache_autotune",
     NULL
   };
   return KEYS;
@@ -3417,6 +3572,15 @@ void BlueStore::handle_conf_change(const struct md_config_t *conf,
       _set_throttle_params();
     }
   }
+  if (changed.count("bluestore_cache_size") ||
+      changed.count("bluestore_cache_meta_ratio") ||
+      changed.count("bluestore_cache_autotune")) {
+    _set_cache_sizes();
+    mempool_thread.reset_autotune();
+    if (!conf->bluestore_cache_autotune && db) {
+      db->set_cache_size(conf->rocksdb_cache_size);
+    }
+  }
   if (changed.count("bluestore_throttle_bytes")) {
     throttle_bytes.reset_max(conf->bluestore_throttle_bytes);
     throttle_deferred_bytes.reset_max(
@@ -3523,6 +3687,15 @@ void BlueStore::_set_blob_size()
            << std::dec << dendl;
 }
 
+void BlueStore::_set_cache_sizes()
+{
+  // with bluestore_cache_autotune the mempool thread takes over from here
+  cache_size = cct->_conf->bluestore_cache_size;
+  cache_meta_ratio = cct->_conf->bluestore_cache_meta_ratio;
+  dout(10) << __func__ << " cache_size " << cache_size
+	   << " meta ratio " << cache_meta_ratio << dendl;
+}
+
 void BlueStore::_init_logger()
 {
   PerfCountersBuilder b(cct, "bluestore",
@@ -3626,6 +3799,12 @@ void BlueStore::_init_logger()
     "Sum for bytes of read hit in the cache");
   b.add_u64(l_bluestore_buffer_miss_bytes, "bluestore_buffer_miss_bytes",
     "Sum for bytes of read missed in the cache");
+  b.add_u64(l_bluestore_cache_kv_target, "bluestore_cache_kv_target",
+	    "Autotuned kv cache size");
+  b.add_u64(l_bluestore_cache_meta_target, "bluestore_cache_meta_target",
+	    "Autotuned onode cache size");
+  b.add_u64(l_bluestore_cache_data_target, "bluestore_cache_data_target",
+	    "Autotuned buffer cache size");
 
   b.add_u64_counter(l_bluestore_write_big, "bluestore_write_big",
 		    "Large aligned writes into fresh blobs");
@@ -3649,6 +3828,11 @@ void BlueStore::_init_logger()
 		    "cached) to fill out the block");
   b.add_u64_counter(l_bluestore_write_small_new, "bluestore_write_small_new",
 		    "Small write into new (sparse) blob");
+  b.add_u64_counter(l_bluestore_write_packed, "bluestore_write_packed",
+		    "Small new objects packed into a shared allocation unit");
+  b.add_u64_counter(l_bluestore_write_packed_bytes,
+		    "bluestore_write_packed_bytes",
+		    "Small new objects packed into a shared allocation unit (bytes)");
 
   b.add_u64_counter(l_bluestore_txc, "bluestore_txc", "Transactions committed");
   b.add_u64_counter(l_bluestore_onode_reshard, "bluestore_onode_reshard",
@@ -9588,6 +9772,135 @@ int BlueStore::_do_alloc_write(
   return 0;
 }
 
+bool BlueStore::_can_pack(
+  Collection *c,
+  OnodeRef o,
+  uint64_t offset,
+  uint64_t length)
+{
+  uint64_t max = cct->_conf->bluestore_pack_max_object_size;
+  return max &&
+    c->cid.is_pg() &&
+    offset == 0 &&
+    length <= max &&
+    P2ROUNDUP(length, block_size) <= min_alloc_size / 2 &&
+    o->onode.size == 0 &&
+    o->extent_map.extent_map.empty() &&
+    !g_conf->bluestore_debug_omit_block_device_write;
+}
+
+int BlueStore::_do_write_packed(
+  TransContext *txc,
+  CollectionRef& c,
+  OnodeRef o,
+  uint64_t length,
+  bufferlist& bl,
+  WriteContext *wctx)
+{
+  uint32_t slot_len = P2ROUNDUP(length, block_size);
+  Collection::PackedAU& pack = c->pack;
+
+  // the open unit is gone once every object packed into it has been
+  // removed (its extents are released when the last ref is put), and
+  // after a split its shared blob may belong to the other collection.
+  if (pack.sb &&
+      (pack.sb->coll != c ||
+       pack.used + slot_len > pack.blob.get_logical_length() ||
+       !pack.sb->persistent->ref_map.contains(
+	 pack.blob.get_extents().front().offset, min_alloc_size))) {
+    c->reset_pack();
+  }
+
+  BlobRef b;
+  if (!pack.sb) {
+    int r = alloc->reserve(min_alloc_size);
+    if (r < 0) {
+      derr << __func__ << " failed to reserve 0x" << std::hex
+	   << min_alloc_size << std::dec << dendl;
+      return r;
+    }
+    AllocExtentVector extents;
+    int64_t got = alloc->allocate(min_alloc_size, min_alloc_size,
+				  max_alloc_size.load(), 0, &extents);
+    assert(got == (int64_t)min_alloc_size);
+    txc->statfs_delta.allocated() += got;
+    for (auto& p : extents) {
+      txc->allocated.insert(p.offset, p.length);
+    }
+    b = c->new_blob();
+    b->dirty_blob().allocated(0, min_alloc_size, extents);
+    c->make_blob_shared(_assign_blobid(txc), b);
+    pack.sb = b->shared_blob;
+    pack.blob = b->get_blob();
+    pack.used = 0;
+    dout(20) << __func__ << " new unit " << pack.blob << dendl;
+  } else {
+    b = new Blob();
+    b->shared_blob = pack.sb;
+    b->dirty_blob() = pack.blob;
+    for (auto& p : pack.blob.get_extents()) {
+      pack.sb->get_ref(p.offset, p.length);
+    }
+  }
+  txc->write_shared_blob(pack.sb);
+
+  uint32_t b_off = pack.used;
+  pack.used += slot_len;
+
+  bufferlist padded = bl;
+  padded.append_zero(slot_len - length);
+  logger->inc(l_bluestore_write_pad_bytes, slot_len - length);
+
+  int csum = csum_type.load();
+  csum = select_option(
+    "csum_type",
+    csum,
+    [&]() {
+      int val;
+      if(c->pool_opts.get(pool_opts_t::CSUM_TYPE, &val)) {
+        return  boost::optional<int>(val);
+      }
+      return boost::optional<int>();
+    }
+  );
+  bluestore_blob_t& dblob = b->dirty_blob();
+  if (csum != Checksummer::CSUM_NONE) {
+    dblob.init_csum(csum, block_size_order, dblob.get_logical_length());
+    dblob.calc_csum(b_off, padded);
+  }
+
+  Extent *le = o->extent_map.set_lextent(c, 0, b_off, length, b, nullptr);
+  txc->statfs_delta.stored() += le->length;
+  dout(20) << __func__ << "  lex " << *le << " slot 0x" << std::hex
+	   << b_off << "~" << slot_len << std::dec << dendl;
+  _buffer_cache_write(txc, b, b_off, padded,
+		      wctx->buffered ? 0 : Buffer::FLAG_NOCACHE);
+
+  // nothing else lives in this slot, so it is always safe to write it
+  // directly, but small writes still do better deferred
+  if (padded.length() <= prefer_deferred_size.load()) {
+    bluestore_deferred_op_t *op = _get_deferred_op(txc, o);
+    op->op = bluestore_deferred_op_t::OP_WRITE;
+    int r = b->get_blob().map(
+      b_off, padded.length(),
+      [&](uint64_t offset, uint64_t length) {
+	op->extents.emplace_back(bluestore_pextent_t(offset, length));
+	return 0;
+      });
+    assert(r == 0);
+    op->data = padded;
+  } else {
+    b->get_blob().map_bl(
+      b_off, padded,
+      [&](uint64_t offset, bufferlist& t) {
+	bdev->aio_write(offset, t, &txc->ioc, false);
+      });
+  }
+  logger->inc(l_bluestore_write_packed);
+  logger->inc(l_bluestore_write_packed_bytes, length);
+  return 0;
+}
+
 void BlueStore::_wctx_finish(
   TransContext *txc,
   CollectionRef& c,
@@ -9819,13 +10132,22 @@ int BlueStore::_do_write(
 	   << std::dec << dendl;
 
   o->extent_map.fault_range(db, offset, length);
-  _do_write_data(txc, c, o, offset, length, bl, &wctx);
+  if (_can_pack(c.get(), o, offset, length)) {
+    r = _do_write_packed(txc, c, o, length, bl, &wctx);
+    if (r < 0) {
+      derr << __func__ << " _do_write_packed failed with " << cpp_strerror(r)
+	   << dendl;
+      goto out;
+    }
+  } else {
+    _do_write_data(txc, c, o, offset, length, bl, &wctx);
 
-  r = _do_alloc_write(txc, c, o, &wctx);
-  if (r < 0) {
-    derr << __func__ << " _do_alloc_write failed with " << cpp_strerror(r)
-	 << dendl;
-    goto out;
+    r = _do_alloc_write(txc, c, o, &wctx);
+    if (r < 0) {
+      derr << __func__ << " _do_alloc_write failed with " << cpp_strerror(r)
+	   << dendl;
+      goto out;
+    }
   }
 
   benefit = gc.estimate(offset,
@@ -10666,6 +10988,7 @@ int BlueStore::_remove_collection(TransContext *txc, const coll_t &cid,
         }
       }
       if (!exists) {
+        (*c)->reset_pack();
         coll_map.erase(cid);
         txc->removed_collections.push_back(*c);
         (*c)->exists = false;
@@ -10720,6 +11043,9 @@ int BlueStore::_split_collection(TransContext *txc,
   assert(d->shared_blob_set.empty());
   assert(d->cnode.bits == bits);
 
+  // packed units are not worth following across the split
+  c->reset_pack();
+  d->reset_pack();
   c->split_cache(d.get());
 
   // adjust bits.  note that this will be redundant for all but the first
@@ -10908,6 +11234,9 @@ void BlueStore::generate_db_histogram(Formatter *f)
 void BlueStore::flush_cache()
 {
   dout(10) << __func__ << dendl;
+  for (auto& p : coll_map) {
+    p.second->reset_pack();
+  }
   for (auto i : cache_shards) {
     i->trim_all();
   }
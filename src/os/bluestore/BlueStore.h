@@ -96,6 +96,9 @@ enum {
   l_bluestore_buffer_bytes,
   l_bluestore_buffer_hit_bytes,
   l_bluestore_buffer_miss_bytes,
+  l_bluestore_cache_kv_target,
+  l_bluestore_cache_meta_target,
+  l_bluestore_cache_data_target,
   l_bluestore_write_big,
   l_bluestore_write_big_bytes,
   l_bluestore_write_big_blobs,
@@ -105,6 +108,8 @@ enum {
   l_bluestore_write_small_deferred,
   l_bluestore_write_small_pre_read,
   l_bluestore_write_small_new,
+  l_bluestore_write_packed,
+  l_bluestore_write_packed_bytes,
   l_bluestore_txc,
   l_bluestore_onode_reshard,
   l_bluestore_blob_split,
@@ -962,6 +967,66 @@ public:
 				    uint64_t min_alloc_size);
   };
 
+  /// splits one memory budget between the kv, onode and buffer caches
+  class CacheAutotuner {
+  public:
+    /// what the caches look like at the start of a round
+    struct Inputs {
+      uint64_t target = 0;        ///< osd_memory_target
+      uint64_t cache_min = 0;     ///< osd_memory_cache_min
+      uint64_t chunk = 0;         ///< bytes moved between caches per round
+      uint64_t mempool_total = 0; ///< bytes allocated by all the mempools
+      uint64_t meta_bytes = 0;    ///< bytes used by the onode cache
+      uint64_t onodes = 0;        ///< onodes in the onode cache
+      uint64_t data_bytes = 0;    ///< bytes used by the buffer cache
+      bool kv_tunable = false;    ///< the kv cache can be resized
+      uint64_t kv_bytes = 0;      ///< bytes used by the kv cache
+      bool kv_stats = false;      ///< kv_misses is valid
+      uint64_t kv_misses = 0;     ///< kv cache misses, in blocks
+      uint64_t kv_block_size = 0;
+      uint64_t onode_misses = 0;
+      uint64_t buffer_miss_bytes = 0;
+
+      // the static configuration the first round starts from
+      uint64_t cache_size = 0;        ///< onode + buffer cache size
+      double cache_meta_ratio = 0;    ///< onode share of cache_size
+      uint64_t kv_cache_size = 0;
+    };
+
+    /// the sizes the caches should be trimmed to
+    struct Targets {
+      uint64_t other = 0;   ///< memory used by everything but the caches
+      uint64_t budget = 0;  ///< memory the caches may use
+      uint64_t kv = 0;
+      uint64_t meta = 0;
+      uint64_t data = 0;
+    };
+
+    explicit CacheAutotuner(CephContext *_cct) : cct(_cct) {}
+
+    /// run one round, moving at most one chunk between caches
+    Targets tune(const Inputs& in);
+
+    /// start over from the static configuration on the next round
+    void reset() {
+      primed = false;
+    }
+
+    double get_kv_ratio() const { return kv_ratio; }
+    double get_meta_ratio() const { return meta_ratio; }
+    double get_data_ratio() const { return data_ratio; }
+
+  private:
+    CephContext *cct;
+    bool primed = false;
+    double kv_ratio = 0;    ///< share of the cache budget for the kv cache
+    double meta_ratio = 0;  ///< share of the cache budget for onodes
+    double data_ratio = 0;  ///< share of the cache budget for buffers
+    uint64_t last_kv_misses = 0;
+    uint64_t last_onode_misses = 0;
+    uint64_t last_buffer_miss_bytes = 0;
+  };
+
   struct OnodeSpace;
 
   /// an in-memory object
@@ -1331,6 +1396,18 @@ public:
       return b;
     }
 
+    /// allocation unit that small new objects are currently packed into
+    struct PackedAU {
+      SharedBlobRef sb;        ///< shared by every blob packed into the unit
+      bluestore_blob_t blob;   ///< the unit's extents, as new blobs start
+      uint32_t used = 0;       ///< bytes of the unit handed out so far
+    } pack;
+
+    void reset_pack() {
+      pack.sb.reset();
+      pack.used = 0;
+    }
+
     const coll_t &get_cid() override {
       return cid;
     }
@@ -1864,16 +1941,31 @@ private:
     *onodes = mempool_onodes;
   }
 
+  ///< onode + buffer cache target, summed over all cache shards
+  std::atomic<uint64_t> cache_size = {0};
+  ///< fraction of cache_size used for onodes (metadata)
+  std::atomic<double> cache_meta_ratio = {0};
+
   struct MempoolThread : public Thread {
     BlueStore *store;
     Cond cond;
     Mutex lock;
     bool stop = false;
+
+    CacheAutotuner autotuner;  ///< protected by lock
+
+    void _autotune_cache();
   public:
     explicit MempoolThread(BlueStore *s)
       : store(s),
-	lock("BlueStore::MempoolThread::lock") {}
+	lock("BlueStore::MempoolThread::lock"),
+	autotuner(s->cct) {}
     void *entry() override;
+    /// drop the autotuning state so the next round starts from the config
+    void reset_autotune() {
+      Mutex::Locker l(lock);
+      autotuner.reset();
+    }
     void init() {
       assert(stop == false);
       create("bstore_mempool");
@@ -1903,6 +1995,7 @@ private:
   void _close_fsid();
   void _set_alloc_sizes();
   void _set_blob_size();
+  void _set_cache_sizes();
 
   int _open_bdev(bool create);
   void _close_bdev();
@@ -2463,6 +2556,18 @@ private:
     CollectionRef c,
     OnodeRef o,
     WriteContext *wctx);
+  bool _can_pack(
+    Collection *c,
+    OnodeRef o,
+    uint64_t offset,
+    uint64_t length);
+  int _do_write_packed(
+    TransContext *txc,
+    CollectionRef& c,
+    OnodeRef o,
+    uint64_t length,
+    bufferlist& bl,
+    WriteContext *wctx);
   void _wctx_finish(
     TransContext *txc,
     CollectionRef& c,
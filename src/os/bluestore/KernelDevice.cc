@@ -19,6 +19,7 @@
 #include <fcntl.h>
 
 #include "KernelDevice.h"
+#include "os/fs/io_uring.h"
 #include "include/types.h"
 #include "include/compat.h"
 #include "include/stringify.h"
@@ -40,13 +41,25 @@ KernelDevice::KernelDevice(CephContext* cct, aio_callback_t cb, void *cbpriv)
     size(0), block_size(0),
     fs(NULL), aio(false), dio(false),
     debug_lock("KernelDevice::debug_lock"),
-    aio_queue(cct->_conf->bdev_aio_max_queue_depth),
     aio_callback(cb),
     aio_callback_priv(cbpriv),
     aio_stop(false),
     aio_thread(this),
     injecting_crash(0)
 {
+  if (cct->_conf->bdev_ioring) {
+    if (ioring_queue_t::supported()) {
+      io_queue.reset(new ioring_queue_t(
+	cct->_conf->bdev_aio_max_queue_depth,
+	cct->_conf->bdev_ioring_sqthread_poll));
+    } else {
+      derr << __func__ << " bdev_ioring is set but io_uring is not supported"
+	   << " by this build or kernel; falling back to libaio" << dendl;
+    }
+  }
+  if (!io_queue) {
+    io_queue.reset(new aio_queue_t(cct->_conf->bdev_aio_max_queue_depth));
+  }
 }
 
 int KernelDevice::_lock()
@@ -206,6 +219,8 @@ int KernelDevice::collect_metadata(string prefix, map<string,string> *pm) const
   (*pm)[prefix + "size"] = stringify(get_size());
   (*pm)[prefix + "block_size"] = stringify(get_block_size());
   (*pm)[prefix + "driver"] = "KernelDevice";
+  (*pm)[prefix + "io_engine"] =
+    dynamic_cast<ioring_queue_t*>(io_queue.get()) ? "io_uring" : "libaio";
   if (rotational) {
     (*pm)[prefix + "type"] = "hdd";
   } else {
@@ -306,7 +321,8 @@ int KernelDevice::_aio_start()
 {
   if (aio) {
     dout(10) << __func__ << dendl;
-    int r = aio_queue.init();
+    std::vector<int> fds = {fd_direct, fd_buffered};
+    int r = io_queue->init(fds);
     if (r < 0) {
       derr << __func__ << " failed: " << cpp_strerror(r) << dendl;
       return r;
@@ -323,7 +339,7 @@ void KernelDevice::_aio_stop()
     aio_stop = true;
     aio_thread.join();
     aio_stop = false;
-    aio_queue.shutdown();
+    io_queue->shutdown();
   }
 }
 
@@ -335,7 +351,7 @@ void KernelDevice::_aio_thread()
     dout(40) << __func__ << " polling" << dendl;
     int max = 16;
     aio_t *aio[max];
-    int r = aio_queue.get_next_completed(cct->_conf->bdev_aio_poll_ms,
+    int r = io_queue->get_next_completed(cct->_conf->bdev_aio_poll_ms,
 					 aio, max);
     if (r < 0) {
       derr << __func__ << " got " << cpp_strerror(r) << dendl;
@@ -492,39 +508,32 @@ void KernelDevice::aio_submit(IOContext *ioc)
   ioc->num_pending -= pending;
   assert(ioc->num_pending.load() == 0);  // we should be only thread doing this
 
-  bool done = false;
-  while (!done) {
+  for (; p != e; ++p) {
     aio_t& aio = *p;
-    aio.priv = static_cast<void*>(ioc);
     dout(20) << __func__ << "  aio " << &aio << " fd " << aio.fd
 	     << " 0x" << std::hex << aio.offset << "~" << aio.length
 	     << std::dec << dendl;
     for (auto& io : aio.iov)
       dout(30) << __func__ << "   iov " << (void*)io.iov_base
 	       << " len " << io.iov_len << dendl;
-
-    // be careful: as soon as we submit aio we race with completion.
-    // since we are holding a ref take care not to dereference txc at
-    // all after that point.
-    list<aio_t>::iterator cur = p;
-    ++p;
-    done = (p == e);
-
-    // do not dereference txc (or it's contents) after we submit (if
-    // done == true and we don't loop)
-    int retries = 0;
     if (cct->_conf->bdev_debug_aio) {
       std::lock_guard<std::mutex> l(debug_queue_lock);
-      debug_aio_link(*cur);
-    }
-    int r = aio_queue.submit(*cur, &retries);
-    if (retries)
-      derr << __func__ << " retries " << retries << dendl;
-    if (r) {
-      derr << " aio submit got " << cpp_strerror(r) << dendl;
-      assert(r == 0);
+      debug_aio_link(aio);
     }
   }
+
+  // be careful: as soon as we submit aio we race with completion.
+  // since we are holding a ref take care not to dereference txc (or
+  // its contents) or the submitted aios after that point.
+  int retries = 0;
+  int r = io_queue->submit_batch(ioc->running_aios.begin(), e,
+				 pending, static_cast<void*>(ioc), &retries);
+  if (retries)
+    derr << __func__ << " retries " << retries << dendl;
+  if (r < 0) {
+    derr << " aio submit got " << cpp_strerror(r) << dendl;
+    assert(r == 0);
+  }
 }
 
 int KernelDevice::_sync_write(uint64_t off, bufferlist &bl, bool buffered)
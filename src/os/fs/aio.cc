@@ -1,18 +1,31 @@
 // -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
 // vim: ts=8 sw=2 smarttab
 
+#include <algorithm>
+
 #include "aio.h"
 
 #if defined(HAVE_LIBAIO)
 
-int aio_queue_t::submit(aio_t &aio, int *retries)
+int aio_queue_t::submit_batch(aio_iter begin, aio_iter end,
+			      int aios_size, void *priv,
+			      int *retries)
 {
   // 2^16 * 125us = ~8 seconds, so max sleep is ~16 seconds
   int attempts = 16;
   int delay = 125;
-  iocb *piocb = &aio.iocb;
-  while (true) {
-    int r = io_submit(ctx, 1, &piocb);
+
+  iocb *piocb[aios_size];
+  int left = 0;
+  for (aio_iter cur = begin; cur != end; ++cur) {
+    cur->priv = priv;
+    piocb[left++] = &cur->iocb;
+  }
+  assert(left == aios_size);
+
+  int done = 0;
+  while (left > 0) {
+    int r = io_submit(ctx, std::min(left, max_iodepth), piocb + done);
     if (r < 0) {
       if (r == -EAGAIN && attempts-- > 0) {
 	usleep(delay);
@@ -22,10 +35,11 @@ int aio_queue_t::submit(aio_t &aio, int *retries)
       }
       return r;
     }
-    assert(r == 1);
-    break;
+    assert(r > 0);
+    done += r;
+    left -= r;
   }
-  return 0;
+  return done;
 }
 
 int aio_queue_t::get_next_completed(int timeout_ms, aio_t **paio, int max)
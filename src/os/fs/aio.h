@@ -7,6 +7,8 @@
 #ifdef HAVE_LIBAIO
 # include <libaio.h>
 
+#include <list>
+#include <vector>
 #include <boost/intrusive/list.hpp>
 #include <boost/container/small_vector.hpp>
 
@@ -35,7 +37,8 @@ struct aio_t {
     offset = _offset;
     length = len;
     bufferptr p = buffer::create_page_aligned(length);
-    io_prep_pread(&iocb, fd, p.c_str(), length, offset);
+    iov.push_back(iovec{p.c_str(), length});
+    io_prep_preadv(&iocb, fd, &iov[0], iov.size(), offset);
     bl.append(std::move(p));
   }
 
@@ -51,7 +54,23 @@ typedef boost::intrusive::list<
     boost::intrusive::list_member_hook<>,
     &aio_t::queue_item> > aio_list_t;
 
-struct aio_queue_t {
+/// submission/completion queue for aio_t's; see aio_queue_t, ioring_queue_t
+struct io_queue_t {
+  typedef std::list<aio_t>::iterator aio_iter;
+
+  virtual ~io_queue_t() {}
+
+  /// set up the queue; fds are the files ios may be issued against
+  virtual int init(std::vector<int> &fds) = 0;
+  virtual void shutdown() = 0;
+
+  /// submit [begin, end) (aios_size items) in as few syscalls as possible
+  virtual int submit_batch(aio_iter begin, aio_iter end, int aios_size,
+			   void *priv, int *retries) = 0;
+  virtual int get_next_completed(int timeout_ms, aio_t **paio, int max) = 0;
+};
+
+struct aio_queue_t final : public io_queue_t {
   int max_iodepth;
   io_context_t ctx;
 
@@ -59,15 +78,15 @@ struct aio_queue_t {
     : max_iodepth(max_iodepth),
       ctx(0) {
   }
-  ~aio_queue_t() {
+  ~aio_queue_t() override {
     assert(ctx == 0);
   }
 
-  int init() {
+  int init(std::vector<int> &fds) override {
     assert(ctx == 0);
     return io_setup(max_iodepth, &ctx);
   }
-  void shutdown() {
+  void shutdown() override {
     if (ctx) {
       int r = io_destroy(ctx);
       assert(r == 0);
@@ -75,8 +94,9 @@ struct aio_queue_t {
     }
   }
 
-  int submit(aio_t &aio, int *retries);
-  int get_next_completed(int timeout_ms, aio_t **paio, int max);
+  int submit_batch(aio_iter begin, aio_iter end, int aios_size,
+		   void *priv, int *retries) override;
+  int get_next_completed(int timeout_ms, aio_t **paio, int max) override;
 };
 
 #endif
@@ -0,0 +1,276 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "io_uring.h"
+
+#if defined(HAVE_LIBAIO)
+
+#if defined(HAVE_LIBURING)
+
+#include <liburing.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <map>
+#include <mutex>
+
+#include "include/assert.h"
+
+struct ioring_data {
+  struct io_uring io_uring;
+  std::mutex sq_mutex;   ///< serializes submitters
+  std::mutex cq_mutex;   ///< serializes reapers
+  int epoll_fd = -1;
+  std::map<int, int> fixed_fds_map;  ///< real fd -> registered file index
+  bool initialized = false;
+};
+
+static int ioring_get_cqe(struct ioring_data *d, unsigned int max,
+			  struct aio_t **paio)
+{
+  struct io_uring *ring = &d->io_uring;
+  struct io_uring_cqe *cqe;
+
+  unsigned nr = 0;
+  unsigned head;
+  io_uring_for_each_cqe(ring, head, cqe) {
+    struct aio_t *io = (struct aio_t *)(uintptr_t) io_uring_cqe_get_data(cqe);
+    io->rval = cqe->res;
+
+    paio[nr++] = io;
+
+    if (nr == max)
+      break;
+  }
+  io_uring_cq_advance(ring, nr);
+
+  return nr;
+}
+
+static int find_fixed_fd(struct ioring_data *d, int real_fd)
+{
+  auto it = d->fixed_fds_map.find(real_fd);
+  if (it == d->fixed_fds_map.end())
+    return -1;
+
+  return it->second;
+}
+
+static void init_sqe(struct ioring_data *d, struct io_uring_sqe *sqe,
+		     struct aio_t *io)
+{
+  int fixed_fd = find_fixed_fd(d, io->fd);
+
+  assert(fixed_fd != -1);
+
+  if (io->iocb.aio_lio_opcode == IO_CMD_PWRITEV)
+    io_uring_prep_writev(sqe, fixed_fd, &io->iov[0],
+			 io->iov.size(), io->offset);
+  else if (io->iocb.aio_lio_opcode == IO_CMD_PREADV)
+    io_uring_prep_readv(sqe, fixed_fd, &io->iov[0],
+			io->iov.size(), io->offset);
+  else
+    assert(0 == "unsupported aio opcode");
+
+  io_uring_sqe_set_data(sqe, io);
+  io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+}
+
+ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool sq_thread_)
+  : d(new ioring_data),
+    iodepth(iodepth_),
+    sq_thread(sq_thread_)
+{
+}
+
+ioring_queue_t::~ioring_queue_t()
+{
+  assert(!d->initialized);
+}
+
+int ioring_queue_t::init(std::vector<int> &fds)
+{
+  assert(!d->initialized);
+
+  unsigned flags = 0;
+  if (sq_thread)
+    flags |= IORING_SETUP_SQPOLL;
+
+  int ret = io_uring_queue_init(iodepth, &d->io_uring, flags);
+  if (ret < 0)
+    return ret;
+
+  // registered files save an fget/fput per io, and older kernels
+  // require them for SQ polling.
+  ret = io_uring_register_files(&d->io_uring, &fds[0], fds.size());
+  if (ret < 0)
+    goto close_ring_fd;
+
+  d->fixed_fds_map.clear();
+  for (unsigned i = 0; i < fds.size(); ++i)
+    d->fixed_fds_map[fds[i]] = i;
+
+  d->epoll_fd = epoll_create1(0);
+  if (d->epoll_fd < 0) {
+    ret = -errno;
+    goto close_ring_fd;
+  }
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.fd = d->io_uring.ring_fd;
+  ret = epoll_ctl(d->epoll_fd, EPOLL_CTL_ADD, d->io_uring.ring_fd, &ev);
+  if (ret < 0) {
+    ret = -errno;
+    goto close_epoll_fd;
+  }
+
+  d->initialized = true;
+  return 0;
+
+close_epoll_fd:
+  ::close(d->epoll_fd);
+  d->epoll_fd = -1;
+close_ring_fd:
+  io_uring_queue_exit(&d->io_uring);
+
+  return ret;
+}
+
+void ioring_queue_t::shutdown()
+{
+  if (d->initialized) {
+    d->fixed_fds_map.clear();
+    ::close(d->epoll_fd);
+    d->epoll_fd = -1;
+    io_uring_queue_exit(&d->io_uring);
+    d->initialized = false;
+  }
+}
+
+int ioring_queue_t::submit_batch(aio_iter beg, aio_iter end,
+				 int aios_size, void *priv,
+				 int *retries)
+{
+  // 2^16 * 125us = ~8 seconds, so max sleep is ~16 seconds
+  int attempts = 16;
+  int delay = 125;
+  int done = 0;
+
+  std::lock_guard<std::mutex> l(d->sq_mutex);
+  struct io_uring *ring = &d->io_uring;
+  while (true) {
+    // fill as many sqes as the ring has room for, then hand them all
+    // to the kernel with a single io_uring_enter.
+    unsigned queued = 0;
+    for (; beg != end; ++beg) {
+      struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+      if (!sqe)
+	break;
+      aio_t *io = &*beg;
+      io->priv = priv;
+      init_sqe(d.get(), sqe, io);
+      ++queued;
+    }
+    done += queued;
+
+    // anything left in the sq ring after a failed submit is picked up
+    // by the next io_uring_enter.
+    int r = io_uring_submit(ring);
+    if (r < 0 && r != -EAGAIN && r != -EBUSY)
+      return r;
+    if (r >= 0) {
+      if (beg == end)
+	break;
+      if (queued)
+	continue;
+    }
+    // the kernel is short on resources or has not consumed the sq ring
+    // yet (sq polling); back off.
+    if (attempts-- == 0)
+      return r < 0 ? r : -EAGAIN;
+    usleep(delay);
+    delay *= 2;
+    (*retries)++;
+  }
+  assert(done == aios_size);
+  return done;
+}
+
+int ioring_queue_t::get_next_completed(int timeout_ms, aio_t **paio, int max)
+{
+  while (true) {
+    {
+      std::lock_guard<std::mutex> l(d->cq_mutex);
+      int events = ioring_get_cqe(d.get(), max, paio);
+      if (events > 0)
+	return events;
+    }
+
+    struct epoll_event ev;
+    int ret = epoll_wait(d->epoll_fd, &ev, 1, timeout_ms);
+    if (ret < 0) {
+      if (errno == EINTR)
+	continue;
+      return -errno;
+    }
+    if (ret == 0)
+      return 0;
+    // the ring fd is readable; time to reap
+  }
+}
+
+bool ioring_queue_t::supported()
+{
+  struct io_uring ring;
+  int ret = io_uring_queue_init(16, &ring, 0);
+  if (ret)
+    return false;
+  io_uring_queue_exit(&ring);
+  return true;
+}
+
+#else // #if defined(HAVE_LIBURING)
+
+struct ioring_data {};
+
+ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool sq_thread_)
+{
+  assert(0);
+}
+
+ioring_queue_t::~ioring_queue_t()
+{
+  assert(0);
+}
+
+int ioring_queue_t::init(std::vector<int> &fds)
+{
+  assert(0);
+}
+
+void ioring_queue_t::shutdown()
+{
+  assert(0);
+}
+
+int ioring_queue_t::submit_batch(aio_iter beg, aio_iter end,
+				 int aios_size, void *priv,
+				 int *retries)
+{
+  assert(0);
+}
+
+int ioring_queue_t::get_next_completed(int timeout_ms, aio_t **paio, int max)
+{
+  assert(0);
+}
+
+bool ioring_queue_t::supported()
+{
+  return false;
+}
+
+#endif // #if defined(HAVE_LIBURING)
+
+#endif // #if defined(HAVE_LIBAIO)
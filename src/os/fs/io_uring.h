@@ -0,0 +1,35 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#pragma once
+
+#include "acconfig.h"
+#include "aio.h"
+
+#if defined(HAVE_LIBAIO)
+
+#include <memory>
+
+struct ioring_data;
+
+/// io_queue_t backed by an io_uring submission/completion ring pair
+struct ioring_queue_t final : public io_queue_t {
+  std::unique_ptr<ioring_data> d;
+  unsigned iodepth = 0;
+  bool sq_thread = false;
+
+  ioring_queue_t(unsigned iodepth, bool sq_thread);
+  ~ioring_queue_t() override;
+
+  /// true if this build and the running kernel can set up a ring
+  static bool supported();
+
+  int init(std::vector<int> &fds) override;
+  void shutdown() override;
+
+  int submit_batch(aio_iter begin, aio_iter end, int aios_size,
+		   void *priv, int *retries) override;
+  int get_next_completed(int timeout_ms, aio_t **paio, int max) override;
+};
+
+#endif
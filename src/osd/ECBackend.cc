@@ -117,7 +117,8 @@ ostream &operator<<(ostream &lhs, const ECBackend::ReadOp &rhs)
 	     << ", priority=" << rhs.priority
 	     << ", obj_to_source=" << rhs.obj_to_source
 	     << ", source_to_obj=" << rhs.source_to_obj
-	     << ", in_progress=" << rhs.in_progress << ")";
+	     << ", in_progress=" << rhs.in_progress
+	     << (rhs.shards_only ? ", shards_only" : "") << ")";
 }
 
 void ECBackend::ReadOp::dump(Formatter *f) const
@@ -132,6 +133,7 @@ void ECBackend::ReadOp::dump(Formatter *f) const
   f->dump_stream("obj_to_source") << obj_to_source;
   f->dump_stream("source_to_obj") << source_to_obj;
   f->dump_stream("in_progress") << in_progress;
+  f->dump_bool("shards_only", shards_only);
 }
 
 ostream &operator<<(ostream &lhs, const ECBackend::Op &rhs)
@@ -154,8 +156,11 @@ ostream &operator<<(ostream &lhs, const ECBackend::Op &rhs)
       << " pending_apply=" << rhs.pending_apply
       << " pending_commit=" << rhs.pending_commit
       << " plan.to_read=" << rhs.plan.to_read
-      << " plan.will_write=" << rhs.plan.will_write
-      << ")";
+      << " plan.will_write=" << rhs.plan.will_write;
+  if (rhs.parity_delta_oid)
+    lhs << " parity_delta_read=" << rhs.parity_delta_read.size()
+	<< (rhs.parity_delta_reading ? " (reading)" : "");
+  lhs << ")";
   return lhs;
 }
 
@@ -1171,7 +1176,18 @@ void ECBackend::handle_sub_read_reply(
   // For redundant reads check for completion as each shard comes in,
   // or in a non-recovery read check for completion once all the shards read.
   // TODO: It would be nice if recovery could send more reads too
-  if (rop.do_redundant_reads || (!rop.for_recovery && rop.in_progress.empty())) {
+  if (rop.shards_only) {
+    // the caller asked for these shards and no others, so there is
+    // nothing to decode and nothing else to read on error
+    if (rop.in_progress.empty()) {
+      for (auto &&i: rop.complete) {
+	if (!i.second.errors.empty()) {
+	  i.second.r = i.second.errors.begin()->second;
+	  dout(20) << __func__ << " shard error err=" << i.second.r << dendl;
+	}
+      }
+    }
+  } else if (rop.do_redundant_reads || (!rop.for_recovery && rop.in_progress.empty())) {
     for (map<hobject_t, read_result_t>::const_iterator iter =
         rop.complete.begin();
       iter != rop.complete.end();
@@ -1369,6 +1385,7 @@ void ECBackend::on_change()
     cache.release_write_pin(op.second.pin);
   }
   tid_to_op_map.clear();
+  parity_delta_objects.clear();
 
   for (map<ceph_tid_t, ReadOp>::iterator i = tid_to_read_map.begin();
        i != tid_to_read_map.end();
@@ -1595,7 +1612,8 @@ void ECBackend::start_read_op(
   map<hobject_t, read_request_t> &to_read,
   OpRequestRef _op,
   bool do_redundant_reads,
-  bool for_recovery)
+  bool for_recovery,
+  bool shards_only)
 {
   ceph_tid_t tid = get_parent()->get_tid();
   assert(!tid_to_read_map.count(tid));
@@ -1606,6 +1624,7 @@ void ECBackend::start_read_op(
       tid,
       do_redundant_reads,
       for_recovery,
+      shards_only,
       _op,
       std::move(to_read))).first->second;
   dout(10) << __func__ << ": starting " << op << dendl;
@@ -1764,6 +1783,129 @@ void ECBackend::start_rmw(Op *op, PGTransactionUPtr &&t)
   check_ops();
 }
 
+struct ParityDeltaReadCB :
+  public GenContext<pair<RecoveryMessages*, ECBackend::read_result_t& > &> {
+  ECBackend *ec;
+  ECBackend::Op *op;
+  ParityDeltaReadCB(ECBackend *ec, ECBackend::Op *op) : ec(ec), op(op) {}
+  void finish(pair<RecoveryMessages *, ECBackend::read_result_t &> &in) override {
+    ec->handle_parity_delta_read(op, in.second);
+  }
+};
+
+bool ECBackend::try_parity_delta(Op *op)
+{
+  const ECTransaction::ParityDelta &delta = *(op->plan.parity_delta);
+  if (!cct->_conf->osd_ec_parity_delta_writes ||
+      !get_parent()->get_pool().allows_ecoverwrites() ||
+      !ec_impl->supports_parity_delta())
+    return false;
+
+  // the stripe on disk is only current if nothing else is being
+  // written to the object
+  for (auto &&i: waiting_reads) {
+    if (i.plan.will_write.count(delta.oid))
+      return false;
+  }
+  for (auto &&i: waiting_commit) {
+    if (i.plan.will_write.count(delta.oid))
+      return false;
+  }
+
+  // the data chunk and every coding chunk must be readable
+  set<int> want;
+  want.insert(delta.data_chunk);
+  for (unsigned i = ec_impl->get_data_chunk_count();
+       i < ec_impl->get_chunk_count();
+       ++i) {
+    want.insert(i);
+  }
+  const vector<int> &chunk_mapping = ec_impl->get_chunk_mapping();
+  map<shard_id_t, pg_shard_t> avail;
+  for (auto &&i: get_parent()->get_acting_shards()) {
+    if (!get_parent()->get_shard_missing(i).is_missing(delta.oid))
+      avail.insert(make_pair(i.shard, i));
+  }
+  set<pg_shard_t> need;
+  for (auto &&i: want) {
+    int shard = chunk_mapping.size() > (unsigned)i ? chunk_mapping[i] : i;
+    auto iter = avail.find(shard_id_t(shard));
+    if (iter == avail.end()) {
+      dout(20) << __func__ << ": shard " << shard << " of " << delta.oid
+	       << " is not available" << dendl;
+      return false;
+    }
+    need.insert(iter->second);
+  }
+
+  dout(10) << __func__ << ": " << delta.oid
+	   << " stripe " << delta.stripe_offset
+	   << " data chunk " << delta.data_chunk
+	   << " reading " << need << dendl;
+  parity_delta_objects.insert(delta.oid);
+  op->parity_delta_oid = delta.oid;
+  op->parity_delta_reading = true;
+  op->using_cache = false;
+
+  list<boost::tuple<uint64_t, uint64_t, uint32_t> > to_read;
+  to_read.push_back(
+    boost::make_tuple(delta.stripe_offset, sinfo.get_stripe_width(), 0));
+  map<hobject_t, read_request_t> for_read_op;
+  for_read_op.insert(
+    make_pair(
+      delta.oid,
+      read_request_t(
+	to_read,
+	need,
+	false,
+	new ParityDeltaReadCB(this, op))));
+  start_read_op(
+    CEPH_MSG_PRIO_DEFAULT,
+    for_read_op,
+    OpRequestRef(),
+    false, false, true);
+  return true;
+}
+
+void ECBackend::handle_parity_delta_read(Op *op, read_result_t &res)
+{
+  assert(op->parity_delta_reading);
+  op->parity_delta_reading = false;
+  const ECTransaction::ParityDelta &delta = *(op->plan.parity_delta);
+  if (res.r == 0) {
+    assert(res.returned.size() == 1);
+    for (auto &&i: res.returned.front().get<2>()) {
+      if (i.second.length() != sinfo.get_chunk_size()) {
+	dout(0) << __func__ << ": short read of " << delta.oid
+		<< " from " << i.first << dendl;
+	res.r = -EIO;
+	break;
+      }
+      op->parity_delta_read[i.first.shard].claim(i.second);
+    }
+  }
+  if (res.r < 0) {
+    // fall back to reading and rewriting the full stripe; the object
+    // stays in parity_delta_objects as this op is still not cached
+    dout(10) << __func__ << ": " << delta.oid << " read failed: r="
+	     << res.r << ", falling back to full stripe" << dendl;
+    op->plan.parity_delta = boost::none;
+    op->parity_delta_read.clear();
+    op->remote_read = op->plan.to_read;
+    objects_read_async_no_cache(
+      op->remote_read,
+      [this, op](map<hobject_t,pair<int, extent_map> > &&results) {
+	for (auto &&i: results) {
+	  op->remote_read_result.emplace(i.first, i.second.second);
+	}
+	check_ops();
+      });
+    return;
+  }
+  dout(20) << __func__ << ": " << *op << dendl;
+  check_ops();
+}
+
 bool ECBackend::try_state_to_reads()
 {
   if (waiting_state.empty())
@@ -1779,6 +1921,23 @@ bool ECBackend::try_state_to_reads()
     return false;
   }
 
+  for (auto &&hpair: op->plan.will_write) {
+    if (parity_delta_objects.count(hpair.first)) {
+      dout(20) << __func__ << ": blocking " << *op
+	       << " behind a parity delta write to " << hpair.first
+	       << dendl;
+      return false;
+    }
+  }
+
+  if (op->plan.parity_delta && try_parity_delta(op)) {
+    waiting_state.pop_front();
+    waiting_reads.push_back(*op);
+    dout(10) << __func__ << ": " << *op << dendl;
+    return true;
+  }
+  op->plan.parity_delta = boost::none;
+
   if (op->invalidates_cache()) {
     dout(20) << __func__ << ": invalidating cache after this op"
 	     << dendl;
@@ -1888,6 +2047,7 @@ bool ECBackend::try_reads_to_commit()
       !get_osdmap()->test_flag(CEPH_OSDMAP_REQUIRE_KRAKEN),
       sinfo,
       op->remote_read_result,
+      op->parity_delta_read,
       op->log_entries,
       &written,
       &trans,
@@ -1915,7 +2075,8 @@ bool ECBackend::try_reads_to_commit()
     written_set[i.first] = i.second.get_interval_set();
   }
   dout(20) << __func__ << ": written_set: " << written_set << dendl;
-  assert(written_set == op->plan.will_write);
+  // a parity delta write does not produce the whole stripe
+  assert(op->plan.parity_delta || written_set == op->plan.will_write);
 
   if (op->using_cache) {
     for (auto &&hpair: written) {
@@ -1925,6 +2086,7 @@ bool ECBackend::try_reads_to_commit()
   }
   op->remote_read.clear();
   op->remote_read_result.clear();
+  op->parity_delta_read.clear();
 
   dout(10) << "onreadable_sync: " << op->on_local_applied_sync << dendl;
   ObjectStore::Transaction empty;
@@ -2036,6 +2198,9 @@ bool ECBackend::try_finish_rmw()
   if (op->using_cache) {
     cache.release_write_pin(op->pin);
   }
+  if (op->parity_delta_oid) {
+    parity_delta_objects.erase(*(op->parity_delta_oid));
+  }
   tid_to_op_map.erase(op->tid);
 
   if (waiting_reads.empty() &&
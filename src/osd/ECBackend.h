@@ -378,6 +378,10 @@ public:
     // True if reading for recovery which could possibly reading only a subset
     // of the available shards.
     bool for_recovery;
+    // True if the caller wants the chunks of exactly the shards it
+    // asked for, rather than enough of them to decode the object. No
+    // other shards are read if one of them fails.
+    bool shards_only;
 
     ZTracer::Trace trace;
 
@@ -396,10 +400,12 @@ public:
       ceph_tid_t tid,
       bool do_redundant_reads,
       bool for_recovery,
+      bool shards_only,
       OpRequestRef op,
       map<hobject_t, read_request_t> &&_to_read)
       : priority(priority), tid(tid), op(op), do_redundant_reads(do_redundant_reads),
-	for_recovery(for_recovery), to_read(std::move(_to_read)) {
+	for_recovery(for_recovery), shards_only(shards_only),
+	to_read(std::move(_to_read)) {
       for (auto &&hpair: to_read) {
 	auto &returned = complete[hpair.first].returned;
 	for (auto &&extent: hpair.second.to_read) {
@@ -427,7 +433,8 @@ public:
     int priority,
     map<hobject_t, read_request_t> &to_read,
     OpRequestRef op,
-    bool do_redundant_reads, bool for_recovery);
+    bool do_redundant_reads, bool for_recovery,
+    bool shards_only = false);
 
   void do_read_op(ReadOp &rop);
   int send_all_remaining_reads(
@@ -483,8 +490,15 @@ public:
     map<hobject_t,extent_set> pending_read; // subset already being read
     map<hobject_t,extent_set> remote_read;  // subset we must read
     map<hobject_t,extent_map> remote_read_result;
+
+    /// Parity delta state, see try_parity_delta
+    boost::optional<hobject_t> parity_delta_oid; // held in parity_delta_objects
+    bool parity_delta_reading = false;
+    map<int, bufferlist> parity_delta_read;     // by shard
+
     bool read_in_progress() const {
-      return !remote_read.empty() && remote_read_result.empty();
+      return (!remote_read.empty() && remote_read_result.empty()) ||
+	parity_delta_reading;
     }
 
     /// In progress write state
@@ -563,6 +577,18 @@ public:
   op_list waiting_commit;       /// writes waiting on initial commit
   eversion_t completed_to;
   eversion_t committed_to;
+
+  /**
+   * A parity delta write reads and writes its stripe without going
+   * through the extent cache, so the cache cannot order it against
+   * other writes to the same object. It is only started when no other
+   * write to the object is in flight, and the object is held here
+   * until it commits; later writes to the object wait in waiting_state.
+   */
+  set<hobject_t> parity_delta_objects;
+  bool try_parity_delta(Op *op);
+  void handle_parity_delta_read(Op *op, read_result_t &res);
+
   void start_rmw(Op *op, PGTransactionUPtr &&t);
   bool try_state_to_reads();
   bool try_reads_to_commit();
@@ -95,6 +95,102 @@ bool ECTransaction::requires_overwrite(
       (op.truncate->first < prev_size)));
 }
 
+bool ECTransaction::can_update_parity_delta(
+  const ECUtil::stripe_info_t &sinfo,
+  uint64_t prev_size,
+  const PGTransaction::ObjectOperation &op,
+  ParityDelta *delta) {
+  if (!op.is_none() || op.truncate || op.buffer_updates.ext_count() != 1)
+    return false;
+  auto extent = op.buffer_updates.begin();
+  uint64_t off = extent.get_off();
+  uint64_t end = off + extent.get_len();
+  uint64_t stripe_offset = sinfo.logical_to_prev_stripe_offset(off);
+  if (stripe_offset + sinfo.get_stripe_width() > prev_size)
+    return false;
+  unsigned data_chunk = (off - stripe_offset) / sinfo.get_chunk_size();
+  if (end > stripe_offset + (data_chunk + 1) * sinfo.get_chunk_size())
+    return false;
+  delta->stripe_offset = stripe_offset;
+  delta->data_chunk = data_chunk;
+  return true;
+}
+
+static void delta_and_write(
+  pg_t pgid,
+  const hobject_t &oid,
+  const ECUtil::stripe_info_t &sinfo,
+  ErasureCodeInterfaceRef &ecimpl,
+  const ECTransaction::ParityDelta &delta,
+  const map<int, bufferlist> &old_chunks,
+  const extent_map &to_write,
+  uint32_t flags,
+  map<shard_id_t, ObjectStore::Transaction> *transactions,
+  DoutPrefixProvider *dpp) {
+  const uint64_t chunk_size = sinfo.get_chunk_size();
+  const uint64_t chunk_offset = sinfo.aligned_logical_offset_to_chunk_offset(
+    delta.stripe_offset);
+  const uint64_t data_offset =
+    delta.stripe_offset + delta.data_chunk * chunk_size;
+  int data_shard = delta.data_chunk;
+  const vector<int> &chunk_mapping = ecimpl->get_chunk_mapping();
+  if (chunk_mapping.size() > delta.data_chunk)
+    data_shard = chunk_mapping[delta.data_chunk];
+
+  // gf-complete wants the buffers of a region operation to share the
+  // same alignment, so work on aligned copies of what was read
+  auto copy_chunk = [chunk_size](const bufferlist &bl) {
+    assert(bl.length() == chunk_size);
+    bufferptr p(buffer::create_page_aligned(chunk_size));
+    bl.copy(0, chunk_size, p.c_str());
+    return p;
+  };
+
+  auto old_iter = old_chunks.find(data_shard);
+  assert(old_iter != old_chunks.end());
+  bufferptr old_data = copy_chunk(old_iter->second);
+  bufferptr new_data = copy_chunk(old_iter->second);
+  for (auto &&extent: to_write) {
+    assert(extent.get_off() >= data_offset);
+    assert(extent.get_off() + extent.get_len() <= data_offset + chunk_size);
+    extent.get_val().copy(
+      0, extent.get_len(), new_data.c_str() + extent.get_off() - data_offset);
+  }
+
+  map<int, bufferptr> deltas;
+  int r = ecimpl->encode_delta(old_data, new_data, &deltas[data_shard]);
+  assert(r == 0);
+  map<int, bufferptr> coding;
+  for (auto &&i: old_chunks) {
+    if (i.first != data_shard)
+      coding[i.first] = copy_chunk(i.second);
+  }
+  r = ecimpl->apply_delta(deltas, coding);
+  assert(r == 0);
+
+  map<int, bufferlist> buffers;
+  buffers[data_shard].append(new_data);
+  for (auto &&i: coding)
+    buffers[i.first].append(i.second);
+
+  ldpp_dout(dpp, 20) << __func__ << ": " << oid
+		     << " chunk " << chunk_offset << "~" << chunk_size
+		     << " shards " << buffers.size()
+		     << dendl;
+  for (auto &&i: buffers) {
+    auto st = transactions->find(shard_id_t(i.first));
+    if (st == transactions->end())
+      continue;
+    st->second.write(
+      coll_t(spg_t(pgid, st->first)),
+      ghobject_t(oid, ghobject_t::NO_GEN, st->first),
+      chunk_offset,
+      chunk_size,
+      i.second,
+      flags);
+  }
+}
+
 void ECTransaction::generate_transactions(
   WritePlan &plan,
   ErasureCodeInterfaceRef &ecimpl,
@@ -102,6 +198,7 @@ void ECTransaction::generate_transactions(
   bool legacy_log_entries,
   const ECUtil::stripe_info_t &sinfo,
   const map<hobject_t,extent_map> &partial_extents,
+  const map<int,bufferlist> &parity_delta_chunks,
   vector<pg_log_entry_t> &entries,
   map<hobject_t,extent_map> *written_map,
   map<shard_id_t, ObjectStore::Transaction> *transactions,
@@ -537,6 +634,48 @@ void ECTransaction::generate_transactions(
 			   << dendl;
       }
 
+      if (plan.parity_delta && plan.parity_delta->oid == oid) {
+	/* Only the chunks of one stripe are rewritten, but the rollback
+	 * extent is applied to every shard, like a full stripe overwrite;
+	 * shards that are not written simply restore what they have. */
+	const ParityDelta &delta = *(plan.parity_delta);
+	assert(!to_write.empty());
+	assert(delta.stripe_offset + sinfo.get_stripe_width() <= append_after);
+	if (entry) {
+	  uint64_t restore_from = sinfo.aligned_logical_offset_to_chunk_offset(
+	    delta.stripe_offset);
+	  uint64_t restore_len = sinfo.get_chunk_size();
+	  ldpp_dout(dpp, 20) << __func__ << ": overwriting with parity delta "
+			     << restore_from << "~" << restore_len
+			     << dendl;
+	  rollback_extents.emplace_back(make_pair(restore_from, restore_len));
+	  for (auto &&st : *transactions) {
+	    st.second.touch(
+	      coll_t(spg_t(pgid, st.first)),
+	      ghobject_t(oid, entry->version.version, st.first));
+	    st.second.clone_range(
+	      coll_t(spg_t(pgid, st.first)),
+	      ghobject_t(oid, ghobject_t::NO_GEN, st.first),
+	      ghobject_t(oid, entry->version.version, st.first),
+	      restore_from,
+	      restore_len,
+	      restore_from);
+	  }
+	}
+	delta_and_write(
+	  pgid,
+	  oid,
+	  sinfo,
+	  ecimpl,
+	  delta,
+	  parity_delta_chunks,
+	  to_write,
+	  fadvise_flags,
+	  transactions,
+	  dpp);
+	to_write.clear();
+      }
+
       set<int> want;
       for (unsigned i = 0; i < ecimpl->get_chunk_count(); ++i) {
 	want.insert(i);
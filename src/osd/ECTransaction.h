@@ -23,6 +23,19 @@
 #include "ExtentCache.h"
 
 namespace ECTransaction {
+  /**
+   * A transaction consisting of a single overwrite that stays within
+   * one data chunk of a stripe the object already has.  With a plugin
+   * that supports_parity_delta() it can be applied by reading back
+   * only that data chunk and the coding chunks of the stripe, rather
+   * than the whole stripe, and writing only those chunks.
+   */
+  struct ParityDelta {
+    hobject_t oid;
+    uint64_t stripe_offset = 0; ///< logical offset of the stripe
+    unsigned data_chunk = 0;    ///< data chunk within the stripe
+  };
+
   struct WritePlan {
     PGTransactionUPtr t;
     bool invalidates_cache = false; // Yes, both are possible
@@ -30,8 +43,18 @@ namespace ECTransaction {
     map<hobject_t,extent_set> will_write; // superset of to_read
 
     map<hobject_t,ECUtil::HashInfoRef> hash_infos;
+
+    // set if the transaction could be applied as a parity delta, it is
+    // up to ECBackend to decide whether it is
+    boost::optional<ParityDelta> parity_delta;
   };
 
+  bool can_update_parity_delta(
+    const ECUtil::stripe_info_t &sinfo,
+    uint64_t prev_size,
+    const PGTransaction::ObjectOperation &op,
+    ParityDelta *delta);
+
   bool requires_overwrite(
     uint64_t prev_size,
     const PGTransaction::ObjectOperation &op);
@@ -51,6 +74,12 @@ namespace ECTransaction {
 	uint64_t projected_size =
 	  hinfo->get_projected_total_logical_size(sinfo);
 
+	ParityDelta delta;
+	if (can_update_parity_delta(sinfo, projected_size, i.second, &delta)) {
+	  delta.oid = i.first;
+	  plan.parity_delta = delta;
+	}
+
 	if (i.second.has_source()) {
 	  plan.invalidates_cache = true;
 	}
@@ -172,6 +201,11 @@ namespace ECTransaction {
 	       (!plan.to_read.at(i.first).empty() &&
 		!i.second.has_source()));
       });
+    if (plan.parity_delta && plan.will_write.size() > 1) {
+      ldpp_dout(dpp, 20) << __func__ << ": no parity delta, transaction"
+			 << " touches more than one object" << dendl;
+      plan.parity_delta = boost::none;
+    }
     plan.t = std::move(t);
     return plan;
   }
@@ -183,6 +217,7 @@ namespace ECTransaction {
     bool legacy_log_entries,
     const ECUtil::stripe_info_t &sinfo,
     const map<hobject_t,extent_map> &partial_extents,
+    const map<int,bufferlist> &parity_delta_chunks,
     vector<pg_log_entry_t> &entries,
     map<hobject_t,extent_map> *written,
     map<shard_id_t, ObjectStore::Transaction> *transactions,
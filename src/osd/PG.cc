@@ -5325,6 +5325,11 @@ void PG::start_peering_interval(
       clear_publish_stats();
     }
 
+    // replicas do not look up requests in the log, drop the indexes
+    // we built as primary; they are rebuilt on demand if needed
+    if (was_old_primary && !is_primary())
+      pg_log.unindex();
+
     on_role_change();
 
     // take active waiters
@@ -36,10 +36,10 @@ void PGLog::IndexedLog::split_out_child(
   unsigned split_bits,
   PGLog::IndexedLog *target)
 {
+  __u16 was_indexed = indexed_data;
   unindex();
   *target = pg_log_t::split_out_child(child_pgid, split_bits);
-  index();
-  target->index();
+  index(was_indexed);
   reset_rollback_info_trimmed_to_riter();
 }
 
@@ -434,6 +434,163 @@ void PGLog::check() {
   }
 }
 
+static void write_missing_changes(
+  const pg_missing_tracker_t &missing,
+  map<string,bufferlist> *km,
+  set<string> *to_remove)
+{
+  missing.get_changed(
+    [&](const hobject_t &obj) {
+      string key = string("missing/") + obj.to_str();
+      pg_missing_item item;
+      if (!missing.is_missing(obj, &item)) {
+	to_remove->insert(key);
+      } else {
+	::encode(make_pair(obj, item), (*km)[key]);
+      }
+    });
+}
+
+void PGLog::encode_journal_record(
+  const pg_log_t &log,
+  eversion_t from,
+  bool has_rollback_info,
+  bufferlist &bl)
+{
+  list<pg_log_entry_t>::const_reverse_iterator p = log.log.rbegin();
+  uint32_t count = 0;
+  for (; p != log.log.rend() && p->version >= from; ++p)
+    ++count;
+
+  ENCODE_START(1, 1, bl);
+  ::encode(count, bl);
+  for (list<pg_log_entry_t>::const_iterator i = p.base();
+       i != log.log.end();
+       ++i)
+    i->encode_with_checksum(bl);
+  ::encode(has_rollback_info, bl);
+  ::encode(log.get_can_rollback_to(), bl);
+  ::encode(log.get_rollback_info_trimmed_to(), bl);
+  ENCODE_FINISH(bl);
+}
+
+void PGLog::decode_journal_record(
+  bufferlist::iterator &p,
+  list<pg_log_entry_t> *entries,
+  eversion_t *can_rollback_to,
+  eversion_t *rollback_info_trimmed_to)
+{
+  DECODE_START(1, p);
+  uint32_t count;
+  ::decode(count, p);
+  while (count--) {
+    entries->push_back(pg_log_entry_t());
+    entries->back().decode_with_checksum(p);
+  }
+  bool has_rollback_info;
+  eversion_t crt, ritt;
+  ::decode(has_rollback_info, p);
+  ::decode(crt, p);
+  ::decode(ritt, p);
+  if (has_rollback_info) {
+    *can_rollback_to = crt;
+    *rollback_info_trimmed_to = ritt;
+  }
+  DECODE_FINISH(p);
+}
+
+bool PGLog::can_append_to_journal() const
+{
+  if (!cct || cct->_conf->osd_pg_log_journal_max_bytes == 0)
+    return false;
+  // anything but appending new entries and trimming old ones
+  // rewrites omap keys
+  return touched_log &&
+    dirty_to == eversion_t() &&
+    dirty_from == eversion_t::max() &&
+    !clear_divergent_priors &&
+    journal.head != eversion_t::max() &&
+    (writeout_from == eversion_t::max() || writeout_from > journal.head);
+}
+
+void PGLog::append_to_journal(
+  ObjectStore::Transaction& t,
+  map<string,bufferlist> *km,
+  const coll_t& coll, const ghobject_t &log_oid,
+  bufferlist &record,
+  bool require_rollback)
+{
+  // entries still in omap are removed at the next checkpoint, the
+  // others just won't be written out
+  for (set<eversion_t>::const_iterator i = trimmed.begin();
+       i != trimmed.end();
+       ++i) {
+    if (*i < journal.from)
+      journal.trimmed.insert(*i);
+    if (pg_log_debug) {
+      assert(log_keys_debug.count(i->get_key_name()));
+      log_keys_debug.erase(i->get_key_name());
+    }
+  }
+
+  eversion_t first = eversion_t::max();
+  for (list<pg_log_entry_t>::reverse_iterator p = log.log.rbegin();
+       p != log.log.rend() && p->version >= writeout_from;
+       ++p) {
+    first = p->version;
+    if (pg_log_debug) {
+      assert(!log_keys_debug.count(p->get_key_name()));
+      log_keys_debug.insert(p->get_key_name());
+    }
+  }
+  if (first != eversion_t::max() || require_rollback) {
+    dout(20) << __func__ << " " << record.length() << " bytes at "
+	     << journal.bytes << dendl;
+    t.write(coll, log_oid, journal.bytes, record.length(), record);
+    journal.bytes += record.length();
+    if (journal.from == eversion_t::max())
+      journal.from = first;
+  }
+  journal.head = log.head;
+
+  set<string> to_remove;
+  write_missing_changes(missing, km, &to_remove);
+  if (!to_remove.empty())
+    t.omap_rmkeys(coll, log_oid, to_remove);
+}
+
+void PGLog::checkpoint_journal(
+  ObjectStore::Transaction& t,
+  const coll_t& coll, const ghobject_t &log_oid)
+{
+  dout(10) << __func__ << " " << journal.bytes << " bytes from "
+	   << journal.from << ", " << journal.trimmed.size()
+	   << " trimmed keys" << dendl;
+  if (!journal.trimmed.empty()) {
+    set<string> keys;
+    for (set<eversion_t>::const_iterator i = journal.trimmed.begin();
+	 i != journal.trimmed.end();
+	 ++i)
+      keys.insert(i->get_key_name());
+    t.omap_rmkeys(coll, log_oid, keys);
+  }
+  if (journal.from != eversion_t::max()) {
+    // write the live journaled entries out with the rest of the log
+    mark_writeout_from(journal.from);
+    if (pg_log_debug) {
+      for (list<pg_log_entry_t>::reverse_iterator p = log.log.rbegin();
+	   p != log.log.rend() && p->version >= journal.from;
+	   ++p)
+	log_keys_debug.erase(p->get_key_name());
+    }
+  }
+  if (journal.bytes)
+    t.truncate(coll, log_oid, 0);
+  journal.bytes = 0;
+  journal.from = eversion_t::max();
+  journal.trimmed.clear();
+}
+
 void PGLog::write_log_and_missing(
   ObjectStore::Transaction& t,
   map<string,bufferlist> *km,
@@ -448,6 +605,18 @@ void PGLog::write_log_and_missing(
 	     << ", trimmed: " << trimmed
 	     << ", clear_divergent_priors: " << clear_divergent_priors
 	     << dendl;
+    if (can_append_to_journal()) {
+      bufferlist record;
+      encode_journal_record(log, writeout_from, require_rollback, record);
+      if (journal.bytes + record.length() <=
+	  cct->_conf->osd_pg_log_journal_max_bytes) {
+	append_to_journal(t, km, coll, log_oid, record, require_rollback);
+	undirty();
+	return;
+      }
+    }
+    if (journal.bytes || !journal.trimmed.empty())
+      checkpoint_journal(t, coll, log_oid);
     _write_log_and_missing(
       t, km, log, coll, log_oid,
       dirty_to,
@@ -459,6 +628,7 @@ void PGLog::write_log_and_missing(
       require_rollback,
       clear_divergent_priors,
       (pg_log_debug ? &log_keys_debug : 0));
+    journal.head = log.head;
     undirty();
   } else {
     dout(10) << "log is not dirty" << dendl;
@@ -664,16 +834,7 @@ void PGLog::_write_log_and_missing(
     //dout(10) << "write_log_and_missing: writing divergent_priors" << dendl;
     to_remove.insert("divergent_priors");
   }
-  missing.get_changed(
-    [&](const hobject_t &obj) {
-      string key = string("missing/") + obj.to_str();
-      pg_missing_item item;
-      if (!missing.is_missing(obj, &item)) {
-	to_remove.insert(key);
-      } else {
-	::encode(make_pair(obj, item), (*km)[key]);
-      }
-    });
+  write_missing_changes(missing, km, &to_remove);
   if (require_rollback) {
     ::encode(
       log.get_can_rollback_to(),
@@ -73,13 +73,40 @@ struct PGLog : DoutPrefixProvider {
     char buf[512];
   };
 
+  /**
+   * With osd_pg_log_journal_max_bytes set, new log entries are
+   * appended to the data of the pgmeta object, one record per
+   * transaction, instead of being written as one omap key each.
+   * Trimming entries that are already in omap is deferred as well.
+   * Once the data grows past the limit, or the log is changed in any
+   * other way than appending, the pending entries are checkpointed to
+   * omap and the data is truncated.
+   */
+  struct log_journal_t {
+    uint64_t bytes = 0;                   ///< length of the object data
+    eversion_t from = eversion_t::max();  ///< oldest live entry in it
+    eversion_t head = eversion_t::max();  ///< newest entry on disk
+    set<eversion_t> trimmed;              ///< trimmed entries still in omap
+  };
+
+  /// encode the entries of log from from onwards as a journal record
+  static void encode_journal_record(
+    const pg_log_t &log,
+    eversion_t from,
+    bool has_rollback_info,
+    bufferlist &bl);
+  static void decode_journal_record(
+    bufferlist::iterator &p,
+    list<pg_log_entry_t> *entries,
+    eversion_t *can_rollback_to,
+    eversion_t *rollback_info_trimmed_to);
+
 public:
   /**
    * IndexLog - adds in-memory index of the log, by oid.
    * plus some methods to manipulate it all.
    */
   struct IndexedLog : public pg_log_t {
-    mutable ceph::unordered_map<hobject_t,pg_log_entry_t*> objects;  // ptrs into log.  be careful!
     mutable ceph::unordered_map<osd_reqid_t,pg_log_entry_t*> caller_ops;
     mutable ceph::unordered_multimap<osd_reqid_t,pg_log_entry_t*> extra_caller_ops;
 
@@ -89,6 +116,9 @@ public:
 
     //
   private:
+    // only reached through logged_object()/get_latest_entry(), which build
+    // it on first use
+    mutable ceph::unordered_map<hobject_t,pg_log_entry_t*> objects;  // ptrs into log.  be careful!
     mutable __u16 indexed_data = 0;
     /**
      * rollback_info_trimmed_to_riter points to the first log entry <=
@@ -134,6 +164,9 @@ public:
       rollback_info_trimmed_to_riter(log.rbegin())
       {}
 
+    // the indexes are only built when first needed: a replica never
+    // looks up caller ops and only needs the objects index while
+    // peering, so most logs on an OSD never pay for them
     template <typename... Args>
     IndexedLog(Args&&... args) :
       pg_log_t(std::forward<Args>(args)...),
@@ -142,7 +175,6 @@ public:
       indexed_data(0),
       rollback_info_trimmed_to_riter(log.rbegin()) {
       reset_rollback_info_trimmed_to_riter();
-      index();
     }
 
     IndexedLog(const IndexedLog &rhs) :
@@ -181,7 +213,7 @@ public:
 
     mempool::osd::list<pg_log_entry_t> rewind_from_head(eversion_t newhead) {
       auto divergent = pg_log_t::rewind_from_head(newhead);
-      index();
+      index(indexed_data);
       reset_rollback_info_trimmed_to_riter();
       return divergent;
     }
@@ -210,7 +242,6 @@ public:
       *this = IndexedLog(o);
 
       skip_can_rollback_to_to_head();
-      index();
     }
 
     void split_out_child(
@@ -237,6 +268,21 @@ public:
       last_requested = 0;
     }
 
+    bool has_index(__u16 what) const {
+      return (indexed_data & what) == what;
+    }
+
+    /// most recent entry for oid, or NULL if it is not in the log
+    const pg_log_entry_t *get_latest_entry(const hobject_t& oid) const {
+      if (!(indexed_data & PGLOG_INDEXED_OBJECTS)) {
+         index_objects();
+      }
+      auto p = objects.find(oid);
+      if (p == objects.end())
+	return nullptr;
+      return p->second;
+    }
+
     bool logged_object(const hobject_t& oid) const {
       if (!(indexed_data & PGLOG_INDEXED_OBJECTS)) {
          index_objects();
@@ -398,9 +444,11 @@ public:
       }
     }
     void unindex() {
-      objects.clear();
-      caller_ops.clear();
-      extra_caller_ops.clear();
+      // swap with empty maps so that the buckets are released too
+      ceph::unordered_map<hobject_t,pg_log_entry_t*>().swap(objects);
+      ceph::unordered_map<osd_reqid_t,pg_log_entry_t*>().swap(caller_ops);
+      ceph::unordered_multimap<osd_reqid_t,pg_log_entry_t*>().swap(
+	extra_caller_ops);
       indexed_data = 0;
     }
     void unindex(pg_log_entry_t& e) {
@@ -499,6 +547,7 @@ protected:
   /// Log is clean on [dirty_to, dirty_from)
   bool touched_log;
   bool clear_divergent_priors;
+  log_journal_t journal;
 
   void mark_dirty_to(eversion_t to) {
     if (to > dirty_to)
@@ -786,20 +835,18 @@ protected:
 		       << " last_divergent_update: " << last_divergent_update
 		       << dendl;
 
-    ceph::unordered_map<hobject_t, pg_log_entry_t*>::const_iterator objiter =
-      log.objects.find(hoid);
-    if (objiter != log.objects.end() &&
-	objiter->second->version >= first_divergent_update) {
+    const pg_log_entry_t *latest = log.get_latest_entry(hoid);
+    if (latest && latest->version >= first_divergent_update) {
       /// Case 1)
       ldpp_dout(dpp, 10) << __func__ << ": more recent entry found: "
-			 << *objiter->second << ", already merged" << dendl;
+			 << *latest << ", already merged" << dendl;
 
-      assert(objiter->second->version > last_divergent_update);
+      assert(latest->version > last_divergent_update);
 
       // ensure missing has been updated appropriately
-      if (objiter->second->is_update()) {
+      if (latest->is_update()) {
 	assert(missing.is_missing(hoid) &&
-	       missing.get_items().at(hoid).need == objiter->second->version);
+	       missing.get_items().at(hoid).need == latest->version);
       } else {
 	assert(!missing.is_missing(hoid));
       }
@@ -1044,6 +1091,19 @@ public:
 		 const ghobject_t &log_oid,
 		 bool require_rollback);
 
+private:
+  bool can_append_to_journal() const;
+  void append_to_journal(ObjectStore::Transaction& t,
+			 map<string,bufferlist> *km,
+			 const coll_t& coll,
+			 const ghobject_t &log_oid,
+			 bufferlist &record,
+			 bool require_rollback);
+  void checkpoint_journal(ObjectStore::Transaction& t,
+			  const coll_t& coll,
+			  const ghobject_t &log_oid);
+public:
+
   static void write_log_and_missing_wo_missing(
     ObjectStore::Transaction& t,
     map<string,bufferlist>* km,
@@ -1108,7 +1168,8 @@ public:
       &clear_divergent_priors,
       this,
       (pg_log_debug ? &log_keys_debug : 0),
-      debug_verify_stored_missing);
+      debug_verify_stored_missing,
+      &journal);
   }
 
   template <typename missing_type>
@@ -1121,16 +1182,27 @@ public:
     bool *clear_divergent_priors = NULL,
     const DoutPrefixProvider *dpp = NULL,
     set<string> *log_keys_debug = 0,
-    bool debug_verify_stored_missing = false
+    bool debug_verify_stored_missing = false,
+    log_journal_t *journal = 0
     ) {
     ldpp_dout(dpp, 20) << "read_log_and_missing coll " << pg_coll
 		       << " log_oid " << log_oid << dendl;
 
-    // legacy?
+    // the object data only holds entries appended since the last
+    // checkpoint, see log_journal_t
     struct stat st;
     int r = store->stat(log_coll, log_oid, &st);
     assert(r == 0);
-    assert(st.st_size == 0);
+    bufferlist journal_bl;
+    if (st.st_size > 0) {
+      r = store->read(log_coll, log_oid, 0, st.st_size, journal_bl);
+      assert(r == st.st_size);
+    }
+    if (journal) {
+      *journal = log_journal_t();
+      journal->bytes = st.st_size;
+      journal->head = info.last_update;
+    }
 
     // will get overridden below if it had been recorded
     eversion_t on_disk_can_rollback_to = info.last_update;
@@ -1164,6 +1236,12 @@ public:
 	  pg_log_entry_t e;
 	  e.decode_with_checksum(bp);
 	  ldpp_dout(dpp, 20) << "read_log_and_missing " << e << dendl;
+	  if (e.version <= info.log_tail) {
+	    // trimmed, but its removal was deferred to the next checkpoint
+	    if (journal)
+	      journal->trimmed.insert(e.version);
+	    continue;
+	  }
 	  if (!entries.empty()) {
 	    pg_log_entry_t last_e(entries.back());
 	    assert(last_e.version.version < e.version.version);
@@ -1175,6 +1253,26 @@ public:
 	}
       }
     }
+    bufferlist::iterator jp = journal_bl.begin();
+    while (!jp.end()) {
+      list<pg_log_entry_t> appended;
+      decode_journal_record(jp, &appended, &on_disk_can_rollback_to,
+			    &on_disk_rollback_info_trimmed_to);
+      for (auto &e : appended) {
+	ldpp_dout(dpp, 20) << "read_log_and_missing journal " << e << dendl;
+	if (e.version <= info.log_tail)
+	  continue;
+	if (!entries.empty()) {
+	  assert(entries.back().version.version < e.version.version);
+	  assert(entries.back().version.epoch <= e.version.epoch);
+	}
+	if (journal && journal->from == eversion_t::max())
+	  journal->from = e.version;
+	entries.push_back(e);
+	if (log_keys_debug)
+	  log_keys_debug->insert(e.get_key_name());
+      }
+    }
     log = IndexedLog(
       info.last_update,
       info.log_tail,
@@ -348,8 +348,9 @@ void PrimaryLogPG::on_local_recover(
   if (pg_log.get_missing().is_missing(recovery_info.soid) &&
       pg_log.get_missing().get_items().find(recovery_info.soid)->second.need > recovery_info.version) {
     assert(is_primary());
-    const pg_log_entry_t *latest = pg_log.get_log().objects.find(recovery_info.soid)->second;
-    if (latest->op == pg_log_entry_t::LOST_REVERT &&
+    const pg_log_entry_t *latest =
+      pg_log.get_log().get_latest_entry(recovery_info.soid);
+    if (latest && latest->op == pg_log_entry_t::LOST_REVERT &&
 	latest->reverting_to == recovery_info.version) {
       dout(10) << " got old revert version " << recovery_info.version
 	       << " for " << *latest << dendl;
@@ -9074,10 +9075,10 @@ void PrimaryLogPG::populate_obc_watchers(ObjectContextRef obc)
   assert(is_active());
   assert((recovering.count(obc->obs.oi.soid) ||
 	  !is_missing_object(obc->obs.oi.soid)) ||
-	 (pg_log.get_log().objects.count(obc->obs.oi.soid) && // or this is a revert... see recover_primary()
-	  pg_log.get_log().objects.find(obc->obs.oi.soid)->second->op ==
+	 (pg_log.get_log().logged_object(obc->obs.oi.soid) && // or this is a revert... see recover_primary()
+	  pg_log.get_log().get_latest_entry(obc->obs.oi.soid)->op ==
 	    pg_log_entry_t::LOST_REVERT &&
-	  pg_log.get_log().objects.find(obc->obs.oi.soid)->second->reverting_to ==
+	  pg_log.get_log().get_latest_entry(obc->obs.oi.soid)->reverting_to ==
 	    obc->obs.oi.version));
 
   dout(10) << "populate_obc_watchers " << obc->obs.oi.soid << dendl;
@@ -9194,8 +9195,8 @@ ObjectContextRef PrimaryLogPG::get_object_context(
   assert(
     attrs || !pg_log.get_missing().is_missing(soid) ||
     // or this is a revert... see recover_primary()
-    (pg_log.get_log().objects.count(soid) &&
-      pg_log.get_log().objects.find(soid)->second->op ==
+    (pg_log.get_log().logged_object(soid) &&
+      pg_log.get_log().get_latest_entry(soid)->op ==
       pg_log_entry_t::LOST_REVERT));
   ObjectContextRef obc = object_contexts.lookup(soid);
   osd->logger->inc(l_osd_object_ctx_cache_total);
@@ -10746,7 +10747,7 @@ uint64_t PrimaryLogPG::recover_primary(uint64_t max, ThreadPool::TPHandle &handl
   dout(25) << "recover_primary " << missing.get_items() << dendl;
 
   // look at log!
-  pg_log_entry_t *latest = 0;
+  const pg_log_entry_t *latest = 0;
   unsigned started = 0;
   int skipped = 0;
 
@@ -10758,12 +10759,11 @@ uint64_t PrimaryLogPG::recover_primary(uint64_t max, ThreadPool::TPHandle &handl
     hobject_t soid;
     version_t v = p->first;
 
-    if (pg_log.get_log().objects.count(p->second)) {
-      latest = pg_log.get_log().objects.find(p->second)->second;
+    latest = pg_log.get_log().get_latest_entry(p->second);
+    if (latest) {
       assert(latest->is_update());
       soid = latest->soid;
     } else {
-      latest = 0;
       soid = p->second;
     }
     const pg_missing_item& item = missing.get_items().find(p->second)->second;
@@ -1406,11 +1406,11 @@ void ReplicatedBackend::prepare_pull(
 	     << " at version " << pmissing.get_items().find(soid)->second.have
 	     << " rather than at version " << v << dendl;
     v = pmissing.get_items().find(soid)->second.have;
-    assert(get_parent()->get_log().get_log().objects.count(soid) &&
-	   (get_parent()->get_log().get_log().objects.find(soid)->second->op ==
+    assert(get_parent()->get_log().get_log().logged_object(soid) &&
+	   (get_parent()->get_log().get_log().get_latest_entry(soid)->op ==
 	    pg_log_entry_t::LOST_REVERT) &&
-	   (get_parent()->get_log().get_log().objects.find(
-	     soid)->second->reverting_to ==
+	   (get_parent()->get_log().get_log().get_latest_entry(
+	     soid)->reverting_to ==
 	    v));
   }
 
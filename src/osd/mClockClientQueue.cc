@@ -0,0 +1,66 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2016 Red Hat Inc.
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <memory>
+
+#include "osd/mClockClientQueue.h"
+#include "common/dout.h"
+
+namespace dmc = crimson::dmclock;
+
+#define dout_context cct
+#define dout_subsys ceph_subsys_osd
+#undef dout_prefix
+#define dout_prefix *_dout
+
+namespace ceph {
+
+  mClockClientQueue::mClockClientQueue(CephContext *cct,
+				       const std::string& name) :
+    client_info_mgr(cct),
+    perf(cct, name),
+    queue(std::bind(&mClockClientQueue::op_class_client_info_f, this,
+		    std::placeholders::_1))
+  {
+    // empty
+  }
+
+  const dmc::ClientInfo mClockClientQueue::op_class_client_info_f(
+    const mClockClientQueue::InnerClient& client)
+  {
+    return *client_info_mgr.get_client_info(client.second);
+  }
+
+  void mClockClientQueue::remove_by_class(Client cl,
+					  std::list<Request> *out)
+  {
+    queue.remove_by_filter(
+      [&cl, out, this] (Request r) -> bool {
+	if (cl == r.second.get_owner()) {
+	  perf.removed(get_osd_op_type(r));
+	  if (out) {
+	    out->push_front(r);
+	  }
+	  return true;
+	}
+	return false;
+      });
+  }
+
+  // Formatted output of the queue
+  void mClockClientQueue::dump(ceph::Formatter *f) const {
+    queue.dump(f);
+  }
+
+} // namespace ceph
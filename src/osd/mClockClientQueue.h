@@ -0,0 +1,137 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2016 Red Hat Inc.
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_OSD_MCLOCKCLIENTQUEUE_H
+#define CEPH_OSD_MCLOCKCLIENTQUEUE_H
+
+#include <ostream>
+#include <string>
+
+#include "common/mClockPriorityQueue.h"
+#include "osd/PGQueueable.h"
+#include "osd/mClockOpClassSupport.h"
+
+namespace ceph {
+
+  using Request = std::pair<spg_t, PGQueueable>;
+  using Client = entity_inst_t;
+
+  // This class exists to bridge the ceph code, which treats the class
+  // as the client, and the queue, where the class is the pair of the
+  // client and its op class.  Every client gets its own dmClock tags,
+  // using the reservation/weight/limit of the op class, so clients of
+  // the same class are isolated from each other.
+  class mClockClientQueue : public OpQueue<Request, Client> {
+
+    using osd_op_type_t = ceph::mclock::osd_op_type_t;
+    using InnerClient = std::pair<entity_inst_t, osd_op_type_t>;
+    using queue_t = mClockQueue<Request, InnerClient>;
+
+    mclock::OpClassClientInfoMgr client_info_mgr;
+    mclock::OpClassPerfCounters perf;
+    queue_t queue;
+
+    osd_op_type_t get_osd_op_type(const Request& request) {
+      return mclock::OpClassClientInfoMgr::get_osd_op_type(request);
+    }
+
+    InnerClient get_inner_client(const Client& cl, const Request& request) {
+      return InnerClient(cl, get_osd_op_type(request));
+    }
+
+  public:
+
+    mClockClientQueue(CephContext *cct, const std::string& name);
+
+    const dmc::ClientInfo op_class_client_info_f(const InnerClient& client);
+
+    inline unsigned length() const override final {
+      return queue.length();
+    }
+
+    // Ops will be removed f evaluates to true, f may have sideeffects
+    inline void remove_by_filter(
+      std::function<bool (Request)> filter_accum) override final {
+      queue.remove_by_filter(
+	[&] (Request r) -> bool {
+	  if (filter_accum(r)) {
+	    perf.removed(get_osd_op_type(r));
+	    return true;
+	  }
+	  return false;
+	});
+    }
+
+    // Ops of this client should be deleted immediately
+    void remove_by_class(Client cl,
+			 std::list<Request> *out) override final;
+
+    // Enqueue op in the back of the strict queue
+    inline void enqueue_strict(Client cl,
+			       unsigned priority,
+			       Request item) override final {
+      InnerClient ic = get_inner_client(cl, item);
+      perf.queued(ic.second);
+      queue.enqueue_strict(ic, priority, item);
+    }
+
+    // Enqueue op in the front of the strict queue
+    inline void enqueue_strict_front(Client cl,
+				     unsigned priority,
+				     Request item) override final {
+      InnerClient ic = get_inner_client(cl, item);
+      perf.queued(ic.second);
+      queue.enqueue_strict_front(ic, priority, item);
+    }
+
+    // Enqueue op in the back of the regular queue
+    inline void enqueue(Client cl,
+			unsigned priority,
+			unsigned cost,
+			Request item) override final {
+      InnerClient ic = get_inner_client(cl, item);
+      perf.queued(ic.second);
+      queue.enqueue(ic, priority, cost, item);
+    }
+
+    // Enqueue the op in the front of the regular queue
+    inline void enqueue_front(Client cl,
+			      unsigned priority,
+			      unsigned cost,
+			      Request item) override final {
+      InnerClient ic = get_inner_client(cl, item);
+      perf.queued(ic.second);
+      queue.enqueue_front(ic, priority, cost, item);
+    }
+
+    // Returns if the queue is empty
+    inline bool empty() const override final {
+      return queue.empty();
+    }
+
+    // Return an op to be dispatch
+    inline Request dequeue() override final {
+      boost::optional<dmc::PhaseType> phase;
+      Request r = queue.dequeue(&phase);
+      perf.dequeued(get_osd_op_type(r), phase);
+      return r;
+    }
+
+    // Formatted output of the queue
+    void dump(ceph::Formatter *f) const override final;
+  }; // class mClockClientQueue
+
+} // namespace ceph
+
+#endif
@@ -0,0 +1,50 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2016 Red Hat Inc.
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <memory>
+
+#include "osd/mClockOpClassQueue.h"
+#include "common/dout.h"
+
+namespace dmc = crimson::dmclock;
+
+#define dout_context cct
+#define dout_subsys ceph_subsys_osd
+#undef dout_prefix
+#define dout_prefix *_dout
+
+namespace ceph {
+
+  mClockOpClassQueue::mClockOpClassQueue(CephContext *cct,
+					 const std::string& name) :
+    client_info_mgr(cct),
+    perf(cct, name),
+    queue(std::bind(&mClockOpClassQueue::op_class_client_info_f, this,
+		    std::placeholders::_1))
+  {
+    // empty
+  }
+
+  const dmc::ClientInfo mClockOpClassQueue::op_class_client_info_f(
+    const osd_op_type_t& op_type)
+  {
+    return *client_info_mgr.get_client_info(op_type);
+  }
+
+  // Formatted output of the queue
+  void mClockOpClassQueue::dump(ceph::Formatter *f) const {
+    queue.dump(f);
+  }
+
+} // namespace ceph
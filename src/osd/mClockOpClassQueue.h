@@ -0,0 +1,143 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2016 Red Hat Inc.
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_OSD_MCLOCKOPCLASSQUEUE_H
+#define CEPH_OSD_MCLOCKOPCLASSQUEUE_H
+
+#include <ostream>
+#include <string>
+
+#include "common/mClockPriorityQueue.h"
+#include "osd/PGQueueable.h"
+#include "osd/mClockOpClassSupport.h"
+
+namespace ceph {
+
+  using Request = std::pair<spg_t, PGQueueable>;
+  using Client = entity_inst_t;
+
+  // This class exists to bridge the ceph code, which treats the class
+  // as the client, and the queue, where the class is
+  // osd_op_type_t. So this adapter class will transform calls
+  // appropriately.
+  class mClockOpClassQueue : public OpQueue<Request, Client> {
+
+    using osd_op_type_t = ceph::mclock::osd_op_type_t;
+    using queue_t = mClockQueue<Request, osd_op_type_t>;
+
+    mclock::OpClassClientInfoMgr client_info_mgr;
+    mclock::OpClassPerfCounters perf;
+    queue_t queue;
+
+    osd_op_type_t get_osd_op_type(const Request& request) {
+      return mclock::OpClassClientInfoMgr::get_osd_op_type(request);
+    }
+
+  public:
+
+    mClockOpClassQueue(CephContext *cct, const std::string& name);
+
+    const dmc::ClientInfo op_class_client_info_f(const osd_op_type_t& op_type);
+
+    inline unsigned length() const override final {
+      return queue.length();
+    }
+
+    // Ops will be removed f evaluates to true, f may have sideeffects
+    inline void remove_by_filter(
+      std::function<bool (Request)> filter_accum) override final {
+      queue.remove_by_filter(
+	[&] (Request r) -> bool {
+	  if (filter_accum(r)) {
+	    perf.removed(get_osd_op_type(r));
+	    return true;
+	  }
+	  return false;
+	});
+    }
+
+    // Ops of this client should be deleted immediately
+    inline void remove_by_class(Client cl,
+				std::list<Request> *out) override final {
+      queue.remove_by_filter(
+	[&cl, out, this] (Request r) -> bool {
+	  if (cl == r.second.get_owner()) {
+	    perf.removed(get_osd_op_type(r));
+	    if (out) {
+	      out->push_front(r);
+	    }
+	    return true;
+	  }
+	  return false;
+	});
+    }
+
+    // Enqueue op in the back of the strict queue
+    inline void enqueue_strict(Client cl,
+			       unsigned priority,
+			       Request item) override final {
+      osd_op_type_t t = get_osd_op_type(item);
+      perf.queued(t);
+      queue.enqueue_strict(t, priority, item);
+    }
+
+    // Enqueue op in the front of the strict queue
+    inline void enqueue_strict_front(Client cl,
+				     unsigned priority,
+				     Request item) override final {
+      osd_op_type_t t = get_osd_op_type(item);
+      perf.queued(t);
+      queue.enqueue_strict_front(t, priority, item);
+    }
+
+    // Enqueue op in the back of the regular queue
+    inline void enqueue(Client cl,
+			unsigned priority,
+			unsigned cost,
+			Request item) override final {
+      osd_op_type_t t = get_osd_op_type(item);
+      perf.queued(t);
+      queue.enqueue(t, priority, cost, item);
+    }
+
+    // Enqueue the op in the front of the regular queue
+    inline void enqueue_front(Client cl,
+			      unsigned priority,
+			      unsigned cost,
+			      Request item) override final {
+      osd_op_type_t t = get_osd_op_type(item);
+      perf.queued(t);
+      queue.enqueue_front(t, priority, cost, item);
+    }
+
+    // Returns if the queue is empty
+    inline bool empty() const override final {
+      return queue.empty();
+    }
+
+    // Return an op to be dispatch
+    inline Request dequeue() override final {
+      boost::optional<dmc::PhaseType> phase;
+      Request r = queue.dequeue(&phase);
+      perf.dequeued(get_osd_op_type(r), phase);
+      return r;
+    }
+
+    // Formatted output of the queue
+    void dump(ceph::Formatter *f) const override final;
+  }; // class mClockOpClassQueue
+
+} // namespace ceph
+
+#endif
@@ -0,0 +1,189 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2017 Red Hat Inc.
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "osd/mClockOpClassSupport.h"
+
+#include "common/ceph_context.h"
+#include "common/perf_counters.h"
+#include "common/config.h"
+
+namespace ceph {
+  namespace mclock {
+
+    std::ostream& operator<<(std::ostream& out, const osd_op_type_t& t) {
+      switch(t) {
+      case osd_op_type_t::client_op:
+	return out << "client_op";
+      case osd_op_type_t::osd_subop:
+	return out << "osd_subop";
+      case osd_op_type_t::bg_snaptrim:
+	return out << "bg_snaptrim";
+      case osd_op_type_t::bg_recovery:
+	return out << "bg_recovery";
+      case osd_op_type_t::bg_scrub:
+	return out << "bg_scrub";
+      default:
+	return out << "unknown";
+      }
+    }
+
+    OpClassClientInfoMgr::OpClassClientInfoMgr(CephContext *cct) :
+      client_op(cct->_conf->osd_op_queue_mclock_client_op_res,
+		cct->_conf->osd_op_queue_mclock_client_op_wgt,
+		cct->_conf->osd_op_queue_mclock_client_op_lim),
+      osd_subop(cct->_conf->osd_op_queue_mclock_osd_subop_res,
+		cct->_conf->osd_op_queue_mclock_osd_subop_wgt,
+		cct->_conf->osd_op_queue_mclock_osd_subop_lim),
+      snaptrim(cct->_conf->osd_op_queue_mclock_snap_res,
+	       cct->_conf->osd_op_queue_mclock_snap_wgt,
+	       cct->_conf->osd_op_queue_mclock_snap_lim),
+      recov(cct->_conf->osd_op_queue_mclock_recov_res,
+	    cct->_conf->osd_op_queue_mclock_recov_wgt,
+	    cct->_conf->osd_op_queue_mclock_recov_lim),
+      scrub(cct->_conf->osd_op_queue_mclock_scrub_res,
+	    cct->_conf->osd_op_queue_mclock_scrub_wgt,
+	    cct->_conf->osd_op_queue_mclock_scrub_lim)
+    {
+      // empty
+    }
+
+    struct pg_queueable_visitor_t : public boost::static_visitor<osd_op_type_t> {
+      osd_op_type_t operator()(const OpRequestRef& o) const {
+	// replication, EC sub-ops and other peer traffic are scheduled
+	// apart from the client ops that caused them
+	if (o->get_req()->get_type() == CEPH_MSG_OSD_OP) {
+	  return osd_op_type_t::client_op;
+	}
+	return osd_op_type_t::osd_subop;
+      }
+
+      osd_op_type_t operator()(const PGSnapTrim& o) const {
+	return osd_op_type_t::bg_snaptrim;
+      }
+
+      osd_op_type_t operator()(const PGScrub& o) const {
+	return osd_op_type_t::bg_scrub;
+      }
+
+      osd_op_type_t operator()(const PGRecovery& o) const {
+	return osd_op_type_t::bg_recovery;
+      }
+    };
+
+    osd_op_type_t OpClassClientInfoMgr::get_osd_op_type(
+      const std::pair<spg_t, PGQueueable>& request)
+    {
+      return boost::apply_visitor(pg_queueable_visitor_t(),
+				  request.second.get_variant());
+    }
+
+    OpClassPerfCounters::OpClassPerfCounters(CephContext *cct,
+					     const std::string& name) :
+      cct(cct)
+    {
+      PerfCountersBuilder b(cct, name, l_mclock_first, l_mclock_last);
+
+      b.add_u64(l_mclock_client_op_queued, "client_op_queued",
+		"Client ops waiting in the queue");
+      b.add_u64_counter(l_mclock_client_op_dequeued, "client_op_dequeued",
+			"Client ops dequeued");
+      b.add_u64_counter(l_mclock_client_op_res_dequeued,
+			"client_op_res_dequeued",
+			"Client ops dequeued within their reservation");
+
+      b.add_u64(l_mclock_osd_subop_queued, "osd_subop_queued",
+		"OSD sub-ops waiting in the queue");
+      b.add_u64_counter(l_mclock_osd_subop_dequeued, "osd_subop_dequeued",
+			"OSD sub-ops dequeued");
+      b.add_u64_counter(l_mclock_osd_subop_res_dequeued,
+			"osd_subop_res_dequeued",
+			"OSD sub-ops dequeued within their reservation");
+
+      b.add_u64(l_mclock_snaptrim_queued, "snaptrim_queued",
+		"Snap trim work waiting in the queue");
+      b.add_u64_counter(l_mclock_snaptrim_dequeued, "snaptrim_dequeued",
+			"Snap trim work dequeued");
+      b.add_u64_counter(l_mclock_snaptrim_res_dequeued,
+			"snaptrim_res_dequeued",
+			"Snap trim work dequeued within its reservation");
+
+      b.add_u64(l_mclock_recovery_queued, "recovery_queued",
+		"Recovery work waiting in the queue");
+      b.add_u64_counter(l_mclock_recovery_dequeued, "recovery_dequeued",
+			"Recovery work dequeued");
+      b.add_u64_counter(l_mclock_recovery_res_dequeued,
+			"recovery_res_dequeued",
+			"Recovery work dequeued within its reservation");
+
+      b.add_u64(l_mclock_scrub_queued, "scrub_queued",
+		"Scrub work waiting in the queue");
+      b.add_u64_counter(l_mclock_scrub_dequeued, "scrub_dequeued",
+			"Scrub work dequeued");
+      b.add_u64_counter(l_mclock_scrub_res_dequeued,
+			"scrub_res_dequeued",
+			"Scrub work dequeued within its reservation");
+
+      logger = b.create_perf_counters();
+      cct->get_perfcounters_collection()->add(logger);
+    }
+
+    OpClassPerfCounters::~OpClassPerfCounters()
+    {
+      cct->get_perfcounters_collection()->remove(logger);
+      delete logger;
+    }
+
+    int OpClassPerfCounters::first_counter(osd_op_type_t type)
+    {
+      switch(type) {
+      case osd_op_type_t::client_op:
+	return l_mclock_client_op_queued;
+      case osd_op_type_t::osd_subop:
+	return l_mclock_osd_subop_queued;
+      case osd_op_type_t::bg_snaptrim:
+	return l_mclock_snaptrim_queued;
+      case osd_op_type_t::bg_recovery:
+	return l_mclock_recovery_queued;
+      case osd_op_type_t::bg_scrub:
+	return l_mclock_scrub_queued;
+      default:
+	assert(0);
+	return 0;
+      }
+    }
+
+    void OpClassPerfCounters::queued(osd_op_type_t type)
+    {
+      logger->inc(first_counter(type));
+    }
+
+    void OpClassPerfCounters::removed(osd_op_type_t type)
+    {
+      logger->dec(first_counter(type));
+    }
+
+    void OpClassPerfCounters::dequeued(
+      osd_op_type_t type,
+      const boost::optional<dmc::PhaseType>& phase)
+    {
+      int idx = first_counter(type);
+      logger->dec(idx);
+      logger->inc(idx + 1);
+      if (phase && *phase == dmc::PhaseType::reservation) {
+	logger->inc(idx + 2);
+      }
+    }
+
+  } // namespace mclock
+} // namespace ceph
@@ -0,0 +1,117 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2017 Red Hat Inc.
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_OSD_MCLOCKOPCLASSSUPPORT_H
+#define CEPH_OSD_MCLOCKOPCLASSSUPPORT_H
+
+#include <ostream>
+#include <string>
+
+#include <boost/optional.hpp>
+
+#include "dmclock/src/dmclock_server.h"
+#include "osd/PGQueueable.h"
+
+class CephContext;
+class PerfCounters;
+
+namespace ceph {
+  namespace mclock {
+
+    namespace dmc = crimson::dmclock;
+
+    /// the classes of work the mClock op queues schedule independently
+    enum class osd_op_type_t {
+      client_op, osd_subop, bg_snaptrim, bg_recovery, bg_scrub };
+
+    std::ostream& operator<<(std::ostream& out, const osd_op_type_t& t);
+
+    /// reservation/weight/limit per op class, from osd_op_queue_mclock_*
+    class OpClassClientInfoMgr {
+      dmc::ClientInfo client_op;
+      dmc::ClientInfo osd_subop;
+      dmc::ClientInfo snaptrim;
+      dmc::ClientInfo recov;
+      dmc::ClientInfo scrub;
+
+    public:
+
+      explicit OpClassClientInfoMgr(CephContext *cct);
+
+      const dmc::ClientInfo* get_client_info(osd_op_type_t type) const {
+	switch(type) {
+	case osd_op_type_t::client_op:
+	  return &client_op;
+	case osd_op_type_t::osd_subop:
+	  return &osd_subop;
+	case osd_op_type_t::bg_snaptrim:
+	  return &snaptrim;
+	case osd_op_type_t::bg_recovery:
+	  return &recov;
+	case osd_op_type_t::bg_scrub:
+	  return &scrub;
+	default:
+	  assert(0);
+	  return nullptr;
+	}
+      }
+
+      /// work out which class a queued item belongs to
+      static osd_op_type_t get_osd_op_type(
+	const std::pair<spg_t, PGQueueable>& request);
+    }; // OpClassClientInfoMgr
+
+    enum {
+      l_mclock_first = 72000,
+      l_mclock_client_op_queued,
+      l_mclock_client_op_dequeued,
+      l_mclock_client_op_res_dequeued,
+      l_mclock_osd_subop_queued,
+      l_mclock_osd_subop_dequeued,
+      l_mclock_osd_subop_res_dequeued,
+      l_mclock_snaptrim_queued,
+      l_mclock_snaptrim_dequeued,
+      l_mclock_snaptrim_res_dequeued,
+      l_mclock_recovery_queued,
+      l_mclock_recovery_dequeued,
+      l_mclock_recovery_res_dequeued,
+      l_mclock_scrub_queued,
+      l_mclock_scrub_dequeued,
+      l_mclock_scrub_res_dequeued,
+      l_mclock_last,
+    };
+
+    /// per op class perf counters of one mClock op queue
+    class OpClassPerfCounters {
+      CephContext *cct;
+      PerfCounters *logger = nullptr;
+
+      // index of the *_queued counter of each op class; dequeued and
+      // res_dequeued follow it
+      static int first_counter(osd_op_type_t type);
+
+    public:
+      OpClassPerfCounters(CephContext *cct, const std::string& name);
+      ~OpClassPerfCounters();
+
+      void queued(osd_op_type_t type);
+      void removed(osd_op_type_t type);
+      void dequeued(osd_op_type_t type,
+		    const boost::optional<dmc::PhaseType>& phase);
+    }; // OpClassPerfCounters
+
+  } // namespace mclock
+} // namespace ceph
+
+#endif
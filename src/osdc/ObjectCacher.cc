@@ -609,7 +609,7 @@ ObjectCacher::ObjectCacher(CephContext *cct_, string name,
   : perfcounter(NULL),
     cct(cct_), writeback_handler(wb), name(name), lock(l),
     max_dirty(max_dirty), target_dirty(target_dirty),
-    max_size(max_bytes), max_objects(max_objects),
+    max_size(max_bytes), max_objects(max_objects), max_readahead(0),
     max_dirty_age(ceph::make_timespan(max_dirty_age)),
     block_writes_upfront(block_writes_upfront),
     flush_set_callback(flush_callback),
@@ -668,6 +668,10 @@ void ObjectCacher::perf_start()
 		      "Write data blocked on dirty limit");
   plb.add_time(l_objectcacher_write_time_blocked, "write_time_blocked",
 	       "Time spent blocking a write due to dirty limits");
+  plb.add_u64_counter(l_objectcacher_readahead_ops, "readahead_ops",
+		      "Read ahead operations");
+  plb.add_u64_counter(l_objectcacher_readahead_bytes, "readahead_bytes",
+		      "Data read ahead");
 
   perfcounter = plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(perfcounter);
@@ -1292,7 +1296,138 @@ bool ObjectCacher::is_cached(ObjectSet *oset, vector<ObjectExtent>& extents,
  */
 int ObjectCacher::readx(OSDRead *rd, ObjectSet *oset, Context *onfinish)
 {
-  return _readx(rd, oset, onfinish, true);
+  vector<ObjectExtent> readahead;
+  snapid_t snap = rd->snap;
+  int op_flags = rd->fadvise_flags;
+  bool do_readahead = prepare_readahead(rd, oset, &readahead);
+
+  int r = _readx(rd, oset, onfinish, true);
+
+  // the read itself goes out first
+  if (do_readahead)
+    issue_readahead(oset, snap, op_flags, readahead);
+  return r;
+}
+
+/*
+ * Follow the sequential read stream of an object set and decide what
+ * to read ahead of it.  The window starts at one object and doubles
+ * each time the reader gets within half a window of what has been
+ * read ahead, up to max_readahead (and never more than half the
+ * cache).  Reads without a buffer are the caller's own readahead and
+ * are ignored.
+ */
+bool ObjectCacher::prepare_readahead(OSDRead *rd, ObjectSet *oset,
+				     vector<ObjectExtent> *extents)
+{
+  const file_layout_t &layout = oset->layout;
+  uint64_t object_size = layout.object_size;
+  if (!max_readahead || !rd->bl || rd->extents.empty() ||
+      object_size == 0 || layout.stripe_count != 1 ||
+      (oset->object_format.empty() && oset->ino == 0) ||
+      (rd->fadvise_flags & (LIBRADOS_OP_FLAG_FADVISE_RANDOM |
+			    LIBRADOS_OP_FLAG_FADVISE_DONTNEED |
+			    LIBRADOS_OP_FLAG_FADVISE_NOCACHE)))
+    return false;
+
+  // with one object per stripe the objects hold consecutive ranges
+  uint64_t start = UINT64_MAX, end = 0, len = 0;
+  for (vector<ObjectExtent>::iterator p = rd->extents.begin();
+       p != rd->extents.end();
+       ++p) {
+    uint64_t off = p->objectno * object_size + p->offset;
+    start = MIN(start, off);
+    end = MAX(end, off + p->length);
+    len += p->length;
+  }
+
+  // reads that land anywhere between the trailing edge of the window
+  // and what has been read ahead continue the stream; this tolerates
+  // requests that were issued in parallel and arrive out of order
+  uint64_t behind = MIN(oset->read_next, oset->readahead_window);
+  if (start < oset->read_next - behind ||
+      start > MAX(oset->read_next, oset->readahead_end)) {
+    ldout(cct, 20) << "readahead reset at " << start << "~" << (end - start)
+		   << ", expected " << oset->read_next << dendl;
+    oset->read_next = end;
+    oset->readahead_window = 0;
+    oset->readahead_end = 0;
+    return false;
+  }
+  oset->read_next = MAX(oset->read_next, end);
+
+  if (oset->readahead_end > oset->read_next + oset->readahead_window / 2)
+    return false;
+
+  uint64_t max_window = MIN(max_readahead, max_size / 2);
+  max_window -= max_window % object_size;
+  if (max_window == 0)
+    return false;
+  uint64_t window = oset->readahead_window ?
+    MIN(oset->readahead_window * 2, max_window) : object_size;
+
+  // whole objects, so that each one missing from the cache becomes a
+  // single read and all of them are in flight at once
+  uint64_t from = MAX(oset->read_next, oset->readahead_end);
+  uint64_t to = ROUND_UP_TO(oset->read_next + window, object_size);
+  if (oset->readahead_limit)
+    to = MIN(to, oset->readahead_limit);
+  if (to <= from)
+    return false;
+
+  // leave the cache to demand reads when it is busy
+  if (!waitfor_read.empty() ||
+      (uint64_t)stat_rx + len + (to - from) > max_size) {
+    ldout(cct, 20) << "readahead " << from << "~" << (to - from)
+		   << " deferred, " << stat_rx << " bytes in flight" << dendl;
+    return false;
+  }
+
+  if (oset->object_format.empty())
+    Striper::file_to_extents(cct, oset->ino, &layout, from, to - from,
+			     oset->truncate_size, *extents);
+  else
+    Striper::file_to_extents(cct, oset->object_format.c_str(), &layout,
+			     from, to - from, oset->truncate_size, *extents);
+  // use the locator of the read, the layout may not carry the namespace
+  for (vector<ObjectExtent>::iterator p = extents->begin();
+       p != extents->end();
+       ++p)
+    p->oloc = rd->extents.front().oloc;
+
+  ldout(cct, 10) << "readahead " << from << "~" << (to - from)
+		 << " window " << window << " after read " << start << "~"
+		 << (end - start) << dendl;
+  oset->readahead_window = window;
+  oset->readahead_end = to;
+  return true;
+}
+
+void ObjectCacher::issue_readahead(ObjectSet *oset, snapid_t snap,
+				   int op_flags,
+				   vector<ObjectExtent> &extents)
+{
+  assert(lock.is_locked());
+  uint64_t bytes = 0;
+  for (vector<ObjectExtent>::iterator ex_it = extents.begin();
+       ex_it != extents.end();
+       ++ex_it) {
+    sobject_t soid(ex_it->oid, snap);
+    Object *o = get_object(soid, ex_it->objectno, oset, ex_it->oloc,
+			   ex_it->truncate_size, oset->truncate_seq);
+    map<loff_t, BufferHead*> hits, missing, rx, errors;
+    o->map_read(*ex_it, hits, missing, rx, errors);
+    for (map<loff_t, BufferHead*>::iterator bh_it = missing.begin();
+	 bh_it != missing.end();
+	 ++bh_it) {
+      bh_read(bh_it->second, op_flags);
+      bytes += bh_it->second->length();
+    }
+  }
+  if (bytes) {
+    perfcounter->inc(l_objectcacher_readahead_ops);
+    perfcounter->inc(l_objectcacher_readahead_bytes, bytes);
+  }
 }
 
 int ObjectCacher::_readx(OSDRead *rd, ObjectSet *oset, Context *onfinish,
@@ -46,6 +46,9 @@ enum {
 				     // blocking a write due to dirty
 				     // limits
 
+  l_objectcacher_readahead_ops, // prefetches issued for sequential reads
+  l_objectcacher_readahead_bytes, // bytes prefetched
+
   l_objectcacher_last,
 };
 
@@ -382,10 +385,24 @@ class ObjectCacher {
     int dirty_or_tx;
     bool return_enoent;
 
+    // Sequential reads are read ahead if the owner describes how the
+    // set maps onto its file or image: objects are named by
+    // object_format (or by ino if that is empty) and laid out as
+    // layout says.  Only layouts with a stripe count of 1 qualify.
+    file_layout_t layout;
+    string object_format;
+    uint64_t readahead_limit;  ///< never read ahead past this (0: no limit)
+
+    // sequential read stream state
+    uint64_t read_next;        ///< where the next sequential read starts
+    uint64_t readahead_window;
+    uint64_t readahead_end;    ///< end of what has been read ahead
+
     ObjectSet(void *p, int64_t _poolid, inodeno_t i)
       : parent(p), ino(i), truncate_seq(0),
 	truncate_size(0), poolid(_poolid), dirty_or_tx(0),
-	return_enoent(false) {}
+	return_enoent(false), readahead_limit(0), read_next(0),
+	readahead_window(0), readahead_end(0) {}
 
   };
 
@@ -400,6 +417,7 @@ class ObjectCacher {
   Mutex& lock;
 
   uint64_t max_dirty, target_dirty, max_size, max_objects;
+  uint64_t max_readahead;
   ceph::timespan max_dirty_age;
   bool block_writes_upfront;
 
@@ -550,6 +568,11 @@ class ObjectCacher {
 	     bool external_call);
   void retry_waiting_reads();
 
+  bool prepare_readahead(OSDRead *rd, ObjectSet *oset,
+			 vector<ObjectExtent> *extents);
+  void issue_readahead(ObjectSet *oset, snapid_t snap, int op_flags,
+		       vector<ObjectExtent> &extents);
+
  public:
   void bh_read_finish(int64_t poolid, sobject_t oid, ceph_tid_t tid,
 		      loff_t offset, uint64_t length,
@@ -652,6 +675,9 @@ public:
   void set_max_objects(int64_t v) {
     max_objects = v;
   }
+  void set_max_readahead(uint64_t v) {
+    max_readahead = v;
+  }
 
 
   // file functions
@@ -671,6 +697,8 @@ public:
     OSDRead *rd = prepare_read(snapid, bl, flags);
     Striper::file_to_extents(cct, oset->ino, layout, offset, len,
 			     oset->truncate_size, rd->extents);
+    if (max_readahead)
+      oset->layout = *layout;
     return readx(rd, oset, onfinish);
   }
 
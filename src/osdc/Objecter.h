@@ -34,6 +34,7 @@
 #include "common/ceph_time.h"
 #include "common/ceph_timer.h"
 #include "common/Finisher.h"
+#include "common/sharded_shared_mutex.h"
 #include "common/shunique_lock.h"
 #include "common/zipkin_trace.h"
 
@@ -1202,7 +1203,9 @@ private:
   version_t last_seen_osdmap_version;
   version_t last_seen_pgmap_version;
 
-  mutable boost::shared_mutex rwlock;
+  // guards the osdmap, the session map and the op tables; every op
+  // submission and reply takes it shared, so it is sharded per thread
+  mutable ceph::sharded_shared_mutex rwlock;
   using lock_guard = std::unique_lock<decltype(rwlock)>;
   using unique_lock = std::unique_lock<decltype(rwlock)>;
   using shared_lock = boost::shared_lock<decltype(rwlock)>;
@@ -1909,7 +1912,7 @@ public:
   }
 
 private:
-  void _check_op_pool_dne(Op *op, unique_lock *sl);
+  void _check_op_pool_dne(Op *op, OSDSession::unique_lock *sl);
   void _send_op_map_check(Op *op);
   void _op_cancel_map_check(Op *op);
   void _check_linger_pool_dne(LingerOp *op, bool *need_unregister);
@@ -4,6 +4,7 @@
 #define RGW_ASIO_CLIENT_H
 
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/spawn.hpp>
 #include <beast/http/message.hpp>
 #include <beast/http/message_parser.hpp>
 #include <beast/core/flat_streambuf.hpp>
@@ -56,6 +57,7 @@ class ClientIO : public io::RestfulClient,
   tcp::socket& socket;
   parser_type& parser;
   beast::flat_streambuf& buffer; //< parse buffer
+  boost::asio::yield_context yield; //< socket i/o suspends the connection
 
   bool conn_keepalive{false};
   bool conn_close{false};
@@ -68,7 +70,7 @@ class ClientIO : public io::RestfulClient,
 
  public:
   ClientIO(tcp::socket& socket, parser_type& parser,
-           beast::flat_streambuf& buffer);
+           beast::flat_streambuf& buffer, boost::asio::yield_context yield);
   ~ClientIO() override;
 
   bool get_conn_close() const { return conn_close; }
@@ -71,6 +71,7 @@ using tcp = boost::asio::ip::tcp;
 
 // coroutine to handle a client connection to completion
 static void handle_connection(RGWProcessEnv& env, tcp::socket socket,
+                              boost::asio::io_service& service,
                               boost::asio::yield_context yield)
 {
   auto cct = env.store->ctx();
@@ -108,7 +109,7 @@ static void handle_connection(RGWProcessEnv& env, tcp::socket socket,
     // process the request
     RGWRequest req{env.store->get_new_req_id()};
 
-    rgw::asio::ClientIO real_client{socket, parser, buffer};
+    rgw::asio::ClientIO real_client{socket, parser, buffer, yield};
 
     auto real_client_io = rgw::io::add_reordering(
                             rgw::io::add_buffering(
@@ -116,8 +117,11 @@ static void handle_connection(RGWProcessEnv& env, tcp::socket socket,
                                 rgw::io::add_conlen_controlling(
                                   &real_client))));
     RGWRestfulIO client(&real_client_io);
+    // rados i/o for the request suspends this coroutine instead of
+    // blocking the thread
     process_request(env.store, env.rest, &req, env.uri_prefix,
-                    *env.auth_registry, &client, env.olog);
+                    *env.auth_registry, &client, env.olog,
+                    optional_yield{service, yield});
 
     if (real_client.get_conn_close()) {
       return;
@@ -191,7 +195,7 @@ void AsioFrontend::accept(boost::system::error_code ec)
   // spawn a coroutine to handle the connection
   boost::asio::spawn(service,
                      [&] (boost::asio::yield_context yield) {
-                       handle_connection(env, std::move(socket), yield);
+                       handle_connection(env, std::move(socket), service, yield);
                      });
   acceptor.async_accept(peer_socket,
                         [this] (boost::system::error_code ec) {
@@ -0,0 +1,217 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <algorithm>
+
+#include "include/ceph_hash.h"
+
+#include "rgw_bucket_list.h"
+#include "rgw_multi.h"
+#include "rgw_rados.h"
+
+uint32_t rgw_bucket_shard_index(const string& key, uint32_t num_shards)
+{
+  uint32_t sid = ceph_str_hash_linux(key.c_str(), key.size());
+  uint32_t sid2 = sid ^ ((sid & 0xFF) << 24);
+  return sid2 % MAX_BUCKET_INDEX_SHARDS_PRIME % num_shards;
+}
+
+bool rgw_bucket_list_hash_key(const string& index_name, string *key)
+{
+  static MultipartMetaFilter multipart_meta_filter;
+
+  string name = index_name;
+  string meta_key;
+  if (multipart_meta_filter.filter(name, meta_key)) {
+    name = meta_key;
+  }
+  rgw_obj_key obj_key;
+  if (!rgw_obj_key::parse_raw_oid(name, &obj_key)) {
+    return false;
+  }
+  *key = obj_key.name;
+  return true;
+}
+
+/*
+ * Per-shard state of an ordered listing: the entries fetched from the shard
+ * that have not been merged yet, and where to continue reading from.
+ */
+struct rgw_bucket_list_cursor {
+  map<string, rgw_bucket_dir_entry> entries;
+  map<string, rgw_bucket_dir_entry>::iterator pos;
+  cls_rgw_obj_key marker;   // last index key fetched from the shard
+  uint32_t batch{0};        // number of entries to ask for on the next fetch
+  bool truncated{true};     // the shard has entries past marker
+
+  rgw_bucket_list_cursor() : pos(entries.end()) {}
+  bool drained() const { return pos == entries.end(); }
+};
+
+int rgw_bucket_list_merge(const set<int>& shards, const cls_rgw_obj_key& start,
+                          uint32_t num_entries, uint32_t min_shard_batch,
+                          const RGWBucketListShardsFn& list_shards,
+                          const RGWBucketListCheckFn& check,
+                          map<string, rgw_bucket_dir_entry>& m,
+                          bool *is_truncated)
+{
+  /* The entries of the page are spread over all the shards, so rather than
+   * asking every shard for the whole page, ask each one for its share plus
+   * some slack.  A shard that runs out of fetched entries before the page is
+   * full is read again from where it stopped, with a batch twice as big. */
+  uint32_t batch = num_entries;
+  if (shards.size() > 1) {
+    batch = std::max<uint32_t>(min_shard_batch, num_entries * 2 / shards.size() + 1);
+    batch = std::min(batch, num_entries);
+  }
+
+  map<int, rgw_bucket_list_cursor> cursors;
+  for (auto shard : shards) {
+    rgw_bucket_list_cursor& cursor = cursors[shard];
+    cursor.marker = start;
+    cursor.batch = batch;
+  }
+
+  // Track the next candidate entry from each shard, if the entry from a
+  // specified shard is selected/erased, the next entry from that shard will
+  // be inserted for next round selection
+  map<string, int> candidates;
+
+  // shards that need to be read before the next entry can be selected
+  set<int> refill = shards;
+
+  uint32_t count = 0;
+  while (count < num_entries) {
+    if (!refill.empty()) {
+      map<int, cls_rgw_obj_key> starts;
+      map<int, uint32_t> nums;
+      map<int, rgw_cls_list_ret> list_results;
+      for (auto shard : refill) {
+        rgw_bucket_list_cursor& cursor = cursors[shard];
+        starts[shard] = cursor.marker;
+        nums[shard] = cursor.batch;
+      }
+      int r = list_shards(starts, nums, list_results);
+      if (r < 0)
+        return r;
+
+      for (auto& result : list_results) {
+        rgw_bucket_list_cursor& cursor = cursors[result.first];
+        cursor.entries = std::move(result.second.dir.m);
+        cursor.pos = cursor.entries.begin();
+        cursor.truncated = result.second.is_truncated;
+        if (!cursor.drained()) {
+          // index keys are passed back verbatim, so the next read of this
+          // shard starts right after the last entry we got
+          cursor.marker = cls_rgw_obj_key(cursor.entries.rbegin()->first);
+          candidates[cursor.pos->first] = result.first;
+        } else {
+          cursor.truncated = false;
+        }
+        cursor.batch = std::min(cursor.batch * 2, num_entries);
+      }
+      refill.clear();
+    }
+
+    if (candidates.empty())
+      break;
+
+    // Select the next one
+    int pos = candidates.begin()->second;
+    rgw_bucket_list_cursor& cursor = cursors[pos];
+    const string& name = cursor.pos->first;
+    rgw_bucket_dir_entry& dirent = cursor.pos->second;
+
+    int r = check(pos, dirent);
+    if (r < 0 && r != -ENOENT) {
+      return r;
+    }
+    if (r >= 0) {
+      m[name] = std::move(dirent);
+      ++count;
+    }
+
+    // Refresh the candidates map
+    candidates.erase(candidates.begin());
+    ++cursor.pos;
+    if (!cursor.drained()) {
+      candidates[cursor.pos->first] = pos;
+    } else if (cursor.truncated) {
+      // the next entry may sort before every other candidate
+      refill.insert(pos);
+    }
+  }
+
+  // Check if all the returned entries are consumed or not
+  *is_truncated = false;
+  for (auto& cursor : cursors) {
+    if (!cursor.second.drained() || cursor.second.truncated) {
+      *is_truncated = true;
+      break;
+    }
+  }
+
+  return 0;
+}
+
+int rgw_bucket_list_unordered(const set<int>& shards, int start_shard,
+                              const cls_rgw_obj_key& start, const cls_rgw_obj_key& end,
+                              uint32_t num_entries,
+                              const RGWBucketListShardsFn& list_shards,
+                              const RGWBucketListCheckFn& check,
+                              vector<rgw_bucket_dir_entry>& ent_list,
+                              bool *is_truncated, cls_rgw_obj_key *last_entry)
+{
+  ent_list.clear();
+
+  cls_rgw_obj_key marker = start;
+  cls_rgw_obj_key last_processed;
+  uint32_t count = 0;
+  auto iter = shards.find(start_shard);
+  while (iter != shards.end() && count < num_entries) {
+    map<int, cls_rgw_obj_key> starts;
+    map<int, uint32_t> nums;
+    map<int, rgw_cls_list_ret> list_results;
+    starts[*iter] = marker;
+    nums[*iter] = num_entries - count;
+    int r = list_shards(starts, nums, list_results);
+    if (r < 0)
+      return r;
+
+    rgw_cls_list_ret& result = list_results[*iter];
+    for (auto& ent : result.dir.m) {
+      rgw_bucket_dir_entry& dirent = ent.second;
+      marker = dirent.key;
+      last_processed = dirent.key;
+
+      /* entries are not sorted across shards, so the ones past the end
+       * marker are skipped rather than ending the listing */
+      if (!end.name.empty() && end <= dirent.key) {
+        continue;
+      }
+
+      r = check(*iter, dirent);
+      if (r < 0 && r != -ENOENT) {
+        return r;
+      }
+      if (r >= 0) {
+        ent_list.emplace_back(std::move(dirent));
+        ++count;
+      }
+    }
+
+    if (!result.is_truncated || result.dir.m.empty()) {
+      // this shard is done, the next one is read from its beginning
+      ++iter;
+      marker = cls_rgw_obj_key();
+    }
+  }
+
+  *is_truncated = (iter != shards.end());
+  // skipped entries count as read, so that the next call does not go over
+  // them again
+  if (!last_processed.empty())
+    *last_entry = last_processed;
+
+  return 0;
+}
@@ -0,0 +1,73 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef RGW_BUCKET_LIST_H
+#define RGW_BUCKET_LIST_H
+
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "cls/rgw/cls_rgw_ops.h"
+
+/*
+ * The parts of a bucket listing that do not need a cluster: how the entries
+ * of the bucket index shards are read and put together.  RGWRados supplies
+ * the shard reads and the entry checks.
+ */
+
+/**
+ * Read the entries of a set of bucket index shards.  Each shard in starts is
+ * read from its own start key, for up to the matching number in nums
+ * entries, and its result is stored in results under the same shard id.
+ */
+typedef std::function<int(const std::map<int, cls_rgw_obj_key>& starts,
+                          const std::map<int, uint32_t>& nums,
+                          std::map<int, rgw_cls_list_ret>& results)> RGWBucketListShardsFn;
+
+/**
+ * Called for every entry before it is returned.  -ENOENT leaves the entry
+ * out, any other error ends the listing.
+ */
+typedef std::function<int(int shard, rgw_bucket_dir_entry& dirent)> RGWBucketListCheckFn;
+
+/// the index shard that holds the entry for an object hashed by key
+uint32_t rgw_bucket_shard_index(const std::string& key, uint32_t num_shards);
+
+/**
+ * Find the key an index entry is hashed by.  Multipart meta objects are
+ * indexed on the shard of the object they upload.
+ * Returns false if the entry name can not be parsed.
+ */
+bool rgw_bucket_list_hash_key(const std::string& index_name, std::string *key);
+
+/**
+ * Merge up to num_entries entries after start from all the shards, in key
+ * order.  Each shard is first read for its share of the page, but at least
+ * min_shard_batch entries; a shard that runs dry while it still has entries
+ * is read again with a batch twice as big.
+ */
+int rgw_bucket_list_merge(const std::set<int>& shards, const cls_rgw_obj_key& start,
+                          uint32_t num_entries, uint32_t min_shard_batch,
+                          const RGWBucketListShardsFn& list_shards,
+                          const RGWBucketListCheckFn& check,
+                          std::map<std::string, rgw_bucket_dir_entry>& m,
+                          bool *is_truncated);
+
+/**
+ * Read up to num_entries entries, going through the shards one after the
+ * other from start_shard on, and within start_shard from after start.
+ * Entries at or past end (if not empty) are left out.  last_entry is set to
+ * the last entry read, whether it was returned or not.
+ */
+int rgw_bucket_list_unordered(const std::set<int>& shards, int start_shard,
+                              const cls_rgw_obj_key& start, const cls_rgw_obj_key& end,
+                              uint32_t num_entries,
+                              const RGWBucketListShardsFn& list_shards,
+                              const RGWBucketListCheckFn& check,
+                              std::vector<rgw_bucket_dir_entry>& ent_list,
+                              bool *is_truncated, cls_rgw_obj_key *last_entry);
+
+#endif
@@ -4,55 +4,103 @@
 #include "rgw_cache.h"
 
 #include <errno.h>
+#include <set>
+
+#include "common/ceph_hash.h"
 
 #define dout_subsys ceph_subsys_rgw
 
 using namespace std;
 
+ObjectCache::~ObjectCache()
+{
+  for (auto& shard : shards) {
+    if (shard->logger) {
+      cct->get_perfcounters_collection()->remove(shard->logger);
+      delete shard->logger;
+    }
+  }
+}
+
+void ObjectCache::set_ctx(CephContext *_cct)
+{
+  cct = _cct;
+
+  int num_shards = max(cct->_conf->rgw_cache_shards, 1);
+  shard_max_entries = max(cct->_conf->rgw_cache_lru_size / num_shards, 1);
+
+  for (int i = 0; i < num_shards; i++) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "rgw_cache_shard_%d", i);
+    ObjectCacheShard *shard = new ObjectCacheShard(buf);
+
+    PerfCountersBuilder plb(cct, buf, l_rgw_cache_shard_first, l_rgw_cache_shard_last);
+    plb.add_u64_counter(l_rgw_cache_shard_hit, "hit", "Cache hits");
+    plb.add_u64_counter(l_rgw_cache_shard_miss, "miss", "Cache misses");
+    plb.add_u64_counter(l_rgw_cache_shard_evict, "evict", "Entries evicted to make room");
+    plb.add_u64(l_rgw_cache_shard_entries, "entries", "Cached entries");
+    shard->logger = plb.create_perf_counters();
+    cct->get_perfcounters_collection()->add(shard->logger);
+
+    shards.emplace_back(shard);
+  }
+}
+
+ObjectCacheShard& ObjectCache::get_shard(const string& name)
+{
+  uint32_t i = ceph_str_hash_linux(name.c_str(), name.size()) % shards.size();
+  return *shards[i];
+}
+
+void ObjectCache::lock_all()
+{
+  for (auto& shard : shards) {
+    shard->lock.get_write();
+  }
+}
+
+void ObjectCache::unlock_all()
+{
+  for (auto& shard : shards) {
+    shard->lock.unlock();
+  }
+}
+
 int ObjectCache::get(string& name, ObjectCacheInfo& info, uint32_t mask, rgw_cache_entry_info *cache_info)
 {
-  RWLock::RLocker l(lock);
+  if (shards.empty()) {
+    return -ENOENT;
+  }
+
+  ObjectCacheShard& shard = get_shard(name);
+  RWLock::RLocker l(shard.lock);
 
   if (!enabled) {
     return -ENOENT;
   }
 
-  map<string, ObjectCacheEntry>::iterator iter = cache_map.find(name);
-  if (iter == cache_map.end()) {
+  map<string, ObjectCacheEntry>::iterator iter = shard.cache_map.find(name);
+  if (iter == shard.cache_map.end()) {
     ldout(cct, 10) << "cache get: name=" << name << " : miss" << dendl;
     if(perfcounter) perfcounter->inc(l_rgw_cache_miss);
+    shard.logger->inc(l_rgw_cache_shard_miss);
     return -ENOENT;
   }
 
   ObjectCacheEntry *entry = &iter->second;
 
-  if (lru_counter - entry->lru_promotion_ts > lru_window) {
-    ldout(cct, 20) << "cache get: touching lru, lru_counter=" << lru_counter
-                   << " promotion_ts=" << entry->lru_promotion_ts << dendl;
-    lock.unlock();
-    lock.get_write(); /* promote lock to writer */
-
-    /* need to redo this because entry might have dropped off the cache */
-    iter = cache_map.find(name);
-    if (iter == cache_map.end()) {
-      ldout(cct, 10) << "lost race! cache get: name=" << name << " : miss" << dendl;
-      if(perfcounter) perfcounter->inc(l_rgw_cache_miss);
-      return -ENOENT;
-    }
-
-    entry = &iter->second;
-    /* check again, we might have lost a race here */
-    if (lru_counter - entry->lru_promotion_ts > lru_window) {
-      touch_lru(name, *entry, iter->second.lru_iter);
-    }
+  /* don't dirty the cache line if the bit is already set */
+  if (!entry->referenced.load(std::memory_order_relaxed)) {
+    entry->referenced.store(true, std::memory_order_relaxed);
   }
 
-  ObjectCacheInfo& src = iter->second.info;
+  ObjectCacheInfo& src = entry->info;
   if ((src.flags & mask) != mask) {
     ldout(cct, 10) << "cache get: name=" << name << " : type miss (requested=0x"
                    << std::hex << mask << ", cached=0x" << src.flags
                    << std::dec << ")" << dendl;
     if(perfcounter) perfcounter->inc(l_rgw_cache_miss);
+    shard.logger->inc(l_rgw_cache_shard_miss);
     return -ENOENT;
   }
   ldout(cct, 10) << "cache get: name=" << name << " : hit (requested=0x"
@@ -65,60 +113,84 @@ int ObjectCache::get(string& name, ObjectCacheInfo& info, uint32_t mask, rgw_cac
     cache_info->gen = entry->gen;
   }
   if(perfcounter) perfcounter->inc(l_rgw_cache_hit);
+  shard.logger->inc(l_rgw_cache_shard_hit);
 
   return 0;
 }
 
 bool ObjectCache::chain_cache_entry(list<rgw_cache_entry_info *>& cache_info_entries, RGWChainedCache::Entry *chained_entry)
 {
-  RWLock::WLocker l(lock);
-
-  if (!enabled) {
+  if (shards.empty()) {
     return false;
   }
 
+  /* the entries may live in different shards; take their locks in shard order */
+  std::set<uint32_t> locked;
+  for (auto cache_info : cache_info_entries) {
+    const string& name = cache_info->cache_locator;
+    locked.insert(ceph_str_hash_linux(name.c_str(), name.size()) % shards.size());
+  }
+  for (auto i : locked) {
+    shards[i]->lock.get_write();
+  }
+
+  bool ret = enabled;
+
   list<rgw_cache_entry_info *>::iterator citer;
 
   list<ObjectCacheEntry *> cache_entry_list;
 
   /* first verify that all entries are still valid */
-  for (citer = cache_info_entries.begin(); citer != cache_info_entries.end(); ++citer) {
+  for (citer = cache_info_entries.begin(); ret && citer != cache_info_entries.end(); ++citer) {
     rgw_cache_entry_info *cache_info = *citer;
 
     ldout(cct, 10) << "chain_cache_entry: cache_locator=" << cache_info->cache_locator << dendl;
-    map<string, ObjectCacheEntry>::iterator iter = cache_map.find(cache_info->cache_locator);
-    if (iter == cache_map.end()) {
+    ObjectCacheShard& shard = get_shard(cache_info->cache_locator);
+    map<string, ObjectCacheEntry>::iterator iter = shard.cache_map.find(cache_info->cache_locator);
+    if (iter == shard.cache_map.end()) {
       ldout(cct, 20) << "chain_cache_entry: couldn't find cache locator" << dendl;
-      return false;
+      ret = false;
+      break;
     }
 
     ObjectCacheEntry *entry = &iter->second;
 
     if (entry->gen != cache_info->gen) {
       ldout(cct, 20) << "chain_cache_entry: entry.gen (" << entry->gen << ") != cache_info.gen (" << cache_info->gen << ")" << dendl;
-      return false;
+      ret = false;
+      break;
     }
 
     cache_entry_list.push_back(entry);
   }
 
+  if (ret) {
+    chained_entry->cache->chain_cb(chained_entry->key, chained_entry->data);
 
-  chained_entry->cache->chain_cb(chained_entry->key, chained_entry->data);
+    list<ObjectCacheEntry *>::iterator liter;
 
-  list<ObjectCacheEntry *>::iterator liter;
+    for (liter = cache_entry_list.begin(); liter != cache_entry_list.end(); ++liter) {
+      ObjectCacheEntry *entry = *liter;
 
-  for (liter = cache_entry_list.begin(); liter != cache_entry_list.end(); ++liter) {
-    ObjectCacheEntry *entry = *liter;
+      entry->chained_entries.push_back(make_pair(chained_entry->cache, chained_entry->key));
+    }
+  }
 
-    entry->chained_entries.push_back(make_pair(chained_entry->cache, chained_entry->key));
+  for (auto i : locked) {
+    shards[i]->lock.unlock();
   }
 
-  return true;
+  return ret;
 }
 
 void ObjectCache::put(string& name, ObjectCacheInfo& info, rgw_cache_entry_info *cache_info)
 {
-  RWLock::WLocker l(lock);
+  if (shards.empty()) {
+    return;
+  }
+
+  ObjectCacheShard& shard = get_shard(name);
+  RWLock::WLocker l(shard.lock);
 
   if (!enabled) {
     return;
@@ -126,14 +198,7 @@ void ObjectCache::put(string& name, ObjectCacheInfo& info, rgw_cache_entry_info
 
   ldout(cct, 10) << "cache put: name=" << name << " info.flags=0x"
                  << std::hex << info.flags << std::dec << dendl;
-  map<string, ObjectCacheEntry>::iterator iter = cache_map.find(name);
-  if (iter == cache_map.end()) {
-    ObjectCacheEntry entry;
-    entry.lru_iter = lru.end();
-    cache_map.insert(pair<string, ObjectCacheEntry>(name, entry));
-    iter = cache_map.find(name);
-  }
-  ObjectCacheEntry& entry = iter->second;
+  ObjectCacheEntry& entry = shard.cache_map[name];
   ObjectCacheInfo& target = entry.info;
 
   for (list<pair<RGWChainedCache *, string> >::iterator iiter = entry.chained_entries.begin();
@@ -144,8 +209,9 @@ void ObjectCache::put(string& name, ObjectCacheInfo& info, rgw_cache_entry_info
 
   entry.chained_entries.clear();
   entry.gen++;
+  entry.referenced = true;
 
-  touch_lru(name, entry, entry.lru_iter);
+  trim(shard, name);
 
   target.status = info.status;
 
@@ -195,14 +261,19 @@ void ObjectCache::put(string& name, ObjectCacheInfo& info, rgw_cache_entry_info
 
 void ObjectCache::remove(string& name)
 {
-  RWLock::WLocker l(lock);
+  if (shards.empty()) {
+    return;
+  }
+
+  ObjectCacheShard& shard = get_shard(name);
+  RWLock::WLocker l(shard.lock);
 
   if (!enabled) {
     return;
   }
 
-  map<string, ObjectCacheEntry>::iterator iter = cache_map.find(name);
-  if (iter == cache_map.end())
+  map<string, ObjectCacheEntry>::iterator iter = shard.cache_map.find(name);
+  if (iter == shard.cache_map.end())
     return;
 
   ldout(cct, 10) << "removing " << name << " from cache" << dendl;
@@ -214,90 +285,83 @@ void ObjectCache::remove(string& name)
     chained_cache->invalidate(iiter->second);
   }
 
-  remove_lru(name, iter->second.lru_iter);
-  cache_map.erase(iter);
+  shard.cache_map.erase(iter);
+  shard.logger->set(l_rgw_cache_shard_entries, shard.cache_map.size());
 }
 
-void ObjectCache::touch_lru(string& name, ObjectCacheEntry& entry, std::list<string>::iterator& lru_iter)
+/*
+ * Called with the shard write-locked.  Advances the CLOCK hand, clearing
+ * reference bits, until the shard is back under its size; 'keep' is the
+ * entry being put and is never evicted.
+ */
+void ObjectCache::trim(ObjectCacheShard& shard, const string& keep)
 {
-  while (lru_size > (size_t)cct->_conf->rgw_cache_lru_size) {
-    list<string>::iterator iter = lru.begin();
-    if ((*iter).compare(name) == 0) {
-      /*
-       * if the entry we're touching happens to be at the lru end, don't remove it,
-       * lru shrinking can wait for next time
-       */
-      break;
+  map<string, ObjectCacheEntry>& cache_map = shard.cache_map;
+  map<string, ObjectCacheEntry>::iterator iter = cache_map.lower_bound(shard.clock_hand);
+
+  while (cache_map.size() > shard_max_entries) {
+    if (iter == cache_map.end()) {
+      iter = cache_map.begin();
+    }
+    if (iter->first == keep) {
+      ++iter;
+      continue;
+    }
+    if (iter->second.referenced) {
+      iter->second.referenced = false;
+      ++iter;
+      continue;
     }
-    map<string, ObjectCacheEntry>::iterator map_iter = cache_map.find(*iter);
-    ldout(cct, 10) << "removing entry: name=" << *iter << " from cache LRU" << dendl;
-    if (map_iter != cache_map.end())
-      cache_map.erase(map_iter);
-    lru.pop_front();
-    lru_size--;
+    ldout(cct, 10) << "removing entry: name=" << iter->first << " from cache LRU" << dendl;
+    iter = cache_map.erase(iter);
+    shard.logger->inc(l_rgw_cache_shard_evict);
   }
 
-  if (lru_iter == lru.end()) {
-    lru.push_back(name);
-    lru_size++;
-    lru_iter--;
-    ldout(cct, 10) << "adding " << name << " to cache LRU end" << dendl;
+  if (iter == cache_map.end()) {
+    shard.clock_hand.clear();
   } else {
-    ldout(cct, 10) << "moving " << name << " to cache LRU end" << dendl;
-    lru.erase(lru_iter);
-    lru.push_back(name);
-    lru_iter = lru.end();
-    --lru_iter;
+    shard.clock_hand = iter->first;
   }
-
-  lru_counter++;
-  entry.lru_promotion_ts = lru_counter;
-}
-
-void ObjectCache::remove_lru(string& name, std::list<string>::iterator& lru_iter)
-{
-  if (lru_iter == lru.end())
-    return;
-
-  lru.erase(lru_iter);
-  lru_size--;
-  lru_iter = lru.end();
+  shard.logger->set(l_rgw_cache_shard_entries, cache_map.size());
 }
 
 void ObjectCache::set_enabled(bool status)
 {
-  RWLock::WLocker l(lock);
+  lock_all();
 
   enabled = status;
 
   if (!enabled) {
     do_invalidate_all();
   }
+
+  unlock_all();
 }
 
 void ObjectCache::invalidate_all()
 {
-  RWLock::WLocker l(lock);
+  lock_all();
 
   do_invalidate_all();
+
+  unlock_all();
 }
 
 void ObjectCache::do_invalidate_all()
 {
-  cache_map.clear();
-  lru.clear();
-
-  lru_size = 0;
-  lru_counter = 0;
-  lru_window = 0;
+  for (auto& shard : shards) {
+    shard->cache_map.clear();
+    shard->clock_hand.clear();
+    shard->logger->set(l_rgw_cache_shard_entries, 0);
+  }
 
+  RWLock::RLocker l(chained_lock);
   for (list<RGWChainedCache *>::iterator iter = chained_cache.begin(); iter != chained_cache.end(); ++iter) {
     (*iter)->invalidate_all();
   }
 }
 
 void ObjectCache::chain_cache(RGWChainedCache *cache) {
-  RWLock::WLocker l(lock);
+  RWLock::WLocker l(chained_lock);
   chained_cache.push_back(cache);
 }
-
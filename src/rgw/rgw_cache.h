@@ -7,10 +7,14 @@
 #include "rgw_rados.h"
 #include <string>
 #include <map>
+#include <atomic>
+#include <memory>
+#include <vector>
 #include "include/types.h"
 #include "include/utime.h"
 #include "include/assert.h"
 #include "common/RWLock.h"
+#include "common/perf_counters.h"
 
 enum {
   UPDATE_OBJ,
@@ -126,40 +130,62 @@ WRITE_CLASS_ENCODER(RGWCacheNotifyInfo)
 
 struct ObjectCacheEntry {
   ObjectCacheInfo info;
-  std::list<string>::iterator lru_iter;
-  uint64_t lru_promotion_ts;
+  std::atomic<bool> referenced; /* CLOCK reference bit, set on every hit */
   uint64_t gen;
   std::list<pair<RGWChainedCache *, string> > chained_entries;
 
-  ObjectCacheEntry() : lru_promotion_ts(0), gen(0) {}
+  ObjectCacheEntry() : referenced(false), gen(0) {}
 };
 
-class ObjectCache {
-  std::map<string, ObjectCacheEntry> cache_map;
-  std::list<string> lru;
-  unsigned long lru_size;
-  unsigned long lru_counter;
-  unsigned long lru_window;
+enum {
+  l_rgw_cache_shard_first = 15200,
+
+  l_rgw_cache_shard_hit,
+  l_rgw_cache_shard_miss,
+  l_rgw_cache_shard_evict,
+  l_rgw_cache_shard_entries,
+
+  l_rgw_cache_shard_last,
+};
+
+/*
+ * One lock stripe of the ObjectCache.  Hits only take the read lock and set
+ * the entry's reference bit; eviction runs a CLOCK hand over the (sorted)
+ * map under the write lock, skipping entries referenced since its last pass.
+ */
+struct ObjectCacheShard {
   RWLock lock;
+  std::map<string, ObjectCacheEntry> cache_map;
+  string clock_hand; /* key the next eviction scan resumes from */
+  PerfCounters *logger;
+
+  explicit ObjectCacheShard(const string& name) : lock(name), logger(NULL) {}
+};
+
+class ObjectCache {
+  std::vector<std::unique_ptr<ObjectCacheShard>> shards;
+  size_t shard_max_entries;
   CephContext *cct;
 
+  RWLock chained_lock;
   list<RGWChainedCache *> chained_cache;
 
+  /* written with every shard lock held, so any one of them is enough to read it */
   bool enabled;
 
-  void touch_lru(string& name, ObjectCacheEntry& entry, std::list<string>::iterator& lru_iter);
-  void remove_lru(string& name, std::list<string>::iterator& lru_iter);
+  ObjectCacheShard& get_shard(const string& name);
+  void trim(ObjectCacheShard& shard, const string& keep);
 
+  void lock_all();
+  void unlock_all();
   void do_invalidate_all();
 public:
-  ObjectCache() : lru_size(0), lru_counter(0), lru_window(0), lock("ObjectCache"), cct(NULL), enabled(false) { }
+  ObjectCache() : shard_max_entries(0), cct(NULL), chained_lock("ObjectCache::chained_lock"), enabled(false) { }
+  ~ObjectCache();
   int get(std::string& name, ObjectCacheInfo& bl, uint32_t mask, rgw_cache_entry_info *cache_info);
   void put(std::string& name, ObjectCacheInfo& bl, rgw_cache_entry_info *cache_info);
   void remove(std::string& name);
-  void set_ctx(CephContext *_cct) {
-    cct = _cct;
-    lru_window = cct->_conf->rgw_cache_lru_size / 2;
-  }
+  void set_ctx(CephContext *_cct);
   bool chain_cache_entry(list<rgw_cache_entry_info *>& cache_info_entries, RGWChainedCache::Entry *chained_entry);
 
   void set_enabled(bool status);
@@ -240,7 +266,8 @@ public:
                      rgw_cache_entry_info *cache_info) override;
 
   int raw_obj_stat(rgw_raw_obj& obj, uint64_t *psize, real_time *pmtime, uint64_t *epoch, map<string, bufferlist> *attrs,
-                   bufferlist *first_chunk, RGWObjVersionTracker *objv_tracker) override;
+                   bufferlist *first_chunk, RGWObjVersionTracker *objv_tracker,
+                   optional_yield y = null_yield) override;
 
   int delete_system_obj(rgw_raw_obj& obj, RGWObjVersionTracker *objv_tracker) override;
 
@@ -455,7 +482,8 @@ int RGWCache<T>::put_system_obj_data(void *ctx, rgw_raw_obj& obj, bufferlist& da
 template <class T>
 int RGWCache<T>::raw_obj_stat(rgw_raw_obj& obj, uint64_t *psize, real_time *pmtime,
                           uint64_t *pepoch, map<string, bufferlist> *attrs,
-                          bufferlist *first_chunk, RGWObjVersionTracker *objv_tracker)
+                          bufferlist *first_chunk, RGWObjVersionTracker *objv_tracker,
+                          optional_yield y)
 {
   rgw_pool pool;
   string oid;
@@ -483,7 +511,7 @@ int RGWCache<T>::raw_obj_stat(rgw_raw_obj& obj, uint64_t *psize, real_time *pmti
       objv_tracker->read_version = info.version;
     goto done;
   }
-  r = T::raw_obj_stat(obj, &size, &mtime, &epoch, &info.xattrs, first_chunk, objv_tracker);
+  r = T::raw_obj_stat(obj, &size, &mtime, &epoch, &info.xattrs, first_chunk, objv_tracker, y);
   if (r < 0) {
     if (r == -ENOENT) {
       info.status = r;
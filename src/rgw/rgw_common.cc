@@ -64,6 +64,17 @@ int rgw_perf_start(CephContext *cct)
   plb.add_u64_counter(l_rgw_keystone_token_cache_hit, "keystone_token_cache_hit", "Keystone token cache hits");
   plb.add_u64_counter(l_rgw_keystone_token_cache_miss, "keystone_token_cache_miss", "Keystone token cache miss");
 
+  plb.add_u64(l_rgw_gc_shards_pending, "gc_shards_pending", "GC shards waiting for a worker in the current round");
+  plb.add_u64(l_rgw_gc_shards_behind, "gc_shards_behind", "GC shards left with expired entries when their time ran out");
+  plb.add_u64(l_rgw_gc_inflight_io, "gc_inflight_io", "GC tail object deletes in flight");
+  plb.add_u64_counter(l_rgw_gc_remove_obj, "gc_remove_obj", "Tail objects removed by GC");
+  plb.add_u64_counter(l_rgw_gc_remove_tag, "gc_remove_tag", "GC entries retired");
+
+  plb.add_u64(l_rgw_lc_shards_pending, "lc_shards_pending", "LC shards waiting for a worker in the current round");
+  plb.add_u64_counter(l_rgw_lc_remove_obj, "lc_remove_obj", "Objects expired by LC");
+  plb.add_u64_counter(l_rgw_lc_abort_mp, "lc_abort_mp", "Multipart uploads aborted by LC");
+  plb.add_u64_counter(l_rgw_lc_bucket_done, "lc_bucket_done", "Buckets processed by LC");
+
   perfcounter = plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(perfcounter);
   return 0;
@@ -197,6 +197,7 @@ using ceph::crypto::MD5;
 #define ERR_MALFORMED_DOC        2204
 #define ERR_NO_ROLE_FOUND        2205
 #define ERR_DELETE_CONFLICT      2206
+#define ERR_BUSY_RESHARDING      2300 /* == CLS_RGW_ERR_BUSY_RESHARDING */
 
 #ifndef UINT32_MAX
 #define UINT32_MAX (0xffffffffu)
@@ -234,6 +235,17 @@ enum {
   l_rgw_keystone_token_cache_hit,
   l_rgw_keystone_token_cache_miss,
 
+  l_rgw_gc_shards_pending,
+  l_rgw_gc_shards_behind,
+  l_rgw_gc_inflight_io,
+  l_rgw_gc_remove_obj,
+  l_rgw_gc_remove_tag,
+
+  l_rgw_lc_shards_pending,
+  l_rgw_lc_remove_obj,
+  l_rgw_lc_abort_mp,
+  l_rgw_lc_bucket_done,
+
   l_rgw_last,
 };
 
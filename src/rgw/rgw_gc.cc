@@ -7,7 +7,9 @@
 #include "cls/refcount/cls_refcount_client.h"
 #include "cls/lock/cls_lock_client.h"
 #include "auth/Crypto.h"
+#include "rgw_tools.h"
 
+#include <deque>
 #include <list>
 
 #define dout_context g_ceph_context
@@ -129,11 +131,134 @@ int RGWGC::list(int *index, string& marker, uint32_t max, bool expired_only, std
   return 0;
 }
 
+#define MAX_REMOVE_CHUNK 16
+
+/*
+ * Keeps up to rgw_gc_max_concurrent_io tail object deletes of one gc shard
+ * in flight.  A gc entry's tag is removed from the shard once every delete
+ * in its chain has completed successfully.
+ */
+class RGWGCIOManager {
+  CephContext *cct;
+  RGWGC *gc;
+  int index;
+  utime_t end;  /* when the shard lock expires */
+  size_t max_aio;
+
+  struct IO {
+    AioCompletion *c;
+    string oid;
+    string tag;
+  };
+  std::deque<IO> ios;
+
+  struct TagState {
+    int pending{0};
+    bool closed{false};
+    bool failed{false};
+  };
+  std::map<string, TagState> tags;
+  std::list<string> remove_tags;
+
+  void finish_tag(std::map<string, TagState>::iterator iter) {
+    if (!iter->second.failed) {
+      remove_tags.push_back(iter->first);
+      /* past the end of the shard lock, tags are only removed once it has
+       * been renewed */
+      if (remove_tags.size() > MAX_REMOVE_CHUNK && ceph_clock_now() < end) {
+        flush_remove_tags();
+      }
+    }
+    tags.erase(iter);
+  }
+
+  void handle_next_completion() {
+    IO& io = ios.front();
+    io.c->wait_for_safe();
+    int ret = io.c->get_return_value();
+    io.c->release();
+    if (perfcounter) perfcounter->dec(l_rgw_gc_inflight_io);
+
+    if (ret == -ENOENT)
+      ret = 0;
+
+    auto iter = tags.find(io.tag);
+    assert(iter != tags.end());
+    if (ret < 0) {
+      iter->second.failed = true;
+      dout(0) << "failed to remove " << io.oid << " ret=" << ret << dendl;
+    } else if (perfcounter) {
+      perfcounter->inc(l_rgw_gc_remove_obj);
+    }
+    if (--iter->second.pending == 0 && iter->second.closed) {
+      finish_tag(iter);
+    }
+
+    ios.pop_front();
+  }
+
+public:
+  RGWGCIOManager(CephContext *_cct, RGWGC *_gc, int _index, utime_t _end)
+    : cct(_cct), gc(_gc), index(_index), end(_end),
+      max_aio(max(cct->_conf->rgw_gc_max_concurrent_io, 1)) {}
+  ~RGWGCIOManager() {
+    drain();
+  }
+
+  void add_tag(const string& tag) {
+    tags[tag];
+  }
+
+  /* called after all of the tag's deletes were scheduled */
+  void close_tag(const string& tag) {
+    auto iter = tags.find(tag);
+    assert(iter != tags.end());
+    iter->second.closed = true;
+    if (iter->second.pending == 0) {
+      finish_tag(iter);
+    }
+  }
+
+  int schedule_io(IoCtx& ctx, const string& oid, ObjectWriteOperation *op, const string& tag) {
+    while (ios.size() >= max_aio) {
+      handle_next_completion();
+    }
+
+    AioCompletion *c = librados::Rados::aio_create_completion(NULL, NULL, NULL);
+    int ret = ctx.aio_operate(oid, c, op);
+    if (ret < 0) {
+      c->release();
+      tags[tag].failed = true;
+      return ret;
+    }
+    if (perfcounter) perfcounter->inc(l_rgw_gc_inflight_io);
+
+    ios.push_back(IO{c, oid, tag});
+    tags[tag].pending++;
+    return 0;
+  }
+
+  /* waits for all deletes; tags that were not closed are left in place */
+  void drain() {
+    while (!ios.empty()) {
+      handle_next_completion();
+    }
+  }
+
+  /* the shard lock must be held */
+  void flush_remove_tags() {
+    if (remove_tags.empty())
+      return;
+    gc->remove(index, remove_tags);
+    if (perfcounter) perfcounter->inc(l_rgw_gc_remove_tag, remove_tags.size());
+    remove_tags.clear();
+  }
+};
+
 int RGWGC::process(int index, int max_secs)
 {
   rados::cls::lock::Lock l(gc_index_lock_name);
   utime_t end = ceph_clock_now();
-  std::list<string> remove_tags;
 
   /* max_secs should be greater than zero. We don't want a zero max_secs
    * to be translated as no timeout, since we'd then need to break the
@@ -156,7 +281,8 @@ int RGWGC::process(int index, int max_secs)
 
   string marker;
   bool truncated;
-  IoCtx *ctx = new IoCtx;
+  RGWGCIOManager io_manager(cct, this, index, end);
+  std::map<string, IoCtx> ctxs; /* by pool */
   do {
     int max = 100;
     std::list<cls_rgw_gc_obj_info> entries;
@@ -168,67 +294,67 @@ int RGWGC::process(int index, int max_secs)
     if (ret < 0)
       goto done;
 
-    string last_pool;
     std::list<cls_rgw_gc_obj_info>::iterator iter;
     for (iter = entries.begin(); iter != entries.end(); ++iter) {
-      bool remove_tag;
       cls_rgw_gc_obj_info& info = *iter;
       std::list<cls_rgw_obj>::iterator liter;
       cls_rgw_obj_chain& chain = info.chain;
 
       utime_t now = ceph_clock_now();
-      if (now >= end)
+      if (now >= end) {
+        if (perfcounter) perfcounter->inc(l_rgw_gc_shards_behind);
         goto done;
+      }
 
-      remove_tag = true;
+      io_manager.add_tag(info.tag);
       for (liter = chain.objs.begin(); liter != chain.objs.end(); ++liter) {
         cls_rgw_obj& obj = *liter;
 
-        if (obj.pool != last_pool) {
-          delete ctx;
-          ctx = new IoCtx;
-	  ret = rgw_init_ioctx(store->get_rados_handle(), obj.pool, *ctx);
+        auto ctx_iter = ctxs.find(obj.pool);
+        if (ctx_iter == ctxs.end()) {
+          ctx_iter = ctxs.emplace(obj.pool, IoCtx()).first;
+	  ret = rgw_init_ioctx(store->get_rados_handle(), obj.pool, ctx_iter->second);
 	  if (ret < 0) {
 	    dout(0) << "ERROR: failed to create ioctx pool=" << obj.pool << dendl;
+	    ctxs.erase(ctx_iter);
 	    continue;
 	  }
-          last_pool = obj.pool;
         }
+        IoCtx& ctx = ctx_iter->second;
 
-        ctx->locator_set_key(obj.loc);
+        ctx.locator_set_key(obj.loc);
 
         const string& oid = obj.key.name; /* just stored raw oid there */
 
 	dout(0) << "gc::process: removing " << obj.pool << ":" << obj.key.name << dendl;
 	ObjectWriteOperation op;
 	cls_refcount_put(op, info.tag, true);
-        ret = ctx->operate(oid, &op);
-	if (ret == -ENOENT)
-	  ret = 0;
+        ret = io_manager.schedule_io(ctx, oid, &op, info.tag);
         if (ret < 0) {
-          remove_tag = false;
           dout(0) << "failed to remove " << obj.pool << ":" << oid << "@" << obj.loc << dendl;
         }
 
-        if (going_down()) // leave early, even if tag isn't removed, it's ok
+        // leave early, even if tag isn't removed, it's ok
+        if (going_down() || ceph_clock_now() >= end)
           goto done;
       }
-      if (remove_tag) {
-        remove_tags.push_back(info.tag);
-#define MAX_REMOVE_CHUNK 16
-        if (remove_tags.size() > MAX_REMOVE_CHUNK) {
-          RGWGC::remove(index, remove_tags);
-          remove_tags.clear();
-        }
-      }
+      io_manager.close_tag(info.tag);
     }
   } while (truncated);
 
 done:
-  if (!remove_tags.empty())
-    RGWGC::remove(index, remove_tags);
+  /* the shard lock must still be held while the tags are removed, and the
+   * deletes in flight may take us past its expiry, so renew it first */
+  io_manager.drain();
+  l.set_renew(true);
+  ret = l.lock_exclusive(&store->gc_pool_ctx, obj_names[index]);
+  if (ret < 0) {
+    dout(0) << "RGWGC::process() lost the lock on " << obj_names[index]
+            << ", leaving the tags of removed chains for the next round" << dendl;
+    return 0;
+  }
+  io_manager.flush_remove_tags();
   l.unlock(&store->gc_pool_ctx, obj_names[index]);
-  delete ctx;
   return 0;
 }
 
@@ -241,14 +367,21 @@ int RGWGC::process()
   if (ret < 0)
     return ret;
 
-  for (int i = 0; i < max_objs; i++) {
-    int index = (i + start) % max_objs;
-    ret = process(index, max_secs);
-    if (ret < 0)
-      return ret;
+  if (perfcounter) {
+    perfcounter->set(l_rgw_gc_shards_pending, max_objs);
+    perfcounter->set(l_rgw_gc_shards_behind, 0);
   }
 
-  return 0;
+  ret = rgw_process_shards(max_objs, cct->_conf->rgw_gc_max_worker,
+                           [this]() { return going_down(); },
+                           [&](int i) {
+                             if (perfcounter) perfcounter->dec(l_rgw_gc_shards_pending);
+                             return process((i + start) % max_objs, max_secs);
+                           });
+
+  if (perfcounter) perfcounter->set(l_rgw_gc_shards_pending, 0);
+
+  return ret;
 }
 
 bool RGWGC::going_down()
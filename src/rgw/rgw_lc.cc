@@ -11,6 +11,7 @@
 #include "rgw_common.h"
 #include "rgw_bucket.h"
 #include "rgw_lc.h"
+#include "rgw_tools.h"
 
 #define dout_context g_ceph_context
 #define dout_subsys ceph_subsys_rgw
@@ -307,6 +308,9 @@ int RGWLC::handle_multipart_expiration(RGWRados::Bucket *target, const map<strin
             ldout(cct, 0) << "ERROR: abort_multipart_upload failed, ret=" << ret <<dendl;
             return ret;
           }
+          if (ret == 0 && perfcounter) {
+            perfcounter->inc(l_rgw_lc_abort_mp);
+          }
         }
       }
     } while(is_truncated);
@@ -398,6 +402,7 @@ int RGWLC::bucket_lc_process(string& shard_id)
             if (ret < 0) {
               ldout(cct, 0) << "ERROR: remove_expired_obj " << dendl;
             } else {
+              if (perfcounter) perfcounter->inc(l_rgw_lc_remove_obj);
               ldout(cct, 10) << "DELETED:" << bucket_name << ":" << key << dendl;
             }
           }
@@ -483,6 +488,7 @@ int RGWLC::bucket_lc_process(string& shard_id)
             if (ret < 0) {
               ldout(cct, 0) << "ERROR: remove_expired_obj " << dendl;
             } else {
+              if (perfcounter) perfcounter->inc(l_rgw_lc_remove_obj);
               ldout(cct, 10) << "DELETED:" << bucket_name << ":" << obj_iter->key << dendl;
             }
           }
@@ -564,14 +570,18 @@ int RGWLC::process()
   if (ret < 0)
     return ret;
 
-  for (int i = 0; i < max_objs; i++) {
-    int index = (i + start) % max_objs;
-    ret = process(index, max_secs);
-    if (ret < 0)
-      return ret;
-  }
+  if (perfcounter) perfcounter->set(l_rgw_lc_shards_pending, max_objs);
 
-  return 0;
+  ret = rgw_process_shards(max_objs, cct->_conf->rgw_lc_max_worker,
+                           [this]() { return going_down(); },
+                           [&](int i) {
+                             if (perfcounter) perfcounter->dec(l_rgw_lc_shards_pending);
+                             return process((i + start) % max_objs, max_secs);
+                           });
+
+  if (perfcounter) perfcounter->set(l_rgw_lc_shards_pending, 0);
+
+  return ret;
 }
 
 int RGWLC::process(int index, int max_lock_secs)
@@ -637,6 +647,7 @@ int RGWLC::process(int index, int max_lock_secs)
     }
     l.unlock(&store->lc_pool_ctx, obj_names[index]);
     ret = bucket_lc_process(entry.first);
+    if (perfcounter) perfcounter->inc(l_rgw_lc_bucket_done);
     ret = bucket_lc_post(index, max_lock_secs, head, entry, ret);
     return 0;
 exit:
@@ -637,6 +637,7 @@ protected:
   string delimiter;
   string encoding_type;
   bool list_versions;
+  bool allow_unordered;
   int max;
   vector<rgw_bucket_dir_entry> objs;
   map<string, bool> common_prefixes;
@@ -649,7 +650,7 @@ protected:
   int parse_max_keys();
 
 public:
-  RGWListBucket() : list_versions(false), max(0),
+  RGWListBucket() : list_versions(false), allow_unordered(false), max(0),
                     default_max(0), is_truncated(false), shard_id(-1) {}
   int verify_permission() override;
   void pre_exec() override;
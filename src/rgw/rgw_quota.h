@@ -105,6 +105,10 @@ public:
 
   virtual void update_stats(const rgw_user& bucket_owner, rgw_bucket& bucket, int obj_delta, uint64_t added_bytes, uint64_t removed_bytes) = 0;
 
+  virtual int check_bucket_shards(uint64_t max_objs_per_shard, uint64_t num_shards,
+                                  const rgw_user& bucket_owner, rgw_bucket& bucket,
+                                  bool& need_resharding, uint32_t *suggested_num_shards) = 0;
+
   static RGWQuotaHandler *generate_handler(RGWRados *store, bool quota_threads);
   static void free_handler(RGWQuotaHandler *handler);
 };
@@ -43,6 +43,7 @@
 #include "rgw_tools.h"
 #include "rgw_coroutine.h"
 #include "rgw_compression.h"
+#include "rgw_bucket_list.h"
 
 #include "rgw_boost_asio_yield.h"
 #undef fork // fails to compile RGWPeriod::fork() below
@@ -64,6 +65,7 @@ using namespace librados;
 
 #include "rgw_gc.h"
 #include "rgw_lc.h"
+#include "rgw_reshard.h"
 
 #include "rgw_object_expirer_core.h"
 #include "rgw_sync.h"
@@ -2482,7 +2484,7 @@ int RGWPutObjProcessor_Aio::wait_pending_front()
     return 0;
   }
   struct put_obj_aio_info info = pop_pending();
-  int ret = store->aio_wait(info.handle);
+  int ret = store->aio_wait(info.handle, obj_ctx.yield);
 
   if (ret >= 0) {
     add_written_obj(info.obj);
@@ -3413,6 +3415,9 @@ void RGWRados::finalize()
   delete gc;
   gc = NULL;
 
+  delete reshard;
+  reshard = nullptr;
+
   if (use_lc_thread) {
     lc->stop_processor();
   }
@@ -4155,6 +4160,11 @@ int RGWRados::init_complete()
     obj_expirer->start_processor();
   }
 
+  reshard = new RGWReshard(cct, this);
+  if (use_gc_thread && cct->_conf->rgw_dynamic_resharding) {
+    reshard->start_processor();
+  }
+
   if (run_sync_thread) {
     // initialize the log period history. we want to do this any time we're not
     // running under radosgw-admin, so we check run_sync_thread here before
@@ -5169,6 +5179,20 @@ int rgw_policy_from_attrset(CephContext *cct, map<string, bufferlist>& attrset,
 int RGWRados::Bucket::List::list_objects(int max, vector<rgw_bucket_dir_entry> *result,
                                          map<string, bool> *common_prefixes,
                                          bool *is_truncated)
+{
+  if (params.allow_unordered) {
+    /* common prefixes can only be rolled up when entries come in order */
+    if (!params.delim.empty()) {
+      return -EINVAL;
+    }
+    return list_objects_unordered(max, result, is_truncated);
+  }
+  return list_objects_ordered(max, result, common_prefixes, is_truncated);
+}
+
+int RGWRados::Bucket::List::list_objects_ordered(int max, vector<rgw_bucket_dir_entry> *result,
+                                                 map<string, bool> *common_prefixes,
+                                                 bool *is_truncated)
 {
   RGWRados *store = target->get_store();
   CephContext *cct = store->ctx();
@@ -5330,6 +5354,100 @@ done:
   return 0;
 }
 
+/**
+ * Like list_objects_ordered(), but the bucket index shards are read one
+ * after the other, so entries come back in no particular order and every
+ * call reads only as many entries as it returns.  Delimiters are not
+ * supported.
+ */
+int RGWRados::Bucket::List::list_objects_unordered(int max, vector<rgw_bucket_dir_entry> *result,
+                                                   bool *is_truncated)
+{
+  RGWRados *store = target->get_store();
+  CephContext *cct = store->ctx();
+  int shard_id = target->get_shard_id();
+
+  int count = 0;
+  bool truncated = true;
+
+  // read a few more than asked for, some may be filtered out below, and at
+  // least one more to tell whether the listing is truncated
+  const int read_ahead = max + std::min(max, 100) + 1;
+
+  result->clear();
+
+  rgw_obj_key marker_obj(params.marker.name, params.marker.instance, params.ns);
+  rgw_obj_index_key cur_marker;
+  marker_obj.get_index_key(&cur_marker);
+
+  rgw_obj_index_key cur_end_marker;
+  if (!params.end_marker.empty()) {
+    rgw_obj_key end_marker_obj(params.end_marker.name, params.end_marker.instance, params.ns);
+    end_marker_obj.get_index_key(&cur_end_marker);
+  }
+
+  rgw_obj_key prefix_obj(params.prefix);
+  prefix_obj.ns = params.ns;
+  string cur_prefix = prefix_obj.get_index_key_name();
+
+  while (truncated && count <= max) {
+    vector<rgw_bucket_dir_entry> ent_list;
+    int r = store->cls_bucket_list_unordered(target->get_bucket_info(), shard_id, cur_marker,
+                                             cur_end_marker, cur_prefix,
+                                             read_ahead, params.list_versions, ent_list,
+                                             &truncated, &cur_marker);
+    if (r < 0)
+      return r;
+
+    for (auto& entry : ent_list) {
+      rgw_obj_index_key index_key = entry.key;
+      rgw_obj_key obj(index_key);
+
+      bool valid = rgw_obj_key::parse_raw_oid(index_key.name, &obj);
+      if (!valid) {
+        ldout(cct, 0) << "ERROR: could not parse object name: " << obj.name << dendl;
+        continue;
+      }
+
+      if (!params.list_versions && !entry.is_visible()) {
+        continue;
+      }
+
+      /* entries are not sorted, so anything outside of the namespace is
+       * skipped rather than ending the listing; entries past the end marker
+       * were already left out by cls_bucket_list_unordered() */
+      if (params.enforce_ns && obj.ns != params.ns) {
+        continue;
+      }
+
+      if (count < max) {
+        params.marker = index_key;
+        next_marker = index_key;
+      }
+
+      if (params.filter && !params.filter->filter(obj.name, index_key.name))
+        continue;
+
+      if (params.prefix.size() && (obj.name.compare(0, params.prefix.size(), params.prefix) != 0))
+        continue;
+
+      if (count >= max) {
+        truncated = true;
+        goto done;
+      }
+
+      result->emplace_back(std::move(entry));
+      count++;
+    }
+  }
+
+done:
+  if (is_truncated)
+    *is_truncated = truncated;
+
+  return 0;
+}
+
 /**
  * create a rados pool, associated meta info
  * returns 0 on success, -ERR# otherwise.
@@ -6518,7 +6636,7 @@ int RGWRados::Object::Write::_do_write_meta(uint64_t size, uint64_t accounted_si
       return r;
   }
 
-  r = ref.ioctx.operate(ref.oid, &op);
+  r = rgw_rados_operate(ref.ioctx, ref.oid, &op, target->get_ctx().yield, &epoch);
   if (r < 0) { /* we can expect to get -ECANCELED if object was replaced under,
                 or -ENOENT if was removed, or -EEXIST if it did not exist
                 before and now it does */
@@ -6529,7 +6647,6 @@ int RGWRados::Object::Write::_do_write_meta(uint64_t size, uint64_t accounted_si
     goto done_cancel;
   }
 
-  epoch = ref.ioctx.get_last_version();
   poolid = ref.ioctx.get_id();
 
   r = target->complete_atomic_modification();
@@ -6574,6 +6691,14 @@ int RGWRados::Object::Write::_do_write_meta(uint64_t size, uint64_t accounted_si
   /* update quota cache */
   store->quota_handler->update_stats(meta.owner, obj.bucket, (orig_exists ? 0 : 1),
                                      accounted_size, orig_size);
+
+  if (!orig_exists) {
+    /* a new index entry, check whether the index has outgrown its shards */
+    r = store->check_bucket_shards(target->get_bucket_info(), obj.bucket);
+    if (r < 0) {
+      ldout(store->ctx(), 0) << "WARNING: check_bucket_shards() returned r=" << r << dendl;
+    }
+  }
   return 0;
 
 done_cancel:
@@ -6627,7 +6752,7 @@ int RGWRados::Object::Write::write_meta(uint64_t size, uint64_t accounted_size,
   RGWBucketInfo& bucket_info = target->get_bucket_info();
 
   RGWRados::Bucket bop(target->get_store(), bucket_info);
-  RGWRados::Bucket::UpdateIndex index_op(&bop, target->get_obj());
+  RGWRados::Bucket::UpdateIndex index_op(&bop, target->get_obj(), target->get_ctx().yield);
 
   bool assume_noent = (meta.if_match == NULL && meta.if_nomatch == NULL);
   int r;
@@ -6757,8 +6882,7 @@ int RGWRados::aio_put_obj_data(void *ctx, rgw_raw_obj& obj, bufferlist& bl,
     return r;
   }
 
-  AioCompletion *c = librados::Rados::aio_create_completion(NULL, NULL, NULL);
-  *handle = c;
+  RGWAioWait *w = new RGWAioWait;
   
   ObjectWriteOperation op;
 
@@ -6770,26 +6894,28 @@ int RGWRados::aio_put_obj_data(void *ctx, rgw_raw_obj& obj, bufferlist& bl,
   } else {
     op.write(ofs, bl);
   }
-  r = ref.ioctx.aio_operate(ref.oid, c, &op);
-  if (r < 0)
+  r = ref.ioctx.aio_operate(ref.oid, w->completion(), &op);
+  if (r < 0) {
+    delete w;
     return r;
+  }
 
+  *handle = w;
   return 0;
 }
 
-int RGWRados::aio_wait(void *handle)
+int RGWRados::aio_wait(void *handle, optional_yield y)
 {
-  AioCompletion *c = (AioCompletion *)handle;
-  c->wait_for_safe();
-  int ret = c->get_return_value();
-  c->release();
+  RGWAioWait *w = static_cast<RGWAioWait *>(handle);
+  int ret = w->wait(y);
+  delete w;
   return ret;
 }
 
 bool RGWRados::aio_completed(void *handle)
 {
-  AioCompletion *c = (AioCompletion *)handle;
-  return c->is_safe();
+  RGWAioWait *w = static_cast<RGWAioWait *>(handle);
+  return w->is_done();
 }
 
 class RGWRadosPutObj : public RGWGetDataCB
@@ -8210,6 +8336,61 @@ int RGWRados::bucket_rebuild_index(RGWBucketInfo& bucket_info)
   return CLSRGWIssueBucketRebuild(index_ctx, bucket_objs, cct->_conf->rgw_bucket_index_max_aio)();
 }
 
+/*
+ * Find out why an index operation on bs was refused for resharding. Sets
+ * new_bucket_id to the instance that replaced the index once the reshard
+ * has finished, or leaves it empty if the operation can be retried on the
+ * same index. Returns -ERR_BUSY_RESHARDING while the final pass of the
+ * reshard is running; rather than tie up the request thread for it, the
+ * request fails with SlowDown and the client retries.
+ */
+int RGWRados::check_resharding(BucketShard *bs, string *new_bucket_id)
+{
+  cls_rgw_bucket_instance_entry entry;
+  int ret = cls_rgw_get_bucket_resharding(bs->index_ctx, bs->bucket_obj, &entry);
+  if (ret < 0) {
+    ldout(cct, 0) << "ERROR: failed to get bucket resharding status of " << bs->bucket_obj
+                  << " ret=" << ret << dendl;
+    return ret;
+  }
+  if (entry.reshard_status == CLS_RGW_RESHARD_DONE) {
+    *new_bucket_id = entry.new_bucket_instance_id;
+    return 0;
+  }
+  if (!entry.blocks_writes()) {
+    return 0;
+  }
+
+  /* the index stays blocked if the resharding process died, check that
+   * its lock is still held */
+  librados::IoCtx index_ctx;
+  map<int, string> bucket_objs;
+  RGWObjectCtx obj_ctx(this);
+  RGWBucketInfo bucket_info;
+  ret = get_bucket_instance_info(obj_ctx, bs->bucket, bucket_info, nullptr, nullptr);
+  if (ret < 0) {
+    return ret;
+  }
+  ret = open_bucket_index(bucket_info, index_ctx, bucket_objs);
+  if (ret < 0) {
+    return ret;
+  }
+  map<rados::cls::lock::locker_id_t, rados::cls::lock::locker_info_t> lockers;
+  ClsLockType type;
+  string tag;
+  ret = rados::cls::lock::get_lock_info(&index_ctx, bucket_objs.begin()->second,
+                                        reshard_lock_name, &lockers, &type, &tag);
+  if ((ret == 0 && lockers.empty()) || ret == -ENOENT) {
+    ldout(cct, 0) << "WARNING: reshard of " << bs->bucket << " is no longer running, clearing its status" << dendl;
+    cls_rgw_bucket_instance_entry none;
+    return CLSRGWIssueSetBucketResharding(index_ctx, bucket_objs, none,
+                                          cct->_conf->rgw_bucket_index_max_aio)();
+  }
+
+  ldout(cct, 10) << "reshard of " << bs->bucket << " is blocking writes" << dendl;
+  return -ERR_BUSY_RESHARDING;
+}
+
 
 int RGWRados::defer_gc(void *ctx, const RGWBucketInfo& bucket_info, const rgw_obj& obj)
 {
@@ -8404,7 +8585,7 @@ int RGWRados::Object::Delete::delete_obj()
   RGWBucketInfo& bucket_info = target->get_bucket_info();
 
   RGWRados::Bucket bop(store, bucket_info);
-  RGWRados::Bucket::UpdateIndex index_op(&bop, obj);
+  RGWRados::Bucket::UpdateIndex index_op(&bop, obj, target->get_ctx().yield);
 
   index_op.set_bilog_flags(params.bilog_flags);
 
@@ -8414,7 +8595,8 @@ int RGWRados::Object::Delete::delete_obj()
     return r;
 
   store->remove_rgw_head_obj(op);
-  r = ref.ioctx.operate(ref.oid, &op);
+  uint64_t epoch = 0;
+  r = rgw_rados_operate(ref.ioctx, ref.oid, &op, target->get_ctx().yield, &epoch);
   bool need_invalidate = false;
   if (r == -ECANCELED) {
     /* raced with another operation, we can regard it as removed */
@@ -8430,7 +8612,7 @@ int RGWRados::Object::Delete::delete_obj()
       tombstone_entry entry{*state};
       obj_tombstone_cache->add(obj, entry);
     }
-    r = index_op.complete_del(poolid, ref.ioctx.get_last_version(), state->mtime, params.remove_objs);
+    r = index_op.complete_del(poolid, epoch, state->mtime, params.remove_objs);
   } else {
     int ret = index_op.cancel();
     if (ret < 0) {
@@ -8623,7 +8805,8 @@ int RGWRados::get_system_obj_state_impl(RGWObjectCtx *rctx, rgw_raw_obj& obj, RG
 
   s->obj = obj;
 
-  int r = raw_obj_stat(obj, &s->size, &s->mtime, &s->epoch, &s->attrset, (s->prefetch_data ? &s->data : NULL), objv_tracker);
+  int r = raw_obj_stat(obj, &s->size, &s->mtime, &s->epoch, &s->attrset, (s->prefetch_data ? &s->data : NULL), objv_tracker,
+                       rctx->yield);
   if (r == -ENOENT) {
     s->exists = false;
     s->has_attrs = true;
@@ -8684,7 +8867,8 @@ int RGWRados::get_obj_state_impl(RGWObjectCtx *rctx, const RGWBucketInfo& bucket
   int r = -ENOENT;
 
   if (!assume_noent) {
-    r = RGWRados::raw_obj_stat(raw_obj, &s->size, &s->mtime, &s->epoch, &s->attrset, (s->prefetch_data ? &s->data : NULL), NULL);
+    r = RGWRados::raw_obj_stat(raw_obj, &s->size, &s->mtime, &s->epoch, &s->attrset, (s->prefetch_data ? &s->data : NULL), NULL,
+                               rctx->yield);
   }
 
   if (r == -ENOENT) {
@@ -9460,18 +9644,81 @@ int RGWRados::SystemObject::Read::stat(RGWObjVersionTracker *objv_tracker)
                                 stat_params.lastmod, stat_params.obj_size, objv_tracker);
 }
 
+int RGWRados::Bucket::update_bucket_id(const string& new_bucket_id)
+{
+  rgw_bucket new_bucket = bucket_info.bucket;
+  new_bucket.bucket_id = new_bucket_id;
+  new_bucket.oid.clear();
+
+  RGWObjectCtx obj_ctx(store);
+  RGWBucketInfo new_bucket_info;
+  int ret = store->get_bucket_instance_info(obj_ctx, new_bucket, new_bucket_info, nullptr, nullptr);
+  if (ret < 0) {
+    return ret;
+  }
+
+  bucket_info = new_bucket_info;
+  return 0;
+}
+
+#define NUM_RESHARD_RETRIES 10
+
+/*
+ * Runs an index operation and, if the index has been resharded, redirects
+ * the operation to the new bucket instance. While the final stage of a
+ * reshard is running the operation fails with -ERR_BUSY_RESHARDING.
+ */
+int RGWRados::Bucket::UpdateIndex::guard_reshard(BucketShard **pbs, std::function<int(BucketShard *)> call)
+{
+  RGWRados *store = target->get_store();
+  BucketShard *bs;
+  int r;
+
+  for (int i = 0; i < NUM_RESHARD_RETRIES; ++i) {
+    int ret = get_bucket_shard(&bs);
+    if (ret < 0) {
+      ldout(store->ctx(), 5) << "failed to get BucketShard object: ret=" << ret << dendl;
+      return ret;
+    }
+    r = call(bs);
+    if (r != -ERR_BUSY_RESHARDING) {
+      break;
+    }
+    ldout(store->ctx(), 0) << "NOTICE: resharding operation on bucket index detected" << dendl;
+    string new_bucket_id;
+    r = store->check_resharding(bs, &new_bucket_id);
+    if (r < 0) {
+      return r;
+    }
+    if (new_bucket_id.empty()) {
+      continue; /* reshard was abandoned, retry on the same index */
+    }
+    ldout(store->ctx(), 20) << "reshard completion identified, new_bucket_id=" << new_bucket_id << dendl;
+    r = target->update_bucket_id(new_bucket_id);
+    if (r < 0) {
+      ldout(store->ctx(), 0) << "ERROR: update_bucket_id() new_bucket_id=" << new_bucket_id << " returned r=" << r << dendl;
+      return r;
+    }
+    invalidate_bs();
+  }
+
+  if (r < 0) {
+    return r;
+  }
+
+  if (pbs) {
+    *pbs = bs;
+  }
+
+  return 0;
+}
+
 int RGWRados::Bucket::UpdateIndex::prepare(RGWModifyOp op, const string *write_tag)
 {
   if (blind) {
     return 0;
   }
   RGWRados *store = target->get_store();
-  BucketShard *bs;
-  int ret = get_bucket_shard(&bs);
-  if (ret < 0) {
-    ldout(store->ctx(), 5) << "failed to get BucketShard object: ret=" << ret << dendl;
-    return ret;
-  }
 
   if (write_tag && write_tag->length()) {
     optag = string(write_tag->c_str(), write_tag->length());
@@ -9481,7 +9728,9 @@ int RGWRados::Bucket::UpdateIndex::prepare(RGWModifyOp op, const string *write_t
     }
   }
 
-  int r = store->cls_obj_prepare_op(*bs, op, optag, obj, bilog_flags);
+  int r = guard_reshard(nullptr, [&](BucketShard *bs) -> int {
+                                   return store->cls_obj_prepare_op(*bs, op, optag, obj, bilog_flags, y);
+                                 });
   if (r < 0) {
     return r;
   }
@@ -9675,7 +9924,7 @@ int RGWRados::Object::Read::read(int64_t ofs, int64_t end, bufferlist& bl)
   ldout(cct, 20) << "rados->read obj-ofs=" << ofs << " read_ofs=" << read_ofs << " read_len=" << read_len << dendl;
   op.read(read_ofs, read_len, pbl, NULL);
 
-  r = state.io_ctx.operate(read_obj.oid, &op, NULL);
+  r = rgw_rados_operate(state.io_ctx, read_obj.oid, &op, NULL, source->get_ctx().yield);
   ldout(cct, 20) << "rados->read r=" << r << " bl.length=" << bl.length() << dendl;
 
   if (r < 0) {
@@ -9802,6 +10051,10 @@ struct get_obj_data : public RefCountedObject {
   std::atomic<int64_t> err_code = { 0 };
   Throttle throttle;
   list<bufferlist> read_list;
+  optional_yield y;
+  set<off_t> done_ios; /* ios whose completion callback has run */
+  off_t waiting_ofs{-1};
+  RGWYieldWaiter *waiter{nullptr};
 
   explicit get_obj_data(CephContext *_cct)
     : cct(_cct),
@@ -9833,8 +10086,18 @@ struct get_obj_data : public RefCountedObject {
     }
     off_t cur_ofs = iter->first;
     librados::AioCompletion *c = iter->second;
+    if (y && done_ios.find(cur_ofs) == done_ios.end()) {
+      RGWYieldWaiter yw(y);
+      waiting_ofs = cur_ofs;
+      waiter = &yw;
+      lock.Unlock();
+      yw.suspend();
+      lock.Lock();
+    }
+    done_ios.erase(cur_ofs);
     lock.Unlock();
 
+    /* when we were woken up this only waits for the tail of the callback */
     c->wait_for_safe_and_cb();
     int r = c->get_return_value();
 
@@ -9882,6 +10145,15 @@ struct get_obj_data : public RefCountedObject {
     get();
   }
 
+  void io_done(off_t ofs) {
+    Mutex::Locker l(lock);
+    done_ios.insert(ofs);
+    if (waiter && waiting_ofs == ofs) {
+      waiter->wake();
+      waiter = nullptr;
+    }
+  }
+
   void cancel_io(off_t ofs) {
     ldout(cct, 20) << "get_obj_data::cancel_io() ofs=" << ofs << dendl;
     lock.Lock();
@@ -10008,6 +10280,7 @@ void RGWRados::get_obj_aio_completion_cb(completion_t c, void *arg)
 done_unlock:
   d->data_lock.Unlock();
 done:
+  d->io_done(ofs);
   d->put();
   return;
 }
@@ -10088,7 +10361,25 @@ int RGWRados::get_obj_iterate_cb(RGWObjectCtx *ctx, RGWObjState *astate,
     }
   }
 
-  d->throttle.get(len);
+  if (d->y) {
+    /* don't block the frontend thread on the read window, wait for the
+     * oldest read and hand its data to the client instead */
+    while (!d->throttle.get_or_fail(len)) {
+      bool done = false;
+      r = d->wait_next_io(&done);
+      if (r < 0)
+        return r;
+      r = flush_read_list(d);
+      if (r < 0)
+        return r;
+      if (done) {
+        d->throttle.get(len); /* nothing in flight, won't block */
+        break;
+      }
+    }
+  } else {
+    d->throttle.get(len);
+  }
   if (d->is_cancelled()) {
     return d->get_err_code();
   }
@@ -10138,6 +10429,7 @@ int RGWRados::Object::Read::iterate(int64_t ofs, int64_t end, RGWGetDataCB *cb)
   data->rados = store;
   data->io_ctx.dup(state.io_ctx);
   data->client_cb = cb;
+  data->y = obj_ctx.yield;
 
   int r = store->iterate_obj(obj_ctx, source->get_bucket_info(), state.obj, ofs, end, cct->_conf->rgw_get_obj_max_req_size, _get_obj_iterate_cb, (void *)data);
   if (r < 0) {
@@ -10962,7 +11254,7 @@ int RGWRados::follow_olh(const RGWBucketInfo& bucket_info, RGWObjectCtx& obj_ctx
 
 int RGWRados::raw_obj_stat(rgw_raw_obj& obj, uint64_t *psize, real_time *pmtime, uint64_t *epoch,
                            map<string, bufferlist> *attrs, bufferlist *first_chunk,
-                           RGWObjVersionTracker *objv_tracker)
+                           RGWObjVersionTracker *objv_tracker, optional_yield y)
 {
   rgw_rados_ref ref;
   int r = get_raw_obj_ref(obj, &ref);
@@ -10988,11 +11280,7 @@ int RGWRados::raw_obj_stat(rgw_raw_obj& obj, uint64_t *psize, real_time *pmtime,
     op.read(0, cct->_conf->rgw_max_chunk_size, first_chunk, NULL);
   }
   bufferlist outbl;
-  r = ref.ioctx.operate(ref.oid, &op, &outbl);
-
-  if (epoch) {
-    *epoch = ref.ioctx.get_last_version();
-  }
+  r = rgw_rados_operate(ref.ioctx, ref.oid, &op, &outbl, y, epoch);
 
   if (r < 0)
     return r;
@@ -12008,12 +12296,12 @@ int RGWRados::cls_rgw_init_index(librados::IoCtx& index_ctx, librados::ObjectWri
 }
 
 int RGWRados::cls_obj_prepare_op(BucketShard& bs, RGWModifyOp op, string& tag,
-                                 rgw_obj& obj, uint16_t bilog_flags)
+                                 rgw_obj& obj, uint16_t bilog_flags, optional_yield y)
 {
   ObjectWriteOperation o;
   cls_rgw_obj_key key(obj.key.get_index_key_name(), obj.key.instance);
   cls_rgw_bucket_prepare_op(o, op, tag, key, obj.key.get_loc(), get_zone().log_data, bilog_flags);
-  return bs.index_ctx.operate(bs.bucket_obj, &o);
+  return rgw_rados_operate(bs.index_ctx, bs.bucket_obj, &o, y);
 }
 
 int RGWRados::cls_obj_complete_op(BucketShard& bs, RGWModifyOp op, string& tag,
@@ -12099,73 +12387,50 @@ int RGWRados::cls_bucket_list(RGWBucketInfo& bucket_info, int shard_id, rgw_obj_
   // key   - oid (for different shards if there is any)
   // value - list result for the corresponding oid (shard), it is filled by the AIO callback
   map<int, string> oids;
-  map<int, struct rgw_cls_list_ret> list_results;
   int r = open_bucket_index(bucket_info, index_ctx, oids, shard_id);
   if (r < 0)
     return r;
 
-  cls_rgw_obj_key start_key(start.name, start.instance);
-  r = CLSRGWIssueBucketList(index_ctx, start_key, prefix, num_entries, list_versions,
-                            oids, list_results, cct->_conf->rgw_bucket_index_max_aio)();
-  if (r < 0)
-    return r;
-
-  // Create a list of iterators that are used to iterate each shard
-  vector<map<string, struct rgw_bucket_dir_entry>::iterator> vcurrents(list_results.size());
-  vector<map<string, struct rgw_bucket_dir_entry>::iterator> vends(list_results.size());
-  vector<string> vnames(list_results.size());
-  map<int, struct rgw_cls_list_ret>::iterator iter = list_results.begin();
-  *is_truncated = false;
-  for (; iter != list_results.end(); ++iter) {
-    vcurrents.push_back(iter->second.dir.m.begin());
-    vends.push_back(iter->second.dir.m.end());
-    vnames.push_back(oids[iter->first]);
-    *is_truncated = (*is_truncated || iter->second.is_truncated);
+  set<int> shards;
+  for (auto& oid : oids) {
+    shards.insert(oid.first);
   }
 
-  // Create a map to track the next candidate entry from each shard, if the entry
-  // from a specified shard is selected/erased, the next entry from that shard will
-  // be inserted for next round selection
-  map<string, size_t> candidates;
-  for (size_t i = 0; i < vcurrents.size(); ++i) {
-    if (vcurrents[i] != vends[i]) {
-      candidates[vcurrents[i]->first] = i;
+  auto list_shards = [&](const map<int, cls_rgw_obj_key>& starts,
+                         const map<int, uint32_t>& nums,
+                         map<int, rgw_cls_list_ret>& results) {
+    map<int, string> shard_oids;
+    for (auto& s : starts) {
+      shard_oids[s.first] = oids[s.first];
     }
-  }
+    return CLSRGWIssueBucketListShards(index_ctx, starts, prefix, nums, list_versions,
+                                       shard_oids, results,
+                                       cct->_conf->rgw_bucket_index_max_aio)();
+  };
 
   map<string, bufferlist> updates;
-  uint32_t count = 0;
-  while (count < num_entries && !candidates.empty()) {
-    r = 0;
-    // Select the next one
-    int pos = candidates.begin()->second;
-    const string& name = vcurrents[pos]->first;
-    struct rgw_bucket_dir_entry& dirent = vcurrents[pos]->second;
-
+  auto check = [&](int shard, rgw_bucket_dir_entry& dirent) {
+    int r = 0;
     bool force_check = force_check_filter && force_check_filter(dirent.key.name);
     if ((!dirent.exists && !dirent.is_delete_marker()) || !dirent.pending_map.empty() || force_check) {
       /* there are uncommitted ops. We need to check the current state,
        * and if the tags are old we need to do cleanup as well. */
       librados::IoCtx sub_ctx;
       sub_ctx.dup(index_ctx);
-      r = check_disk_state(sub_ctx, bucket_info, dirent, dirent, updates[vnames[pos]]);
-      if (r < 0 && r != -ENOENT) {
-          return r;
-      }
+      r = check_disk_state(sub_ctx, bucket_info, dirent, dirent, updates[oids[shard]]);
     }
     if (r >= 0) {
       ldout(cct, 10) << "RGWRados::cls_bucket_list: got " << dirent.key.name << "[" << dirent.key.instance << "]" << dendl;
-      m[name] = std::move(dirent);
-      ++count;
     }
+    return r;
+  };
 
-    // Refresh the candidates map
-    candidates.erase(candidates.begin());
-    ++vcurrents[pos];
-    if (vcurrents[pos] != vends[pos]) {
-      candidates[vcurrents[pos]->first] = pos;
-    }
-  }
+  cls_rgw_obj_key start_key(start.name, start.instance);
+  r = rgw_bucket_list_merge(shards, start_key, num_entries,
+                            cct->_conf->rgw_bucket_list_min_shard_batch,
+                            list_shards, check, m, is_truncated);
+  if (r < 0)
+    return r;
 
   // Suggest updates if there is any
   map<string, bufferlist>::iterator miter = updates.begin();
@@ -12180,17 +12445,101 @@ int RGWRados::cls_bucket_list(RGWBucketInfo& bucket_info, int shard_id, rgw_obj_
     }
   }
 
-  // Check if all the returned entries are consumed or not
-  for (size_t i = 0; i < vcurrents.size(); ++i) {
-    if (vcurrents[i] != vends[i])
-      *is_truncated = true;
-  }
   if (!m.empty())
     *last_entry = m.rbegin()->first;
 
   return 0;
 }
 
+int RGWRados::cls_bucket_list_unordered(RGWBucketInfo& bucket_info, int shard_id, rgw_obj_index_key& start,
+                                        const rgw_obj_index_key& end, const string& prefix,
+                                        uint32_t num_entries, bool list_versions,
+                                        vector<rgw_bucket_dir_entry>& ent_list,
+                                        bool *is_truncated, rgw_obj_index_key *last_entry,
+                                        bool (*force_check_filter)(const string&  name))
+{
+  ldout(cct, 10) << "cls_bucket_list_unordered " << bucket_info.bucket << " start " << start.name << "[" << start.instance << "] num_entries " << num_entries << dendl;
+
+  ent_list.clear();
+  *is_truncated = false;
+
+  librados::IoCtx index_ctx;
+  map<int, string> oids;
+  int r = open_bucket_index(bucket_info, index_ctx, oids, shard_id);
+  if (r < 0)
+    return r;
+
+  set<int> shards;
+  for (auto& oid : oids) {
+    shards.insert(oid.first);
+  }
+
+  /* Shards are read one after the other in shard order.  An object's index
+   * entry lives on the shard its name hashes to, so the marker tells us
+   * which shard to continue with. */
+  int current_shard = oids.begin()->first;
+  if (shard_id < 0 && !start.empty()) {
+    string key;
+    if (!rgw_bucket_list_hash_key(start.name, &key)) {
+      ldout(cct, 0) << "ERROR: " << __func__ << " could not parse marker: " << start.name << dendl;
+      return -EINVAL;
+    }
+    int marker_shard = -1;
+    r = get_target_shard_id(bucket_info, key, &marker_shard);
+    if (r < 0)
+      return r;
+    if (marker_shard >= 0)
+      current_shard = marker_shard;
+  }
+
+  auto list_shards = [&](const map<int, cls_rgw_obj_key>& starts,
+                         const map<int, uint32_t>& nums,
+                         map<int, rgw_cls_list_ret>& results) {
+    map<int, string> shard_oids;
+    for (auto& s : starts) {
+      shard_oids[s.first] = oids[s.first];
+    }
+    return CLSRGWIssueBucketListShards(index_ctx, starts, prefix, nums, list_versions,
+                                       shard_oids, results, 1)();
+  };
+
+  map<string, bufferlist> updates;
+  auto check = [&](int shard, rgw_bucket_dir_entry& dirent) {
+    int r = 0;
+    bool force_check = force_check_filter && force_check_filter(dirent.key.name);
+    if ((!dirent.exists && !dirent.is_delete_marker()) || !dirent.pending_map.empty() || force_check) {
+      /* there are uncommitted ops. We need to check the current state,
+       * and if the tags are old we need to do cleanup as well. */
+      librados::IoCtx sub_ctx;
+      sub_ctx.dup(index_ctx);
+      r = check_disk_state(sub_ctx, bucket_info, dirent, dirent, updates[oids[shard]]);
+    }
+    if (r >= 0) {
+      ldout(cct, 10) << "RGWRados::cls_bucket_list_unordered: got " << dirent.key.name << "[" << dirent.key.instance << "]" << dendl;
+    }
+    return r;
+  };
+
+  r = rgw_bucket_list_unordered(shards, current_shard, start, end, num_entries,
+                                list_shards, check, ent_list, is_truncated, last_entry);
+  if (r < 0)
+    return r;
+
+  // Suggest updates if there is any
+  for (auto& update : updates) {
+    if (update.second.length()) {
+      ObjectWriteOperation o;
+      cls_rgw_suggest_changes(o, update.second);
+      // we don't care if we lose suggested updates, send them off blindly
+      AioCompletion *c = librados::Rados::aio_create_completion(NULL, NULL, NULL);
+      index_ctx.aio_operate(update.first, c, &o);
+      c->release();
+    }
+  }
+
+  return 0;
+}
+
 int RGWRados::cls_obj_usage_log_add(const string& oid, rgw_usage_log_info& info)
 {
   rgw_raw_obj obj(get_zone_params().usage_log_pool, oid);
@@ -12614,6 +12963,51 @@ int RGWRados::check_quota(const rgw_user& bucket_owner, rgw_bucket& bucket,
   return quota_handler->check_quota(bucket_owner, bucket, user_quota, bucket_quota, 1, obj_size);
 }
 
+int RGWRados::check_bucket_shards(const RGWBucketInfo& bucket_info, rgw_bucket& bucket)
+{
+  if (!cct->_conf->rgw_dynamic_resharding ||
+      bucket_info.index_type == RGWBIType_Indexless) {
+    return 0;
+  }
+
+  /* resharding replaces the bucket instance, which multisite bucket sync
+   * does not follow */
+  if (get_zonegroup().zones.size() > 1) {
+    ldout(cct, 20) << "not resharding bucket " << bucket << ", zonegroup has more than one zone" << dendl;
+    return 0;
+  }
+
+  bool need_resharding = false;
+  uint32_t num_source_shards = (bucket_info.num_shards > 0 ? bucket_info.num_shards : 1);
+  uint32_t suggested_num_shards;
+
+  int ret = quota_handler->check_bucket_shards((uint64_t)cct->_conf->rgw_max_objs_per_shard,
+                                               num_source_shards, bucket_info.owner, bucket,
+                                               need_resharding, &suggested_num_shards);
+  if (ret < 0) {
+    return ret;
+  }
+
+  if (need_resharding) {
+    suggested_num_shards = std::min(suggested_num_shards, get_max_bucket_shards());
+    if (suggested_num_shards > num_source_shards) {
+      add_bucket_to_reshard(bucket_info, suggested_num_shards);
+    }
+  }
+
+  return 0;
+}
+
+void RGWRados::add_bucket_to_reshard(const RGWBucketInfo& bucket_info, uint32_t new_num_shards)
+{
+  if (!reshard || !use_gc_thread) {
+    return; /* no reshard thread to pick it up */
+  }
+  ldout(cct, 20) << "bucket " << bucket_info.bucket << " needs resharding into "
+                 << new_num_shards << " shards" << dendl;
+  reshard->add(bucket_info, new_num_shards);
+}
+
 void RGWRados::get_bucket_index_objects(const string& bucket_oid_base,
     uint32_t num_shards, map<int, string>& bucket_objects, int shard_id)
 {
@@ -12670,9 +13064,7 @@ int RGWRados::get_target_shard_id(const RGWBucketInfo& bucket_info, const string
           *shard_id = -1;
         }
       } else {
-        uint32_t sid = ceph_str_hash_linux(obj_key.c_str(), obj_key.size());
-        uint32_t sid2 = sid ^ ((sid & 0xFF) << 24);
-        sid = sid2 % MAX_BUCKET_INDEX_SHARDS_PRIME % bucket_info.num_shards;
+        uint32_t sid = rgw_bucket_shard_index(obj_key, bucket_info.num_shards);
         if (shard_id) {
           *shard_id = (int)sid;
         }
@@ -12710,9 +13102,7 @@ int RGWRados::get_bucket_index_object(const string& bucket_oid_base, const strin
           *shard_id = -1;
         }
       } else {
-        uint32_t sid = ceph_str_hash_linux(obj_key.c_str(), obj_key.size());
-        uint32_t sid2 = sid ^ ((sid & 0xFF) << 24);
-        sid = sid2 % MAX_BUCKET_INDEX_SHARDS_PRIME % num_shards;
+        uint32_t sid = rgw_bucket_shard_index(obj_key, num_shards);
         char buf[bucket_oid_base.size() + 32];
         snprintf(buf, sizeof(buf), "%s.%d", bucket_oid_base.c_str(), sid);
         (*bucket_obj) = buf;
@@ -23,11 +23,13 @@
 #include "rgw_meta_sync_status.h"
 #include "rgw_period_puller.h"
 #include "rgw_sync_module.h"
+#include "rgw_yield.h"
 
 class RGWWatcher;
 class SafeTimer;
 class ACLOwner;
 class RGWGC;
+class RGWReshard;
 class RGWMetaNotifier;
 class RGWDataNotifier;
 class RGWLC;
@@ -2130,6 +2132,7 @@ void RGWObjectCtxImpl<rgw_raw_obj, RGWRawObjState>::invalidate(rgw_raw_obj& obj)
 struct RGWObjectCtx {
   RGWRados *store;
   void *user_ctx;
+  optional_yield yield; // coroutine of the request this context belongs to
 
   RGWObjectCtxImpl<rgw_obj, RGWObjState> obj;
   RGWObjectCtxImpl<rgw_raw_obj, RGWRawObjState> raw;
@@ -2164,6 +2167,7 @@ struct tombstone_entry {
 class RGWRados
 {
   friend class RGWGC;
+  friend class RGWBucketReshard;
   friend class RGWMetaNotifier;
   friend class RGWDataNotifier;
   friend class RGWLC;
@@ -2207,6 +2211,7 @@ class RGWRados
   RGWGC *gc;
   RGWLC *lc;
   RGWObjectExpirer *obj_expirer;
+  RGWReshard *reshard;
   bool use_gc_thread;
   bool use_lc_thread;
   bool quota_threads;
@@ -2299,7 +2304,7 @@ protected:
   RGWPeriod current_period;
 public:
   RGWRados() : lock("rados_timer_lock"), watchers_lock("watchers_lock"), timer(NULL),
-               gc(NULL), lc(NULL), obj_expirer(NULL), use_gc_thread(false), use_lc_thread(false), quota_threads(false),
+               gc(NULL), lc(NULL), obj_expirer(NULL), reshard(nullptr), use_gc_thread(false), use_lc_thread(false), quota_threads(false),
                run_sync_thread(false), async_rados(nullptr), meta_notifier(NULL),
                data_notifier(NULL), meta_sync_processor_thread(NULL),
                meta_sync_thread_lock("meta_sync_thread_lock"), data_sync_thread_lock("data_sync_thread_lock"),
@@ -2841,6 +2846,8 @@ public:
       shard_id = id;
     }
 
+    int update_bucket_id(const string& new_bucket_id);
+
     class UpdateIndex {
       RGWRados::Bucket *target;
       string optag;
@@ -2850,10 +2857,18 @@ public:
       bool bs_initialized{false};
       bool blind;
       bool prepared{false};
+      optional_yield y;
+
+      void invalidate_bs() {
+        bs_initialized = false;
+      }
+
+      int guard_reshard(BucketShard **pbs, std::function<int(BucketShard *)> call);
     public:
 
-      UpdateIndex(RGWRados::Bucket *_target, const rgw_obj& _obj) : target(_target), obj(_obj),
-                                                              bs(target->get_store()) {
+      UpdateIndex(RGWRados::Bucket *_target, const rgw_obj& _obj,
+                  optional_yield _y = null_yield) : target(_target), obj(_obj),
+                                                    bs(target->get_store()), y(_y) {
                                                                 blind = (target->get_bucket_info().index_type == RGWBIType_Indexless);
                                                               }
 
@@ -2902,10 +2917,15 @@ public:
         bool enforce_ns;
         RGWAccessListFilter *filter;
         bool list_versions;
+        bool allow_unordered;
 
-        Params() : enforce_ns(true), filter(NULL), list_versions(false) {}
+        Params() : enforce_ns(true), filter(NULL), list_versions(false), allow_unordered(false) {}
       } params;
 
+    private:
+      int list_objects_ordered(int max, vector<rgw_bucket_dir_entry> *result, map<string, bool> *common_prefixes, bool *is_truncated);
+      int list_objects_unordered(int max, vector<rgw_bucket_dir_entry> *result, bool *is_truncated);
+
     public:
       explicit List(RGWRados::Bucket *_target) : target(_target) {}
 
@@ -2939,7 +2959,7 @@ public:
 
     return put_system_obj_impl(obj, len, mtime, attrs, flags, bl, objv_tracker, set_mtime);
   }
-  int aio_wait(void *handle);
+  int aio_wait(void *handle, optional_yield y = null_yield);
   bool aio_completed(void *handle);
 
   int on_last_entry_in_listing(RGWBucketInfo& bucket_info,
@@ -3207,7 +3227,7 @@ public:
 
   virtual int raw_obj_stat(rgw_raw_obj& obj, uint64_t *psize, ceph::real_time *pmtime, uint64_t *epoch,
                        map<string, bufferlist> *attrs, bufferlist *first_chunk,
-                       RGWObjVersionTracker *objv_tracker);
+                       RGWObjVersionTracker *objv_tracker, optional_yield y = null_yield);
 
   int obj_operate(const RGWBucketInfo& bucket_info, const rgw_obj& obj, librados::ObjectWriteOperation *op);
   int obj_operate(const RGWBucketInfo& bucket_info, const rgw_obj& obj, librados::ObjectReadOperation *op);
@@ -3309,7 +3329,8 @@ public:
                                      map<string, bufferlist> *pattrs, bool create_entry_point);
 
   int cls_rgw_init_index(librados::IoCtx& io_ctx, librados::ObjectWriteOperation& op, string& oid);
-  int cls_obj_prepare_op(BucketShard& bs, RGWModifyOp op, string& tag, rgw_obj& obj, uint16_t bilog_flags);
+  int cls_obj_prepare_op(BucketShard& bs, RGWModifyOp op, string& tag, rgw_obj& obj, uint16_t bilog_flags,
+                         optional_yield y = null_yield);
   int cls_obj_complete_op(BucketShard& bs, RGWModifyOp op, string& tag, int64_t pool, uint64_t epoch,
                           rgw_bucket_dir_entry& ent, RGWObjCategory category, list<rgw_obj_index_key> *remove_objs, uint16_t bilog_flags);
   int cls_obj_complete_add(BucketShard& bs, string& tag, int64_t pool, uint64_t epoch, rgw_bucket_dir_entry& ent,
@@ -3322,6 +3343,12 @@ public:
                       uint32_t num_entries, bool list_versions, map<string, rgw_bucket_dir_entry>& m,
                       bool *is_truncated, rgw_obj_index_key *last_entry,
                       bool (*force_check_filter)(const string&  name) = NULL);
+  int cls_bucket_list_unordered(RGWBucketInfo& bucket_info, int shard_id, rgw_obj_index_key& start,
+                                const rgw_obj_index_key& end, const string& prefix,
+                                uint32_t num_entries, bool list_versions,
+                                vector<rgw_bucket_dir_entry>& ent_list,
+                                bool *is_truncated, rgw_obj_index_key *last_entry,
+                                bool (*force_check_filter)(const string&  name) = NULL);
   int cls_bucket_head(const RGWBucketInfo& bucket_info, int shard_id, map<string, struct rgw_bucket_dir_header>& headers, map<int, string> *bucket_instance_ids = NULL);
   int cls_bucket_head_async(const RGWBucketInfo& bucket_info, int shard_id, RGWGetDirHeader_CB *ctx, int *num_aio);
   int list_bi_log_entries(RGWBucketInfo& bucket_info, int shard_id, string& marker, uint32_t max, std::list<rgw_bi_log_entry>& result, bool *truncated);
@@ -3409,6 +3436,7 @@ public:
                          map<RGWObjCategory, RGWStorageStats> *existing_stats,
                          map<RGWObjCategory, RGWStorageStats> *calculated_stats);
   int bucket_rebuild_index(RGWBucketInfo& bucket_info);
+  int check_resharding(BucketShard *bs, string *new_bucket_id);
   int remove_objs_from_index(RGWBucketInfo& bucket_info, list<rgw_obj_index_key>& oid_list);
   int move_rados_obj(librados::IoCtx& src_ioctx,
 		     const string& src_oid, const string& src_locator,
@@ -3437,6 +3465,9 @@ public:
   int check_quota(const rgw_user& bucket_owner, rgw_bucket& bucket,
                   RGWQuotaInfo& user_quota, RGWQuotaInfo& bucket_quota, uint64_t obj_size);
 
+  int check_bucket_shards(const RGWBucketInfo& bucket_info, rgw_bucket& bucket);
+  void add_bucket_to_reshard(const RGWBucketInfo& bucket_info, uint32_t new_num_shards);
+
   uint64_t instance_id();
   const string& zone_id() {
     return get_zone_params().get_id();
@@ -0,0 +1,925 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <deque>
+#include <set>
+
+#include "rgw_reshard.h"
+#include "rgw_bucket.h"
+#include "cls/rgw/cls_rgw_client.h"
+#include "common/errno.h"
+#include "common/ceph_json.h"
+
+#define dout_context g_ceph_context
+#define dout_subsys ceph_subsys_rgw
+
+using namespace std;
+
+const string reshard_lock_name = "reshard_process";
+
+#define RESHARD_SHARD_WINDOW 64
+#define RESHARD_MAX_AIO 128
+
+/* catch-up passes made while writes are still allowed */
+#define RESHARD_MAX_CATCHUP_PASSES 8
+
+class BucketReshardShard {
+  RGWRados *store;
+  RGWBucketInfo& bucket_info;
+  int num_shard;
+  RGWRados::BucketShard bs;
+  vector<rgw_cls_bi_entry> entries;
+  map<uint8_t, rgw_bucket_category_stats> stats;
+  deque<librados::AioCompletion *>& aio_completions;
+
+  int wait_next_completion() {
+    librados::AioCompletion *c = aio_completions.front();
+    aio_completions.pop_front();
+
+    c->wait_for_safe();
+
+    int ret = c->get_return_value();
+    c->release();
+
+    if (ret < 0) {
+      lderr(store->ctx()) << "ERROR: reshard rados operation failed: " << cpp_strerror(-ret) << dendl;
+      return ret;
+    }
+
+    return 0;
+  }
+
+  int get_completion(librados::AioCompletion **c) {
+    if (aio_completions.size() >= RESHARD_MAX_AIO) {
+      int ret = wait_next_completion();
+      if (ret < 0) {
+        return ret;
+      }
+    }
+
+    *c = librados::Rados::aio_create_completion(nullptr, nullptr, nullptr);
+    aio_completions.push_back(*c);
+
+    return 0;
+  }
+
+public:
+  BucketReshardShard(RGWRados *_store, RGWBucketInfo& _bucket_info,
+                     int _num_shard,
+                     deque<librados::AioCompletion *>& _completions) : store(_store), bucket_info(_bucket_info), bs(store),
+                                                                       aio_completions(_completions) {
+    num_shard = (bucket_info.num_shards > 0 ? _num_shard : -1);
+    bs.init(bucket_info.bucket, num_shard);
+  }
+
+  int get_num_shard() {
+    return num_shard;
+  }
+
+  int add_entry(rgw_cls_bi_entry& entry, bool account, uint8_t category,
+                const rgw_bucket_category_stats& entry_stats) {
+    entries.push_back(entry);
+    if (account) {
+      rgw_bucket_category_stats& target = stats[category];
+      target.num_entries += entry_stats.num_entries;
+      target.total_size += entry_stats.total_size;
+      target.total_size_rounded += entry_stats.total_size_rounded;
+    }
+    if (entries.size() >= RESHARD_SHARD_WINDOW) {
+      int ret = flush();
+      if (ret < 0) {
+        return ret;
+      }
+    }
+    return 0;
+  }
+  int flush() {
+    if (entries.size() == 0) {
+      return 0;
+    }
+
+    librados::ObjectWriteOperation op;
+    for (auto& entry : entries) {
+      store->bi_put(op, bs, entry);
+    }
+    cls_rgw_bucket_update_stats(op, false, stats);
+
+    librados::AioCompletion *c;
+    int ret = get_completion(&c);
+    if (ret < 0) {
+      return ret;
+    }
+    ret = bs.index_ctx.aio_operate(bs.bucket_obj, c, &op);
+    if (ret < 0) {
+      lderr(store->ctx()) << "ERROR: failed to store entries in target bucket shard (bs=" << bs.bucket << "/" << bs.shard_id << ") error=" << cpp_strerror(-ret) << dendl;
+      return ret;
+    }
+    entries.clear();
+    stats.clear();
+    return 0;
+  }
+
+  int wait_all_aio() {
+    int ret = 0;
+    while (!aio_completions.empty()) {
+      int r = wait_next_completion();
+      if (r < 0) {
+        ret = r;
+      }
+    }
+    return ret;
+  }
+};
+
+class BucketReshardManager {
+  RGWRados *store;
+  RGWBucketInfo& target_bucket_info;
+  deque<librados::AioCompletion *> completions;
+  int num_target_shards;
+  vector<BucketReshardShard *> target_shards;
+
+public:
+  BucketReshardManager(RGWRados *_store, RGWBucketInfo& _target_bucket_info, int _num_target_shards) : store(_store), target_bucket_info(_target_bucket_info),
+                                                                                                       num_target_shards(_num_target_shards) {
+    target_shards.resize(num_target_shards);
+    for (int i = 0; i < num_target_shards; ++i) {
+      target_shards[i] = new BucketReshardShard(store, target_bucket_info, i, completions);
+    }
+  }
+
+  ~BucketReshardManager() {
+    for (auto& shard : target_shards) {
+      int ret = shard->wait_all_aio();
+      if (ret < 0) {
+        ldout(store->ctx(), 20) << __func__ << ": shard->wait_all_aio() returned ret=" << ret << dendl;
+      }
+      delete shard;
+    }
+  }
+
+  int add_entry(int shard_index,
+                rgw_cls_bi_entry& entry, bool account, uint8_t category,
+                const rgw_bucket_category_stats& entry_stats) {
+    int ret = target_shards[shard_index]->add_entry(entry, account, category, entry_stats);
+    if (ret < 0) {
+      lderr(store->ctx()) << "ERROR: target_shards.add_entry(" << entry.idx << ") returned error: " << cpp_strerror(-ret) << dendl;
+      return ret;
+    }
+    return 0;
+  }
+
+  int finish() {
+    int ret = 0;
+    for (auto& shard : target_shards) {
+      int r = shard->flush();
+      if (r < 0) {
+        lderr(store->ctx()) << "ERROR: target_shards[" << shard->get_num_shard() << "].flush() returned error: " << cpp_strerror(-r) << dendl;
+        ret = r;
+      }
+    }
+    for (auto& shard : target_shards) {
+      int r = shard->wait_all_aio();
+      if (r < 0) {
+        lderr(store->ctx()) << "ERROR: target_shards[" << shard->get_num_shard() << "].wait_all_aio() returned error: " << cpp_strerror(-r) << dendl;
+        ret = r;
+      }
+      delete shard;
+    }
+    target_shards.clear();
+    return ret;
+  }
+};
+
+RGWBucketReshard::RGWBucketReshard(RGWRados *_store, const RGWBucketInfo& _bucket_info,
+                                   const map<string, bufferlist>& _bucket_attrs,
+                                   const std::atomic<bool> *_down_flag) :
+  store(_store), bucket_info(_bucket_info), bucket_attrs(_bucket_attrs),
+  reshard_lock(reshard_lock_name), down_flag(_down_flag)
+{
+  char buf[32];
+  gen_rand_alphanumeric(store->ctx(), buf, sizeof(buf) - 1);
+  reshard_lock.set_cookie(buf);
+}
+
+int RGWBucketReshard::lock_bucket()
+{
+  int ret = store->open_bucket_index(bucket_info, index_ctx, bucket_objs);
+  if (ret < 0) {
+    return ret;
+  }
+  reshard_oid = bucket_objs.begin()->second;
+
+  reshard_lock.set_duration(utime_t(store->ctx()->_conf->rgw_reshard_bucket_lock_duration, 0));
+  ret = reshard_lock.lock_exclusive(&index_ctx, reshard_oid);
+  if (ret == -EBUSY) {
+    ldout(store->ctx(), 0) << "RGWBucketReshard::" << __func__ << " bucket " << bucket_info.bucket
+                           << " is already being resharded" << dendl;
+    return ret;
+  }
+  if (ret < 0) {
+    ldout(store->ctx(), 0) << "RGWBucketReshard::" << __func__ << " failed to take reshard lock on "
+                           << reshard_oid << " ret=" << ret << dendl;
+    return ret;
+  }
+  lock_start = ceph_clock_now();
+  return 0;
+}
+
+int RGWBucketReshard::renew_lock_bucket(bool force)
+{
+  utime_t now = ceph_clock_now();
+  /* renew the lock once half of its duration has gone by */
+  if (!force &&
+      now < lock_start + utime_t(store->ctx()->_conf->rgw_reshard_bucket_lock_duration / 2, 0)) {
+    return 0;
+  }
+
+  reshard_lock.set_renew(true);
+  int ret = reshard_lock.lock_exclusive(&index_ctx, reshard_oid);
+  reshard_lock.set_renew(false);
+  if (ret < 0) { /* expired and taken by someone else, or the index is gone */
+    ldout(store->ctx(), 0) << "RGWBucketReshard::" << __func__ << " failed to renew reshard lock on "
+                           << reshard_oid << " ret=" << ret << dendl;
+    return ret;
+  }
+  lock_start = now;
+  return 0;
+}
+
+void RGWBucketReshard::unlock_bucket()
+{
+  int ret = reshard_lock.unlock(&index_ctx, reshard_oid);
+  if (ret < 0) {
+    ldout(store->ctx(), 0) << "WARNING: RGWBucketReshard::" << __func__ << " failed to drop lock on "
+                           << reshard_oid << " ret=" << ret << dendl;
+  }
+}
+
+int RGWBucketReshard::set_resharding_status(const string& new_instance_id, int32_t num_shards,
+                                            uint8_t status)
+{
+  cls_rgw_bucket_instance_entry instance_entry;
+  instance_entry.reshard_status = status;
+  instance_entry.new_bucket_instance_id = new_instance_id;
+  instance_entry.num_shards = num_shards;
+
+  int ret = CLSRGWIssueSetBucketResharding(index_ctx, bucket_objs, instance_entry,
+                                           store->ctx()->_conf->rgw_bucket_index_max_aio)();
+  if (ret < 0) {
+    ldout(store->ctx(), 0) << "RGWBucketReshard::" << __func__ << " failed to set status "
+                           << (int)status << " on " << bucket_info.bucket << " ret=" << ret << dendl;
+  }
+  return ret;
+}
+
+int RGWBucketReshard::clear_resharding()
+{
+  return set_resharding_status(string(), -1, CLS_RGW_RESHARD_NONE);
+}
+
+int RGWBucketReshard::create_new_bucket_instance(int new_num_shards,
+                                                 RGWBucketInfo& new_bucket_info)
+{
+  new_bucket_info = bucket_info;
+  store->create_bucket_id(&new_bucket_info.bucket.bucket_id);
+  new_bucket_info.bucket.oid.clear();
+
+  new_bucket_info.num_shards = new_num_shards;
+  new_bucket_info.objv_tracker.clear();
+
+  int ret = store->init_bucket_index(new_bucket_info, new_bucket_info.num_shards);
+  if (ret < 0) {
+    lderr(store->ctx()) << "ERROR: failed to init new bucket indexes: " << cpp_strerror(-ret) << dendl;
+    return ret;
+  }
+
+  ret = store->put_bucket_instance_info(new_bucket_info, true, real_time(), &bucket_attrs);
+  if (ret < 0) {
+    lderr(store->ctx()) << "ERROR: failed to store new bucket instance info: " << cpp_strerror(-ret) << dendl;
+    return ret;
+  }
+
+  return 0;
+}
+
+int RGWBucketReshard::get_log_markers(map<int, string> *markers)
+{
+  map<int, rgw_cls_list_ret> headers;
+  int ret = CLSRGWIssueGetDirHeader(index_ctx, bucket_objs, headers,
+                                    store->ctx()->_conf->rgw_bucket_index_max_aio)();
+  if (ret < 0) {
+    return ret;
+  }
+  for (auto& h : headers) {
+    (*markers)[h.first] = h.second.dir.header.max_marker;
+  }
+  return 0;
+}
+
+int RGWBucketReshard::copy_index(RGWBucketInfo& new_bucket_info, int max_entries,
+                                 bool verbose, ostream *out, Formatter *formatter)
+{
+  int num_source_shards = (bucket_info.num_shards > 0 ? bucket_info.num_shards : 1);
+  int num_target_shards = (new_bucket_info.num_shards > 0 ? new_bucket_info.num_shards : 1);
+
+  BucketReshardManager target_shards_mgr(store, new_bucket_info, num_target_shards);
+
+  verbose = verbose && formatter;
+
+  if (verbose) {
+    formatter->open_array_section("entries");
+  }
+
+  uint64_t total_entries = 0;
+
+  if (!verbose && out) {
+    (*out) << "total entries:";
+  }
+
+  list<rgw_cls_bi_entry> entries;
+  for (int i = 0; i < num_source_shards; ++i) {
+    bool is_truncated = true;
+    string marker;
+    while (is_truncated) {
+      entries.clear();
+      int ret = store->bi_list(bucket_info.bucket, i, string(), marker, max_entries, &entries, &is_truncated);
+      if (ret < 0) {
+        lderr(store->ctx()) << "ERROR: bi_list(): " << cpp_strerror(-ret) << dendl;
+        return ret;
+      }
+
+      for (auto& entry : entries) {
+        if (verbose) {
+          formatter->open_object_section("entry");
+
+          encode_json("shard_id", i, formatter);
+          encode_json("num_entry", total_entries, formatter);
+          encode_json("entry", entry, formatter);
+        }
+        total_entries++;
+
+        marker = entry.idx;
+
+        int target_shard_id;
+        cls_rgw_obj_key cls_key;
+        uint8_t category;
+        rgw_bucket_category_stats stats;
+        bool account = entry.get_info(&cls_key, &category, &stats);
+        rgw_obj_key key(cls_key);
+        rgw_obj obj(new_bucket_info.bucket, key);
+        ret = store->get_target_shard_id(new_bucket_info, obj.get_hash_object(), &target_shard_id);
+        if (ret < 0) {
+          lderr(store->ctx()) << "ERROR: get_target_shard_id() returned ret=" << ret << dendl;
+          return ret;
+        }
+
+        int shard_index = (target_shard_id > 0 ? target_shard_id : 0);
+
+        ret = target_shards_mgr.add_entry(shard_index, entry, account, category, stats);
+        if (ret < 0) {
+          return ret;
+        }
+        if (verbose) {
+          formatter->close_section();
+          if (out) {
+            formatter->flush(*out);
+          }
+        } else if (out && !(total_entries % 1000)) {
+          (*out) << " " << total_entries;
+        }
+      }
+
+      if (going_down()) {
+        return -ECANCELED;
+      }
+      ret = renew_lock_bucket();
+      if (ret < 0) {
+        return ret;
+      }
+    }
+  }
+  if (verbose) {
+    formatter->close_section();
+    if (out) {
+      formatter->flush(*out);
+    }
+  } else if (out) {
+    (*out) << " " << total_entries << std::endl;
+  }
+
+  int ret = target_shards_mgr.finish();
+  if (ret < 0) {
+    lderr(store->ctx()) << "ERROR: failed to reshard" << dendl;
+    return -EIO;
+  }
+  return 0;
+}
+
+/*
+ * Make the entries of one object in the new index match the old index:
+ * every plain, instance and olh entry of the object is copied over, and
+ * entries that no longer exist in the old index are dropped.  The new
+ * shard's stats are adjusted by the difference in the same operation.
+ */
+int RGWBucketReshard::sync_entries(RGWBucketInfo& new_bucket_info,
+                                   librados::IoCtx& new_index_ctx,
+                                   map<int, string>& new_bucket_objs,
+                                   const string& oid, const string& name)
+{
+  rgw_obj_key key(cls_rgw_obj_key(name, string()));
+  rgw_obj obj(new_bucket_info.bucket, key);
+  int target_shard_id;
+  int ret = store->get_target_shard_id(new_bucket_info, obj.get_hash_object(), &target_shard_id);
+  if (ret < 0) {
+    return ret;
+  }
+  const string& new_oid = new_bucket_objs[target_shard_id > 0 ? target_shard_id : 0];
+
+  list<rgw_cls_bi_entry> old_entries;
+  list<rgw_cls_bi_entry> new_entries;
+  string marker;
+  bool is_truncated = true;
+  while (is_truncated) {
+    list<rgw_cls_bi_entry> entries;
+    ret = cls_rgw_bi_list(index_ctx, oid, name, marker, RESHARD_SHARD_WINDOW, &entries, &is_truncated);
+    if (ret < 0) {
+      return ret;
+    }
+    if (entries.empty()) {
+      break;
+    }
+    marker = entries.back().idx;
+    old_entries.splice(old_entries.end(), entries);
+  }
+  marker.clear();
+  is_truncated = true;
+  while (is_truncated) {
+    list<rgw_cls_bi_entry> entries;
+    ret = cls_rgw_bi_list(new_index_ctx, new_oid, name, marker, RESHARD_SHARD_WINDOW, &entries, &is_truncated);
+    if (ret < 0) {
+      return ret;
+    }
+    if (entries.empty()) {
+      break;
+    }
+    marker = entries.back().idx;
+    new_entries.splice(new_entries.end(), entries);
+  }
+
+  /* the object's entries in the new shard end up being exactly the old
+   * ones; unsigned wrap-around makes the subtracted stats a delta */
+  map<uint8_t, rgw_bucket_category_stats> delta;
+  set<string> old_keys;
+  for (auto& entry : old_entries) {
+    old_keys.insert(entry.idx);
+
+    cls_rgw_obj_key cls_key;
+    uint8_t category;
+    rgw_bucket_category_stats stats;
+    if (entry.get_info(&cls_key, &category, &stats)) {
+      rgw_bucket_category_stats& target = delta[category];
+      target.num_entries += stats.num_entries;
+      target.total_size += stats.total_size;
+      target.total_size_rounded += stats.total_size_rounded;
+    }
+  }
+  set<string> removed_keys;
+  for (auto& entry : new_entries) {
+    if (old_keys.find(entry.idx) == old_keys.end()) {
+      removed_keys.insert(entry.idx);
+    }
+
+    cls_rgw_obj_key cls_key;
+    uint8_t category;
+    rgw_bucket_category_stats stats;
+    if (entry.get_info(&cls_key, &category, &stats)) {
+      rgw_bucket_category_stats& target = delta[category];
+      target.num_entries -= stats.num_entries;
+      target.total_size -= stats.total_size;
+      target.total_size_rounded -= stats.total_size_rounded;
+    }
+  }
+  if (old_entries.empty() && removed_keys.empty()) {
+    return 0;
+  }
+
+  librados::ObjectWriteOperation op;
+  if (!removed_keys.empty()) {
+    op.omap_rm_keys(removed_keys);
+  }
+  for (auto& entry : old_entries) {
+    cls_rgw_bi_put(op, new_oid, entry);
+  }
+  cls_rgw_bucket_update_stats(op, false, delta);
+  return new_index_ctx.operate(new_oid, &op);
+}
+
+int RGWBucketReshard::replay_log(RGWBucketInfo& new_bucket_info, map<int, string>& markers,
+                                 int max_entries, uint64_t *num_replayed)
+{
+  librados::IoCtx new_index_ctx;
+  map<int, string> new_bucket_objs;
+  int ret = store->open_bucket_index(new_bucket_info, new_index_ctx, new_bucket_objs);
+  if (ret < 0) {
+    return ret;
+  }
+
+  *num_replayed = 0;
+  for (auto& b : bucket_objs) {
+    int shard_id = (bucket_info.num_shards > 0 ? b.first : -1);
+    string& marker = markers[b.first];
+    bool truncated = true;
+    while (truncated) {
+      list<rgw_bi_log_entry> log_entries;
+      ret = store->list_bi_log_entries(bucket_info, shard_id, marker, max_entries,
+                                       log_entries, &truncated);
+      if (ret < 0) {
+        lderr(store->ctx()) << "ERROR: failed to list bilog of " << b.second << ": "
+                            << cpp_strerror(-ret) << dendl;
+        return ret;
+      }
+      if (log_entries.empty()) {
+        break;
+      }
+
+      set<string> names;
+      for (auto& entry : log_entries) {
+        if (!entry.object.empty()) {
+          names.insert(entry.object);
+        }
+      }
+      for (auto& name : names) {
+        ret = sync_entries(new_bucket_info, new_index_ctx, new_bucket_objs, b.second, name);
+        if (ret < 0) {
+          lderr(store->ctx()) << "ERROR: failed to sync index entries of " << name << ": "
+                              << cpp_strerror(-ret) << dendl;
+          return ret;
+        }
+      }
+      *num_replayed += names.size();
+      marker = log_entries.back().id;
+
+      if (going_down()) {
+        return -ECANCELED;
+      }
+      ret = renew_lock_bucket();
+      if (ret < 0) {
+        return ret;
+      }
+    }
+  }
+  return 0;
+}
+
+int RGWBucketReshard::do_reshard(RGWBucketInfo& new_bucket_info, int max_entries,
+                                 bool verbose, ostream *out, Formatter *formatter)
+{
+  const string& new_id = new_bucket_info.bucket.bucket_id;
+  int32_t new_num_shards = new_bucket_info.num_shards;
+
+  /* changes that land after these markers are replayed onto the new index */
+  map<int, string> markers;
+  int ret = get_log_markers(&markers);
+  if (ret < 0) {
+    return ret;
+  }
+
+  ret = set_resharding_status(new_id, new_num_shards, CLS_RGW_RESHARD_IN_PROGRESS);
+  if (ret < 0) {
+    return ret;
+  }
+
+  ret = copy_index(new_bucket_info, max_entries, verbose, out, formatter);
+  if (ret < 0) {
+    return ret;
+  }
+
+  uint64_t num_replayed = 0;
+  uint64_t total_replayed = 0;
+  for (int pass = 0; pass < RESHARD_MAX_CATCHUP_PASSES; ++pass) {
+    ret = replay_log(new_bucket_info, markers, max_entries, &num_replayed);
+    if (ret < 0) {
+      return ret;
+    }
+    total_replayed += num_replayed;
+    ldout(store->ctx(), 10) << "RGWBucketReshard::" << __func__ << " bucket " << bucket_info.bucket
+                            << " catch-up pass " << pass << " replayed " << num_replayed << " objects" << dendl;
+    if (num_replayed < (uint64_t)max_entries) {
+      break;
+    }
+  }
+
+  /*
+   * Writes are refused from here on, keep this window short.  Once our
+   * lock expires a refused writer clears the status and goes on writing
+   * to the old index, so the lock must stay valid until the new instance
+   * is linked: start with a full lock duration and renew after every step.
+   */
+  ret = renew_lock_bucket(true);
+  if (ret < 0) {
+    return ret;
+  }
+
+  ret = set_resharding_status(new_id, new_num_shards, CLS_RGW_RESHARD_BLOCKING);
+  if (ret < 0) {
+    return ret;
+  }
+
+  ret = replay_log(new_bucket_info, markers, max_entries, &num_replayed);
+  if (ret < 0) {
+    return ret;
+  }
+  total_replayed += num_replayed;
+  ldout(store->ctx(), 10) << "RGWBucketReshard::" << __func__ << " bucket " << bucket_info.bucket
+                          << " replayed " << total_replayed << " objects in total" << dendl;
+
+  ret = renew_lock_bucket(true);
+  if (ret < 0) {
+    return ret;
+  }
+
+  ret = rgw_link_bucket(store, bucket_info.owner, new_bucket_info.bucket,
+                        bucket_info.creation_time);
+  if (ret < 0) {
+    lderr(store->ctx()) << "ERROR: failed to link new bucket instance (bucket_id=" << new_id
+                        << "): " << cpp_strerror(-ret) << dendl;
+    return ret;
+  }
+
+  /* keep blocked writers waiting until DONE is set; the new instance is
+   * linked already, so there is no aborting if this fails */
+  ret = renew_lock_bucket(true);
+  if (ret < 0) {
+    ldout(store->ctx(), 0) << "WARNING: RGWBucketReshard::" << __func__ << " lost reshard lock of "
+                           << bucket_info.bucket << " after linking the new instance" << dendl;
+  }
+
+  /* writers still holding the old bucket instance will move to the new one */
+  ret = set_resharding_status(new_id, new_num_shards, CLS_RGW_RESHARD_DONE);
+  if (ret < 0) {
+    return ret;
+  }
+
+  return 0;
+}
+
+int RGWBucketReshard::execute(int num_shards, int max_entries,
+                              bool verbose, ostream *out, Formatter *formatter,
+                              string *new_bucket_id)
+{
+  int ret = lock_bucket();
+  if (ret < 0) {
+    return ret;
+  }
+
+  map<int, cls_rgw_bucket_instance_entry> status;
+  ret = get_status(&status);
+  if (ret < 0) {
+    unlock_bucket();
+    return ret;
+  }
+  for (auto& s : status) {
+    if (s.second.reshard_status == CLS_RGW_RESHARD_DONE) {
+      ldout(store->ctx(), 0) << "RGWBucketReshard::" << __func__ << " bucket instance " << bucket_info.bucket
+                             << " was already resharded into " << s.second.new_bucket_instance_id << dendl;
+      unlock_bucket();
+      return -EEXIST;
+    }
+  }
+
+  /* a reshard that did not finish leaves the old index in place, start over */
+  ret = clear_resharding();
+  if (ret < 0) {
+    unlock_bucket();
+    return ret;
+  }
+
+  RGWBucketInfo new_bucket_info;
+  ret = create_new_bucket_instance(num_shards, new_bucket_info);
+  if (ret < 0) {
+    unlock_bucket();
+    return ret;
+  }
+
+  ldout(store->ctx(), 1) << "RGWBucketReshard::" << __func__ << " resharding " << bucket_info.bucket
+                         << " into " << new_bucket_info.bucket.bucket_id << " with "
+                         << num_shards << " shards" << dendl;
+  if (new_bucket_id) {
+    *new_bucket_id = new_bucket_info.bucket.bucket_id;
+  }
+
+  ret = do_reshard(new_bucket_info, max_entries, verbose, out, formatter);
+  if (ret < 0) {
+    int r = clear_resharding();
+    if (r < 0) {
+      lderr(store->ctx()) << "ERROR: failed to clear reshard status of " << bucket_info.bucket
+                          << ", writes stay blocked until the reshard lock expires" << dendl;
+    }
+  }
+
+  unlock_bucket();
+  return ret;
+}
+
+int RGWBucketReshard::get_status(map<int, cls_rgw_bucket_instance_entry> *status)
+{
+  if (bucket_objs.empty()) {
+    int ret = store->open_bucket_index(bucket_info, index_ctx, bucket_objs);
+    if (ret < 0) {
+      return ret;
+    }
+  }
+
+  for (auto& b : bucket_objs) {
+    cls_rgw_bucket_instance_entry entry;
+    int ret = cls_rgw_get_bucket_resharding(index_ctx, b.second, &entry);
+    if (ret < 0) {
+      return ret;
+    }
+    (*status)[b.first] = entry;
+  }
+  return 0;
+}
+
+int RGWBucketReshard::purge_superseded_index()
+{
+  int ret = store->open_bucket_index(bucket_info, index_ctx, bucket_objs);
+  if (ret < 0) {
+    return ret;
+  }
+
+  /* writers that still hold this instance find DONE on its index and move
+   * to the new one, so only purge once nobody uses this instance anymore */
+  for (auto& b : bucket_objs) {
+    cls_rgw_bucket_instance_entry entry;
+    ret = cls_rgw_get_bucket_resharding(index_ctx, b.second, &entry);
+    if (ret == -ENOENT) {
+      continue; /* purged already */
+    }
+    if (ret < 0) {
+      return ret;
+    }
+    if (entry.reshard_status != CLS_RGW_RESHARD_DONE) {
+      ldout(store->ctx(), 0) << "RGWBucketReshard::" << __func__ << " bucket instance " << bucket_info.bucket
+                             << " was not resharded" << dendl;
+      return -EINVAL;
+    }
+  }
+
+  RGWObjectCtx obj_ctx(store);
+  RGWBucketInfo cur_bucket_info;
+  ret = store->get_bucket_info(obj_ctx, bucket_info.bucket.tenant, bucket_info.bucket.name,
+                               cur_bucket_info, nullptr);
+  if (ret < 0 && ret != -ENOENT) {
+    return ret;
+  }
+  if (ret == 0 && cur_bucket_info.bucket.bucket_id == bucket_info.bucket.bucket_id) {
+    ldout(store->ctx(), 0) << "RGWBucketReshard::" << __func__ << " bucket instance " << bucket_info.bucket
+                           << " is still the current one" << dendl;
+    return -EINVAL;
+  }
+
+  for (auto& b : bucket_objs) {
+    ret = index_ctx.remove(b.second);
+    if (ret < 0 && ret != -ENOENT) {
+      lderr(store->ctx()) << "ERROR: failed to remove bucket index object " << b.second << ": "
+                          << cpp_strerror(-ret) << dendl;
+      return ret;
+    }
+  }
+  return 0;
+}
+
+int RGWBucketReshard::cancel()
+{
+  int ret = lock_bucket();
+  if (ret < 0) {
+    return ret;
+  }
+
+  map<int, cls_rgw_bucket_instance_entry> status;
+  ret = get_status(&status);
+  if (ret == 0) {
+    for (auto& s : status) {
+      if (s.second.reshard_status == CLS_RGW_RESHARD_DONE) {
+        ret = -EEXIST;
+        break;
+      }
+    }
+  }
+  if (ret == 0) {
+    ret = clear_resharding();
+  }
+
+  unlock_bucket();
+  return ret;
+}
+
+void RGWReshard::add(const RGWBucketInfo& bucket_info, uint32_t new_num_shards)
+{
+  Mutex::Locker l(lock);
+  reshard_entry& entry = entries[bucket_info.bucket.get_key('/', 0)];
+  entry.tenant = bucket_info.bucket.tenant;
+  entry.bucket_name = bucket_info.bucket.name;
+  entry.new_num_shards = std::max(entry.new_num_shards, new_num_shards);
+}
+
+int RGWReshard::process_entry(const reshard_entry& entry)
+{
+  RGWObjectCtx obj_ctx(store);
+  RGWBucketInfo bucket_info;
+  map<string, bufferlist> attrs;
+  int ret = store->get_bucket_info(obj_ctx, entry.tenant, entry.bucket_name,
+                                   bucket_info, nullptr, &attrs);
+  if (ret < 0) {
+    return ret;
+  }
+
+  if (bucket_info.num_shards >= entry.new_num_shards) {
+    return 0; /* resharded in the meantime */
+  }
+
+  RGWBucketReshard br(store, bucket_info, attrs, &down_flag);
+  ret = br.execute(entry.new_num_shards, 1000);
+  if (ret == -EBUSY || ret == -EEXIST || ret == -ECANCELED) {
+    return 0;
+  }
+  return ret;
+}
+
+int RGWReshard::process()
+{
+  map<string, reshard_entry> pending;
+  {
+    Mutex::Locker l(lock);
+    pending.swap(entries);
+  }
+
+  for (auto& p : pending) {
+    if (going_down()) {
+      break;
+    }
+    int ret = process_entry(p.second);
+    if (ret < 0) {
+      ldout(cct, 0) << "ERROR: failed to reshard bucket " << p.first << " into "
+                    << p.second.new_num_shards << " shards: " << cpp_strerror(-ret) << dendl;
+    }
+  }
+  return 0;
+}
+
+bool RGWReshard::going_down()
+{
+  return down_flag;
+}
+
+void RGWReshard::start_processor()
+{
+  worker = new ReshardWorker(cct, this);
+  worker->create("rgw_reshard");
+}
+
+void RGWReshard::stop_processor()
+{
+  down_flag = true;
+  if (worker) {
+    worker->stop();
+    worker->join();
+  }
+  delete worker;
+  worker = nullptr;
+}
+
+void *RGWReshard::ReshardWorker::entry() {
+  do {
+    utime_t start = ceph_clock_now();
+    int r = reshard->process();
+    if (r < 0) {
+      dout(0) << "ERROR: reshard process() returned error r=" << r << dendl;
+    }
+
+    if (reshard->going_down())
+      break;
+
+    utime_t end = ceph_clock_now();
+    end -= start;
+    int secs = cct->_conf->rgw_reshard_thread_interval;
+
+    if (secs <= end.sec())
+      continue; // next round
+
+    secs -= end.sec();
+
+    lock.Lock();
+    cond.WaitInterval(lock, utime_t(secs, 0));
+    lock.Unlock();
+  } while (!reshard->going_down());
+
+  return NULL;
+}
+
+void RGWReshard::ReshardWorker::stop()
+{
+  Mutex::Locker l(lock);
+  cond.Signal();
+}
@@ -0,0 +1,140 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef RGW_RESHARD_H
+#define RGW_RESHARD_H
+
+#include <atomic>
+#include <map>
+#include <string>
+
+#include "include/rados/librados.hpp"
+#include "common/Mutex.h"
+#include "common/Cond.h"
+#include "common/Thread.h"
+#include "cls/rgw/cls_rgw_types.h"
+#include "cls/lock/cls_lock_client.h"
+#include "rgw_rados.h"
+
+/* name of the cls_lock taken on the first index object of a bucket while it
+ * is being resharded */
+extern const std::string reshard_lock_name;
+
+/*
+ * Copies a bucket index into a new bucket instance with a different number
+ * of shards while the bucket stays writable.
+ *
+ * The old index is flagged so that every change made to it is also written to
+ * its bilog; after the bulk copy those changes are replayed onto the new index.
+ * Writes are refused only for the final catch-up pass, after which the bucket
+ * entrypoint is switched to the new instance and the old index is flagged as
+ * superseded so that writers still holding the old instance move over.
+ */
+class RGWBucketReshard {
+  RGWRados *store;
+  RGWBucketInfo bucket_info;
+  std::map<string, bufferlist> bucket_attrs;
+
+  librados::IoCtx index_ctx;
+  std::map<int, string> bucket_objs;
+
+  rados::cls::lock::Lock reshard_lock;
+  string reshard_oid;
+  utime_t lock_start;
+
+  const std::atomic<bool> *down_flag; /* set when the caller shuts down */
+
+  bool going_down() const {
+    return down_flag && *down_flag;
+  }
+
+  int lock_bucket();
+  int renew_lock_bucket(bool force = false);
+  void unlock_bucket();
+
+  int set_resharding_status(const string& new_instance_id, int32_t num_shards,
+                            uint8_t status);
+  int clear_resharding();
+  int create_new_bucket_instance(int new_num_shards,
+                                 RGWBucketInfo& new_bucket_info);
+  int get_log_markers(std::map<int, string> *markers);
+  int copy_index(RGWBucketInfo& new_bucket_info, int max_entries,
+                 bool verbose, ostream *out, Formatter *formatter);
+  int sync_entries(RGWBucketInfo& new_bucket_info,
+                   librados::IoCtx& new_index_ctx,
+                   std::map<int, string>& new_bucket_objs,
+                   const string& oid, const string& name);
+  int replay_log(RGWBucketInfo& new_bucket_info, std::map<int, string>& markers,
+                 int max_entries, uint64_t *num_replayed);
+  int do_reshard(RGWBucketInfo& new_bucket_info, int max_entries,
+                 bool verbose, ostream *out, Formatter *formatter);
+
+public:
+  RGWBucketReshard(RGWRados *_store, const RGWBucketInfo& _bucket_info,
+                   const std::map<string, bufferlist>& _bucket_attrs,
+                   const std::atomic<bool> *_down_flag = nullptr);
+
+  /* returns -EBUSY if the bucket is already being resharded */
+  int execute(int num_shards, int max_entries,
+              bool verbose = false, ostream *out = nullptr,
+              Formatter *formatter = nullptr,
+              string *new_bucket_id = nullptr);
+  int get_status(std::map<int, cls_rgw_bucket_instance_entry> *status);
+  int cancel();
+
+  /* removes the index objects of this bucket instance once a finished
+   * reshard has replaced it; -EINVAL if it has not been replaced */
+  int purge_superseded_index();
+};
+
+/*
+ * Background resharding of the buckets that were found to hold more than
+ * rgw_max_objs_per_shard entries per index shard.
+ */
+class RGWReshard {
+  CephContext *cct;
+  RGWRados *store;
+
+  struct reshard_entry {
+    string tenant;
+    string bucket_name;
+    uint32_t new_num_shards{0};
+  };
+
+  Mutex lock;
+  std::map<string, reshard_entry> entries; /* keyed by bucket key */
+  std::atomic<bool> down_flag = { false };
+
+  class ReshardWorker : public Thread {
+    CephContext *cct;
+    RGWReshard *reshard;
+    Mutex lock;
+    Cond cond;
+
+  public:
+    ReshardWorker(CephContext *_cct, RGWReshard *_reshard)
+      : cct(_cct), reshard(_reshard), lock("ReshardWorker") {}
+    void *entry() override;
+    void stop();
+  };
+
+  ReshardWorker *worker;
+
+  int process_entry(const reshard_entry& entry);
+
+public:
+  RGWReshard(CephContext *_cct, RGWRados *_store)
+    : cct(_cct), store(_store), lock("RGWReshard"), worker(nullptr) {}
+  ~RGWReshard() {
+    stop_processor();
+  }
+
+  void add(const RGWBucketInfo& bucket_info, uint32_t new_num_shards);
+  int process();
+
+  bool going_down();
+  void start_processor();
+  void stop_processor();
+};
+
+#endif
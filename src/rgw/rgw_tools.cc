@@ -3,6 +3,9 @@
 
 #include <errno.h>
 
+#include <atomic>
+#include <thread>
+
 #include "common/errno.h"
 #include "common/safe_io.h"
 
@@ -98,6 +101,54 @@ int rgw_delete_system_obj(RGWRados *rgwstore, const rgw_pool& pool, const string
   return rgwstore->delete_system_obj(obj, objv_tracker);
 }
 
+int rgw_rados_operate(librados::IoCtx& ioctx, const std::string& oid,
+                      librados::ObjectReadOperation *op, bufferlist *pbl,
+                      optional_yield y, uint64_t *pver)
+{
+  int r;
+  if (!y) {
+    r = ioctx.operate(oid, op, pbl);
+    if (pver) {
+      *pver = ioctx.get_last_version();
+    }
+    return r;
+  }
+  RGWAioWait w;
+  r = ioctx.aio_operate(oid, w.completion(), op, pbl);
+  if (r < 0) {
+    return r;
+  }
+  r = w.wait(y);
+  if (pver) {
+    *pver = w.completion()->get_version64();
+  }
+  return r;
+}
+
+int rgw_rados_operate(librados::IoCtx& ioctx, const std::string& oid,
+                      librados::ObjectWriteOperation *op, optional_yield y,
+                      uint64_t *pver)
+{
+  int r;
+  if (!y) {
+    r = ioctx.operate(oid, op);
+    if (pver) {
+      *pver = ioctx.get_last_version();
+    }
+    return r;
+  }
+  RGWAioWait w;
+  r = ioctx.aio_operate(oid, w.completion(), op);
+  if (r < 0) {
+    return r;
+  }
+  r = w.wait(y);
+  if (pver) {
+    *pver = w.completion()->get_version64();
+  }
+  return r;
+}
+
 void parse_mime_map_line(const char *start, const char *end)
 {
   char line[end - start + 1];
@@ -191,6 +242,35 @@ const char *rgw_find_mime_by_ext(string& ext)
   return iter->second.c_str();
 }
 
+int rgw_process_shards(int num_shards, int num_workers,
+                       const std::function<bool()>& stop,
+                       const std::function<int(int)>& process)
+{
+  std::atomic<int> next = { 0 };
+  std::atomic<int> first_error = { 0 };
+  auto work = [&]() {
+    for (int i = next++; i < num_shards && !first_error && !stop(); i = next++) {
+      int r = process(i);
+      if (r < 0) {
+        int expected = 0;
+        first_error.compare_exchange_strong(expected, r);
+      }
+    }
+  };
+
+  num_workers = std::min(std::max(num_workers, 1), num_shards);
+  std::vector<std::thread> workers;
+  for (int i = 1; i < num_workers; i++) {
+    workers.emplace_back(work);
+  }
+  work();
+  for (auto& t : workers) {
+    t.join();
+  }
+
+  return first_error;
+}
+
 int rgw_tools_init(CephContext *cct)
 {
   ext_mime_map = new std::map<std::string, std::string>;
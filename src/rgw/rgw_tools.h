@@ -4,11 +4,14 @@
 #ifndef CEPH_RGW_TOOLS_H
 #define CEPH_RGW_TOOLS_H
 
+#include <functional>
 #include <string>
 
 #include "include/types.h"
+#include "include/rados/librados.hpp"
 #include "common/ceph_time.h"
 #include "rgw_common.h"
+#include "rgw_yield.h"
 
 class RGWRados;
 class RGWObjectCtx;
@@ -24,6 +27,23 @@ int rgw_get_system_obj(RGWRados *rgwstore, RGWObjectCtx& obj_ctx, const rgw_pool
 int rgw_delete_system_obj(RGWRados *rgwstore, const rgw_pool& pool, const string& oid,
                           RGWObjVersionTracker *objv_tracker);
 
+/* run a rados op, suspending the request's coroutine rather than blocking
+ * the thread when it has one.  Async ops don't update
+ * IoCtx::get_last_version(), use pver instead. */
+int rgw_rados_operate(librados::IoCtx& ioctx, const std::string& oid,
+                      librados::ObjectReadOperation *op, bufferlist *pbl,
+                      optional_yield y, uint64_t *pver = nullptr);
+int rgw_rados_operate(librados::IoCtx& ioctx, const std::string& oid,
+                      librados::ObjectWriteOperation *op, optional_yield y,
+                      uint64_t *pver = nullptr);
+
+/* run process(i) for i = 0 .. num_shards-1 on up to num_workers threads,
+ * the calling one included.  Workers claim shards in turn until they run
+ * out, stop() returns true or a call fails.  Returns the first error. */
+int rgw_process_shards(int num_shards, int num_workers,
+                       const std::function<bool()>& stop,
+                       const std::function<int(int)>& process);
+
 int rgw_tools_init(CephContext *cct);
 void rgw_tools_cleanup();
 const char *rgw_find_mime_by_ext(string& ext);
@@ -0,0 +1,74 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <boost/asio/detail/bind_handler.hpp>
+
+#include "rgw_yield.h"
+
+RGWYieldWaiter::RGWYieldWaiter(optional_yield y)
+  : service(y.get_io_service()), handler(y.get_yield_context()),
+    result(handler)
+{
+}
+
+void RGWYieldWaiter::wake()
+{
+  /* the handler is dispatched through the coroutine's strand */
+  service.post(boost::asio::detail::bind_handler(handler,
+                                                 boost::system::error_code()));
+}
+
+void RGWYieldWaiter::suspend()
+{
+  result.get();
+}
+
+RGWAioWait::RGWAioWait() : lock("RGWAioWait::lock")
+{
+  c = librados::Rados::aio_create_completion(this, complete_cb, NULL);
+}
+
+RGWAioWait::~RGWAioWait()
+{
+  c->release();
+}
+
+void RGWAioWait::complete_cb(librados::completion_t cb, void *arg)
+{
+  RGWAioWait *w = static_cast<RGWAioWait *>(arg);
+  Mutex::Locker l(w->lock);
+  w->done = true;
+  if (w->waiter) {
+    w->waiter->wake();
+    w->waiter = nullptr;
+  } else {
+    w->cond.Signal();
+  }
+}
+
+bool RGWAioWait::is_done()
+{
+  Mutex::Locker l(lock);
+  return done;
+}
+
+int RGWAioWait::wait(optional_yield y)
+{
+  Mutex::Locker l(lock);
+  if (!done) {
+    if (y) {
+      RGWYieldWaiter yw(y);
+      waiter = &yw;
+      lock.Unlock();
+      yw.suspend();
+      /* retaking the lock also makes sure complete_cb is done with us
+       * before the caller can destroy us */
+      lock.Lock();
+    } else {
+      while (!done) {
+        cond.Wait(lock);
+      }
+    }
+  }
+  return c->get_return_value();
+}
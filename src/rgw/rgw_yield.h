@@ -0,0 +1,86 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef RGW_YIELD_H
+#define RGW_YIELD_H
+
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/handler_type.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/spawn.hpp>
+
+#include "include/rados/librados.hpp"
+#include "common/Mutex.h"
+#include "common/Cond.h"
+
+/*
+ * The coroutine a request is running on, if any.  The beast frontend runs
+ * every connection on a stackful coroutine and passes it down with the
+ * request, so that rados I/O done for the request suspends the coroutine
+ * rather than blocking the frontend thread.  Everything else passes
+ * null_yield and blocks as before.
+ */
+class optional_yield {
+  boost::asio::io_service *service{nullptr};
+  boost::asio::yield_context *yield{nullptr};
+public:
+  constexpr optional_yield() = default;
+  optional_yield(boost::asio::io_service& _service,
+                 boost::asio::yield_context& _yield)
+    : service(&_service), yield(&_yield) {}
+
+  explicit operator bool() const { return yield != nullptr; }
+
+  boost::asio::io_service& get_io_service() const { return *service; }
+  boost::asio::yield_context& get_yield_context() const { return *yield; }
+};
+
+constexpr optional_yield null_yield{};
+
+/*
+ * Suspends a coroutine until another thread wakes it up.  Create it on the
+ * coroutine, hand it to whoever signals the event (under the lock that
+ * protects the event), drop that lock and suspend().  wake() may come before
+ * suspend(): the coroutine runs on a strand, so it is not resumed until it
+ * has suspended.
+ */
+class RGWYieldWaiter {
+  using handler_t =
+    boost::asio::handler_type<boost::asio::yield_context,
+                              void(boost::system::error_code)>::type;
+  boost::asio::io_service& service;
+  handler_t handler;
+  boost::asio::async_result<handler_t> result;
+public:
+  explicit RGWYieldWaiter(optional_yield y);
+
+  void wake();
+  void suspend();
+};
+
+/*
+ * Waits for a single librados aio op.  Issue the op with completion(), then
+ * call wait() exactly once; the object must not go away before that.
+ */
+class RGWAioWait {
+  librados::AioCompletion *c;
+  Mutex lock;
+  Cond cond;
+  bool done{false};
+  RGWYieldWaiter *waiter{nullptr}; // set while a coroutine waits on us
+
+  static void complete_cb(librados::completion_t cb, void *arg);
+
+public:
+  RGWAioWait();
+  ~RGWAioWait();
+
+  librados::AioCompletion *completion() { return c; }
+
+  bool is_done();
+
+  /* returns the result of the op */
+  int wait(optional_yield y);
+};
+
+#endif
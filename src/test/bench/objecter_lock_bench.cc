@@ -0,0 +1,202 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+/*
+ * Models the lock traffic of the Objecter op fast path: an op submit
+ * takes the Objecter lock shared, maps the object to an OSD through
+ * the current map, looks up the OSD session and inserts the op into
+ * that session's in-flight table; the reply takes the Objecter lock
+ * shared again and removes it.  A map thread takes the lock exclusive
+ * to install a new "epoch" at a fixed interval.  Run it with each lock
+ * type and a range of thread counts to see how submission scales.
+ */
+
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "common/ceph_time.h"
+#include "common/sharded_shared_mutex.h"
+#include "include/ceph_hash.h"
+
+namespace po = boost::program_options;
+using namespace std;
+
+namespace {
+
+struct Session {
+  boost::shared_mutex lock;
+  map<uint64_t, uint64_t> ops;
+};
+
+template <typename RWLock>
+struct Client {
+  RWLock rwlock;
+  vector<int> pg_to_osd;
+  map<int, Session*> sessions;
+  uint64_t epoch = 1;
+  std::atomic<uint64_t> last_tid = { 0 };
+
+  Client(unsigned num_osds, unsigned num_pgs) : pg_to_osd(num_pgs) {
+    for (unsigned i = 0; i < num_osds; ++i)
+      sessions[i] = new Session;
+    remap();
+  }
+  ~Client() {
+    for (auto& p : sessions)
+      delete p.second;
+  }
+
+  void remap() {
+    for (unsigned pg = 0; pg < pg_to_osd.size(); ++pg)
+      pg_to_osd[pg] = (pg + epoch) % sessions.size();
+  }
+
+  Session *submit(const string& oid, uint64_t *tid) {
+    boost::shared_lock<RWLock> l(rwlock);
+    uint32_t ps = ceph_str_hash_rjenkins(oid.c_str(), oid.length());
+    int osd = pg_to_osd[ps % pg_to_osd.size()];
+    Session *s = sessions.find(osd)->second;
+    std::unique_lock<boost::shared_mutex> sl(s->lock);
+    *tid = ++last_tid;
+    s->ops[*tid] = epoch;
+    return s;
+  }
+
+  void finish(Session *s, uint64_t tid) {
+    boost::shared_lock<RWLock> l(rwlock);
+    std::unique_lock<boost::shared_mutex> sl(s->lock);
+    s->ops.erase(tid);
+  }
+
+  void new_map() {
+    std::unique_lock<RWLock> l(rwlock);
+    ++epoch;
+    remap();
+  }
+};
+
+template <typename RWLock>
+double run(unsigned num_threads, double seconds, unsigned num_osds,
+	   unsigned num_pgs, unsigned map_interval_ms)
+{
+  Client<RWLock> client(num_osds, num_pgs);
+  std::atomic<bool> stop = { false };
+  std::atomic<uint64_t> total = { 0 };
+
+  vector<thread> workers;
+  for (unsigned t = 0; t < num_threads; ++t) {
+    workers.emplace_back([&client, &stop, &total, t]() {
+	uint64_t n = 0;
+	string prefix = "rbd_data.bench." + std::to_string(t) + ".";
+	while (!stop.load(std::memory_order_relaxed)) {
+	  uint64_t tid;
+	  Session *s = client.submit(prefix + std::to_string(n & 1023), &tid);
+	  client.finish(s, tid);
+	  ++n;
+	}
+	total += n;
+      });
+  }
+
+  thread mapper([&client, &stop, map_interval_ms]() {
+      while (!stop.load(std::memory_order_relaxed)) {
+	std::this_thread::sleep_for(std::chrono::milliseconds(map_interval_ms));
+	client.new_map();
+      }
+    });
+
+  auto start = ceph::mono_clock::now();
+  std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+  stop = true;
+  for (auto& w : workers)
+    w.join();
+  mapper.join();
+  double elapsed = std::chrono::duration<double>(
+    ceph::mono_clock::now() - start).count();
+  return total / elapsed;
+}
+
+} // anonymous namespace
+
+int main(int argc, char **argv)
+{
+  po::options_description desc("Allowed options");
+  desc.add_options()
+    ("help", "produce help message")
+    ("lock", po::value<string>()->default_value("both"),
+     "lock type: boost, sharded or both")
+    ("threads", po::value<string>()->default_value("1,2,4,8,16"),
+     "comma separated list of submitting thread counts")
+    ("seconds", po::value<double>()->default_value(2.0),
+     "duration of each run")
+    ("osds", po::value<unsigned>()->default_value(64),
+     "number of OSD sessions")
+    ("pgs", po::value<unsigned>()->default_value(4096),
+     "number of placement groups")
+    ("map-interval-ms", po::value<unsigned>()->default_value(100),
+     "interval between map changes")
+    ;
+
+  po::variables_map vm;
+  try {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+  } catch (po::error &e) {
+    cerr << e.what() << std::endl;
+    return 1;
+  }
+  if (vm.count("help")) {
+    cout << desc << std::endl;
+    return 1;
+  }
+
+  string lock = vm["lock"].as<string>();
+  if (lock != "boost" && lock != "sharded" && lock != "both") {
+    cerr << "unknown lock type " << lock << std::endl;
+    return 1;
+  }
+
+  vector<unsigned> thread_counts;
+  stringstream ss(vm["threads"].as<string>());
+  string item;
+  while (getline(ss, item, ',')) {
+    int n = atoi(item.c_str());
+    if (n <= 0) {
+      cerr << "invalid thread count " << item << std::endl;
+      return 1;
+    }
+    thread_counts.push_back(n);
+  }
+
+  double seconds = vm["seconds"].as<double>();
+  unsigned osds = vm["osds"].as<unsigned>();
+  unsigned pgs = vm["pgs"].as<unsigned>();
+  unsigned interval = vm["map-interval-ms"].as<unsigned>();
+  if (osds == 0 || pgs == 0 || interval == 0) {
+    cerr << "osds, pgs and map-interval-ms must be positive" << std::endl;
+    return 1;
+  }
+
+  cout << "threads\tlock\tops/sec" << std::endl;
+  for (auto n : thread_counts) {
+    if (lock != "sharded") {
+      double rate = run<boost::shared_mutex>(n, seconds, osds, pgs, interval);
+      cout << n << "\tboost\t" << (uint64_t)rate << std::endl;
+    }
+    if (lock != "boost") {
+      double rate = run<ceph::sharded_shared_mutex>(n, seconds, osds, pgs,
+						    interval);
+      cout << n << "\tsharded\t" << (uint64_t)rate << std::endl;
+    }
+  }
+  return 0;
+}
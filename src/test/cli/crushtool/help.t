@@ -87,6 +87,8 @@
      --show-mappings       show mappings
      --show-bad-mappings   show bad mappings
      --show-choose-tries   show choose tries histogram
+     --benchmark           time the CRUSH mappings and report
+                           mappings per second
      --output-name name
                            prepend the data file(s) generated during the
                            testing routine with name
@@ -4,6 +4,7 @@
 #include "include/types.h"
 #include "cls/rgw/cls_rgw_client.h"
 #include "cls/rgw/cls_rgw_ops.h"
+#include "cls/rgw/cls_rgw_const.h"
 
 #include "gtest/gtest.h"
 #include "test/librados/test.h"
@@ -373,6 +374,56 @@ TEST(cls_rgw, index_suggest)
   test_stats(ioctx, bucket_oid, 0, num_objs / 2, total_size);
 }
 
+TEST(cls_rgw, index_resharding)
+{
+  string bucket_oid = str_int("bucket", 4);
+
+  OpMgr mgr;
+
+  ObjectWriteOperation *op = mgr.write_op();
+  cls_rgw_bucket_init(*op);
+  ASSERT_EQ(0, ioctx.operate(bucket_oid, op));
+
+  map<int, string> oids = { {0, bucket_oid} };
+
+  cls_rgw_bucket_instance_entry entry;
+  ASSERT_EQ(0, cls_rgw_get_bucket_resharding(ioctx, bucket_oid, &entry));
+  ASSERT_EQ(CLS_RGW_RESHARD_NONE, entry.reshard_status);
+
+  string obj = str_int("obj", 0);
+  string loc = str_int("loc", 0);
+
+  /* writes are accepted while entries are being copied */
+  entry.reshard_status = CLS_RGW_RESHARD_IN_PROGRESS;
+  entry.new_bucket_instance_id = "new_instance";
+  entry.num_shards = 8;
+  ASSERT_EQ(0, CLSRGWIssueSetBucketResharding(ioctx, oids, entry, 8)());
+
+  string tag = str_int("tag", 0);
+  index_prepare(mgr, ioctx, bucket_oid, CLS_RGW_OP_ADD, tag, obj, loc);
+
+  cls_rgw_bucket_instance_entry status;
+  ASSERT_EQ(0, cls_rgw_get_bucket_resharding(ioctx, bucket_oid, &status));
+  ASSERT_EQ(CLS_RGW_RESHARD_IN_PROGRESS, status.reshard_status);
+  ASSERT_EQ(string("new_instance"), status.new_bucket_instance_id);
+  ASSERT_EQ(8, status.num_shards);
+
+  /* and refused during the final pass */
+  entry.reshard_status = CLS_RGW_RESHARD_BLOCKING;
+  ASSERT_EQ(0, CLSRGWIssueSetBucketResharding(ioctx, oids, entry, 8)());
+
+  tag = str_int("tag", 1);
+  op = mgr.write_op();
+  cls_rgw_obj_key key(obj, string());
+  cls_rgw_bucket_prepare_op(*op, CLS_RGW_OP_ADD, tag, key, loc, false, 0);
+  ASSERT_EQ(-CLS_RGW_ERR_BUSY_RESHARDING, ioctx.operate(bucket_oid, op));
+
+  /* cancelled */
+  entry.clear();
+  ASSERT_EQ(0, CLSRGWIssueSetBucketResharding(ioctx, oids, entry, 8)());
+  index_prepare(mgr, ioctx, bucket_oid, CLS_RGW_OP_ADD, tag, obj, loc);
+}
+
 /* test garbage collection */
 static void create_obj(cls_rgw_obj& obj, int i, int j)
 {
@@ -266,3 +266,55 @@ TEST(Crc32c, RangeNull) {
     ASSERT_EQ(crc, *check);
   }
 }
+
+TEST(Crc32c, Multi) {
+  int len = 256 * 1024;
+  unsigned char *b = (unsigned char *)malloc(len + 1);
+  for (int i = 0; i < len + 1; i++)
+    b[i] = rand();
+  unsigned block_lens[] = { 1, 7, 8, 13, 512, 4096, 65536 };
+  uint32_t out[64];
+  for (unsigned block_len : block_lens) {
+    for (unsigned nblocks = 0;
+	 nblocks <= 64 && nblocks * block_len <= (unsigned)len;
+	 nblocks++) {
+      // start at an odd address to exercise unaligned loads
+      ceph_crc32c_multi(-1, b + 1, block_len, nblocks, out);
+      for (unsigned i = 0; i < nblocks; i++) {
+	ASSERT_EQ(ceph_crc32c(-1, b + 1 + i * block_len, block_len), out[i]);
+      }
+    }
+  }
+  free(b);
+}
+
+TEST(Crc32c, MultiPerformance) {
+  int len = 256 * 1024 * 1024;
+  char *a = (char *)malloc(len);
+  for (int i = 0; i < len; i++)
+    a[i] = i & 0xff;
+  unsigned block_lens[] = { 4096, 65536 };
+  for (unsigned block_len : block_lens) {
+    unsigned nblocks = len / block_len;
+    uint32_t *out = (uint32_t *)malloc(nblocks * sizeof(uint32_t));
+    {
+      utime_t start = ceph_clock_now();
+      for (unsigned i = 0; i < nblocks; i++)
+	out[i] = ceph_crc32c(0, (unsigned char *)a + i * block_len, block_len);
+      utime_t end = ceph_clock_now();
+      float rate = (float)len / (float)(1024*1024) / (float)(end - start);
+      std::cout << "single " << block_len << " byte blocks: " << rate
+		<< " MB/sec" << std::endl;
+    }
+    {
+      utime_t start = ceph_clock_now();
+      ceph_crc32c_multi(0, (unsigned char *)a, block_len, nblocks, out);
+      utime_t end = ceph_clock_now();
+      float rate = (float)len / (float)(1024*1024) / (float)(end - start);
+      std::cout << "multi  " << block_len << " byte blocks: " << rate
+		<< " MB/sec" << std::endl;
+    }
+    free(out);
+  }
+  free(a);
+}
@@ -0,0 +1,80 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "gtest/gtest.h"
+#include "common/MPSCQueue.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+TEST(MPSCQueue, Empty)
+{
+  ceph::MPSCQueue<int> q;
+  ASSERT_TRUE(q.empty());
+  ASSERT_EQ(0u, q.drain([](int&&) { FAIL(); }));
+}
+
+TEST(MPSCQueue, FIFO)
+{
+  ceph::MPSCQueue<int> q;
+  ASSERT_TRUE(q.push(1));
+  ASSERT_FALSE(q.push(2));
+  ASSERT_FALSE(q.push(3));
+  ASSERT_FALSE(q.empty());
+
+  std::vector<int> out;
+  ASSERT_EQ(3u, q.drain([&](int&& i) { out.push_back(i); }));
+  ASSERT_EQ((std::vector<int>{1, 2, 3}), out);
+  ASSERT_TRUE(q.empty());
+
+  // the first push after a drain reports the queue as empty again
+  ASSERT_TRUE(q.push(4));
+}
+
+TEST(MPSCQueue, MoveOnly)
+{
+  ceph::MPSCQueue<std::unique_ptr<int>> q;
+  q.push(std::unique_ptr<int>(new int(7)));
+  q.push(std::unique_ptr<int>(new int(8)));
+  int sum = 0;
+  q.drain([&](std::unique_ptr<int>&& p) { sum += *p; });
+  ASSERT_EQ(15, sum);
+
+  // items left behind are destroyed with the queue
+  q.push(std::unique_ptr<int>(new int(9)));
+}
+
+TEST(MPSCQueue, Producers)
+{
+  const int nthreads = 4;
+  const int per_thread = 100000;
+  ceph::MPSCQueue<std::pair<int, int>> q;
+
+  std::vector<std::thread> producers;
+  for (int t = 0; t < nthreads; ++t) {
+    producers.emplace_back([&q, t] {
+	for (int i = 0; i < per_thread; ++i)
+	  q.push(std::make_pair(t, i));
+      });
+  }
+
+  // each producer's items must come out in the order it pushed them
+  std::vector<int> next(nthreads, 0);
+  int total = 0;
+  auto consume = [&](std::pair<int, int>&& p) {
+    ASSERT_EQ(next[p.first], p.second);
+    ++next[p.first];
+    ++total;
+  };
+  while (total < nthreads * per_thread / 2)
+    q.drain(consume);
+  for (auto& t : producers)
+    t.join();
+  q.drain(consume);
+
+  ASSERT_EQ(nthreads * per_thread, total);
+  for (int t = 0; t < nthreads; ++t)
+    ASSERT_EQ(per_thread, next[t]);
+  ASSERT_TRUE(q.empty());
+}
@@ -0,0 +1,116 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <boost/thread/shared_mutex.hpp>
+
+#include "common/sharded_shared_mutex.h"
+#include "common/shunique_lock.h"
+
+#include "gtest/gtest.h"
+
+typedef ceph::sharded_shared_mutex_t<4> small_mutex;
+
+template<typename SharedMutex>
+static bool test_try_lock(SharedMutex* sm) {
+  if (!sm->try_lock())
+    return false;
+  sm->unlock();
+  return true;
+}
+
+template<typename SharedMutex>
+static bool test_try_lock_shared(SharedMutex* sm) {
+  if (!sm->try_lock_shared())
+    return false;
+  sm->unlock_shared();
+  return true;
+}
+
+TEST(ShardedSharedMutex, SharedExcludesUnique) {
+  small_mutex sm;
+
+  sm.lock_shared();
+  // readers on other threads, whatever their shard, get in; writers don't
+  for (int i = 0; i < 8; ++i) {
+    ASSERT_TRUE(std::async(std::launch::async, test_try_lock_shared<small_mutex>,
+			   &sm).get());
+    ASSERT_FALSE(std::async(std::launch::async, test_try_lock<small_mutex>,
+			    &sm).get());
+  }
+  sm.unlock_shared();
+
+  ASSERT_TRUE(std::async(std::launch::async, test_try_lock<small_mutex>,
+			 &sm).get());
+}
+
+TEST(ShardedSharedMutex, UniqueExcludesAll) {
+  small_mutex sm;
+
+  sm.lock();
+  for (int i = 0; i < 8; ++i) {
+    ASSERT_FALSE(std::async(std::launch::async, test_try_lock_shared<small_mutex>,
+			    &sm).get());
+    ASSERT_FALSE(std::async(std::launch::async, test_try_lock<small_mutex>,
+			    &sm).get());
+  }
+  sm.unlock();
+
+  for (int i = 0; i < 8; ++i) {
+    ASSERT_TRUE(std::async(std::launch::async, test_try_lock_shared<small_mutex>,
+			   &sm).get());
+  }
+}
+
+TEST(ShardedSharedMutex, ShuniqueLock) {
+  small_mutex sm;
+  ceph::shunique_lock<small_mutex> l(sm, ceph::acquire_shared);
+  ASSERT_TRUE(l.owns_lock_shared());
+  l.unlock();
+  l.lock();
+  ASSERT_TRUE(l.owns_lock());
+  ASSERT_FALSE(std::async(std::launch::async, test_try_lock_shared<small_mutex>,
+			  &sm).get());
+}
+
+TEST(ShardedSharedMutex, Contended) {
+  small_mutex sm;
+  uint64_t a = 0, b = 0;
+  std::atomic<bool> bad = { false };
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&sm, &a, &b, &bad, t]() {
+	for (int i = 0; i < 10000; ++i) {
+	  if (t % 4 == 0) {
+	    std::unique_lock<small_mutex> l(sm);
+	    ++a;
+	    ++b;
+	  } else {
+	    boost::shared_lock<small_mutex> l(sm);
+	    if (a != b)
+	      bad = true;
+	  }
+	}
+      });
+  }
+  for (auto& t : threads)
+    t.join();
+
+  ASSERT_FALSE(bad);
+  ASSERT_EQ(20000u, a);
+}
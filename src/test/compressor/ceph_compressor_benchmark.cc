@@ -0,0 +1,231 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph distributed storage system
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ */
+
+#include <boost/program_options/option.hpp>
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/program_options/cmdline.hpp>
+#include <boost/program_options/parsers.hpp>
+
+#include "global/global_context.h"
+#include "global/global_init.h"
+#include "common/ceph_argparse.h"
+#include "common/config.h"
+#include "common/Clock.h"
+#include "include/utime.h"
+#include "ceph_compressor_benchmark.h"
+
+namespace po = boost::program_options;
+
+int CompressorBench::setup(int argc, char** argv) {
+
+  po::options_description desc("Allowed options");
+  desc.add_options()
+    ("help,h", "produce help message")
+    ("verbose,v", "explain what happens")
+    ("size,s", po::value<int>()->default_value(4 * 1024 * 1024),
+     "size of the generated buffer to be compressed (ignored with --input)")
+    ("iterations,i", po::value<int>()->default_value(10),
+     "number of compress/decompress runs")
+    ("plugin,p", po::value<vector<string> >(),
+     "compressor plugin name (repeat to compare several, "
+     "default is every available plugin)")
+    ("input,I", po::value<vector<string> >(),
+     "file to use as sample data, e.g. from ceph-erasure-code-corpus "
+     "(repeat to concatenate several)")
+    ("workload,w", po::value<string>()->default_value("both"),
+     "run compress, decompress or both")
+    ;
+
+  po::variables_map vm;
+  po::parsed_options parsed =
+    po::command_line_parser(argc, argv).options(desc).allow_unregistered().run();
+  po::store(
+    parsed,
+    vm);
+  po::notify(vm);
+
+  vector<const char *> ceph_options, def_args;
+  vector<string> ceph_option_strings = po::collect_unrecognized(
+    parsed.options, po::include_positional);
+  ceph_options.reserve(ceph_option_strings.size());
+  for (vector<string>::iterator i = ceph_option_strings.begin();
+       i != ceph_option_strings.end();
+       ++i) {
+    ceph_options.push_back(i->c_str());
+  }
+
+  cct = global_init(
+    &def_args, ceph_options, CEPH_ENTITY_TYPE_CLIENT,
+    CODE_ENVIRONMENT_UTILITY,
+    CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+  g_ceph_context->_conf->apply_changes(NULL);
+
+  if (vm.count("help")) {
+    cout << desc << std::endl;
+    return 1;
+  }
+
+  in_size = vm["size"].as<int>();
+  max_iterations = vm["iterations"].as<int>();
+  workload = vm["workload"].as<string>();
+  if (workload != "compress" && workload != "decompress" &&
+      workload != "both") {
+    cerr << "--workload must be one of compress, decompress or both" << endl;
+    return -EINVAL;
+  }
+  if (vm.count("plugin")) {
+    plugins = vm["plugin"].as<vector<string> >();
+  } else {
+    for (int alg = Compressor::COMP_ALG_NONE + 1;
+	 alg < Compressor::COMP_ALG_LAST;
+	 ++alg) {
+      plugins.push_back(Compressor::get_comp_alg_name(alg));
+    }
+  }
+  if (vm.count("input"))
+    inputs = vm["input"].as<vector<string> >();
+
+  verbose = vm.count("verbose") > 0 ? true : false;
+
+  return 0;
+}
+
+int CompressorBench::load_input(bufferlist *in)
+{
+  if (inputs.empty()) {
+    // a mix of highly compressible text, mildly compressible
+    // random text and incompressible random bytes
+    const char *text = "There are many objects like it but this one is mine. ";
+    const char *alphabet = "abcdefghijklmnopqrstuvwxyz";
+    bufferptr bp(in_size);
+    char *p = bp.c_str();
+    size_t text_len = strlen(text);
+    for (int i = 0; i < in_size; ++i) {
+      switch ((i / 4096) % 3) {
+      case 0:
+	p[i] = text[i % text_len];
+	break;
+      case 1:
+	p[i] = alphabet[rand() % 10];
+	break;
+      default:
+	p[i] = rand();
+      }
+    }
+    in->append(bp);
+    return 0;
+  }
+
+  for (auto& i : inputs) {
+    bufferlist bl;
+    string error;
+    int r = bl.read_file(i.c_str(), &error);
+    if (r < 0) {
+      cerr << "unable to read " << i << ": " << error << endl;
+      return r;
+    }
+    in->claim_append(bl);
+  }
+  return 0;
+}
+
+int CompressorBench::bench(const string &plugin, const bufferlist &in)
+{
+  CompressorRef compressor = Compressor::create(g_ceph_context, plugin);
+  if (!compressor) {
+    cerr << "unable to load compressor plugin " << plugin << endl;
+    return -ENOENT;
+  }
+
+  bufferlist compressed;
+  int r = compressor->compress(in, compressed);
+  if (r) {
+    cerr << plugin << " compress failed with " << r << endl;
+    return r;
+  }
+  double ratio = (double)compressed.length() / in.length();
+  uint64_t total_kb = (uint64_t)max_iterations * (in.length() / 1024);
+
+  if (workload == "compress" || workload == "both") {
+    utime_t begin_time = ceph_clock_now();
+    for (int i = 0; i < max_iterations; i++) {
+      bufferlist out;
+      r = compressor->compress(in, out);
+      if (r)
+	return r;
+    }
+    utime_t end_time = ceph_clock_now();
+    cout << plugin << "\tcompress\t" << (end_time - begin_time) << "\t"
+	 << total_kb << "\t" << ratio << endl;
+  }
+
+  if (workload == "decompress" || workload == "both") {
+    utime_t begin_time = ceph_clock_now();
+    for (int i = 0; i < max_iterations; i++) {
+      bufferlist out;
+      r = compressor->decompress(compressed, out);
+      if (r)
+	return r;
+      if (verbose && i == 0 && !out.contents_equal(in)) {
+	cerr << plugin << " decompressed content differs from the input" << endl;
+	return -EIO;
+      }
+    }
+    utime_t end_time = ceph_clock_now();
+    cout << plugin << "\tdecompress\t" << (end_time - begin_time) << "\t"
+	 << total_kb << "\t" << ratio << endl;
+  }
+  return 0;
+}
+
+int CompressorBench::run() {
+  bufferlist in;
+  int r = load_input(&in);
+  if (r)
+    return r;
+  if (verbose)
+    cerr << "benchmarking " << plugins.size() << " plugins on "
+	 << in.length() << " bytes, " << max_iterations << " iterations" << endl;
+
+  for (auto& plugin : plugins) {
+    r = bench(plugin, in);
+    if (r)
+      return r;
+  }
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  CompressorBench cbench;
+  try {
+    int err = cbench.setup(argc, argv);
+    if (err)
+      return err;
+    return cbench.run();
+  } catch(po::error &e) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+}
+
+/*
+ * Local Variables:
+ * compile-command: "cd ../../../build ; make -j4 ceph_compressor_benchmark &&
+ *   ./bin/ceph_compressor_benchmark \
+ *      --plugin snappy --plugin lz4 \
+ *      --size $((4 * 1024 * 1024)) \
+ *      --iterations 10
+ * "
+ * End:
+ */
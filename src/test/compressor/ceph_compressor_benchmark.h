@@ -0,0 +1,42 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph distributed storage system
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ */
+
+#ifndef CEPH_COMPRESSOR_BENCHMARK_H
+#define CEPH_COMPRESSOR_BENCHMARK_H
+
+#include <string>
+#include <vector>
+
+#include "include/buffer.h"
+#include "compressor/Compressor.h"
+
+using namespace std;
+
+class CompressorBench {
+  int in_size;
+  int max_iterations;
+
+  vector<string> plugins;
+  vector<string> inputs;
+  string workload;
+
+  bool verbose;
+  boost::intrusive_ptr<CephContext> cct;
+
+  int load_input(bufferlist *in);
+  int bench(const string &plugin, const bufferlist &in);
+public:
+  int setup(int argc, char** argv);
+  int run();
+};
+
+#endif
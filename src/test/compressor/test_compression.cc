@@ -327,6 +327,9 @@ INSTANTIATE_TEST_CASE_P(
 #endif
     "zlib/noisal",
     "snappy",
+#ifdef HAVE_LZ4
+    "lz4",
+#endif
     "zstd"));
 
 #ifdef __x86_64__
@@ -511,6 +511,22 @@ TEST(CRUSH, straw2_stddev)
   }
 }
 
+TEST(CRUSH, hash32_3_multi) {
+  // the batched hash used by straw2 must match the scalar one for
+  // every lane, including the scalar tail
+  __s32 ids[77];
+  __u32 out[77];
+  for (unsigned n = 0; n <= 77; ++n) {
+    for (unsigned i = 0; i < n; ++i)
+      ids[i] = (i & 1) ? -(int)i * 7919 : i * 104729;
+    crush_hash32_3_multi(CRUSH_HASH_RJENKINS1, 0xdeadbeef + n, ids, 42,
+			 out, n);
+    for (unsigned i = 0; i < n; ++i)
+      ASSERT_EQ(crush_hash32_3(CRUSH_HASH_RJENKINS1, 0xdeadbeef + n,
+			       ids[i], 42), out[i]);
+  }
+}
+
 TEST(CRUSH, straw2_reweight) {
   // when we adjust the weight of an item in a straw2 bucket,
   // we should *only* see movement from or to that item, never
@@ -304,6 +304,7 @@ TYPE(rgw_bucket_dir_entry_meta)
 TYPE(rgw_bucket_dir_entry)
 TYPE(rgw_bucket_category_stats)
 TYPE(rgw_bucket_dir_header)
+TYPE(cls_rgw_bucket_instance_entry)
 TYPE(rgw_bucket_dir)
 TYPE(rgw_bucket_entry_ver)
 TYPE(cls_rgw_obj_key)
@@ -366,6 +366,114 @@ TEST_F(IsaErasureCodeTest, encode)
   }
 }
 
+TEST_F(IsaErasureCodeTest, parity_delta)
+{
+  const char *techniques[] = { "reed_sol_van", "cauchy" };
+  const char *ms[] = { "1", "3" };
+  for (auto technique : techniques) {
+    for (auto m : ms) {
+      ErasureCodeIsaDefault Isa(tcache,
+				strcmp(technique, "cauchy") ?
+				ErasureCodeIsaDefault::kVandermonde :
+				ErasureCodeIsaDefault::kCauchy);
+      ErasureCodeProfile profile;
+      profile["k"] = "4";
+      profile["m"] = m;
+      profile["technique"] = technique;
+      Isa.init(profile, &cerr);
+      EXPECT_TRUE(Isa.supports_parity_delta());
+
+      unsigned object_size = Isa.get_alignment() * 4;
+      bufferlist in;
+      for (unsigned i = 0; i < object_size; i++)
+	in.append((char)(rand() & 0xff));
+      set<int> want_to_encode;
+      for (unsigned i = 0; i < Isa.get_chunk_count(); i++)
+	want_to_encode.insert(i);
+      map<int, bufferlist> encoded;
+      EXPECT_EQ(0, Isa.encode(want_to_encode, in, &encoded));
+
+      // overwrite data chunk 2 and update the coding chunks from the delta
+      unsigned chunk_size = encoded[2].length();
+      bufferptr old_data(encoded[2].c_str(), chunk_size);
+      bufferptr new_data(chunk_size);
+      for (unsigned i = 0; i < chunk_size; i++)
+	new_data.c_str()[i] = rand() & 0xff;
+      bufferptr delta;
+      EXPECT_EQ(0, Isa.encode_delta(old_data, new_data, &delta));
+      map<int, bufferptr> deltas;
+      deltas[2] = delta;
+      map<int, bufferptr> coding;
+      for (unsigned i = 4; i < Isa.get_chunk_count(); i++)
+	coding[i] = bufferptr(encoded[i].c_str(), chunk_size);
+      EXPECT_EQ(0, Isa.apply_delta(deltas, coding));
+
+      // the result must match encoding the updated object from scratch
+      bufferlist updated;
+      updated.substr_of(in, 0, 2 * chunk_size);
+      updated.append(new_data);
+      bufferlist tail;
+      tail.substr_of(in, 3 * chunk_size, in.length() - 3 * chunk_size);
+      updated.append(tail);
+      map<int, bufferlist> reencoded;
+      EXPECT_EQ(0, Isa.encode(want_to_encode, updated, &reencoded));
+      for (unsigned i = 4; i < Isa.get_chunk_count(); i++)
+	EXPECT_EQ(0, memcmp(coding[i].c_str(), reencoded[i].c_str(),
+			    chunk_size));
+    }
+  }
+}
+
+TEST_F(IsaErasureCodeTest, encode_decode_stripes)
+{
+  const char *ms[] = { "1", "3" };
+  for (auto m : ms) {
+    ErasureCodeIsaDefault Isa(tcache);
+    ErasureCodeProfile profile;
+    profile["k"] = "4";
+    profile["m"] = m;
+    Isa.init(profile, &cerr);
+
+    unsigned stripe_width = Isa.get_alignment() * 4 * 2;
+    unsigned chunk_size = stripe_width / 4;
+    unsigned stripes = 5;
+    bufferlist in;
+    for (unsigned i = 0; i < stripe_width * stripes; i++)
+      in.append((char)(rand() & 0xff));
+    set<int> want_to_encode;
+    for (unsigned i = 0; i < Isa.get_chunk_count(); i++)
+      want_to_encode.insert(i);
+
+    // encoding all stripes at once matches encoding them one by one
+    map<int, bufferlist> encoded;
+    EXPECT_EQ(0, Isa.encode_stripes(want_to_encode, stripe_width,
+				    in, &encoded));
+    EXPECT_EQ(Isa.get_chunk_count(), encoded.size());
+    for (unsigned s = 0; s < stripes; s++) {
+      bufferlist stripe;
+      stripe.substr_of(in, s * stripe_width, stripe_width);
+      map<int, bufferlist> expected;
+      EXPECT_EQ(0, Isa.encode(want_to_encode, stripe, &expected));
+      for (unsigned i = 0; i < Isa.get_chunk_count(); i++) {
+	ASSERT_EQ(chunk_size * stripes, encoded[i].length());
+	bufferlist chunk;
+	chunk.substr_of(encoded[i], s * chunk_size, chunk_size);
+	EXPECT_TRUE(chunk.contents_equal(expected[i]));
+      }
+    }
+
+    // recover a data chunk of every stripe
+    map<int, bufferlist> chunks = encoded;
+    chunks.erase(2);
+    set<int> want_to_read;
+    want_to_read.insert(2);
+    map<int, bufferlist> decoded;
+    EXPECT_EQ(0, Isa.decode_stripes(want_to_read, chunks, chunk_size,
+				    &decoded));
+    EXPECT_TRUE(decoded[2].contents_equal(encoded[2]));
+  }
+}
+
 TEST_F(IsaErasureCodeTest, sanity_check_k)
 {
   ErasureCodeIsaDefault Isa(tcache);
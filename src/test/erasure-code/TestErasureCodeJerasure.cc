@@ -227,6 +227,111 @@ TYPED_TEST(ErasureCodeTest, minimum_to_decode)
   }
 }
 
+TYPED_TEST(ErasureCodeTest, parity_delta)
+{
+  TypeParam jerasure;
+  ErasureCodeProfile profile;
+  profile["k"] = "4";
+  profile["m"] = "2";
+  profile["packetsize"] = "8";
+  jerasure.init(profile, &cerr);
+
+  unsigned object_size = jerasure.get_chunk_size(1) * 4 * 8;
+  bufferlist in;
+  for (unsigned i = 0; i < object_size; i++)
+    in.append((char)(rand() & 0xff));
+  set<int> want_to_encode;
+  for (unsigned i = 0; i < jerasure.get_chunk_count(); i++)
+    want_to_encode.insert(i);
+  map<int, bufferlist> encoded;
+  EXPECT_EQ(0, jerasure.encode(want_to_encode, in, &encoded));
+
+  if (!jerasure.supports_parity_delta()) {
+    map<int, bufferptr> deltas, coding;
+    EXPECT_EQ(-EOPNOTSUPP, jerasure.apply_delta(deltas, coding));
+    return;
+  }
+
+  // overwrite data chunk 1 and update the coding chunks from the delta
+  unsigned chunk_size = encoded[1].length();
+  ASSERT_EQ(object_size, chunk_size * 4);
+  bufferptr old_data(encoded[1].c_str(), chunk_size);
+  bufferptr new_data(chunk_size);
+  for (unsigned i = 0; i < chunk_size; i++)
+    new_data.c_str()[i] = rand() & 0xff;
+  bufferptr delta;
+  EXPECT_EQ(0, jerasure.encode_delta(old_data, new_data, &delta));
+  map<int, bufferptr> deltas;
+  deltas[1] = delta;
+  map<int, bufferptr> coding;
+  for (int i = 4; i < 6; i++)
+    coding[i] = bufferptr(encoded[i].c_str(), chunk_size);
+  EXPECT_EQ(0, jerasure.apply_delta(deltas, coding));
+
+  // the result must match encoding the updated object from scratch
+  bufferlist updated;
+  updated.substr_of(in, 0, chunk_size);
+  updated.append(new_data);
+  bufferlist tail;
+  tail.substr_of(in, 2 * chunk_size, in.length() - 2 * chunk_size);
+  updated.append(tail);
+  map<int, bufferlist> reencoded;
+  EXPECT_EQ(0, jerasure.encode(want_to_encode, updated, &reencoded));
+  for (int i = 4; i < 6; i++)
+    EXPECT_EQ(0, memcmp(coding[i].c_str(), reencoded[i].c_str(), chunk_size));
+}
+
+TYPED_TEST(ErasureCodeTest, encode_decode_stripes)
+{
+  TypeParam jerasure;
+  ErasureCodeProfile profile;
+  profile["k"] = "4";
+  profile["m"] = "2";
+  profile["packetsize"] = "8";
+  jerasure.init(profile, &cerr);
+
+  unsigned stripe_width = jerasure.get_chunk_size(1) * 4;
+  unsigned chunk_size = stripe_width / 4;
+  unsigned stripes = 5;
+  bufferlist in;
+  for (unsigned i = 0; i < stripe_width * stripes; i++)
+    in.append((char)(rand() & 0xff));
+  set<int> want_to_encode;
+  for (unsigned i = 0; i < jerasure.get_chunk_count(); i++)
+    want_to_encode.insert(i);
+
+  // encoding all stripes at once matches encoding them one by one
+  map<int, bufferlist> encoded;
+  EXPECT_EQ(0, jerasure.encode_stripes(want_to_encode, stripe_width,
+				       in, &encoded));
+  EXPECT_EQ(6u, encoded.size());
+  for (unsigned s = 0; s < stripes; s++) {
+    bufferlist stripe;
+    stripe.substr_of(in, s * stripe_width, stripe_width);
+    map<int, bufferlist> expected;
+    EXPECT_EQ(0, jerasure.encode(want_to_encode, stripe, &expected));
+    for (int i = 0; i < 6; i++) {
+      ASSERT_EQ(chunk_size * stripes, encoded[i].length());
+      bufferlist chunk;
+      chunk.substr_of(encoded[i], s * chunk_size, chunk_size);
+      EXPECT_TRUE(chunk.contents_equal(expected[i]));
+    }
+  }
+
+  // recover two chunks of every stripe
+  map<int, bufferlist> chunks = encoded;
+  chunks.erase(1);
+  chunks.erase(4);
+  set<int> want_to_read;
+  want_to_read.insert(1);
+  want_to_read.insert(4);
+  map<int, bufferlist> decoded;
+  EXPECT_EQ(0, jerasure.decode_stripes(want_to_read, chunks, chunk_size,
+				       &decoded));
+  EXPECT_TRUE(decoded[1].contents_equal(encoded[1]));
+  EXPECT_TRUE(decoded[4].contents_equal(encoded[4]));
+}
+
 TEST(ErasureCodeTest, encode)
 {
   ErasureCodeJerasureReedSolomonVandermonde jerasure;
@@ -61,6 +61,12 @@ int ErasureCodeBench::setup(int argc, char** argv) {
      " the first chunk, then the second etc.)")
     ("parameter,P", po::value<vector<string> >(),
      "add a parameter to the erasure code profile")
+    ("stripe-width", po::value<int>()->default_value(0),
+     "if not zero, handle the buffer as consecutive stripes of this size, "
+     " the way the OSD does, instead of as a single object")
+    ("batch", po::value<int>()->default_value(1),
+     "number of stripes given to each encode_stripes/decode_stripes call "
+     " when --stripe-width is set. If 0, call encode/decode once per stripe")
     ;
 
   po::variables_map vm;
@@ -120,6 +126,8 @@ int ErasureCodeBench::setup(int argc, char** argv) {
     exhaustive_erasures = false;
   if (vm.count("erased") > 0)
     erased = vm["erased"].as<vector<int> >();
+  stripe_width = vm["stripe-width"].as<int>();
+  batch = vm["batch"].as<int>();
 
   k = atoi(profile["k"].c_str());
   m = atoi(profile["m"].c_str());
@@ -132,6 +140,18 @@ int ErasureCodeBench::setup(int argc, char** argv) {
     return -EINVAL;
   } 
 
+  if (stripe_width < 0 || batch < 0) {
+    cout << "--stripe-width and --batch must be >= 0" << endl;
+    return -EINVAL;
+  } else if (stripe_width > 0 && in_size % stripe_width) {
+    cout << "size " << in_size << " is not a multiple of stripe width "
+	 << stripe_width << endl;
+    return -EINVAL;
+  } else if (stripe_width > 0 && exhaustive_erasures) {
+    cout << "--stripe-width cannot be used with exhaustive erasures" << endl;
+    return -EINVAL;
+  }
+
   verbose = vm.count("verbose") > 0 ? true : false;
 
   return 0;
@@ -179,15 +199,88 @@ int ErasureCodeBench::encode()
   utime_t begin_time = ceph_clock_now();
   for (int i = 0; i < max_iterations; i++) {
     map<int,bufferlist> encoded;
-    code = erasure_code->encode(want_to_encode, in, &encoded);
+    if (stripe_width > 0)
+      code = encode_stripes(erasure_code, want_to_encode, in, &encoded);
+    else
+      code = erasure_code->encode(want_to_encode, in, &encoded);
     if (code)
       return code;
   }
   utime_t end_time = ceph_clock_now();
-  cout << (end_time - begin_time) << "\t" << (max_iterations * (in_size / 1024)) << endl;
+  report(end_time - begin_time);
   return 0;
 }
 
+int ErasureCodeBench::encode_stripes(ErasureCodeInterfaceRef erasure_code,
+				     const set<int> &want_to_encode,
+				     const bufferlist &in,
+				     map<int,bufferlist> *encoded)
+{
+  unsigned step = stripe_width * (batch > 0 ? batch : 1);
+  for (unsigned offset = 0; offset < in.length(); offset += step) {
+    bufferlist stripes;
+    stripes.substr_of(in, offset, MIN(step, in.length() - offset));
+    map<int,bufferlist> chunks;
+    int code;
+    if (batch > 0)
+      code = erasure_code->encode_stripes(want_to_encode, stripe_width,
+					  stripes, &chunks);
+    else
+      code = erasure_code->encode(want_to_encode, stripes, &chunks);
+    if (code)
+      return code;
+    for (map<int,bufferlist>::iterator i = chunks.begin();
+	 i != chunks.end();
+	 ++i)
+      (*encoded)[i->first].claim_append(i->second);
+  }
+  return 0;
+}
+
+int ErasureCodeBench::decode_stripes(ErasureCodeInterfaceRef erasure_code,
+				     const set<int> &want_to_read,
+				     const map<int,bufferlist> &chunks,
+				     map<int,bufferlist> *decoded)
+{
+  unsigned chunk_size = erasure_code->get_chunk_size(stripe_width);
+  unsigned length = chunks.begin()->second.length();
+  unsigned step = chunk_size * (batch > 0 ? batch : 1);
+  for (unsigned offset = 0; offset < length; offset += step) {
+    map<int,bufferlist> stripes;
+    for (map<int,bufferlist>::const_iterator i = chunks.begin();
+	 i != chunks.end();
+	 ++i)
+      stripes[i->first].substr_of(i->second, offset,
+				  MIN(step, length - offset));
+    map<int,bufferlist> out;
+    int code;
+    if (batch > 0)
+      code = erasure_code->decode_stripes(want_to_read, stripes, chunk_size,
+					  &out);
+    else
+      code = erasure_code->decode(want_to_read, stripes, &out);
+    if (code)
+      return code;
+    for (set<int>::const_iterator i = want_to_read.begin();
+	 i != want_to_read.end();
+	 ++i)
+      (*decoded)[*i].claim_append(out[*i]);
+  }
+  return 0;
+}
+
+void ErasureCodeBench::report(utime_t elapsed)
+{
+  cout << elapsed << "\t" << (max_iterations * (in_size / 1024));
+  // bench.sh parses the first two columns, only add the throughput
+  // when benchmarking stripes
+  if (stripe_width > 0) {
+    double bytes = (double)max_iterations * in_size;
+    cout << "\t" << (bytes / (double)elapsed / (1024 * 1024 * 1024)) << " GB/s";
+  }
+  cout << endl;
+}
+
 static void display_chunks(const map<int,bufferlist> &chunks,
 			   unsigned int chunk_count) {
   cout << "chunks ";
@@ -281,7 +374,10 @@ int ErasureCodeBench::decode()
   }
 
   map<int,bufferlist> encoded;
-  code = erasure_code->encode(want_to_encode, in, &encoded);
+  if (stripe_width > 0)
+    code = encode_stripes(erasure_code, want_to_encode, in, &encoded);
+  else
+    code = erasure_code->encode(want_to_encode, in, &encoded);
   if (code)
     return code;
 
@@ -303,7 +399,10 @@ int ErasureCodeBench::decode()
 	return code;
     } else if (erased.size() > 0) {
       map<int,bufferlist> decoded;
-      code = erasure_code->decode(want_to_read, encoded, &decoded);
+      if (stripe_width > 0)
+	code = decode_stripes(erasure_code, want_to_read, encoded, &decoded);
+      else
+	code = erasure_code->decode(want_to_read, encoded, &decoded);
       if (code)
 	return code;
     } else {
@@ -316,13 +415,16 @@ int ErasureCodeBench::decode()
 	chunks.erase(erasure);
       }
       map<int,bufferlist> decoded;
-      code = erasure_code->decode(want_to_read, chunks, &decoded);
+      if (stripe_width > 0)
+	code = decode_stripes(erasure_code, want_to_read, chunks, &decoded);
+      else
+	code = erasure_code->decode(want_to_read, chunks, &decoded);
       if (code)
 	return code;
     }
   }
   utime_t end_time = ceph_clock_now();
-  cout << (end_time - begin_time) << "\t" << (max_iterations * (in_size / 1024)) << endl;
+  report(end_time - begin_time);
   return 0;
 }
 
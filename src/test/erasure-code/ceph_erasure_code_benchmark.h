@@ -28,6 +28,8 @@ class ErasureCodeBench {
   int erasures;
   int k;
   int m;
+  int stripe_width;
+  int batch;
 
   string plugin;
 
@@ -49,6 +51,15 @@ public:
 		      ErasureCodeInterfaceRef erasure_code);
   int decode();
   int encode();
+  int encode_stripes(ErasureCodeInterfaceRef erasure_code,
+		     const set<int> &want_to_encode,
+		     const bufferlist &in,
+		     map<int,bufferlist> *encoded);
+  int decode_stripes(ErasureCodeInterfaceRef erasure_code,
+		     const set<int> &want_to_read,
+		     const map<int,bufferlist> &chunks,
+		     map<int,bufferlist> *decoded);
+  void report(utime_t elapsed);
 };
 
 #endif
@@ -22,6 +22,10 @@
 #include <dirent.h>
 #include <sys/xattr.h>
 
+#include <string>
+#include <utility>
+#include <vector>
+
 TEST(LibCephFS, MulticlientSimple) {
   struct ceph_mount_info *ca, *cb;
   ASSERT_EQ(ceph_create(&ca, NULL), 0);
@@ -95,3 +99,136 @@ TEST(LibCephFS, MulticlientHoleEOF) {
   ceph_shutdown(ca);
   ceph_shutdown(cb);
 }
+
+static void readdirplus_sizes(struct ceph_mount_info *cmount,
+			      struct ceph_dir_result *dirp,
+			      std::vector<std::pair<std::string, uint64_t> > *found)
+{
+  while (true) {
+    struct dirent rdent;
+    struct ceph_statx stx;
+    int len = ceph_readdirplus_r(cmount, dirp, &rdent, &stx,
+				 CEPH_STATX_SIZE, 0, NULL);
+    if (len == 0)
+      break;
+    ASSERT_EQ(1, len);
+    if (strcmp(rdent.d_name, ".") == 0 || strcmp(rdent.d_name, "..") == 0)
+      continue;
+    ASSERT_TRUE(stx.stx_mask & CEPH_STATX_SIZE);
+    found->push_back(std::make_pair(std::string(rdent.d_name), stx.stx_size));
+  }
+}
+
+TEST(LibCephFS, MulticlientReaddirplusStatMaxAge) {
+  struct ceph_mount_info *ca, *cb;
+  ASSERT_EQ(ceph_create(&ca, NULL), 0);
+  ASSERT_EQ(ceph_conf_read_file(ca, NULL), 0);
+  ASSERT_EQ(0, ceph_conf_parse_env(ca, NULL));
+  ASSERT_EQ(0, ceph_conf_set(ca, "client_readdir_stat_max_age", "1"));
+  ASSERT_EQ(ceph_mount(ca, NULL), 0);
+
+  ASSERT_EQ(ceph_create(&cb, NULL), 0);
+  ASSERT_EQ(ceph_conf_read_file(cb, NULL), 0);
+  ASSERT_EQ(0, ceph_conf_parse_env(cb, NULL));
+  ASSERT_EQ(ceph_mount(cb, NULL), 0);
+
+  const int num_files = 20;
+  char dir[64];
+  snprintf(dir, sizeof(dir), "readdirplus_max_age.%d", getpid());
+  ASSERT_EQ(0, ceph_mkdir(cb, dir, 0755));
+  char path[128];
+  for (int i = 0; i < num_files; ++i) {
+    snprintf(path, sizeof(path), "%s/f%d", dir, i);
+    int fd = ceph_open(cb, path, O_CREAT|O_RDWR, 0644);
+    ASSERT_LE(0, fd);
+    ASSERT_EQ(0, ceph_close(cb, fd));
+    ASSERT_EQ(0, ceph_truncate(cb, path, i));
+  }
+
+  // pull the first chunk into ca's readdir buffer
+  struct ceph_dir_result *dirp;
+  ASSERT_EQ(0, ceph_opendir(ca, dir, &dirp));
+  struct dirent rdent;
+  struct ceph_statx stx;
+  do {
+    ASSERT_EQ(1, ceph_readdirplus_r(ca, dirp, &rdent, &stx,
+				    CEPH_STATX_SIZE, 0, NULL));
+  } while (rdent.d_name[0] == '.');
+
+  for (int i = 0; i < num_files; ++i) {
+    snprintf(path, sizeof(path), "%s/f%d", dir, i);
+    ASSERT_EQ(0, ceph_truncate(cb, path, i + 1000));
+  }
+
+  // once the buffer is older than client_readdir_stat_max_age, the rest
+  // of the entries have to show the new sizes
+  sleep(2);
+  std::vector<std::pair<std::string, uint64_t> > found;
+  readdirplus_sizes(ca, dirp, &found);
+  ASSERT_EQ((size_t)num_files - 1, found.size());
+  for (auto& f : found) {
+    int i;
+    ASSERT_EQ(1, sscanf(f.first.c_str(), "f%d", &i));
+    ASSERT_EQ((uint64_t)i + 1000, f.second);
+  }
+  ASSERT_EQ(0, ceph_closedir(ca, dirp));
+
+  ceph_shutdown(ca);
+  ceph_shutdown(cb);
+}
+
+TEST(LibCephFS, MulticlientReaddirplusCachedDir) {
+  struct ceph_mount_info *ca, *cb;
+  ASSERT_EQ(ceph_create(&ca, NULL), 0);
+  ASSERT_EQ(ceph_conf_read_file(ca, NULL), 0);
+  ASSERT_EQ(0, ceph_conf_parse_env(ca, NULL));
+  ASSERT_EQ(0, ceph_conf_set(ca, "client_readdir_stat_max_age", "1"));
+  ASSERT_EQ(ceph_mount(ca, NULL), 0);
+
+  ASSERT_EQ(ceph_create(&cb, NULL), 0);
+  ASSERT_EQ(ceph_conf_read_file(cb, NULL), 0);
+  ASSERT_EQ(0, ceph_conf_parse_env(cb, NULL));
+  ASSERT_EQ(ceph_mount(cb, NULL), 0);
+
+  const int num_files = 50;
+  char dir[64];
+  snprintf(dir, sizeof(dir), "readdirplus_cached.%d", getpid());
+  ASSERT_EQ(0, ceph_mkdir(cb, dir, 0755));
+  char path[128];
+  for (int i = 0; i < num_files; ++i) {
+    snprintf(path, sizeof(path), "%s/f%d", dir, i);
+    int fd = ceph_open(cb, path, O_CREAT|O_RDWR, 0644);
+    ASSERT_LE(0, fd);
+    ASSERT_EQ(0, ceph_close(cb, fd));
+    ASSERT_EQ(0, ceph_truncate(cb, path, i));
+  }
+
+  // a full listing leaves the directory complete in ca's readdir cache
+  struct ceph_dir_result *dirp;
+  ASSERT_EQ(0, ceph_opendir(ca, dir, &dirp));
+  std::vector<std::pair<std::string, uint64_t> > first;
+  readdirplus_sizes(ca, dirp, &first);
+  ASSERT_EQ((size_t)num_files, first.size());
+
+  // changing the files revokes any caps ca got on them, so walking the
+  // cached directory has to fall back to a readdir from the MDS
+  for (int i = 0; i < num_files; ++i) {
+    snprintf(path, sizeof(path), "%s/f%d", dir, i);
+    ASSERT_EQ(0, ceph_truncate(cb, path, i + 1000));
+  }
+
+  ceph_rewinddir(ca, dirp);
+  std::vector<std::pair<std::string, uint64_t> > second;
+  readdirplus_sizes(ca, dirp, &second);
+  ASSERT_EQ(first.size(), second.size());
+  for (size_t n = 0; n < first.size(); ++n) {
+    ASSERT_EQ(first[n].first, second[n].first);
+    int i;
+    ASSERT_EQ(1, sscanf(second[n].first.c_str(), "f%d", &i));
+    ASSERT_EQ((uint64_t)i + 1000, second[n].second);
+  }
+  ASSERT_EQ(0, ceph_closedir(ca, dirp));
+
+  ceph_shutdown(ca);
+  ceph_shutdown(cb);
+}
@@ -0,0 +1,177 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "test/librbd/test_fixture.h"
+#include "test/librbd/test_support.h"
+#include "include/buffer.h"
+#include "common/Cond.h"
+#include "librbd/cache/SharedParentCache.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace librbd {
+namespace cache {
+
+class TestSharedParentCache : public TestFixture {
+public:
+  void SetUp() override {
+    TestFixture::SetUp();
+    m_cct = reinterpret_cast<CephContext*>(m_ioctx.cct());
+
+    char path[] = "/tmp/test_shared_parent_cache.XXXXXX";
+    ASSERT_TRUE(mkdtemp(path) != nullptr);
+    m_path = path;
+  }
+
+  void TearDown() override {
+    // the cache directory is flat
+    DIR *dir = opendir(m_path.c_str());
+    ASSERT_TRUE(dir != nullptr);
+    struct dirent *de;
+    while ((de = readdir(dir)) != nullptr) {
+      std::string name = de->d_name;
+      if (name != "." && name != "..") {
+        EXPECT_EQ(0, unlink((m_path + "/" + name).c_str()));
+      }
+    }
+    closedir(dir);
+    ASSERT_EQ(0, rmdir(m_path.c_str()));
+    TestFixture::TearDown();
+  }
+
+  CephContext *m_cct;
+  std::string m_path;
+};
+
+TEST_F(TestSharedParentCache, Miss) {
+  SharedParentCache cache(m_cct, m_path);
+
+  bufferlist bl;
+  ASSERT_EQ(-ENOENT, cache.read(1, "abc", 4, 0, 0, 4096, &bl));
+}
+
+TEST_F(TestSharedParentCache, ReadWrite) {
+  SharedParentCache cache(m_cct, m_path);
+
+  bufferlist data;
+  data.append(std::string(8192, '1'));
+  data.append(std::string(4096, '2'));
+  cache.write(1, "abc", 4, 7, data);
+
+  bufferlist bl;
+  ASSERT_EQ(4096, cache.read(1, "abc", 4, 7, 6144, 4096, &bl));
+  bufferlist expected;
+  expected.append(std::string(2048, '1'));
+  expected.append(std::string(2048, '2'));
+  ASSERT_TRUE(expected.contents_equal(bl));
+
+  // reads past the end of the object are short
+  ASSERT_EQ(2048, cache.read(1, "abc", 4, 7, 10240, 4096, &bl));
+  ASSERT_EQ(0, cache.read(1, "abc", 4, 7, 16384, 4096, &bl));
+  ASSERT_EQ(0U, bl.length());
+
+  // other snapshots, objects and images are separate
+  ASSERT_EQ(-ENOENT, cache.read(1, "abc", 5, 7, 0, 4096, &bl));
+  ASSERT_EQ(-ENOENT, cache.read(1, "abc", 4, 8, 0, 4096, &bl));
+  ASSERT_EQ(-ENOENT, cache.read(1, "abd", 4, 7, 0, 4096, &bl));
+  ASSERT_EQ(-ENOENT, cache.read(2, "abc", 4, 7, 0, 4096, &bl));
+}
+
+TEST_F(TestSharedParentCache, Shared) {
+  SharedParentCache cache1(m_cct, m_path);
+  SharedParentCache cache2(m_cct, m_path);
+
+  bufferlist data;
+  data.append(std::string(4096, 'x'));
+  cache1.write(1, "abc", 4, 0, data);
+
+  bufferlist bl;
+  ASSERT_EQ(4096, cache2.read(1, "abc", 4, 0, 0, 4096, &bl));
+  ASSERT_TRUE(data.contents_equal(bl));
+}
+
+TEST_F(TestSharedParentCache, CoalescedFetch) {
+  bufferlist data;
+  data.append(std::string(8192, 'y'));
+
+  {
+    SharedParentCache cache(m_cct, m_path);
+
+    // only the first miss fetches
+    bufferlist bl1, bl2;
+    C_SaferCond ctx1, ctx2;
+    ASSERT_TRUE(cache.start_fetch(1, "abc", 4, 3, &bl1, &ctx1));
+    ASSERT_FALSE(cache.start_fetch(1, "abc", 4, 3, &bl2, &ctx2));
+
+    // another object is fetched separately
+    bufferlist bl3;
+    C_SaferCond ctx3;
+    ASSERT_TRUE(cache.start_fetch(1, "abc", 4, 4, &bl3, &ctx3));
+    cache.finish_fetch(1, "abc", 4, 4, -ENOENT, bl3);
+    ASSERT_EQ(-ENOENT, ctx3.wait());
+
+    bl1 = data;
+    cache.finish_fetch(1, "abc", 4, 3, 0, bl1);
+    ASSERT_EQ(0, ctx1.wait());
+    ASSERT_EQ(0, ctx2.wait());
+    ASSERT_TRUE(data.contents_equal(bl1));
+    ASSERT_TRUE(data.contents_equal(bl2));
+
+    // served from memory or from the file, depending on the publisher
+    bufferlist bl;
+    ASSERT_EQ(4096, cache.read(1, "abc", 4, 3, 4096, 8192, &bl));
+  }
+
+  // destroying the cache waited for the object to be published
+  SharedParentCache cache(m_cct, m_path);
+  bufferlist bl;
+  ASSERT_EQ(8192, cache.read(1, "abc", 4, 3, 0, 8192, &bl));
+  ASSERT_TRUE(data.contents_equal(bl));
+  ASSERT_EQ(-ENOENT, cache.read(1, "abc", 4, 4, 0, 8192, &bl));
+}
+
+TEST_F(TestSharedParentCache, UnsafeFile) {
+  SharedParentCache cache(m_cct, m_path);
+
+  bufferlist data;
+  data.append(std::string(4096, 'z'));
+  cache.write(1, "abc", 4, 0, data);
+
+  // files others may have written are misses
+  std::string name = m_path + "/1.abc.4.0000000000000000";
+  ASSERT_EQ(0, chmod(name.c_str(), 0666));
+  bufferlist bl;
+  ASSERT_EQ(-ENOENT, cache.read(1, "abc", 4, 0, 0, 4096, &bl));
+
+  // and so are links
+  ASSERT_EQ(0, chmod(name.c_str(), 0600));
+  ASSERT_EQ(0, symlink(name.c_str(),
+                       (m_path + "/1.abc.4.0000000000000001").c_str()));
+  ASSERT_EQ(-ENOENT, cache.read(1, "abc", 4, 1, 0, 4096, &bl));
+  ASSERT_EQ(4096, cache.read(1, "abc", 4, 0, 0, 4096, &bl));
+}
+
+TEST_F(TestSharedParentCache, UnsafeDirectory) {
+  ASSERT_EQ(0, chmod(m_path.c_str(), 0777));
+  {
+    SharedParentCache cache(m_cct, m_path);
+
+    bufferlist data;
+    data.append(std::string(4096, 'z'));
+    cache.write(1, "abc", 4, 0, data);
+
+    bufferlist bl;
+    ASSERT_EQ(-ENOENT, cache.read(1, "abc", 4, 0, 0, 4096, &bl));
+  }
+  ASSERT_EQ(0, chmod(m_path.c_str(), 0700));
+
+  // nothing was written there
+  SharedParentCache cache(m_cct, m_path);
+  bufferlist bl;
+  ASSERT_EQ(-ENOENT, cache.read(1, "abc", 4, 0, 0, 4096, &bl));
+}
+
+} // namespace cache
+} // namespace librbd
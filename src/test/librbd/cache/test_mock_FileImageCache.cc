@@ -0,0 +1,590 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "test/librbd/test_mock_fixture.h"
+#include "test/librbd/test_support.h"
+#include "test/librbd/mock/MockImageCtx.h"
+#include "test/librbd/mock/MockExclusiveLock.h"
+#include "common/Cond.h"
+#include "include/stringify.h"
+#include "librbd/cache/FileImageCache.h"
+#include "librbd/managed_lock/GetLockerRequest.h"
+#include <atomic>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace librbd {
+namespace {
+
+struct MockTestImageCtx : public MockImageCtx {
+  MockTestImageCtx(ImageCtx &image_ctx) : MockImageCtx(image_ctx) {
+  }
+};
+
+} // anonymous namespace
+
+namespace managed_lock {
+
+template <>
+struct GetLockerRequest<librbd::MockTestImageCtx> {
+  Locker *locker;
+  Context *on_finish;
+
+  static GetLockerRequest *s_instance;
+  static GetLockerRequest* create(librados::IoCtx& ioctx,
+                                  const std::string& oid, bool exclusive,
+                                  Locker *locker, Context *on_finish) {
+    assert(s_instance != nullptr);
+    s_instance->locker = locker;
+    s_instance->on_finish = on_finish;
+    return s_instance;
+  }
+
+  GetLockerRequest() {
+    s_instance = this;
+  }
+
+  MOCK_METHOD0(send, void());
+};
+
+GetLockerRequest<librbd::MockTestImageCtx> *GetLockerRequest<librbd::MockTestImageCtx>::s_instance = nullptr;
+
+} // namespace managed_lock
+
+namespace cache {
+
+template <>
+struct ImageWriteback<librbd::MockTestImageCtx> {
+  typedef std::vector<std::pair<uint64_t,uint64_t> > Extents;
+
+  static ImageWriteback* s_instance;
+
+  ImageWriteback(librbd::MockTestImageCtx &image_ctx) {
+    s_instance = this;
+  }
+
+  MOCK_METHOD4(aio_read_mock, void(const Extents &, ceph::bufferlist *, int,
+                                   Context *));
+  void aio_read(Extents &&image_extents, ceph::bufferlist *bl,
+                int fadvise_flags, Context *on_finish) {
+    aio_read_mock(image_extents, bl, fadvise_flags, on_finish);
+  }
+
+  MOCK_METHOD4(aio_write_mock, void(const Extents &, const ceph::bufferlist &,
+                                    int, Context *));
+  void aio_write(Extents &&image_extents, ceph::bufferlist &&bl,
+                 int fadvise_flags, Context *on_finish) {
+    aio_write_mock(image_extents, bl, fadvise_flags, on_finish);
+  }
+
+  MOCK_METHOD4(aio_discard, void(uint64_t, uint64_t, bool, Context *));
+  MOCK_METHOD1(aio_flush, void(Context *));
+
+  MOCK_METHOD5(aio_writesame_mock, void(uint64_t, uint64_t,
+                                        const ceph::bufferlist &, int,
+                                        Context *));
+  void aio_writesame(uint64_t offset, uint64_t length, ceph::bufferlist &&bl,
+                     int fadvise_flags, Context *on_finish) {
+    aio_writesame_mock(offset, length, bl, fadvise_flags, on_finish);
+  }
+};
+
+ImageWriteback<librbd::MockTestImageCtx>* ImageWriteback<librbd::MockTestImageCtx>::s_instance = nullptr;
+
+} // namespace cache
+} // namespace librbd
+
+#include "librbd/cache/FileImageCache.cc"
+
+namespace librbd {
+namespace cache {
+
+using ::testing::_;
+using ::testing::InSequence;
+using ::testing::Invoke;
+
+static const uint64_t IMAGE_SIZE = 1 << 20;
+
+struct TestMockCacheFileImageCache : public TestMockFixture {
+  typedef FileImageCache<librbd::MockTestImageCtx> MockFileImageCache;
+  typedef ImageWriteback<librbd::MockTestImageCtx> MockImageWriteback;
+  typedef managed_lock::GetLockerRequest<librbd::MockTestImageCtx> MockGetLockerRequest;
+  typedef std::vector<std::pair<uint64_t,uint64_t> > Extents;
+
+  std::string m_path;
+  std::string m_image_data;
+  std::atomic<int> m_image_writes{0};
+
+  void SetUp() override {
+    TestMockFixture::SetUp();
+
+    char path[] = "/tmp/test_mock_file_image_cache.XXXXXX";
+    ASSERT_TRUE(mkdtemp(path) != nullptr);
+    m_path = path;
+    m_image_data.assign(IMAGE_SIZE, '\0');
+  }
+
+  void TearDown() override {
+    DIR *dir = opendir(m_path.c_str());
+    if (dir != nullptr) {
+      struct dirent *de;
+      while ((de = readdir(dir)) != nullptr) {
+        std::string name = de->d_name;
+        if (name != "." && name != "..") {
+          unlink((m_path + "/" + name).c_str());
+        }
+      }
+      closedir(dir);
+    }
+    rmdir(m_path.c_str());
+    TestMockFixture::TearDown();
+  }
+
+  void init_image_ctx(MockTestImageCtx &mock_image_ctx, uint64_t log_size) {
+    mock_image_ctx.persistent_cache_path = m_path;
+    mock_image_ctx.persistent_cache_size = log_size;
+    expect_op_work_queue(mock_image_ctx);
+  }
+
+  static bufferlist make_data(char c, uint64_t length) {
+    bufferlist bl;
+    bl.append(std::string(length, c));
+    return bl;
+  }
+
+  // image writes land in m_image_data; the first fail_after succeed
+  void expect_image_writes(MockTestImageCtx &mock_image_ctx,
+                           int fail_after = -1) {
+    EXPECT_CALL(*MockImageWriteback::s_instance, aio_write_mock(_, _, _, _))
+      .WillRepeatedly(Invoke([this, &mock_image_ctx, fail_after](
+          const Extents &extents, const bufferlist &bl, int,
+          Context *on_finish) {
+        int r = 0;
+        if (fail_after >= 0 && m_image_writes >= fail_after) {
+          r = -EIO;
+        } else {
+          bufferlist data(bl);
+          uint64_t off = 0;
+          for (auto &extent : extents) {
+            data.copy(off, extent.second, &m_image_data[extent.first]);
+            off += extent.second;
+          }
+          ++m_image_writes;
+        }
+        mock_image_ctx.image_ctx->op_work_queue->queue(on_finish, r);
+      }));
+  }
+
+  void expect_image_reads(MockTestImageCtx &mock_image_ctx) {
+    EXPECT_CALL(*MockImageWriteback::s_instance, aio_read_mock(_, _, _, _))
+      .WillRepeatedly(Invoke([this, &mock_image_ctx](
+          const Extents &extents, bufferlist *bl, int, Context *on_finish) {
+        for (auto &extent : extents) {
+          bl->append(m_image_data.substr(extent.first, extent.second));
+        }
+        mock_image_ctx.image_ctx->op_work_queue->queue(on_finish, 0);
+      }));
+  }
+
+  void expect_image_flush(MockTestImageCtx &mock_image_ctx) {
+    EXPECT_CALL(*MockImageWriteback::s_instance, aio_flush(_))
+      .WillRepeatedly(CompleteContext(
+        0, mock_image_ctx.image_ctx->op_work_queue));
+  }
+
+  void expect_get_locker(MockTestImageCtx &mock_image_ctx,
+                         MockGetLockerRequest &mock_get_locker_request,
+                         const entity_name_t &entity, int r) {
+    EXPECT_CALL(mock_get_locker_request, send())
+      .WillOnce(Invoke([&mock_image_ctx, &mock_get_locker_request, entity,
+                        r]() {
+        if (r == 0) {
+          *mock_get_locker_request.locker = managed_lock::Locker(
+            entity, "auto 123", "1.2.3.4:0/0", 123);
+        }
+        mock_image_ctx.image_ctx->op_work_queue->queue(
+          mock_get_locker_request.on_finish, r);
+      }));
+  }
+
+  // logs A, B and C, destages only A and leaves the log as at a crash
+  void crash_with_log(librbd::ImageCtx *ictx, uint64_t log_size) {
+    MockTestImageCtx mock_image_ctx(*ictx);
+    init_image_ctx(mock_image_ctx, log_size);
+    MockFileImageCache cache(mock_image_ctx);
+
+    expect_image_writes(mock_image_ctx, 1);
+    expect_image_flush(mock_image_ctx);
+
+    ASSERT_EQ(0, init(cache));
+    ASSERT_EQ(0, write(cache, 0, make_data('a', 4096)));
+    ASSERT_EQ(0, write(cache, 65536, make_data('b', 4096)));
+    ASSERT_EQ(0, write(cache, 131072, make_data('c', 4096)));
+    ASSERT_EQ(-EIO, shut_down(cache));
+    ASSERT_EQ(1, m_image_writes);
+    m_image_writes = 0;
+  }
+
+  int init(MockFileImageCache &cache) {
+    C_SaferCond ctx;
+    cache.init(&ctx);
+    return ctx.wait();
+  }
+
+  int shut_down(MockFileImageCache &cache) {
+    C_SaferCond ctx;
+    cache.shut_down(&ctx);
+    return ctx.wait();
+  }
+
+  int flush(MockFileImageCache &cache) {
+    C_SaferCond ctx;
+    cache.flush(&ctx);
+    return ctx.wait();
+  }
+
+  int write(MockFileImageCache &cache, uint64_t off, bufferlist &&bl) {
+    C_SaferCond ctx;
+    uint64_t len = bl.length();
+    cache.aio_write({{off, len}}, std::move(bl), 0, &ctx);
+    return ctx.wait();
+  }
+
+  int read(MockFileImageCache &cache, Extents &&extents, bufferlist *bl) {
+    C_SaferCond ctx;
+    cache.aio_read(std::move(extents), bl, 0, &ctx);
+    return ctx.wait();
+  }
+
+  bool image_contains(uint64_t off, bufferlist &bl) {
+    return m_image_data.compare(off, bl.length(), bl.to_str()) == 0;
+  }
+};
+
+TEST_F(TestMockCacheFileImageCache, OverlayRead) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  init_image_ctx(mock_image_ctx, 1 << 20);
+  MockFileImageCache cache(mock_image_ctx);
+
+  // hold the destages back until the reads are done; the image itself
+  // is left as it is
+  Mutex lock("TestMockCacheFileImageCache::lock");
+  bool hold = true;
+  std::list<Context*> destages;
+  EXPECT_CALL(*MockImageWriteback::s_instance, aio_write_mock(_, _, _, _))
+    .WillRepeatedly(Invoke([&mock_image_ctx, &lock, &hold, &destages](
+        const Extents &, const bufferlist &, int, Context *on_finish) {
+      {
+        Mutex::Locker locker(lock);
+        if (hold) {
+          destages.push_back(on_finish);
+          return;
+        }
+      }
+      mock_image_ctx.image_ctx->op_work_queue->queue(on_finish, 0);
+    }));
+  expect_image_reads(mock_image_ctx);
+  expect_image_flush(mock_image_ctx);
+
+  m_image_data.replace(0, 16384, std::string(16384, 'i'));
+
+  ASSERT_EQ(0, init(cache));
+  ASSERT_EQ(0, write(cache, 0, make_data('a', 4096)));
+  ASSERT_EQ(0, write(cache, 8192, make_data('b', 4096)));
+  ASSERT_EQ(0, write(cache, 10240, make_data('c', 1024)));
+
+  // served from the log alone
+  bufferlist bl;
+  ASSERT_EQ(0, read(cache, {{8192, 4096}}, &bl));
+  bufferlist expected;
+  expected.append(std::string(2048, 'b'));
+  expected.append(std::string(1024, 'c'));
+  expected.append(std::string(1024, 'b'));
+  ASSERT_TRUE(bl.contents_equal(expected));
+
+  // the log laid over the image, across several extents
+  bl.clear();
+  ASSERT_EQ(0, read(cache, {{2048, 4096}, {10240, 4096}}, &bl));
+  expected.clear();
+  expected.append(std::string(2048, 'a'));
+  expected.append(std::string(2048, 'i'));
+  expected.append(std::string(1024, 'c'));
+  expected.append(std::string(1024, 'b'));
+  expected.append(std::string(2048, 'i'));
+  ASSERT_TRUE(bl.contents_equal(expected));
+
+  std::list<Context*> ctxs;
+  {
+    Mutex::Locker locker(lock);
+    hold = false;
+    ctxs.swap(destages);
+  }
+  for (auto ctx : ctxs) {
+    mock_image_ctx.image_ctx->op_work_queue->queue(ctx, 0);
+  }
+  ASSERT_EQ(0, flush(cache));
+
+  // once destaged, reads are no longer overlaid
+  bl.clear();
+  ASSERT_EQ(0, read(cache, {{0, 4096}}, &bl));
+  ASSERT_TRUE(bl.contents_equal(make_data('i', 4096)));
+
+  ASSERT_EQ(0, shut_down(cache));
+}
+
+TEST_F(TestMockCacheFileImageCache, FlushBarrier) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  init_image_ctx(mock_image_ctx, 1 << 20);
+  MockFileImageCache cache(mock_image_ctx);
+  ASSERT_EQ(0, init(cache));
+
+  // writes logged before the discard reach the image before it, and a
+  // write issued behind the discard after it
+  std::atomic<bool> discarded{false};
+  {
+    InSequence seq;
+    EXPECT_CALL(*MockImageWriteback::s_instance,
+                aio_write_mock(Extents{{0, 4096}}, _, _, _))
+      .WillOnce(Invoke([&mock_image_ctx](const Extents &, const bufferlist &,
+                                         int, Context *on_finish) {
+        mock_image_ctx.image_ctx->op_work_queue->queue(on_finish, 0);
+      }));
+    EXPECT_CALL(*MockImageWriteback::s_instance,
+                aio_write_mock(Extents{{0, 8192}}, _, _, _))
+      .WillOnce(Invoke([&mock_image_ctx](const Extents &, const bufferlist &,
+                                         int, Context *on_finish) {
+        mock_image_ctx.image_ctx->op_work_queue->queue(on_finish, 0);
+      }));
+    EXPECT_CALL(*MockImageWriteback::s_instance,
+                aio_discard(0, 65536, _, _))
+      .WillOnce(Invoke([&mock_image_ctx, &discarded](
+          uint64_t, uint64_t, bool, Context *on_finish) {
+        discarded = true;
+        mock_image_ctx.image_ctx->op_work_queue->queue(on_finish, 0);
+      }));
+    EXPECT_CALL(*MockImageWriteback::s_instance,
+                aio_write_mock(Extents{{4096, 4096}}, _, _, _))
+      .WillOnce(Invoke([&mock_image_ctx, &discarded](
+          const Extents &, const bufferlist &, int, Context *on_finish) {
+        EXPECT_TRUE(discarded);
+        mock_image_ctx.image_ctx->op_work_queue->queue(on_finish, 0);
+      }));
+    EXPECT_CALL(*MockImageWriteback::s_instance, aio_flush(_))
+      .WillOnce(CompleteContext(0, mock_image_ctx.image_ctx->op_work_queue));
+    EXPECT_CALL(*MockImageWriteback::s_instance, aio_flush(_))
+      .WillOnce(CompleteContext(0, mock_image_ctx.image_ctx->op_work_queue));
+  }
+
+  ASSERT_EQ(0, write(cache, 0, make_data('a', 4096)));
+  ASSERT_EQ(0, write(cache, 0, make_data('b', 8192)));
+
+  C_SaferCond discard_ctx;
+  cache.aio_discard(0, 65536, false, &discard_ctx);
+  C_SaferCond write_ctx;
+  cache.aio_write({{4096, 4096}}, make_data('c', 4096), 0, &write_ctx);
+  ASSERT_EQ(0, discard_ctx.wait());
+  ASSERT_EQ(0, write_ctx.wait());
+
+  ASSERT_EQ(0, flush(cache));
+  ASSERT_EQ(0, shut_down(cache));
+}
+
+TEST_F(TestMockCacheFileImageCache, ReplayAfterCrash) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  // a 64K ring: A (8K), B, C, D (16K each), then E (16K) does not fit in
+  // the 8K left at the end of the ring and is logged behind a PAD entry
+  const uint64_t log_size = 65536;
+  bufferlist a = make_data('a', 4096);
+  bufferlist b = make_data('b', 12288);
+  bufferlist c = make_data('c', 12288);
+  bufferlist d = make_data('d', 12288);
+  bufferlist e = make_data('e', 12288);
+
+  {
+    MockTestImageCtx mock_image_ctx(*ictx);
+    init_image_ctx(mock_image_ctx, log_size);
+    MockFileImageCache cache(mock_image_ctx);
+
+    // only A and B are destaged before the "crash", freeing the space E
+    // needs; C, D and E are only in the log
+    expect_image_writes(mock_image_ctx, 2);
+    expect_image_flush(mock_image_ctx);
+
+    ASSERT_EQ(0, init(cache));
+    ASSERT_EQ(0, write(cache, 0, bufferlist(a)));
+    ASSERT_EQ(0, write(cache, 65536, bufferlist(b)));
+    ASSERT_EQ(0, write(cache, 131072, bufferlist(c)));
+    ASSERT_EQ(0, write(cache, 196608, bufferlist(d)));
+    ASSERT_EQ(0, write(cache, 262144, bufferlist(e)));
+
+    // failing to destage leaves the log as it was at the crash
+    ASSERT_EQ(-EIO, shut_down(cache));
+    ASSERT_EQ(2, m_image_writes);
+    ASSERT_TRUE(image_contains(0, a));
+    ASSERT_TRUE(image_contains(65536, b));
+  }
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  init_image_ctx(mock_image_ctx, log_size);
+  MockExclusiveLock mock_exclusive_lock;
+  mock_image_ctx.exclusive_lock = &mock_exclusive_lock;
+  MockFileImageCache cache(mock_image_ctx);
+
+  // the crashed client still holds the image lock
+  MockGetLockerRequest mock_get_locker_request;
+  expect_get_locker(mock_image_ctx, mock_get_locker_request,
+                    entity_name_t::CLIENT(ictx->md_ctx.get_instance_id()), 0);
+
+  // the open finishes without the lock; it is requested afterwards
+  C_SaferCond lock_requested;
+  EXPECT_CALL(mock_exclusive_lock, is_lock_owner())
+    .WillRepeatedly(::testing::Return(false));
+  EXPECT_CALL(mock_exclusive_lock, acquire_lock(nullptr))
+    .WillOnce(Invoke([&lock_requested](Context *) {
+      lock_requested.complete(0);
+    }));
+  m_image_writes = 0;
+  expect_image_writes(mock_image_ctx);
+  expect_image_reads(mock_image_ctx);
+  expect_image_flush(mock_image_ctx);
+
+  ASSERT_EQ(0, init(cache));
+  ASSERT_EQ(0, lock_requested.wait());
+
+  // the replayed entries, including the one after the PAD, are read
+  // from the log while they wait for the lock
+  bufferlist bl;
+  ASSERT_EQ(0, read(cache, {{131072, 12288}, {196608, 12288},
+                            {262144, 12288}}, &bl));
+  bufferlist expected;
+  expected.append(c);
+  expected.append(d);
+  expected.append(e);
+  ASSERT_TRUE(bl.contents_equal(expected));
+
+  // without the lock nothing is destaged
+  ASSERT_EQ(0, flush(cache));
+  ASSERT_EQ(0, m_image_writes);
+
+  cache.handle_lock_acquired();
+  ASSERT_EQ(0, flush(cache));
+  ASSERT_EQ(3, m_image_writes);
+  ASSERT_TRUE(image_contains(131072, c));
+  ASSERT_TRUE(image_contains(196608, d));
+  ASSERT_TRUE(image_contains(262144, e));
+
+  ASSERT_EQ(0, shut_down(cache));
+  mock_image_ctx.exclusive_lock = nullptr;
+}
+
+TEST_F(TestMockCacheFileImageCache, ReplayAfterLockBroken) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  const uint64_t log_size = 65536;
+  ASSERT_NO_FATAL_FAILURE(crash_with_log(ictx, log_size));
+
+  // another client took the lock over and wrote B's range since
+  m_image_data.replace(65536, 4096, std::string(4096, 'x'));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  init_image_ctx(mock_image_ctx, log_size);
+  MockExclusiveLock mock_exclusive_lock;
+  mock_image_ctx.exclusive_lock = &mock_exclusive_lock;
+  MockFileImageCache cache(mock_image_ctx);
+
+  MockGetLockerRequest mock_get_locker_request;
+  expect_get_locker(mock_image_ctx, mock_get_locker_request,
+                    entity_name_t::CLIENT(ictx->md_ctx.get_instance_id() + 1),
+                    0);
+  EXPECT_CALL(mock_exclusive_lock, acquire_lock(_)).Times(0);
+  expect_image_writes(mock_image_ctx);
+  expect_image_reads(mock_image_ctx);
+  expect_image_flush(mock_image_ctx);
+
+  // the log is neither served nor destaged
+  ASSERT_EQ(0, init(cache));
+  bufferlist bl;
+  ASSERT_EQ(0, read(cache, {{65536, 4096}}, &bl));
+  ASSERT_TRUE(bl.contents_equal(make_data('x', 4096)));
+  ASSERT_EQ(0, flush(cache));
+  ASSERT_EQ(0, m_image_writes);
+  ASSERT_EQ(0, shut_down(cache));
+  mock_image_ctx.exclusive_lock = nullptr;
+}
+
+TEST_F(TestMockCacheFileImageCache, ReplayAfterLockReleased) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  const uint64_t log_size = 65536;
+  ASSERT_NO_FATAL_FAILURE(crash_with_log(ictx, log_size));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  init_image_ctx(mock_image_ctx, log_size);
+  MockFileImageCache cache(mock_image_ctx);
+
+  MockGetLockerRequest mock_get_locker_request;
+  expect_get_locker(mock_image_ctx, mock_get_locker_request, entity_name_t(),
+                    -ENOENT);
+  expect_image_writes(mock_image_ctx);
+  expect_image_flush(mock_image_ctx);
+
+  ASSERT_EQ(0, init(cache));
+  ASSERT_EQ(0, flush(cache));
+  ASSERT_EQ(0, m_image_writes);
+  ASSERT_EQ(0, shut_down(cache));
+
+  // the discarded log is not replayed by a later open either
+  MockFileImageCache cache2(mock_image_ctx);
+  expect_image_writes(mock_image_ctx);
+  expect_image_flush(mock_image_ctx);
+  ASSERT_EQ(0, init(cache2));
+  ASSERT_EQ(0, shut_down(cache2));
+  ASSERT_EQ(0, m_image_writes);
+}
+
+TEST_F(TestMockCacheFileImageCache, RefuseUnsafeLog) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  init_image_ctx(mock_image_ctx, 1 << 20);
+  std::string log_path = m_path + "/rbd-" +
+    stringify(ictx->md_ctx.get_id()) + "." + ictx->id + ".cache";
+
+  // a log others may have written is not replayed
+  int fd = ::open(log_path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0600);
+  ASSERT_LE(0, fd);
+  ASSERT_EQ(0, ::fchmod(fd, 0666));
+  ::close(fd);
+  {
+    MockFileImageCache cache(mock_image_ctx);
+    ASSERT_EQ(-EPERM, init(cache));
+  }
+  ASSERT_EQ(0, ::unlink(log_path.c_str()));
+
+  // nor is one behind a symlink
+  std::string target = m_path + "/target";
+  fd = ::open(target.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0600);
+  ASSERT_LE(0, fd);
+  ::close(fd);
+  ASSERT_EQ(0, ::symlink(target.c_str(), log_path.c_str()));
+  {
+    MockFileImageCache cache(mock_image_ctx);
+    ASSERT_EQ(-ELOOP, init(cache));
+  }
+}
+
+} // namespace cache
+} // namespace librbd
@@ -101,7 +101,11 @@ struct MockImageCtx {
           image_ctx.journal_max_concurrent_object_sets),
       mirroring_resync_after_disconnect(
           image_ctx.mirroring_resync_after_disconnect),
-      mirroring_replay_delay(image_ctx.mirroring_replay_delay)
+      mirroring_replay_delay(image_ctx.mirroring_replay_delay),
+      persistent_cache(image_ctx.persistent_cache),
+      persistent_cache_path(image_ctx.persistent_cache_path),
+      persistent_cache_size(image_ctx.persistent_cache_size),
+      shared_parent_cache(image_ctx.shared_parent_cache)
   {
     md_ctx.dup(image_ctx.md_ctx);
     data_ctx.dup(image_ctx.data_ctx);
@@ -286,6 +290,10 @@ struct MockImageCtx {
   int journal_max_concurrent_object_sets;
   bool mirroring_resync_after_disconnect;
   int mirroring_replay_delay;
+  bool persistent_cache;
+  std::string persistent_cache_path;
+  uint64_t persistent_cache_size;
+  bool shared_parent_cache;
 };
 
 } // namespace librbd
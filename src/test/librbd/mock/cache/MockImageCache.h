@@ -36,6 +36,8 @@ struct MockImageCache {
                      int fadvise_flags, Context *on_finish) {
     aio_writesame_mock(off, len, bl, fadvise_flags, on_finish);
   }
+
+  MOCK_METHOD0(handle_lock_acquired, void());
 };
 
 } // namespace cache
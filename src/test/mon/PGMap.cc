@@ -114,6 +114,67 @@ TEST(pgmap, calc_stats)
   }
 }
 
+TEST(pgmap, stuck_and_unscrubbed)
+{
+  PGMap pg_map;
+  PGMap::Incremental inc;
+  pg_stat_t ps;
+  utime_t cutoff(1000, 0);
+
+  // pg 1.0 is clean, 1.1 went inactive/unclean long ago, 1.2 recently
+  ps.state = PG_STATE_ACTIVE | PG_STATE_CLEAN;
+  ps.last_scrub_stamp = utime_t(2000, 0);
+  ps.last_deep_scrub_stamp = utime_t(500, 0);
+  inc.pg_stat_updates[pg_t(0,1)] = ps;
+  ps.state = PG_STATE_PEERING;
+  ps.last_active = utime_t(100, 0);
+  ps.last_clean = utime_t(100, 0);
+  ps.last_scrub_stamp = utime_t(200, 0);
+  inc.pg_stat_updates[pg_t(1,1)] = ps;
+  ps.last_active = utime_t(1500, 0);
+  ps.last_clean = utime_t(1500, 0);
+  inc.pg_stat_updates[pg_t(2,1)] = ps;
+  inc.version = 1;
+  pg_map.apply_incremental(g_ceph_context, inc);
+
+  map<string,int> note;
+  ASSERT_TRUE(pg_map.get_stuck_counts(cutoff, note));
+  ASSERT_EQ(2u, note.size());
+  ASSERT_EQ(1, note["stuck inactive"]);
+  ASSERT_EQ(1, note["stuck unclean"]);
+
+  ceph::unordered_map<pg_t, pg_stat_t> stuck;
+  pg_map.get_stuck_stats(PGMap::STUCK_INACTIVE | PGMap::STUCK_STALE,
+			 cutoff, stuck);
+  ASSERT_EQ(1u, stuck.size());
+  ASSERT_EQ(1u, stuck.count(pg_t(1,1)));
+
+  set<pg_t> not_scrubbed, not_deep_scrubbed;
+  pg_map.get_unscrubbed(cutoff, cutoff, &not_scrubbed, &not_deep_scrubbed);
+  ASSERT_EQ(2u, not_scrubbed.size());
+  ASSERT_EQ(3u, not_deep_scrubbed.size());
+
+  // 1.1 recovers and gets scrubbed; the indexes must follow
+  inc = PGMap::Incremental();
+  ps.state = PG_STATE_ACTIVE | PG_STATE_CLEAN;
+  ps.last_scrub_stamp = utime_t(3000, 0);
+  ps.last_deep_scrub_stamp = utime_t(3000, 0);
+  inc.pg_stat_updates[pg_t(1,1)] = ps;
+  inc.pg_remove.insert(pg_t(2,1));
+  inc.version = 2;
+  pg_map.apply_incremental(g_ceph_context, inc);
+
+  note.clear();
+  ASSERT_FALSE(pg_map.get_stuck_counts(cutoff, note));
+  ASSERT_TRUE(note.empty());
+  not_scrubbed.clear();
+  not_deep_scrubbed.clear();
+  pg_map.get_unscrubbed(cutoff, cutoff, &not_scrubbed, &not_deep_scrubbed);
+  ASSERT_TRUE(not_scrubbed.empty());
+  ASSERT_EQ(1u, not_deep_scrubbed.size());
+  ASSERT_EQ(1u, not_deep_scrubbed.count(pg_t(0,1)));
+}
+
 namespace {
   class CheckTextTable : public TextTable {
   public:
@@ -0,0 +1,135 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "include/page.h"
+#include "msg/async/RxBufferPool.h"
+
+static bool is_page_aligned(const ceph::bufferptr& bp)
+{
+  return ((uintptr_t)bp.c_str() & ~CEPH_PAGE_MASK) == 0;
+}
+
+TEST(RxBufferPool, Create)
+{
+  ASSERT_EQ(nullptr, RxBufferPool::create(0, 1 << 20));
+  ASSERT_EQ(nullptr, RxBufferPool::create(65536, 4096));
+
+  // chunks are whole pages
+  auto pool = RxBufferPool::create(CEPH_PAGE_SIZE + 1, 1 << 20);
+  ASSERT_NE(nullptr, pool);
+  ASSERT_EQ(2 * CEPH_PAGE_SIZE, pool->get_chunk_size());
+}
+
+TEST(RxBufferPool, GetReturn)
+{
+  const unsigned chunk = 2 * CEPH_PAGE_SIZE;
+  auto pool = RxBufferPool::create(chunk, 2 * chunk);
+
+  ceph::bufferptr a = pool->get();
+  ceph::bufferptr b = pool->get();
+  ASSERT_TRUE(a.have_raw());
+  ASSERT_TRUE(b.have_raw());
+  ASSERT_EQ(chunk, a.length());
+  ASSERT_TRUE(is_page_aligned(a));
+  ASSERT_TRUE(is_page_aligned(b));
+
+  // exhausted
+  ASSERT_FALSE(pool->get().have_raw());
+
+  // a released chunk is reused rather than a new one allocated
+  const char *p = a.c_str();
+  a = ceph::bufferptr();
+  ceph::bufferptr c = pool->get();
+  ASSERT_TRUE(c.have_raw());
+  ASSERT_EQ(p, c.c_str());
+  ASSERT_FALSE(pool->get().have_raw());
+
+  // chunks may come back from any thread
+  p = b.c_str();
+  std::thread t([&b]() { b = ceph::bufferptr(); });
+  t.join();
+  ceph::bufferptr d = pool->get();
+  ASSERT_EQ(p, d.c_str());
+}
+
+TEST(RxBufferPool, GetLength)
+{
+  const unsigned chunk = 2 * CEPH_PAGE_SIZE;
+  auto pool = RxBufferPool::create(chunk, 3 * chunk);
+
+  // only whole chunks
+  ceph::bufferlist bl;
+  ASSERT_EQ(0u, pool->get(chunk - 1, bl));
+  ASSERT_EQ(0u, bl.length());
+  ASSERT_EQ(2 * chunk, pool->get(2 * chunk + CEPH_PAGE_SIZE, bl));
+  ASSERT_EQ(2 * chunk, bl.length());
+
+  // short once exhausted
+  ceph::bufferlist bl2;
+  ASSERT_EQ(chunk, pool->get(4 * chunk, bl2));
+  ASSERT_EQ(0u, pool->get(chunk, bl2));
+}
+
+TEST(RxBufferPool, OutlivedByChunks)
+{
+  auto pool = RxBufferPool::create(CEPH_PAGE_SIZE, CEPH_PAGE_SIZE);
+  ceph::bufferptr bp = pool->get();
+  ASSERT_TRUE(bp.have_raw());
+
+  // the chunk keeps the pool alive until it is released
+  pool.reset();
+  memset(bp.c_str(), 0xab, bp.length());
+  bp = ceph::bufferptr();
+}
+
+TEST(RxBufferPool, AlignedRxBuffer)
+{
+  const unsigned chunk = 4 * CEPH_PAGE_SIZE;
+  const unsigned lens[] = {
+    1, 100, CEPH_PAGE_SIZE - 1, CEPH_PAGE_SIZE, CEPH_PAGE_SIZE + 1,
+    chunk - 1, chunk, chunk + 1, 3 * chunk + 100, 10 * chunk
+  };
+  const unsigned offs[] = {
+    0, 1, 512, CEPH_PAGE_SIZE - 1, CEPH_PAGE_SIZE, CEPH_PAGE_SIZE + 100
+  };
+
+  for (unsigned pool_chunks : {0u, 1u, 2u, 16u}) {
+    for (auto len : lens) {
+      for (auto off : offs) {
+	auto pool = pool_chunks ?
+	  RxBufferPool::create(chunk, pool_chunks * chunk) : nullptr;
+	ceph::bufferlist data;
+	unsigned pooled = alloc_aligned_rx_buffer(data, len, off, pool.get());
+
+	// the segment is read into data as it is, so it must fit
+	ASSERT_GE(data.length(), len) << "len " << len << " off " << off;
+	ASSERT_LE(pooled, pool_chunks * chunk);
+	ASSERT_EQ(0u, pooled % chunk);
+
+	// whatever follows the head is page aligned, like the sender's data
+	unsigned head = (CEPH_PAGE_SIZE - (off & ~CEPH_PAGE_MASK)) &
+	  ~CEPH_PAGE_MASK;
+	unsigned pos = 0;
+	for (auto& bp : data.buffers()) {
+	  if (pos >= head && pos + CEPH_PAGE_SIZE <= len) {
+	    ASSERT_TRUE(is_page_aligned(bp)) << "len " << len << " off " << off
+					     << " pos " << pos;
+	  }
+	  pos += bp.length();
+	}
+      }
+    }
+  }
+}
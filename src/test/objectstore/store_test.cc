@@ -1767,6 +1767,95 @@ TEST_P(StoreTestSpecificAUSize, BluestoreFragmentedBlobTest) {
     ASSERT_EQ( 0u, statfs.compressed_allocated);
   }
 }
+
+TEST_P(StoreTestSpecificAUSize, BluestorePackSmallObjects) {
+  if(string(GetParam()) != "bluestore")
+    return;
+  StartDeferred(0x10000);
+  g_conf->set_val("bluestore_pack_max_object_size", "8192");
+  g_conf->apply_changes(NULL);
+
+  ObjectStore::Sequencer osr("test");
+  int r;
+  coll_t cid(spg_t(pg_t(0, 1), shard_id_t::NO_SHARD));
+  const unsigned num = 20;
+  const unsigned len = 2000;
+  auto oid = [](unsigned i) {
+    return ghobject_t(hobject_t(sobject_t("Object " + stringify(i),
+					  CEPH_NOSNAP)));
+  };
+  auto data = [&](unsigned i) {
+    bufferlist bl;
+    bl.append(string(len, 'a' + i));
+    return bl;
+  };
+  auto check = [&](unsigned i) {
+    bufferlist bl, expected = data(i);
+    r = store->read(cid, oid(i), 0, len, bl);
+    ASSERT_EQ((int)len, r);
+    ASSERT_TRUE(bl_eq(expected, bl));
+  };
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  for (unsigned i = 0; i < num; ++i) {
+    ObjectStore::Transaction t;
+    bufferlist bl = data(i);
+    t.write(cid, oid(i), 0, bl.length(), bl);
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  {
+    // one block each, 16 to a 64K allocation unit
+    struct store_statfs_t statfs;
+    r = store->statfs(&statfs);
+    ASSERT_EQ(r, 0);
+    ASSERT_EQ(num * len, statfs.stored);
+    ASSERT_EQ(0x20000u, statfs.allocated);
+    for (unsigned i = 0; i < num; ++i) {
+      check(i);
+    }
+    //force fsck
+    EXPECT_EQ(store->umount(), 0);
+    EXPECT_EQ(store->mount(), 0);
+  }
+  {
+    // overwriting a packed object moves it out of the shared unit
+    ObjectStore::Transaction t;
+    bufferlist bl = data(0);
+    t.write(cid, oid(0), 0, bl.length(), bl);
+    for (unsigned i = 1; i < num; i += 2) {
+      t.remove(cid, oid(i));
+    }
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+    for (unsigned i = 0; i < num; i += 2) {
+      check(i);
+    }
+    EXPECT_EQ(store->umount(), 0);
+    EXPECT_EQ(store->mount(), 0);
+  }
+  {
+    ObjectStore::Transaction t;
+    for (unsigned i = 0; i < num; i += 2) {
+      t.remove(cid, oid(i));
+    }
+    t.remove_collection(cid);
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+
+    struct store_statfs_t statfs;
+    r = store->statfs(&statfs);
+    ASSERT_EQ(r, 0);
+    ASSERT_EQ(0u, statfs.allocated);
+    ASSERT_EQ(0u, statfs.stored);
+  }
+  g_conf->set_val("bluestore_pack_max_object_size", "0");
+  g_conf->apply_changes(NULL);
+}
 #endif
 
 TEST_P(StoreTest, ManySmallWrite) {
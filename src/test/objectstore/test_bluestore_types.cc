@@ -292,6 +292,55 @@ TEST(bluestore_blob_t, calc_csum)
   }
 }
 
+TEST(bluestore_blob_t, calc_csum_fragmented)
+{
+  // enough blocks for several verify batches
+  unsigned block_size = 4096;
+  unsigned len = block_size * (Checksummer::CSUM_BATCH * 2 + 5);
+  bufferptr bp(len);
+  for (unsigned i = 0; i < len; ++i)
+    bp.c_str()[i] = rand();
+  bufferlist contiguous;
+  contiguous.append(bp);
+
+  // same data, split at boundaries that do not match csum blocks
+  bufferlist fragmented;
+  unsigned sizes[] = { 100, 5000, 3 * 4096, 77, 10 * 4096 };
+  for (unsigned off = 0, i = 0; off < len; ++i) {
+    unsigned l = std::min(sizes[i % 5], len - off);
+    fragmented.append(bufferptr(bp, off, l));
+    off += l;
+  }
+
+  for (unsigned csum_type = Checksummer::CSUM_NONE + 1;
+       csum_type < Checksummer::CSUM_MAX;
+       ++csum_type) {
+    cout << "csum_type " << Checksummer::get_csum_type_string(csum_type)
+	 << std::endl;
+    bluestore_blob_t a, b;
+    a.init_csum(csum_type, 12, len);
+    b.init_csum(csum_type, 12, len);
+    a.calc_csum(0, contiguous);
+    b.calc_csum(0, fragmented);
+    ASSERT_TRUE(a.csum_data.length() == b.csum_data.length());
+    ASSERT_EQ(0, memcmp(a.csum_data.c_str(), b.csum_data.c_str(),
+			a.csum_data.length()));
+
+    int bad_off;
+    uint64_t bad_csum;
+    ASSERT_EQ(0, a.verify_csum(0, fragmented, &bad_off, &bad_csum));
+    ASSERT_EQ(-1, bad_off);
+
+    // corrupt a block past the first verify batch
+    unsigned bad = Checksummer::CSUM_BATCH + 3;
+    bufferlist corrupted;
+    corrupted.append(contiguous.c_str(), len);
+    corrupted.c_str()[bad * block_size + 17] ^= 1;
+    ASSERT_EQ(-1, a.verify_csum(0, corrupted, &bad_off, &bad_csum));
+    ASSERT_EQ((int)(bad * block_size), bad_off);
+  }
+}
+
 TEST(bluestore_blob_t, csum_bench)
 {
   bufferlist bl;
@@ -1480,6 +1529,200 @@ TEST(GarbageCollector, BasicTest)
   }
  }
 
+static BlueStore::CacheAutotuner::Inputs autotune_inputs()
+{
+  BlueStore::CacheAutotuner::Inputs in;
+  in.target = 4ull << 30;
+  in.cache_min = 128ull << 20;
+  in.chunk = 32ull << 20;
+  in.mempool_total = 1ull << 30;  // includes the onode and buffer caches
+  in.meta_bytes = 256ull << 20;
+  in.onodes = 1000;
+  in.data_bytes = 256ull << 20;
+  in.kv_tunable = true;
+  in.kv_bytes = 512ull << 20;
+  in.kv_stats = true;
+  in.kv_block_size = 4096;
+  in.cache_size = 1ull << 30;
+  in.cache_meta_ratio = 0.5;
+  in.kv_cache_size = 1ull << 30;
+  return in;
+}
+
+TEST(CacheAutotuner, FirstRound)
+{
+  BlueStore::CacheAutotuner tuner(g_ceph_context);
+  auto in = autotune_inputs();
+  auto t = tuner.tune(in);
+
+  // 1G of mempools, of which 512M are the onode and buffer caches
+  ASSERT_EQ(512ull << 20, t.other);
+  ASSERT_EQ(in.target - t.other, t.budget);
+
+  // split as configured: 1G kv, 512M onodes, 512M buffers
+  ASSERT_DOUBLE_EQ(0.5, tuner.get_kv_ratio());
+  ASSERT_DOUBLE_EQ(0.25, tuner.get_meta_ratio());
+  ASSERT_DOUBLE_EQ(0.25, tuner.get_data_ratio());
+  ASSERT_EQ(t.budget / 2, t.kv);
+  ASSERT_EQ(t.budget / 4, t.meta);
+  ASSERT_EQ(t.budget, t.kv + t.meta + t.data);
+}
+
+TEST(CacheAutotuner, NoKVCache)
+{
+  BlueStore::CacheAutotuner tuner(g_ceph_context);
+  auto in = autotune_inputs();
+  in.kv_tunable = false;
+  in.kv_stats = false;
+  in.kv_bytes = 0;
+  auto t = tuner.tune(in);
+
+  ASSERT_DOUBLE_EQ(0, tuner.get_kv_ratio());
+  ASSERT_DOUBLE_EQ(0.5, tuner.get_meta_ratio());
+  ASSERT_DOUBLE_EQ(0.5, tuner.get_data_ratio());
+  ASSERT_EQ(0u, t.kv);
+  ASSERT_EQ(t.budget, t.meta + t.data);
+}
+
+TEST(CacheAutotuner, Budget)
+{
+  BlueStore::CacheAutotuner tuner(g_ceph_context);
+  auto in = autotune_inputs();
+  auto t = tuner.tune(in);
+
+  // a smaller target shrinks every cache, keeping the split
+  in.target = 2ull << 30;
+  auto smaller = tuner.tune(in);
+  ASSERT_EQ(t.budget - (2ull << 30), smaller.budget);
+  ASSERT_LT(smaller.kv, t.kv);
+  ASSERT_LT(smaller.meta, t.meta);
+  ASSERT_LT(smaller.data, t.data);
+  ASSERT_DOUBLE_EQ(0.5, tuner.get_kv_ratio());
+
+  // so does the rest of the OSD using more memory
+  in.target = 4ull << 30;
+  in.mempool_total += 1ull << 30;
+  auto busier = tuner.tune(in);
+  ASSERT_EQ(t.other + (1ull << 30), busier.other);
+  ASSERT_EQ(t.budget - (1ull << 30), busier.budget);
+
+  // and a larger target grows them again
+  in.mempool_total = autotune_inputs().mempool_total;
+  auto larger = tuner.tune(in);
+  ASSERT_EQ(t.budget, larger.budget);
+  ASSERT_EQ(t.kv, larger.kv);
+
+  // but never below osd_memory_cache_min
+  in.target = 512ull << 20;
+  auto floor = tuner.tune(in);
+  ASSERT_EQ(in.cache_min, floor.budget);
+  ASSERT_EQ(floor.budget, floor.kv + floor.meta + floor.data);
+  in.target = 0;
+  ASSERT_EQ(in.cache_min, tuner.tune(in).budget);
+}
+
+TEST(CacheAutotuner, MovesChunkToPressure)
+{
+  BlueStore::CacheAutotuner tuner(g_ceph_context);
+  auto in = autotune_inputs();
+  auto t = tuner.tune(in);
+  double step = (double)in.chunk / t.budget;
+
+  // no misses, nothing moves
+  tuner.tune(in);
+  ASSERT_DOUBLE_EQ(0.5, tuner.get_kv_ratio());
+  ASSERT_DOUBLE_EQ(0.25, tuner.get_meta_ratio());
+  ASSERT_DOUBLE_EQ(0.25, tuner.get_data_ratio());
+
+  // buffer misses take a chunk from a cache without any
+  in.buffer_miss_bytes += 100ull << 20;
+  tuner.tune(in);
+  ASSERT_DOUBLE_EQ(0.5 - step, tuner.get_kv_ratio());
+  ASSERT_DOUBLE_EQ(0.25, tuner.get_meta_ratio());
+  ASSERT_DOUBLE_EQ(0.25 + step, tuner.get_data_ratio());
+
+  // misses are counted since the last round only
+  tuner.tune(in);
+  ASSERT_DOUBLE_EQ(0.25 + step, tuner.get_data_ratio());
+
+  // onode misses are weighed by the size of an onode: 1000 misses of
+  // 256k onodes outweigh 100M of buffer misses
+  in.onode_misses += 1000;
+  in.buffer_miss_bytes += 100ull << 20;
+  tuner.tune(in);
+  ASSERT_DOUBLE_EQ(0.5 - 2 * step, tuner.get_kv_ratio());
+  ASSERT_DOUBLE_EQ(0.25 + step, tuner.get_meta_ratio());
+  ASSERT_DOUBLE_EQ(0.25 + step, tuner.get_data_ratio());
+
+  // kv misses are counted in blocks
+  in.kv_misses += 1ull << 20;
+  auto t2 = tuner.tune(in);
+  ASSERT_DOUBLE_EQ(0.5 - step, tuner.get_kv_ratio());
+  ASSERT_EQ(t2.budget, t2.kv + t2.meta + t2.data);
+
+  // a counter reset is not taken for misses
+  in.kv_misses = 0;
+  in.onode_misses = 0;
+  in.buffer_miss_bytes = 0;
+  tuner.tune(in);
+  ASSERT_DOUBLE_EQ(0.5 - step, tuner.get_kv_ratio());
+
+  // reset starts over from the configuration
+  tuner.reset();
+  tuner.tune(in);
+  ASSERT_DOUBLE_EQ(0.5, tuner.get_kv_ratio());
+  ASSERT_DOUBLE_EQ(0.25, tuner.get_meta_ratio());
+  ASSERT_DOUBLE_EQ(0.25, tuner.get_data_ratio());
+}
+
+TEST(CacheAutotuner, KVWithoutStats)
+{
+  BlueStore::CacheAutotuner tuner(g_ceph_context);
+  auto in = autotune_inputs();
+  in.kv_stats = false;
+  auto t = tuner.tune(in);
+  double step = (double)in.chunk / t.budget;
+
+  // the kv cache keeps its share, it is neither grown nor shrunk
+  in.buffer_miss_bytes += 100ull << 20;
+  tuner.tune(in);
+  ASSERT_DOUBLE_EQ(0.5, tuner.get_kv_ratio());
+  ASSERT_DOUBLE_EQ(0.25 - step, tuner.get_meta_ratio());
+  ASSERT_DOUBLE_EQ(0.25 + step, tuner.get_data_ratio());
+}
+
+TEST(CacheAutotuner, Minimums)
+{
+  BlueStore::CacheAutotuner tuner(g_ceph_context);
+  auto in = autotune_inputs();
+  auto t = tuner.tune(in);
+  double step = (double)in.chunk / t.budget;
+
+  // the caches without misses give up chunks, but keep one each
+  for (int i = 0; i < 1000; ++i) {
+    in.buffer_miss_bytes += 100ull << 20;
+    t = tuner.tune(in);
+    ASSERT_EQ(t.budget, t.kv + t.meta + t.data);
+  }
+  ASSERT_GE(tuner.get_kv_ratio(), step * 0.999);
+  ASSERT_LT(tuner.get_kv_ratio(), 2 * step);
+  ASSERT_GE(tuner.get_meta_ratio(), step * 0.999);
+  ASSERT_LT(tuner.get_meta_ratio(), 2 * step);
+  ASSERT_NEAR(1.0, tuner.get_kv_ratio() + tuner.get_meta_ratio() +
+	      tuner.get_data_ratio(), 1e-9);
+  ASSERT_GE(t.kv, in.chunk * 0.999);
+  ASSERT_GE(t.meta, in.chunk * 0.999);
+
+  // a chunk larger than the budget moves nothing
+  BlueStore::CacheAutotuner tuner2(g_ceph_context);
+  in.chunk = 8ull << 30;
+  tuner2.tune(in);
+  in.buffer_miss_bytes += 100ull << 20;
+  tuner2.tune(in);
+  ASSERT_DOUBLE_EQ(0.5, tuner2.get_kv_ratio());
+  ASSERT_DOUBLE_EQ(0.25, tuner2.get_data_ratio());
+}
+
 int main(int argc, char **argv) {
   vector<const char*> args;
   argv_to_vec(argc, (const char **)argv, args);
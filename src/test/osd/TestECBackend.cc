@@ -17,6 +17,7 @@
 #include <errno.h>
 #include <signal.h>
 #include "osd/ECBackend.h"
+#include "osd/ECTransaction.h"
 #include "gtest/gtest.h"
 
 TEST(ECUtil, stripe_info_t)
@@ -58,3 +59,60 @@ TEST(ECUtil, stripe_info_t)
             make_pair((uint64_t)0, 2*swidth));
 }
 
+
+TEST(ECTransaction, can_update_parity_delta)
+{
+  const uint64_t swidth = 4096;
+  const uint64_t ssize = 4;
+  const uint64_t csize = swidth / ssize;
+  const uint64_t size = 4 * swidth;
+  ECUtil::stripe_info_t s(ssize, swidth);
+  hobject_t h(object_t("foo"), "", CEPH_NOSNAP, 0, 0, "");
+
+  auto check = [&](uint64_t off, uint64_t len,
+		   ECTransaction::ParityDelta *delta) {
+    PGTransaction t;
+    bufferlist bl;
+    bl.append_zero(len);
+    t.write(h, off, len, bl);
+    return ECTransaction::can_update_parity_delta(
+      s, size, t.op_map[h], delta);
+  };
+
+  ECTransaction::ParityDelta delta;
+  // within the third chunk of the second stripe
+  ASSERT_TRUE(check(swidth + 2 * csize + 10, 100, &delta));
+  ASSERT_EQ(swidth, delta.stripe_offset);
+  ASSERT_EQ(2u, delta.data_chunk);
+  // a whole chunk
+  ASSERT_TRUE(check(3 * csize, csize, &delta));
+  ASSERT_EQ(0u, delta.stripe_offset);
+  ASSERT_EQ(3u, delta.data_chunk);
+  // spans two chunks
+  ASSERT_FALSE(check(csize - 10, 20, &delta));
+  // spans two stripes
+  ASSERT_FALSE(check(swidth - 10, 20, &delta));
+  // past the end of the object
+  ASSERT_FALSE(check(size + 10, 20, &delta));
+
+  // anything else than a single overwrite
+  {
+    PGTransaction t;
+    bufferlist bl;
+    bl.append_zero(20);
+    t.write(h, 10, 20, bl);
+    t.truncate(h, size - swidth);
+    ASSERT_FALSE(ECTransaction::can_update_parity_delta(
+		   s, size, t.op_map[h], &delta));
+  }
+  {
+    PGTransaction t;
+    bufferlist bl;
+    bl.append_zero(10);
+    bufferlist bl2 = bl;
+    t.write(h, 10, 10, bl);
+    t.write(h, 100, 10, bl2);
+    ASSERT_FALSE(ECTransaction::can_update_parity_delta(
+		   s, size, t.op_map[h], &delta));
+  }
+}
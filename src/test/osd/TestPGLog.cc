@@ -362,9 +362,9 @@ TEST_F(PGLogTest, rewind_divergent_log) {
     rewind_divergent_log(newhead, info, &h,
 			 dirty_info, dirty_big_info);
 
-    EXPECT_TRUE(log.objects.count(divergent));
+    EXPECT_TRUE(log.logged_object(divergent));
     EXPECT_TRUE(missing.is_missing(divergent_object));
-    EXPECT_EQ(1U, log.objects.count(divergent_object));
+    EXPECT_TRUE(log.logged_object(divergent_object));
     EXPECT_EQ(2U, log.log.size());
     EXPECT_TRUE(remove_snap.empty());
     EXPECT_EQ(newhead, info.last_update);
@@ -428,7 +428,7 @@ TEST_F(PGLogTest, rewind_divergent_log) {
 			 dirty_info, dirty_big_info);
 
     EXPECT_TRUE(missing.is_missing(divergent_object));
-    EXPECT_EQ(0U, log.objects.count(divergent_object));
+    EXPECT_FALSE(log.logged_object(divergent_object));
     EXPECT_TRUE(log.empty());
     EXPECT_TRUE(remove_snap.empty());
     EXPECT_TRUE(is_dirty());
@@ -1074,7 +1074,7 @@ TEST_F(PGLogTest, merge_log) {
     }
 
     EXPECT_FALSE(missing.have_missing());
-    EXPECT_EQ(1U, log.objects.count(divergent_object));
+    EXPECT_TRUE(log.logged_object(divergent_object));
     EXPECT_EQ(3U, log.log.size());
     EXPECT_TRUE(remove_snap.empty());
     EXPECT_EQ(log.head, info.last_update);
@@ -1093,7 +1093,7 @@ TEST_F(PGLogTest, merge_log) {
        to be divergent.
     */
     EXPECT_TRUE(missing.is_missing(divergent_object));
-    EXPECT_EQ(1U, log.objects.count(divergent_object));
+    EXPECT_TRUE(log.logged_object(divergent_object));
     EXPECT_EQ(4U, log.log.size());
     /* DELETE entries from olog that are appended to the hed of the
        log are also added to remove_snap.
@@ -2031,7 +2031,7 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
   log.add(modify);
 
   EXPECT_TRUE(log.logged_object(oid));
-  pg_log_entry_t *entry = log.objects[oid];
+  const pg_log_entry_t *entry = log.get_latest_entry(oid);
   EXPECT_EQ(modify.op, entry->op);
   EXPECT_EQ(modify.version, entry->version);
   EXPECT_EQ(modify.prior_version, entry->prior_version);
@@ -2045,7 +2045,7 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
   log.add(del);
 
   EXPECT_TRUE(log.logged_object(oid));
-  entry = log.objects[oid];
+  entry = log.get_latest_entry(oid);
   EXPECT_EQ(del.op, entry->op);
   EXPECT_EQ(del.version, entry->version);
   EXPECT_EQ(del.prior_version, entry->prior_version);
@@ -2058,7 +2058,7 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
 		   utime_t(20,1), -ENOENT));
 
   EXPECT_TRUE(log.logged_object(oid));
-  entry = log.objects[oid];
+  entry = log.get_latest_entry(oid);
   EXPECT_EQ(del.op, entry->op);
   EXPECT_EQ(del.version, entry->version);
   EXPECT_EQ(del.prior_version, entry->prior_version);
@@ -2066,6 +2066,156 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
   EXPECT_EQ(del.reqid, entry->reqid);
 }
 
+TEST_F(PGLogTest, IndexBuiltOnDemand) {
+  clear();
+
+  hobject_t oid(object_t("objname"), "key", 123, 456, 0, "");
+  pg_log_entry_t modify(pg_log_entry_t::MODIFY, oid, eversion_t(6,3),
+			eversion_t(3,4), 2,
+			osd_reqid_t(entity_name_t::CLIENT(777), 8, 2),
+			utime_t(1,2), 0);
+  mempool::osd::list<pg_log_entry_t> entries;
+  entries.push_back(modify);
+  IndexedLog loaded(eversion_t(6,3), eversion_t(3,4), eversion_t(),
+		    eversion_t(), std::move(entries));
+
+  // a freshly loaded log has no index until something looks it up
+  EXPECT_FALSE(loaded.has_index(PGLOG_INDEXED_OBJECTS));
+  EXPECT_TRUE(loaded.caller_ops.empty());
+
+  EXPECT_TRUE(loaded.logged_object(oid));
+  EXPECT_TRUE(loaded.has_index(PGLOG_INDEXED_OBJECTS));
+  EXPECT_TRUE(loaded.caller_ops.empty());
+  const pg_log_entry_t *entry = loaded.get_latest_entry(oid);
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(modify.version, entry->version);
+
+  EXPECT_TRUE(loaded.logged_req(modify.reqid));
+  EXPECT_EQ(1U, loaded.caller_ops.size());
+
+  // entries added after the index was built are indexed as well
+  pg_log_entry_t del(pg_log_entry_t::DELETE, oid, eversion_t(7,4),
+		     eversion_t(6,3), 3,
+		     osd_reqid_t(entity_name_t::CLIENT(777), 8, 3),
+		     utime_t(10,2), 0);
+  loaded.add(del);
+  EXPECT_EQ(del.version, loaded.get_latest_entry(oid)->version);
+  EXPECT_EQ(2U, loaded.caller_ops.size());
+
+  loaded.unindex();
+  EXPECT_FALSE(loaded.has_index(PGLOG_INDEXED_OBJECTS));
+  EXPECT_TRUE(loaded.caller_ops.empty());
+  EXPECT_TRUE(loaded.logged_req(del.reqid));
+
+  // entries added while the objects index is dropped are still found,
+  // the index is rebuilt from the log on the next lookup
+  pg_log_entry_t mod2(pg_log_entry_t::MODIFY, oid, eversion_t(8,5),
+		      eversion_t(7,4), 4,
+		      osd_reqid_t(entity_name_t::CLIENT(777), 8, 4),
+		      utime_t(11,2), 0);
+  loaded.unindex();
+  loaded.add(mod2);
+  EXPECT_FALSE(loaded.has_index(PGLOG_INDEXED_OBJECTS));
+  entry = loaded.get_latest_entry(oid);
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(mod2.version, entry->version);
+  EXPECT_TRUE(loaded.has_index(PGLOG_INDEXED_OBJECTS));
+}
+
+TEST_F(PGLogTest, JournalRecord) {
+  clear();
+
+  add(mk_ple_mod(mk_obj(1), mk_evt(10, 100), mk_evt(8, 80)));
+  add(mk_ple_mod(mk_obj(2), mk_evt(10, 101), mk_evt(8, 81)));
+  add(mk_ple_dt(mk_obj(3), mk_evt(10, 102), mk_evt(8, 82)));
+
+  bufferlist bl;
+  encode_journal_record(log, mk_evt(10, 101), true, bl);
+  encode_journal_record(log, eversion_t::max(), false, bl);
+
+  list<pg_log_entry_t> entries;
+  eversion_t can_rollback_to, rollback_info_trimmed_to;
+  bufferlist::iterator p = bl.begin();
+  decode_journal_record(p, &entries, &can_rollback_to,
+			&rollback_info_trimmed_to);
+  ASSERT_EQ(2U, entries.size());
+  EXPECT_EQ(mk_evt(10, 101), entries.front().version);
+  EXPECT_EQ(mk_evt(10, 102), entries.back().version);
+  EXPECT_EQ(mk_obj(3), entries.back().soid);
+  EXPECT_EQ(log.get_can_rollback_to(), can_rollback_to);
+  EXPECT_EQ(log.get_rollback_info_trimmed_to(), rollback_info_trimmed_to);
+
+  // a record without entries nor rollback info leaves them alone
+  entries.clear();
+  can_rollback_to = eversion_t();
+  decode_journal_record(p, &entries, &can_rollback_to,
+			&rollback_info_trimmed_to);
+  EXPECT_TRUE(entries.empty());
+  EXPECT_EQ(eversion_t(), can_rollback_to);
+  EXPECT_TRUE(p.end());
+}
+
+TEST_F(PGLogTest, JournalAppendAndCheckpoint) {
+  g_ceph_context->_conf->set_val("osd_pg_log_journal_max_bytes", "65536");
+  g_ceph_context->_conf->apply_changes(NULL);
+  clear();
+
+  coll_t coll;
+  ghobject_t log_oid(mk_obj(0));
+
+  // the first write goes to omap
+  add(mk_ple_mod(mk_obj(1), mk_evt(10, 100), mk_evt(8, 80)));
+  {
+    ObjectStore::Transaction t;
+    map<string,bufferlist> km;
+    write_log_and_missing(t, &km, coll, log_oid, false);
+    EXPECT_TRUE(km.count(mk_evt(10, 100).get_key_name()));
+    EXPECT_EQ(0U, journal.bytes);
+  }
+
+  // appends go to the object data
+  add(mk_ple_mod(mk_obj(2), mk_evt(10, 101), mk_evt(8, 81)));
+  {
+    ObjectStore::Transaction t;
+    map<string,bufferlist> km;
+    write_log_and_missing(t, &km, coll, log_oid, false);
+    EXPECT_FALSE(km.count(mk_evt(10, 101).get_key_name()));
+    EXPECT_LT(0U, journal.bytes);
+    EXPECT_EQ(mk_evt(10, 101), journal.from);
+  }
+
+  // trimming an entry that is in omap is deferred
+  pg_info_t info;
+  info.last_complete = mk_evt(10, 101);
+  log.skip_can_rollback_to_to_head();
+  trim(mk_evt(10, 100), info);
+  add(mk_ple_mod(mk_obj(3), mk_evt(10, 102), mk_evt(8, 82)));
+  {
+    ObjectStore::Transaction t;
+    map<string,bufferlist> km;
+    write_log_and_missing(t, &km, coll, log_oid, false);
+    EXPECT_TRUE(km.empty());
+    EXPECT_EQ(1U, journal.trimmed.count(mk_evt(10, 100)));
+  }
+
+  // anything but an append checkpoints the journal to omap
+  mark_log_for_rewrite();
+  {
+    ObjectStore::Transaction t;
+    map<string,bufferlist> km;
+    write_log_and_missing(t, &km, coll, log_oid, false);
+    EXPECT_FALSE(km.count(mk_evt(10, 100).get_key_name()));
+    EXPECT_TRUE(km.count(mk_evt(10, 101).get_key_name()));
+    EXPECT_TRUE(km.count(mk_evt(10, 102).get_key_name()));
+    EXPECT_EQ(0U, journal.bytes);
+    EXPECT_EQ(eversion_t::max(), journal.from);
+    EXPECT_TRUE(journal.trimmed.empty());
+  }
+
+  g_ceph_context->_conf->set_val("osd_pg_log_journal_max_bytes", "0");
+  g_ceph_context->_conf->apply_changes(NULL);
+}
+
 // Local Variables:
 // compile-command: "cd ../.. ; make unittest_pglog ; ./unittest_pglog --log-to-stderr=true  --debug-osd=20 # --gtest_filter=*.* "
 // End:
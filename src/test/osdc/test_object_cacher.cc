@@ -0,0 +1,196 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "common/Cond.h"
+#include "common/Mutex.h"
+#include "global/global_context.h"
+#include "include/rados/librados.h"
+#include "osdc/ObjectCacher.h"
+#include "osdc/WritebackHandler.h"
+
+namespace {
+
+const uint64_t object_size = 1 << 16;
+const uint64_t max_readahead = 8 * object_size;
+
+/*
+ * Holds on to every read until the test completes it, so that the reads
+ * each readx issues (demand and readahead) can be looked at.
+ */
+class RecordingWriteback : public WritebackHandler {
+public:
+  struct Read {
+    uint64_t object_no;
+    uint64_t off;
+    uint64_t len;
+    bufferlist *pbl;
+    Context *onfinish;
+  };
+  std::vector<Read> reads;
+
+  void read(const object_t& oid, uint64_t object_no,
+	    const object_locator_t& oloc, uint64_t off, uint64_t len,
+	    snapid_t snapid, bufferlist *pbl, uint64_t trunc_size,
+	    __u32 trunc_seq, int op_flags, Context *onfinish) override {
+    reads.push_back(Read{object_no, off, len, pbl, onfinish});
+  }
+
+  bool may_copy_on_write(const object_t&, uint64_t, uint64_t,
+			 snapid_t) override {
+    return false;
+  }
+
+  ceph_tid_t write(const object_t& oid, const object_locator_t& oloc,
+		   uint64_t off, uint64_t len,
+		   const SnapContext& snapc, const bufferlist &bl,
+		   ceph::real_time mtime, uint64_t trunc_size,
+		   __u32 trunc_seq, ceph_tid_t journal_tid,
+		   Context *oncommit) override {
+    ceph_abort();
+    return 0;
+  }
+
+  using WritebackHandler::write;
+
+  // called with the cache lock held
+  void complete_reads() {
+    std::vector<Read> ls;
+    ls.swap(reads);
+    for (auto& r : ls) {
+      bufferptr bp(r.len);
+      bp.zero();
+      r.pbl->append(bp);
+      r.onfinish->complete(r.len);
+    }
+  }
+};
+
+class TestObjectCacherReadahead : public ::testing::Test {
+public:
+  Mutex lock;
+  RecordingWriteback wb;
+  ObjectCacher obc;
+  ObjectCacher::ObjectSet oset;
+  file_layout_t layout;
+
+  TestObjectCacherReadahead()
+    : lock("TestObjectCacherReadahead::lock"),
+      obc(g_ceph_context, "test", wb, lock, NULL, NULL,
+	  128 * object_size, 1000, 0, 0, 1.0, true),
+      oset(NULL, 0, 1) {
+    layout.stripe_unit = object_size;
+    layout.stripe_count = 1;
+    layout.object_size = object_size;
+    layout.pool_id = 0;
+    obc.set_max_readahead(max_readahead);
+  }
+
+  void SetUp() override {
+    obc.start();
+  }
+
+  void TearDown() override {
+    lock.Lock();
+    wb.complete_reads();
+    obc.release_set(&oset);
+    lock.Unlock();
+    obc.stop();
+  }
+
+  /* reads off~len; returns the end (in file offsets) of everything the
+   * read sent to the OSDs, or 0 if it was served from the cache */
+  uint64_t read(uint64_t off, uint64_t len) {
+    bufferlist bl;
+    C_SaferCond cond;
+    lock.Lock();
+    int r = obc.file_read(&oset, &layout, CEPH_NOSNAP, off, len, &bl, 0,
+			  &cond);
+    uint64_t end = 0;
+    for (auto& rd : wb.reads) {
+      end = MAX(end, rd.object_no * object_size + rd.off + rd.len);
+    }
+    wb.complete_reads();
+    if (r != 0) {
+      cond.complete(r);
+    }
+    lock.Unlock();
+    EXPECT_EQ((int)len, cond.wait());
+    EXPECT_EQ(len, bl.length());
+    return end;
+  }
+};
+
+} // anonymous namespace
+
+TEST_F(TestObjectCacherReadahead, WindowGrows) {
+  const uint64_t len = 1 << 14;
+
+  // the first read of the stream reads ahead one object
+  ASSERT_EQ(2 * object_size, read(0, len));
+
+  // nothing more until the reader is within half a window of the end
+  uint64_t off = len;
+  for (; off + len < 2 * object_size - object_size / 2; off += len) {
+    ASSERT_EQ(0u, read(off, len));
+  }
+  // then the window doubles
+  ASSERT_EQ(4 * object_size, read(off, len));
+  off += len;
+
+  // and keeps doubling up to max_readahead
+  uint64_t window = 2 * object_size;
+  uint64_t readahead_end = 4 * object_size;
+  for (; off < 64 * object_size; off += len) {
+    uint64_t end = read(off, len);
+    if (end == 0)
+      continue;
+    window = MIN(window * 2, max_readahead);
+    ASSERT_EQ(ROUND_UP_TO(off + len + window, object_size), end);
+    ASSERT_LE(end - (off + len), max_readahead + object_size);
+    readahead_end = end;
+  }
+  ASSERT_EQ(max_readahead, window);
+  ASSERT_GT(readahead_end, off);
+}
+
+TEST_F(TestObjectCacherReadahead, ResetOnRandomRead) {
+  const uint64_t len = 1 << 14;
+
+  ASSERT_EQ(2 * object_size, read(0, len));
+  for (uint64_t off = len; off < 2 * object_size; off += len) {
+    read(off, len);
+  }
+
+  // a jump somewhere else only reads what was asked for
+  const uint64_t jump = 40 * object_size;
+  ASSERT_EQ(jump + len, read(jump, len));
+
+  // and a new stream starts from there with a one object window
+  ASSERT_EQ(jump + 2 * object_size, read(jump + len, len));
+
+  // reading backwards resets it again
+  ASSERT_EQ(20 * object_size + len, read(20 * object_size, len));
+}
+
+TEST_F(TestObjectCacherReadahead, RandomAdviceSkipsReadahead) {
+  const uint64_t len = 1 << 14;
+  for (uint64_t off = 0; off < 4 * object_size; off += len) {
+    bufferlist bl;
+    C_SaferCond cond;
+    lock.Lock();
+    int r = obc.file_read(&oset, &layout, CEPH_NOSNAP, off, len, &bl,
+			  LIBRADOS_OP_FLAG_FADVISE_RANDOM, &cond);
+    for (auto& rd : wb.reads) {
+      EXPECT_LE(rd.object_no * object_size + rd.off + rd.len, off + len);
+    }
+    wb.complete_reads();
+    if (r != 0) {
+      cond.complete(r);
+    }
+    lock.Unlock();
+    ASSERT_EQ((int)len, cond.wait());
+  }
+}